@@ -268,14 +268,7 @@ add.gdsn <- function(node, name, val=NULL, storage=storage.mode(val),
     stopifnot(inherits(node, "gdsn.class"))
 
     if (missing(name))
-    {
-        nmlist <- ls.gdsn(node)
-        repeat {
-            name <- sprintf("tmp_%06x", round(runif(1, 0, 2^24-1)))
-            if (!is.element(name, nmlist))
-                break
-        }
-    }
+        name <- .tmp_name(node)
     stopifnot(is.character(name), length(name)==1L)
 
     dots <- list(...)
@@ -353,14 +346,7 @@ addfolder.gdsn <- function(node, name, type=c("directory", "virtual"),
     stopifnot(inherits(node, "gdsn.class"))
 
     if (missing(name))
-    {
-        nmlist <- ls.gdsn(node)
-        repeat {
-            name <- sprintf("tmp_%06x", round(runif(1, 0, 2^24-1)))
-            if (!is.element(name, nmlist))
-                break
-        }
-    }
+        name <- .tmp_name(node)
     stopifnot(is.character(name), length(name)==1L)
 
     type <- match.arg(type)
@@ -381,6 +367,76 @@ addfolder.gdsn <- function(node, name, type=c("directory", "virtual"),
 }
 
 
+#############################################################
+# Add a concatenated array of existing arrays
+#
+addconcat.gdsn <- function(node, name, members, replace=FALSE, visible=TRUE)
+{
+    if (inherits(node, "gds.class"))
+        node <- node$root
+    stopifnot(inherits(node, "gdsn.class"))
+
+    if (missing(name))
+        name <- .tmp_name(node)
+    stopifnot(is.character(name), length(name)==1L)
+
+    if (inherits(members, "gdsn.class"))
+        members <- list(members)
+    stopifnot(is.list(members), length(members) > 0L)
+    for (i in seq_along(members))
+    {
+        if (!inherits(members[[i]], "gdsn.class"))
+            stop("'members[[", i, "]]' should be a 'gdsn.class' object.")
+    }
+
+    stopifnot(is.logical(replace))
+    stopifnot(is.logical(visible))
+
+    # call C function
+    ans <- .Call(gdsAddConcat, node, name, members, replace, visible)
+
+    invisible(ans)
+}
+
+
+#############################################################
+# Add a computed array of existing arrays
+#
+addcompute.gdsn <- function(node, name, expr, sources, replace=FALSE,
+    visible=TRUE)
+{
+    if (inherits(node, "gds.class"))
+        node <- node$root
+    stopifnot(inherits(node, "gdsn.class"))
+
+    if (missing(name))
+        name <- .tmp_name(node)
+    stopifnot(is.character(name), length(name)==1L)
+
+    if (is.language(expr))
+        expr <- paste(deparse(expr), collapse="")
+    stopifnot(is.character(expr), length(expr)==1L, !is.na(expr))
+
+    stopifnot(is.list(sources), length(sources) > 0L)
+    if (is.null(names(sources)) || anyNA(names(sources)) ||
+            any(names(sources) == ""))
+        stop("'sources' should be a named list.")
+    for (i in seq_along(sources))
+    {
+        if (!inherits(sources[[i]], "gdsn.class"))
+            stop("'sources[[", i, "]]' should be a 'gdsn.class' object.")
+    }
+
+    stopifnot(is.logical(replace))
+    stopifnot(is.logical(visible))
+
+    # call C function
+    ans <- .Call(gdsAddCompute, node, name, expr, sources, replace, visible)
+
+    invisible(ans)
+}
+
+
 #############################################################
 # Add a GDS node with a file
 #
@@ -393,14 +449,7 @@ addfile.gdsn <- function(node, name, filename,
     stopifnot(inherits(node, "gdsn.class"))
 
     if (missing(name))
-    {
-        nmlist <- ls.gdsn(node)
-        repeat {
-            name <- sprintf("tmp_%06x", round(runif(1, 0, 2^24-1)))
-            if (!is.element(name, nmlist))
-                break
-        }
-    }
+        name <- .tmp_name(node)
     stopifnot(is.character(name), length(name)==1L)
     stopifnot(is.character(filename), length(filename)==1L)
 
@@ -580,20 +629,18 @@ permdim.gdsn <- function(node, dimidx, target=NULL)
         vdim[length(vdim)] <- 0L
         setdim.gdsn(target.node, vdim, permute=FALSE)
 
+        # reading, permuting and appending margins run concurrently
         if (length(dm) == 2L)
         {
             # tranpose a matrix
-            apply.gdsn(node, margin=1L, FUN=`c`,
-                as.is="gdsnode", target.node=target.node, .useraw=TRUE)
+            .Call(gdsPipeline, node, 1L, NULL, target.node, NULL)
             readmode.gdsn(target.node)
         } else {
             i <- dimidx[length(dimidx)]
             dimidx <- dimidx[-length(dimidx)]
             dimidx[dimidx > i] <- dimidx[dimidx > i] - 1L
 
-            apply.gdsn(node, margin=i, FUN=aperm,
-                as.is="gdsnode", target.node=target.node, .useraw=TRUE,
-                perm = dimidx)
+            .Call(gdsPipeline, node, i, NULL, target.node, dimidx)
             readmode.gdsn(target.node)
         }
 
@@ -663,6 +710,15 @@ read.gdsn <- function(node, start=NULL, count=NULL,
         }
     }
 
+    # multiple hyperslabs, one column per hyperslab
+    #   (a one-column matrix is a single hyperslab as before)
+    if (is.matrix(start) && is.matrix(count) &&
+        (NCOL(start) > 1L || NCOL(count) > 1L))
+    {
+        return(.Call(gdsObjReadMulti, node, start, count, simplify, .useraw,
+            list(.value, .substitute)))
+    }
+
     .Call(gdsObjReadData, node, start, count, simplify, .useraw,
         list(.value, .substitute), .sparse)
 }
@@ -702,7 +758,8 @@ readex.gdsn <- function(node, sel=NULL, simplify=c("auto", "none", "force"),
 apply.gdsn <- function(node, margin, FUN, selection=NULL,
     as.is=c("list", "none", "integer", "double", "character", "logical",
     "raw", "gdsnode"), var.index=c("none", "relative", "absolute"),
-    target.node=NULL, .useraw=FALSE, .value=NULL, .substitute=NULL, ...)
+    target.node=NULL, .useraw=FALSE, .value=NULL, .substitute=NULL,
+    .bufsize=NA, ...)
 {
     # check
     if (inherits(node, "gdsn.class"))
@@ -760,10 +817,14 @@ apply.gdsn <- function(node, margin, FUN, selection=NULL,
     # call C function -- set starting index
     .Call(gdsApplySetStart, 1L)
 
+    # stop the decoding threads if 'FUN' fails
+    nd <- .Call(gdsApplyStopDecoder, -1L)
+    on.exit(.Call(gdsApplyStopDecoder, nd))
+
     # call C function -- apply calling
     ans <- .Call(gdsApplyCall, node, as.integer(margin), FUN,
         selection, as.is, var.index, target.node, new.env(),
-        .useraw, list(.value, .substitute))
+        .useraw, list(.value, .substitute), .bufsize)
 
     if (is.null(ans))
         invisible()
@@ -779,7 +840,7 @@ clusterApply.gdsn <- function(cl, gds.fn, node.name, margin,
     FUN, selection=NULL, as.is=c("list", "none", "integer", "double",
     "character", "logical", "raw"),
     var.index=c("none", "relative", "absolute"), .useraw=FALSE,
-    .value=NULL, .substitute=NULL, ...)
+    .value=NULL, .substitute=NULL, .bufsize=NA, ...)
 {
     #########################################################
     # library
@@ -844,11 +905,30 @@ clusterApply.gdsn <- function(cl, gds.fn, node.name, margin,
 
     if (length(cl) > 1L)
     {
+        # split the margins at the boundaries of compressed blocks, and the
+        # block lists handed over to the workers
+        sp <- .Call(gdsApplySplitMargin, nd_nodes, margin[1L],
+            new.selection[[1L]], length(cl))
+
         # close the GDS file
         closefn.gds(gfile)
         on.exit()
 
-        clseq <- parallel::splitIndices(MarginCount, length(cl))
+        # split the process-wide memory limit among the workers
+        if (is.na(.bufsize))
+        {
+            lim <- getOption("gds.memory.limit", NA_real_)
+            if (!is.null(lim) && is.finite(lim))
+                .bufsize <- lim / length(cl)
+        }
+
+        clseq <- vector("list", length(cl))
+        st <- 0L
+        for (i in seq_along(sp$count))
+        {
+            clseq[[i]] <- st + seq_len(sp$count[i])
+            st <- st + sp$count[i]
+        }
         sel.list <- vector("list", length(cl))
         start <- 1L
 
@@ -871,7 +951,8 @@ clusterApply.gdsn <- function(cl, gds.fn, node.name, margin,
                     tmp[[j]] <- sel
                 }
 
-                sel.list[[i]] <- list(start=start, n=n, sel=tmp)
+                sel.list[[i]] <- list(start=start, n=n, sel=tmp,
+                    block=sp$block)
                 start <- start + n
             } else {
                 sel.list[[i]] <- list(start=start, n=0L, sel=NULL)
@@ -890,20 +971,26 @@ clusterApply.gdsn <- function(cl, gds.fn, node.name, margin,
 
                 # open the file
                 gfile <- openfn.gds(gds.fn, allow.duplicate=TRUE)
-                on.exit({ closefn.gds(gfile) })
+                on.exit({
+                    .Call(gdsApplyStopDecoder, 0L)
+                    closefn.gds(gfile)
+                })
 
                 nd_nodes <- vector("list", length(node.name))
                 names(nd_nodes) <- names(node.name)
                 for (i in seq_along(nd_nodes))
                     nd_nodes[[i]] <- index.gdsn(gfile, path=node.name[i])
 
+                # use the block lists instead of scanning the block headers
+                .Call(gdsApplySetBlockInfo, nd_nodes, item$block)
+
                 # call C function -- set starting index
                 .Call(gdsApplySetStart, item$start)
 
                 # call C function -- apply calling
                 .Call(gdsApplyCall, nd_nodes, margin, FUN, item$sel, as.is,
                     var.index, NULL, new.env(), .useraw,
-                    list(.value, .substitute))
+                    list(.value, .substitute), .bufsize)
 
             }, gds.fn=gds.fn, node.name=node.name, margin=margin,
                 FUN=FUN, as.is=as.is, var.index=var.index, ...
@@ -916,7 +1003,8 @@ clusterApply.gdsn <- function(cl, gds.fn, node.name, margin,
 
     } else {
         apply.gdsn(nd_nodes, margin, FUN, selection, as.is,
-            var.index, .useraw, ...)
+            var.index, .useraw=.useraw, .value=.value,
+            .substitute=.substitute, .bufsize=.bufsize, ...)
     }
 }
 
@@ -1094,10 +1182,15 @@ assign.gdsn <- function(node, src.node=NULL, resize=TRUE, seldim=NULL,
                 setdim.gdsn(dst, dm, permute=FALSE)
             }
 
-            .useraw <- is.null(.value) & is.null(.substitute)
-            apply.gdsn(src, margin=length(dm), FUN=`c`, selection=seldim,
-                as.is="gdsnode", target.node=dst, .useraw=.useraw,
-                .value=.value, .substitute=.substitute)
+            if (is.null(.value) & is.null(.substitute))
+            {
+                # reading and appending margins run concurrently
+                .Call(gdsPipeline, src, length(dm), seldim, dst, NULL)
+            } else {
+                apply.gdsn(src, margin=length(dm), FUN=`c`, selection=seldim,
+                    as.is="gdsnode", target.node=dst,
+                    .value=.value, .substitute=.substitute)
+            }
             if (!append) readmode.gdsn(dst)
         }
 
@@ -1303,7 +1396,16 @@ system.gds <- function()
 
     rv$options <- list(
         gds.crayon = getOption("gds.crayon", NULL),
+        gds.apply.nthread = getOption("gds.apply.nthread", NULL),
+        gds.block.cache = getOption("gds.block.cache", NULL),
+        gds.memory.limit = getOption("gds.memory.limit", NULL),
+        gds.meta.index = getOption("gds.meta.index", FALSE),
+        gds.node.cache = getOption("gds.node.cache", NULL),
+        gds.numa = getOption("gds.numa", FALSE),
         gds.parallel = getOption("gds.parallel", NULL),
+        gds.prefetch = getOption("gds.prefetch", FALSE),
+        gds.progress = getOption("gds.progress", FALSE),
+        gds.swmr = getOption("gds.swmr", FALSE),
         gds.verbose = getOption("gds.verbose", FALSE)
     )
 
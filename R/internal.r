@@ -80,6 +80,19 @@ options(gds.verbose=TRUE)
 .pretty_dsize <- function(sz) .Call(gdsFmtSize, sz)
 
 
+# return a random name "tmp_XXXXXX" not used by the children of node
+.tmp_name <- function(node)
+{
+    nmlist <- ls.gdsn(node)
+    repeat {
+        name <- sprintf("tmp_%06x", round(runif(1, 0, 2^24-1)))
+        if (!is.element(name, nmlist))
+            break
+    }
+    name
+}
+
+
 
 ##############################################################################
 # Parallel functions
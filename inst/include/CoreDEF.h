@@ -72,6 +72,9 @@
  *  \subsection compression COREARRAY_NO_TARGET
  *  If defined, does not use __attribute__((target())) or __attribute__((target_clones()))
  *
+ *  \subsection no_atomic_ref COREARRAY_NO_ATOMIC_REF
+ *  If defined, CdRef uses plain integer reference counting for single-threaded builds
+ *
 **/
 
 
@@ -138,6 +138,12 @@ extern "C" {
 	#define GDS_R_READ_ALLOW_RAW_TYPE    0x01
 	/// the mode of R data allowing sparse matrix, used in GDS_R_Array_Read (requiring >= v1.23.6)
 	#define GDS_R_READ_ALLOW_SP_MATRIX   0x10
+	/// the mode of prefetching the next block in background, used in GDS_R_Apply (requiring >= v1.49.1)
+	#define GDS_R_READ_PREFETCH          0x20
+	/// the mode of showing the progress in GDS_R_Apply (requiring >= v1.49.1)
+	#define GDS_R_READ_PROGRESS          0x40
+	/// the number of threads decoding the margins ahead in GDS_R_Apply, stored in the high 8 bits (requiring >= v1.49.1)
+	#define GDS_R_READ_DECODE_THREAD(n)  (((C_UInt32)(n) & 0xFF) << 24)
 
 
 
@@ -180,6 +186,17 @@ extern "C" {
 			PdArrayRead ReadObjList[], void *_Param),
 		void (*LoopFunc)(SEXP Argument, C_Int32 Idx, void *_Param),
 		void *Param, C_BOOL IncOrDec, C_UInt32 UseMode);
+	/// apply user-defined function margin by margin with a memory budget (requiring >= v1.49.1)
+	extern void GDS_R_Apply2(int Num, PdAbstractArray ObjList[],
+		int Margins[], const C_BOOL *const * const Selection[],
+		void (*InitFunc)(SEXP Argument, C_Int32 Count,
+			PdArrayRead ReadObjList[], void *_Param),
+		void (*LoopFunc)(SEXP Argument, C_Int32 Idx, void *_Param),
+		void *Param, C_BOOL IncOrDec, C_UInt32 UseMode, C_Int64 BufferSize);
+	/// get the numbers of finished and all margins in the outermost running GDS_R_Apply from any thread (requiring >= v1.49.1)
+	extern void GDS_R_Apply_Progress(C_Int64 *Done, C_Int64 *Total);
+	/// request the running (or the next) GDS_R_Apply to stop before the next margin from any thread (requiring >= v1.49.1)
+	extern void GDS_R_Apply_Cancel(void);
 	/// append R data
 	extern void GDS_R_Append(PdAbstractArray Obj, SEXP Val);
 	/// append R data with a range
@@ -215,7 +232,8 @@ extern "C" {
 	extern void GDS_File_Close(PdGDSFile File);
 	/// synchronize the GDS file
 	extern void GDS_File_Sync(PdGDSFile File);
-	/// reopen the GDS file based on R object if needed (requiring >= 1.23.9)
+	/// reopen the GDS file based on R object if needed (requiring >= 1.23.9),
+	/// or load the changes committed by the writer in the SWMR mode
 	extern C_BOOL GDS_File_Reopen(SEXP GDSObj);
 	/// get the root folder of a GDS file
 	extern PdGDSFolder GDS_File_Root(PdGDSFile File);
@@ -232,7 +250,8 @@ extern "C" {
 	extern void GDS_Node_GetClassName(PdGDSObj Node, char *OutStr, size_t OutSize);
 	/// get the number of nodes in the folder
 	extern int GDS_Node_ChildCount(PdGDSFolder Node);
-	/// get a GDS file specified by a path
+	/// get a GDS node specified by a path, which might be unloaded by the node
+	/// cache ('options(gds.node.cache)') once other nodes are loaded
 	extern PdGDSObj GDS_Node_Path(PdGDSFolder Node, const char *Path,
 		C_BOOL MustExist);
 
@@ -282,6 +301,29 @@ extern "C" {
 	extern void *GDS_Array_ReadDataEx(PdAbstractArray Obj, const C_Int32 *Start,
 		const C_Int32 *Length, const C_BOOL *const Selection[], void *OutBuf,
 		enum C_SVType OutSV);
+	/// read data with integer indices in any order (requiring >= v1.49.1)
+	/** \param Obj         GDS array object
+	 *  \param Index       the zero-based indices of each dimension, it could
+	 *                     be NULL, or Index[i] = NULL for the whole dimension
+	 *  \param IdxCnt      the number of indices of each dimension
+	 *  \param OutBuffer   the pointer to the output buffer
+	 *  \param OutSV       data type of output buffer
+	**/
+	extern void *GDS_Array_ReadDataEx2(PdAbstractArray Obj,
+		const C_Int32 *const Index[], const C_Int32 IdxCnt[], void *OutBuf,
+		enum C_SVType OutSV);
+	/// read multiple hyperslabs with merged reading (requiring >= v1.49.1)
+	/** \param Obj         GDS array object
+	 *  \param NumSlab     the number of hyperslabs
+	 *  \param Start       the starting positions (from ZERO), NumSlab*DimCnt
+	 *  \param Length      the lengths of hyperslabs, NumSlab*DimCnt
+	 *  \param OutBuf      the output buffers of hyperslabs, OutBuf[i] = NULL
+	 *                     (i > 0) to follow the data of the previous one
+	 *  \param OutSV       data type of output buffers
+	**/
+	extern void GDS_Array_ReadDataMulti(PdAbstractArray Obj, int NumSlab,
+		const C_Int32 *Start, const C_Int32 *Length, void *const OutBuf[],
+		enum C_SVType OutSV);
 	/// write data
 	/** \param Obj         GDS array object
 	 *  \param Start       the starting positions (from ZERO), it could be NULL
@@ -386,7 +428,7 @@ extern "C" {
 	/// wake up the object
 	extern void GDS_Parallel_WakeUp(PdThreadsSuspending Obj);
 
-	/// run the function with multiple threads
+	/// run the function with multiple threads, which are reused from a pool (>= v1.49.1)
 	extern void GDS_Parallel_RunThreads(
 		void (*Proc)(PdThread, int, void*), void *Param, int nThread);
 
@@ -418,6 +460,12 @@ extern "C" {
 	/// balance the buffers of multiple array objects according to the total buffer size
 	extern void GDS_ArrayRead_BalanceBuffer(PdArrayRead array[], int n,
 		C_Int64 buffer_size);
+	/// read the array object margin by margin with multiple threads, calling Proc in order or not (requiring >= v1.49.1)
+	extern void GDS_ArrayRead_Parallel(PdAbstractArray Obj, int Margin,
+		enum C_SVType SVType, const C_BOOL *const Selection[], int nThread,
+		C_BOOL Ordered,
+		void (*Proc)(int iThread, C_Int32 Idx, void *Buffer, void *Param),
+		void *Param);
 
 
 	// ==================================================================
@@ -146,6 +146,37 @@ COREARRAY_DLL_LOCAL void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 		Param, IncOrDec, UseMode);
 }
 
+typedef void (*Type_R_Apply2)(int, PdAbstractArray [], int [],
+	const C_BOOL *const * const [],
+	void (*)(SEXP, C_Int32, PdArrayRead [], void *),
+	void (*)(SEXP, C_Int32, void *), void *, C_BOOL, C_UInt32 UseMode,
+	C_Int64 BufferSize);
+static Type_R_Apply2 func_R_Apply2 = NULL;
+COREARRAY_DLL_LOCAL void GDS_R_Apply2(int Num, PdAbstractArray ObjList[],
+	int Margins[], const C_BOOL *const * const Selection[],
+	void (*InitFunc)(SEXP Argument, C_Int32 Count, PdArrayRead ReadObjList[],
+		void *_Param),
+	void (*LoopFunc)(SEXP Argument, C_Int32 Idx, void *_Param),
+	void *Param, C_BOOL IncOrDec, C_UInt32 UseMode, C_Int64 BufferSize)
+{
+	(*func_R_Apply2)(Num, ObjList, Margins, Selection, InitFunc, LoopFunc,
+		Param, IncOrDec, UseMode, BufferSize);
+}
+
+typedef void (*Type_R_Apply_Progress)(C_Int64 *, C_Int64 *);
+static Type_R_Apply_Progress func_R_Apply_Progress = NULL;
+COREARRAY_DLL_LOCAL void GDS_R_Apply_Progress(C_Int64 *Done, C_Int64 *Total)
+{
+	(*func_R_Apply_Progress)(Done, Total);
+}
+
+typedef void (*Type_R_Apply_Cancel)();
+static Type_R_Apply_Cancel func_R_Apply_Cancel = NULL;
+COREARRAY_DLL_LOCAL void GDS_R_Apply_Cancel()
+{
+	(*func_R_Apply_Cancel)();
+}
+
 typedef void (*Type_R_Append)(PdAbstractArray, SEXP);
 static Type_R_Append func_R_Append = NULL;
 COREARRAY_DLL_LOCAL void GDS_R_Append(PdAbstractArray Obj, SEXP Data)
@@ -361,6 +392,26 @@ COREARRAY_DLL_LOCAL void *GDS_Array_ReadDataEx(PdAbstractArray Obj,
 	return (*func_Array_ReadDataEx)(Obj, Start, Length, Selection, OutBuf, OutSV);
 }
 
+typedef void* (*Type_Array_ReadDataEx2)(PdAbstractArray, const C_Int32 *const [],
+	C_Int32 const [], void *, enum C_SVType OutSV);
+static Type_Array_ReadDataEx2 func_Array_ReadDataEx2 = NULL;
+COREARRAY_DLL_LOCAL void *GDS_Array_ReadDataEx2(PdAbstractArray Obj,
+	const C_Int32 *const Index[], C_Int32 const IdxCnt[], void *OutBuf,
+	enum C_SVType OutSV)
+{
+	return (*func_Array_ReadDataEx2)(Obj, Index, IdxCnt, OutBuf, OutSV);
+}
+
+typedef void (*Type_Array_ReadDataMulti)(PdAbstractArray, int, C_Int32 const *,
+	C_Int32 const *, void *const [], enum C_SVType OutSV);
+static Type_Array_ReadDataMulti func_Array_ReadDataMulti = NULL;
+COREARRAY_DLL_LOCAL void GDS_Array_ReadDataMulti(PdAbstractArray Obj,
+	int NumSlab, C_Int32 const* Start, C_Int32 const* Length,
+	void *const OutBuf[], enum C_SVType OutSV)
+{
+	(*func_Array_ReadDataMulti)(Obj, NumSlab, Start, Length, OutBuf, OutSV);
+}
+
 typedef const void* (*Type_Array_WriteData)(PdAbstractArray, C_Int32 const *,
 	C_Int32 const *, const void *, enum C_SVType);
 static Type_Array_WriteData func_Array_WriteData = NULL;
@@ -692,6 +743,20 @@ COREARRAY_DLL_LOCAL void GDS_ArrayRead_BalanceBuffer(PdArrayRead array[],
 	(*func_ArrayRead_BalanceBuffer)(array, n, buffer_size);
 }
 
+typedef void (*Type_ArrayRead_Parallel)(PdAbstractArray, int, enum C_SVType,
+	const C_BOOL *const [], int, C_BOOL, void (*)(int, C_Int32, void*, void*),
+	void *);
+static Type_ArrayRead_Parallel func_ArrayRead_Parallel = NULL;
+COREARRAY_DLL_LOCAL void GDS_ArrayRead_Parallel(PdAbstractArray Obj,
+	int Margin, enum C_SVType SVType, const C_BOOL *const Selection[],
+	int nThread, C_BOOL Ordered,
+	void (*Proc)(int iThread, C_Int32 Idx, void *Buffer, void *Param),
+	void *Param)
+{
+	(*func_ArrayRead_Parallel)(Obj, Margin, SVType, Selection, nThread,
+		Ordered, Proc, Param);
+}
+
 typedef C_BOOL (*Type_Load_Matrix)(void);
 static Type_Load_Matrix func_Load_Matrix = NULL;
 COREARRAY_DLL_LOCAL C_BOOL GDS_Load_Matrix(void)
@@ -742,6 +807,9 @@ void Init_GDS_Routines(void)
 	LOAD(func_R_Set_IfFactor, "GDS_R_Set_IfFactor");
 	LOAD(func_R_Array_Read, "GDS_R_Array_Read");
 	LOAD(func_R_Apply, "GDS_R_Apply");
+	LOAD(func_R_Apply2, "GDS_R_Apply2");
+	LOAD(func_R_Apply_Progress, "GDS_R_Apply_Progress");
+	LOAD(func_R_Apply_Cancel, "GDS_R_Apply_Cancel");
 	LOAD(func_R_Append, "GDS_R_Append");
 	LOAD(func_R_AppendEx, "GDS_R_AppendEx");
 	LOAD(func_R_Is_Element, "GDS_R_Is_Element");
@@ -773,6 +841,8 @@ void Init_GDS_Routines(void)
 	LOAD(func_Array_GetBitOf, "GDS_Array_GetBitOf");
 	LOAD(func_Array_ReadData, "GDS_Array_ReadData");
 	LOAD(func_Array_ReadDataEx, "GDS_Array_ReadDataEx");
+	LOAD(func_Array_ReadDataEx2, "GDS_Array_ReadDataEx2");
+	LOAD(func_Array_ReadDataMulti, "GDS_Array_ReadDataMulti");
 	LOAD(func_Array_WriteData, "GDS_Array_WriteData");
 	LOAD(func_Array_AppendData, "GDS_Array_AppendData");
 	LOAD(func_Array_AppendString, "GDS_Array_AppendString");
@@ -822,6 +892,7 @@ void Init_GDS_Routines(void)
 	LOAD(func_ArrayRead_Read, "GDS_ArrayRead_Read");
 	LOAD(func_ArrayRead_Eof, "GDS_ArrayRead_Eof");
 	LOAD(func_ArrayRead_BalanceBuffer, "GDS_ArrayRead_BalanceBuffer");
+	LOAD(func_ArrayRead_Parallel, "GDS_ArrayRead_Parallel");
 
 	LOAD(func_Load_Matrix, "GDS_Load_Matrix");
 	LOAD(func_New_SpCMatrix, "GDS_New_SpCMatrix");
@@ -55,6 +55,7 @@
 #include "dStrGDS.h"
 #include "dVLIntGDS.h"
 #include "dSparse.h"
+#include "dVirtual.h"
 
 
 namespace CoreArray
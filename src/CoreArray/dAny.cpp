@@ -934,6 +934,55 @@ CdReader& CoreArray::operator>> (CdReader &s, CdAny& out)
 	return s;
 }
 
+bool CdAny::Skip(BYTE_LE<CdBufStream> &s)
+{
+	C_UInt8 Type = s.R8b();
+	SIZE64 n = 0;
+	switch (Type)
+	{
+		case dvtInt8:    case dvtUInt8:    case dvtBoolean:
+			n = 1; break;
+		case dvtInt16:   case dvtUInt16:
+			n = 2; break;
+		case dvtInt32:   case dvtUInt32:   case dvtFloat32:
+			n = 4; break;
+		case dvtInt64:   case dvtUInt64:   case dvtFloat64:
+			n = 8; break;
+
+		// string
+		case dvtSString8:
+			n = s.R8b(); break;
+		case dvtSString16:
+			n = 2 * SIZE64(s.R8b()); break;
+		case dvtSString32:
+			n = 4 * SIZE64(s.R8b()); break;
+		case dvtStr8:
+			n = s.Rp32b(); break;
+		case dvtStr16:
+			s.RpUTF16(); break;
+		case dvtStr32:
+			for (C_UInt32 L = s.Rp32b(); L > 0; L--) s.Rp32b();
+			break;
+
+		// array
+		case dvtArray:
+			{
+				C_UInt32 L;
+				s >> L;
+				for (; L > 0; L--)
+					if (!Skip(s)) return false;
+			}
+			break;
+
+		// CdObjRef
+		case dvtObjRef:
+			if (s.R8b()) return false;
+			break;
+	}
+	if (n > 0) s.SetPosition(s.Position() + n);
+	return true;
+}
+
 CdWriter& CoreArray::operator<< (CdWriter &s, CdAny &in)
 {
 	s.Storage() << C_UInt8(in.dsType);
@@ -111,6 +111,12 @@ namespace CoreArray
 
 		/// Type ID of CdAny to a name
 		static const char *dvtNames(int index);
+		/// skip a serialized value without decoding it
+		/** \param s      the storage positioned at a serialized value
+		 *  \return false if the value contains an object reference, which
+		 *          needs decoding
+		**/
+		static bool Skip(BYTE_LE<CdBufStream> &s);
 
 
 		// integer
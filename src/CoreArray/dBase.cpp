@@ -50,16 +50,31 @@ using namespace CoreArray;
 // CdRef
 // =====================================================================
 
+#if defined(COREARRAY_ATOMIC_REF) && defined(__GNUC__)
+#   define REF_INC(x)    __sync_add_and_fetch(&(x), 1)
+#   define REF_DEC(x)    __sync_sub_and_fetch(&(x), 1)
+#elif defined(COREARRAY_ATOMIC_REF) && defined(COREARRAY_CC_MSC)
+#   include <intrin.h>
+#   ifdef _WIN64
+#       define REF_INC(x)    _InterlockedIncrement64((__int64*)&(x))
+#       define REF_DEC(x)    _InterlockedDecrement64((__int64*)&(x))
+#   else
+#       define REF_INC(x)    _InterlockedIncrement((long*)&(x))
+#       define REF_DEC(x)    _InterlockedDecrement((long*)&(x))
+#   endif
+#else
+#   define REF_INC(x)    (++(x))
+#   define REF_DEC(x)    (--(x))
+#endif
+
 ssize_t CoreArray::_INTERNAL::DirectAddRef(CdRef &Obj)
 {
-	Obj.fReference ++;
-	return Obj.fReference;
+	return REF_INC(Obj.fReference);
 }
 
 ssize_t CoreArray::_INTERNAL::DirectDecRef(CdRef &Obj)
 {
-	Obj.fReference --;
-	return Obj.fReference;
+	return REF_DEC(Obj.fReference);
 }
 
 CdRef::CdRef()
@@ -71,15 +86,14 @@ CdRef::~CdRef() {}
 
 ssize_t CdRef::AddRef()
 {
-	fReference ++;
-	return fReference;
+	return REF_INC(fReference);
 }
 
 ssize_t CdRef::Release()
 {
-	fReference --;
-	ssize_t rv = fReference;
-	if (fReference <= 0) delete this;
+	// use the returned count, since fReference might be changed by others
+	ssize_t rv = REF_DEC(fReference);
+	if (rv <= 0) delete this;
 	return rv;
 }
 
@@ -67,6 +67,12 @@ namespace CoreArray
 	// CdRef
 	// =====================================================================
 
+	/// the reference counting of CdRef is atomic (thread-safe)
+	#if !defined(COREARRAY_NO_ATOMIC_REF) && \
+		(defined(__GNUC__) || defined(COREARRAY_CC_MSC))
+	#   define COREARRAY_ATOMIC_REF
+	#endif
+
 	class CdRef;
 
 	namespace _INTERNAL
@@ -85,7 +91,16 @@ namespace CoreArray
 	}
 
 	/// The class with a reference counter
-	/** A reference counter is added to the class. **/
+	/** A reference counter is added to the class. AddRef() and Release() are
+	 *  lock-free atomic operations if COREARRAY_ATOMIC_REF is defined, so an
+	 *  object can be held and released by several threads. It does not make
+	 *  the object itself thread-safe: the streams, the decoders and the array
+	 *  readers under CdGDSFile keep their current positions, and they should
+	 *  be used by one thread at a time. The objects of a file opened read-only
+	 *  which are not changed after loading, e.g., the class manager, the
+	 *  block index of a random-access decoder, the dimensions and attributes
+	 *  of GDS nodes, can be read by several threads.
+	**/
 	class COREARRAY_DLL_DEFAULT CdRef
 	{
 	public:
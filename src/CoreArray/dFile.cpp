@@ -27,6 +27,12 @@
 
 #include "dFile.h"
 #include <algorithm>
+#include <new>
+#include <set>
+
+#ifdef COREARRAY_PLATFORM_UNIX
+#   include <sys/stat.h>
+#endif
 
 
 using namespace CoreArray;
@@ -45,6 +51,221 @@ static const char *ERR_OBJ_RELEASE = "%s(), Release() should return ZERO.";
 // CdGDSObj
 // =====================================================================
 
+// CdNameIndex
+
+// the lists with fewer items are scanned linearly
+static const size_t NAME_INDEX_MIN_COUNT = 8;
+
+/// FNV-1a hash of a name
+static C_UInt32 NameHash(const char *s, size_t n)
+{
+	C_UInt32 h = 2166136261U;
+	for (; n > 0; n--, s++)
+	{
+		h ^= (C_UInt8)(*s);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static inline C_UInt32 NameHash(const UTF8String &s)
+{
+	return NameHash(s.data(), s.size());
+}
+
+static inline bool NameEqual(const UTF8String &s, const char *Name,
+	size_t Len)
+{
+	return (s.size() == Len) && (memcmp(s.data(), Name, Len) == 0);
+}
+
+CdNameIndex::CdNameIndex(const void *List, TdGetName GetName)
+{
+	fList = List;
+	fGetName = GetName;
+}
+
+int CdNameIndex::Find(size_t Count, const char *Name, size_t Len)
+{
+	if (Count < NAME_INDEX_MIN_COUNT)
+	{
+		for (size_t i=0; i < Count; i++)
+		{
+			if (NameEqual(fGetName(fList, i), Name, Len))
+				return i;
+		}
+		return -1;
+	}
+
+	if (fTable.empty()) Build(Count);
+	const size_t Mask = fTable.size() - 1;
+	size_t k = NameHash(Name, Len) & Mask;
+	C_Int32 i;
+	while ((i = fTable[k]) >= 0)
+	{
+		if (NameEqual(fGetName(fList, i), Name, Len))
+			return i;
+		k = (k + 1) & Mask;
+	}
+	return -1;
+}
+
+void CdNameIndex::Add(size_t Count, int Index)
+{
+	// the hash table is built lazily
+	if (fTable.empty()) return;
+	if (2*Count > fTable.size())
+	{
+		Build(Count);
+		return;
+	}
+	const size_t Mask = fTable.size() - 1;
+	size_t k = NameHash(fGetName(fList, Index)) & Mask;
+	while (fTable[k] >= 0) k = (k + 1) & Mask;
+	fTable[k] = Index;
+}
+
+void CdNameIndex::Remove(int Index)
+{
+	if (fTable.empty()) return;
+	const size_t Mask = fTable.size() - 1;
+	size_t i = NameHash(fGetName(fList, Index)) & Mask;
+	while (fTable[i] != Index)
+	{
+		if (fTable[i] < 0) return;
+		i = (i + 1) & Mask;
+	}
+
+	// backward-shift deletion, no tombstone is needed
+	size_t j = i;
+	while (true)
+	{
+		j = (j + 1) & Mask;
+		C_Int32 v = fTable[j];
+		if (v < 0) break;
+		size_t h = NameHash(fGetName(fList, v)) & Mask;
+		// keep it if its home slot is cyclically in (i, j]
+		if ((i <= j) ? ((i < h) && (h <= j)) : ((i < h) || (h <= j)))
+			continue;
+		fTable[i] = v;
+		i = j;
+	}
+	fTable[i] = -1;
+}
+
+void CdNameIndex::Shift(int From, int Delta)
+{
+	vector<C_Int32>::iterator it;
+	for (it = fTable.begin(); it != fTable.end(); it++)
+		if (*it >= From) *it += Delta;
+}
+
+void CdNameIndex::Build(size_t Count)
+{
+	// the load factor is not greater than 0.5
+	size_t n = 16;
+	while (n < 2*Count) n <<= 1;
+	fTable.assign(n, -1);
+	const size_t Mask = n - 1;
+	for (size_t i=0; i < Count; i++)
+	{
+		size_t k = NameHash(fGetName(fList, i)) & Mask;
+		while (fTable[k] >= 0) k = (k + 1) & Mask;
+		fTable[k] = i;
+	}
+}
+
+
+// CdArena
+
+struct CdArena::TChunk
+{
+	CdArena *Owner;
+	TChunk *Prev, *Next;
+	size_t Size;   ///< the total size including this header
+	size_t Used;   ///< the used size including this header
+	size_t Count;  ///< the number of blocks in use
+};
+
+// the header of chunk, aligned to 16 bytes
+static const size_t ARENA_CHUNK_HEAD =
+	(sizeof(void*)*3 + sizeof(size_t)*3 + 15) & ~size_t(15);
+// each block is preceded by a pointer to its chunk
+static const size_t ARENA_BLOCK_HEAD = 8;
+
+CdArena::CdArena(): CdRef()
+{
+	fList = fCurrent = NULL;
+	fNumChunk = 0;
+}
+
+CdArena::~CdArena()
+{
+	while (fList) _FreeChunk(fList);
+}
+
+void *CdArena::Alloc(size_t Size)
+{
+	const size_t n = ((Size + 7) & ~size_t(7)) + ARENA_BLOCK_HEAD;
+	TChunk *p;
+	if (n > CHUNK_SIZE / 4)
+	{
+		// a large block in its own chunk
+		p = _NewChunk(ARENA_CHUNK_HEAD + n);
+	} else {
+		if (!fCurrent || (fCurrent->Used + n > fCurrent->Size))
+		{
+			TChunk *old = fCurrent;
+			fCurrent = _NewChunk(CHUNK_SIZE);
+			if (old && (old->Count == 0)) _FreeChunk(old);
+		}
+		p = fCurrent;
+	}
+	C_UInt8 *rv = (C_UInt8*)p + p->Used;
+	p->Used += n;
+	p->Count ++;
+	*(TChunk**)rv = p;
+	return rv + ARENA_BLOCK_HEAD;
+}
+
+void CdArena::Free(void *Ptr)
+{
+	if (!Ptr) return;
+	TChunk *p = *(TChunk**)((C_UInt8*)Ptr - ARENA_BLOCK_HEAD);
+	if (--p->Count == 0)
+	{
+		if (p != p->Owner->fCurrent)
+			p->Owner->_FreeChunk(p);
+		else
+			p->Used = ARENA_CHUNK_HEAD;  // reuse the current chunk
+	}
+}
+
+CdArena::TChunk *CdArena::_NewChunk(size_t Size)
+{
+	TChunk *p = (TChunk*)malloc(Size);
+	if (!p) throw bad_alloc();
+	p->Owner = this;
+	p->Prev = NULL; p->Next = fList;
+	if (fList) fList->Prev = p;
+	fList = p;
+	p->Size = Size;
+	p->Used = ARENA_CHUNK_HEAD;
+	p->Count = 0;
+	fNumChunk ++;
+	return p;
+}
+
+void CdArena::_FreeChunk(TChunk *p)
+{
+	if (p->Prev) p->Prev->Next = p->Next; else fList = p->Next;
+	if (p->Next) p->Next->Prev = p->Prev;
+	if (p == fCurrent) fCurrent = NULL;
+	fNumChunk --;
+	free(p);
+}
+
+
 // CdObjAttr
 
 static const char *VAR_ATTRCNT  = "ATTRCNT";
@@ -54,8 +275,11 @@ static const char *ERR_ATTR_NAME = "No Attribute Name ('%s').";
 static const char *ERR_ATTR_NAME_EXIST = "Attribute '%s' has existed.";
 static const char *ERR_ATTR_INVALID_NAME = "Invalid zero-length name.";
 
-CdObjAttr::CdObjAttr(CdGDSObj &vOwner): CdObject(), fOwner(vOwner)
-{ }
+CdObjAttr::CdObjAttr(CdGDSObj &vOwner): CdObject(), fOwner(vOwner),
+	fNameIndex(&fList, _PairName)
+{
+	fArena = NULL;
+}
 
 CdObjAttr::~CdObjAttr()
 {
@@ -64,34 +288,45 @@ CdObjAttr::~CdObjAttr()
 	{
 		TdPair *p = *it;
 		*it = NULL;
-		delete p;
+		_FreePair(p);
 	}
+	if (fArena) fArena->Release();
 }
 
 void CdObjAttr::Assign(CdObjAttr &Source)
 {
-	Clear();
+	if (&Source == this) return;
+	TdAutoMutex _s(&Source.fMutex);
+	TdAutoMutex _m(&fMutex);
+	_Clear();
 	const size_t n = Source.Count();
 	fList.reserve(n);
 	for (size_t i=0; i < n; i++)
 	{
-		TdPair *I = new TdPair;
-		I->name = Source.Names(i);
+		TdPair &S = *Source.fList[i];
+		TdPair *I = _NewPair(S.name, S.raw_len);
 		fList.push_back(I);
+		fNameIndex.Add(fList.size(), fList.size() - 1);
 		Changed();
-		I->val = Source[i];
+		if (S.raw_len == 0)
+			I->val = S.val;
+		else {
+			memcpy(I->raw, S.raw, S.raw_len);
+			I->raw_len = S.raw_len;
+		}
 	}
 }
 
 CdAny &CdObjAttr::Add(const UTF8String &Name)
 {
 	_ValidateName(Name);
+	TdAutoMutex _m(&fMutex);
 	vector<TdPair*>::iterator it = _Find(Name);
 	if (it == fList.end())
 	{
-		TdPair *I = new TdPair;
-		I->name = Name;
+		TdPair *I = _NewPair(Name, 0);
 		fList.push_back(I);
+		fNameIndex.Add(fList.size(), fList.size() - 1);
 		Changed();
 		return I->val;
 	} else
@@ -100,6 +335,7 @@ CdAny &CdObjAttr::Add(const UTF8String &Name)
 
 int CdObjAttr::IndexName(const UTF8String &Name)
 {
+	TdAutoMutex _m(&fMutex);
 	vector<TdPair*>::iterator it = _Find(Name);
 	if (it != fList.end())
     	return it - fList.begin();
@@ -114,39 +350,23 @@ bool CdObjAttr::HasName(const UTF8String &Name)
 
 void CdObjAttr::Delete(const UTF8String &Name)
 {
+	TdAutoMutex _m(&fMutex);
 	vector<TdPair*>::iterator it = _Find(Name);
 	if (it == fList.end())
 		throw ErrGDSObj(ERR_ATTR_NAME, Name.c_str());
-	TdPair *p = *it;
-	*it = NULL;
-	fList.erase(it);
-	delete p;
-	Changed();
+	_Delete(it - fList.begin());
 }
 
 void CdObjAttr::Delete(int Index)
 {
-	TdPair *p = fList.at(Index);
-	fList[Index] = NULL;
-    fList.erase(fList.begin() + Index);
-	delete p;
-	Changed();
+	TdAutoMutex _m(&fMutex);
+	_Delete(Index);
 }
 
 void CdObjAttr::Clear()
 {
-	if (!fList.empty())
-	{
-		vector<TdPair*>::iterator it;
-		for (it = fList.begin(); it != fList.end(); it++)
-		{
-			TdPair *p = *it;
-			*it = NULL;
-			delete p;
-		}
-		fList.clear();
-		Changed();
-	}
+	TdAutoMutex _m(&fMutex);
+	_Clear();
 }
 
 void CdObjAttr::Changed()
@@ -156,19 +376,22 @@ void CdObjAttr::Changed()
 
 CdAny & CdObjAttr::operator[](const UTF8String &Name)
 {
+	TdAutoMutex _m(&fMutex);
 	vector<TdPair*>::iterator it = _Find(Name);
 	if (it == fList.end())
 		throw ErrGDSObj(ERR_ATTR_NAME, Name.c_str());
-	return (*it)->val;
+	return _Value(**it);
 }
 
 CdAny & CdObjAttr::operator[](int Index)
 {
-	return fList.at(Index)->val;
+	TdAutoMutex _m(&fMutex);
+	return _Value(*fList.at(Index));
 }
 
 void CdObjAttr::Loading(CdReader &Reader, TdVersion Version)
 {
+	TdAutoMutex _m(&fMutex);
 	C_Int32 Cnt;
 	Reader[VAR_ATTRCNT] >> Cnt;
 	if (!fList.empty())
@@ -178,22 +401,50 @@ void CdObjAttr::Loading(CdReader &Reader, TdVersion Version)
 		{
 			TdPair *p = *it;
 			*it = NULL;
-			delete p;
+			_FreePair(p);
 		}
 		fList.clear();
 	}
+	fNameIndex.Reset();
+
+	// the pairs are allocated in the arena of GDS file
+	if (!fArena)
+	{
+		CdGDSFile *file = fOwner.GDSFile();
+		if (!file && fOwner.Folder())
+			file = fOwner.Folder()->GDSFile();
+		if (file && file->Arena())
+			(fArena = file->Arena())->AddRef();
+	}
 
 	if (Cnt > 0)
 	{
+		// the count is not trusted, a corrupted one reserves too much
+		static const C_Int32 MAX_RESERVE = 4096;
+		fList.reserve((Cnt <= MAX_RESERVE) ? Cnt : MAX_RESERVE);
 		Reader[VAR_ATTRLIST].BeginStruct();
 		for (int i=0; i < Cnt; i++)
 		{
-			TdPair *I = new TdPair;
+			TdPair *I = NULL;
 			try {
-				I->name = UTF16ToUTF8(Reader.Storage().RpUTF16()); // TODO
-				Reader >> I->val;
+				UTF8String name = UTF16ToUTF8(Reader.Storage().RpUTF16()); // TODO
+				// keep the serialized value, decoded at the first access
+				SIZE64 st = Reader.Storage().Position();
+				if (CdAny::Skip(Reader.Storage()))
+				{
+					SIZE64 n = Reader.Storage().Position() - st;
+					I = _NewPair(name, n);
+					Reader.Storage().SetPosition(st);
+					Reader.Storage().ReadData(I->raw, n);
+					I->raw_len = n;
+				} else {
+					// with an object reference
+					I = _NewPair(name, 0);
+					Reader.Storage().SetPosition(st);
+					Reader >> I->val;
+				}
 			} catch (...) {
-				delete I;
+				if (I) _FreePair(I);
 				break;
 			}
 			fList.push_back(I);
@@ -204,6 +455,7 @@ void CdObjAttr::Loading(CdReader &Reader, TdVersion Version)
 
 void CdObjAttr::Saving(CdWriter &Writer)
 {
+	TdAutoMutex _m(&fMutex);
 	C_Int32 Cnt = fList.size();
 	Writer[VAR_ATTRCNT] << Cnt;
 	if (Cnt > 0)
@@ -213,47 +465,83 @@ void CdObjAttr::Saving(CdWriter &Writer)
 		for (it=fList.begin(); it != fList.end(); it++)
 		{
 			Writer.Storage().WpUTF16(UTF8ToUTF16((*it)->name)); // TODO
-			Writer << (*it)->val;
+			if ((*it)->raw_len == 0)
+				Writer << (*it)->val;
+			else
+				Writer.Storage().WriteData((*it)->raw, (*it)->raw_len);
 		}
 		Writer.EndStruct();
 	}
 }
 
-vector<CdObjAttr::TdPair*>::iterator CdObjAttr::_Find(const UTF8String &Name)
+bool CdObjAttr::PeekName(CdReader &Reader, const UTF8String &Name)
 {
-	vector<TdPair*>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
+	if (!Reader.HaveProperty(VAR_ATTRCNT)) return false;
+	C_Int32 Cnt = 0;
+	Reader[VAR_ATTRCNT] >> Cnt;
+
+	bool rv = false;
+	if (Cnt > 0)
 	{
-		if ((*it)->name == Name)
-			break;
+		Reader[VAR_ATTRLIST].BeginStruct();
+		for (int i=0; i < Cnt; i++)
+		{
+			if (UTF16ToUTF8(Reader.Storage().RpUTF16()) == Name)
+			{
+				rv = true;
+				break;
+			}
+			SIZE64 st = Reader.Storage().Position();
+			if (!CdAny::Skip(Reader.Storage()))
+			{
+				// with an object reference
+				Reader.Storage().SetPosition(st);
+				CdAny tmp;
+				Reader >> tmp;
+			}
+		}
+		Reader.EndStruct();
 	}
-	return it;
+	return rv;
+}
+
+vector<CdObjAttr::TdPair*>::iterator CdObjAttr::_Find(const UTF8String &Name)
+{
+	int i = fNameIndex.Find(fList.size(), Name.data(), Name.size());
+	return (i >= 0) ? (fList.begin() + i) : fList.end();
 }
 
 void CdObjAttr::SetName(const UTF8String &OldName, const UTF8String &NewName)
 {
 	_ValidateName(NewName);
+	TdAutoMutex _m(&fMutex);
 	vector<TdPair*>::iterator it = _Find(OldName);
 	if (it == fList.end())
 		throw ErrGDSObj(ERR_ATTR_NAME, OldName.c_str());
 	if (OldName != NewName)
 	{
-		if (HasName(NewName))
+		if (_Find(NewName) != fList.end())
 			throw ErrGDSObj(ERR_ATTR_NAME_EXIST, NewName.c_str());
+		int Index = it - fList.begin();
+		fNameIndex.Remove(Index);
 		(*it)->name = NewName;
+		fNameIndex.Add(fList.size(), Index);
 		Changed();
 	}
 }
 
 void CdObjAttr::SetName(int Index, const UTF8String &NewName)
 {
-	TdPair &p = *fList.at(Index); // check range
 	_ValidateName(NewName);
+	TdAutoMutex _m(&fMutex);
+	TdPair &p = *fList.at(Index); // check range
 	if (p.name != NewName)
 	{
-		if (HasName(NewName))
+		if (_Find(NewName) != fList.end())
 			throw ErrGDSObj(ERR_ATTR_NAME_EXIST, NewName.c_str());
+		fNameIndex.Remove(Index);
 		p.name = NewName;
+		fNameIndex.Add(fList.size(), Index);
 		Changed();
 	}
 }
@@ -264,6 +552,78 @@ void CdObjAttr::_ValidateName(const UTF8String &name)
         throw ErrGDSObj(ERR_ATTR_INVALID_NAME);
 }
 
+CdAny &CdObjAttr::_Value(TdPair &p)
+{
+	if (p.raw_len > 0)
+	{
+		CdMemoryStream *M = new CdMemoryStream(p.raw_len);
+		memcpy(M->BufPointer(), p.raw, p.raw_len);
+		CdReader Reader(M, NULL);
+		Reader >> p.val;
+		p.raw_len = 0;
+	}
+	return p.val;
+}
+
+void CdObjAttr::_Delete(int Index)
+{
+	TdPair *p = fList.at(Index);
+	fNameIndex.Remove(Index);
+	fList[Index] = NULL;
+    fList.erase(fList.begin() + Index);
+	fNameIndex.Shift(Index + 1, -1);
+	_FreePair(p);
+	Changed();
+}
+
+void CdObjAttr::_Clear()
+{
+	if (!fList.empty())
+	{
+		vector<TdPair*>::iterator it;
+		for (it = fList.begin(); it != fList.end(); it++)
+		{
+			TdPair *p = *it;
+			*it = NULL;
+			_FreePair(p);
+		}
+		fList.clear();
+		fNameIndex.Reset();
+		Changed();
+	}
+}
+
+CdObjAttr::TdPair *CdObjAttr::_NewPair(const UTF8String &Name, size_t RawSize)
+{
+	// the serialized value follows the pair in the same block
+	const size_t size = sizeof(TdPair) + RawSize;
+	void *buf = fArena ? fArena->Alloc(size) : ::operator new(size);
+	TdPair *p = new (buf) TdPair;
+	if (RawSize > 0) p->raw = (C_UInt8*)(p + 1);
+	try {
+		p->name = Name;
+	}
+	catch (...) {
+		_FreePair(p);
+		throw;
+	}
+	return p;
+}
+
+void CdObjAttr::_FreePair(TdPair *p)
+{
+	if (p)
+	{
+		p->~TdPair();
+		if (fArena) CdArena::Free(p); else ::operator delete(p);
+	}
+}
+
+const UTF8String &CdObjAttr::_PairName(const void *List, size_t Index)
+{
+	return (*(const vector<TdPair*>*)List)[Index]->name;
+}
+
 
 // CdGDSObj
 
@@ -288,12 +648,33 @@ CdGDSObj::CdGDSObj(): CdObjMsg(), fAttr(*this)
 	fChanged = false;
 }
 
+CdGDSObj::TdOnDestroy CdGDSObj::fOnDestroy = NULL;
+volatile C_UInt32 CdGDSObj::fPathStamp = 0;
+
+/// protecting CdGDSObj::fPathStamp, since an object can be destroyed in
+/// any thread
+static CdThreadMutex PathStampMutex;
+
 CdGDSObj::~CdGDSObj()
 {
+	_PathChanged();
+	if (fOnDestroy)
+		(*fOnDestroy)(this);
 	if (fGDSStream)
 		fGDSStream->Release();
 }
 
+void CdGDSObj::SetOnDestroy(TdOnDestroy Proc)
+{
+	fOnDestroy = Proc;
+}
+
+void CdGDSObj::_PathChanged()
+{
+	TdAutoMutex _m(&PathStampMutex);
+	fPathStamp = fPathStamp + 1;
+}
+
 void CdGDSObj::AssignAttribute(CdGDSObj &Source)
 {
 	fAttr.Assign(Source.Attribute());
@@ -340,8 +721,12 @@ void CdGDSObj::SetName(const UTF8String &NewName)
 			{
 				if (fFolder->_HasName(NewName))
 					throw ErrGDSObj(ERR_DUP_NAME);
+				int Index = it - fFolder->fList.begin();
+				fFolder->fNameIndex.Remove(Index);
 				it->Name = NewName;
+				fFolder->fNameIndex.Add(fFolder->fList.size(), Index);
 				fFolder->fChanged = true;
+				_PathChanged();
 			}
 			return;
 		}
@@ -407,9 +792,14 @@ void CdGDSObj::MoveTo(CdGDSFolder &folder)
 				if (folder._HasName(it->Name))
 					throw ErrGDSObj(ERR_DUP_NAME);
 				folder.fList.push_back(*it);
+				folder.fNameIndex.Add(folder.fList.size(), folder.fList.size() - 1);
+				int Index = it - fFolder->fList.begin();
+				fFolder->fNameIndex.Remove(Index);
 				fFolder->fList.erase(it);
+				fFolder->fNameIndex.Shift(Index + 1, -1);
 				fFolder->fChanged = folder.fChanged = true;
 				fFolder = &folder;
+				_PathChanged();
 			}
 		} else
 			throw ErrGDSObj(ERR_SAME_FILE);
@@ -423,6 +813,9 @@ void CdGDSObj::Synchronize()
 		SaveToBlockStream();
 }
 
+void CdGDSObj::Refresh()
+{ }
+
 void CdGDSObj::GetOwnBlockStream(vector<const CdBlockStream*> &Out) const
 {
 	Out.clear();
@@ -1303,6 +1696,7 @@ CdGDSFolder::TNode::TNode()
 	StreamID = 0;
 	Flag = FLAG_TYPE_CLASS;
 	_pos = 0;
+	_used = 0;
 }
 
 bool CdGDSFolder::TNode::IsFlagType(C_UInt32 val) const
@@ -1328,6 +1722,11 @@ void CdGDSFolder::TNode::SetFlagAttr(C_UInt32 val)
 }
 
 
+CdGDSFolder::CdGDSFolder(): CdGDSAbsFolder(), fNameIndex(&fList, _NodeName)
+{
+	fCommitStamp = -1;
+}
+
 CdGDSFolder::~CdGDSFolder()
 {
     _ClearFolder();
@@ -1382,6 +1781,7 @@ CdGDSObj *CdGDSFolder::AddFolder(const UTF8String &Name)
 	I.StreamID = rv->fGDSStream->ID();
 	I.SetFlagType(CdGDSFolder::TNode::FLAG_TYPE_FOLDER);
 	fList.push_back(I);
+	fNameIndex.Add(fList.size(), fList.size() - 1);
 	fChanged = true;
 
 	return rv;
@@ -1444,9 +1844,14 @@ CdGDSObj *CdGDSFolder::InsertObj(int index, const UTF8String &Name,
 
 	I.Name = Name; I.Obj = val;
 	if (index < 0)
+	{
 		fList.push_back(I);
-	else
+		fNameIndex.Add(fList.size(), fList.size() - 1);
+	} else {
 		fList.insert(fList.begin()+index, I);
+		fNameIndex.Shift(index, 1);
+		fNameIndex.Add(fList.size(), index);
+	}
 	fChanged = true;
 
 	return val;
@@ -1466,13 +1871,19 @@ void CdGDSFolder::MoveTo(int Index, int NewPos)
 	if (Index != NewPos)
 	{
 		TNode ND = fList[Index];
+		fNameIndex.Remove(Index);
 		if (NewPos >= (int)fList.size()-1)
 		{
 			fList.erase(fList.begin() + Index);
+			fNameIndex.Shift(Index + 1, -1);
 			fList.push_back(ND);
+			fNameIndex.Add(fList.size(), fList.size() - 1);
 		} else {
 			fList.erase(fList.begin() + Index);
+			fNameIndex.Shift(Index + 1, -1);
 			fList.insert(fList.begin() + NewPos, ND);
+			fNameIndex.Shift(NewPos, 1);
+			fNameIndex.Add(fList.size(), NewPos);
 		}
 
 		fChanged = true;
@@ -1567,7 +1978,9 @@ void CdGDSFolder::DeleteObj(int Index, bool force)
 		}
 	}
 
-    fList.erase(it);
+	fNameIndex.Remove(Index);
+	fList.erase(it);
+	fNameIndex.Shift(Index + 1, -1);
 	fChanged = true;
 }
 
@@ -1637,6 +2050,67 @@ CdGDSObj *CdGDSFolder::ObjItem(const UTF8String &Name)
 	return I.Obj;
 }
 
+void CdGDSFolder::Refresh()
+{
+	static const char *ERR_NOT_COMMITTED =
+		"The header of '%s' is not in the commit record.";
+
+	if (!fGDSStream) return;
+	const C_Int64 stamp = fGDSStream->CommitStamp();
+	if (stamp < 0)
+		throw ErrGDSObj(ERR_NOT_COMMITTED, FullName().c_str());
+
+	// the child list is unchanged, refresh the loaded child nodes only
+	vector<TNode>::iterator it;
+	if (stamp == fCommitStamp)
+	{
+		for (it = fList.begin(); it != fList.end(); it++)
+			if (it->Obj) it->Obj->Refresh();
+		return;
+	}
+
+	// reload the child list
+	fCommitStamp = -1;
+	GDSFile()->RefreshedHeader(fGDSStream);
+	vector<TNode> old;
+	old.swap(fList);
+	try {
+		CdReader Reader(fGDSStream, &GDSFile()->Log());
+		Reader.BeginNameSpace();
+		LoadStruct(Reader, COREARRAY_CLASS_VERSION);
+		Reader.EndStruct();
+	}
+	catch (...) {
+		fList.swap(old);
+		fNameIndex.Reset();
+		throw;
+	}
+
+	fCommitStamp = stamp;
+
+	// keep the loaded objects
+	map<C_UInt32, CdGDSObj*> loaded;
+	for (it = old.begin(); it != old.end(); it++)
+		if (it->Obj) loaded[it->StreamID.Get()] = it->Obj;
+	for (it = fList.begin(); it != fList.end(); it++)
+	{
+		map<C_UInt32, CdGDSObj*>::iterator p = loaded.find(it->StreamID.Get());
+		if (p != loaded.end())
+		{
+			it->Obj = p->second;
+			loaded.erase(p);
+		}
+	}
+	// the nodes removed by the writer might be still used by the caller
+	map<C_UInt32, CdGDSObj*>::iterator p;
+	for (p = loaded.begin(); p != loaded.end(); p++)
+		fDetached.push_back(p->second);
+
+	// refresh the loaded child nodes
+	for (it = fList.begin(); it != fList.end(); it++)
+		if (it->Obj) it->Obj->Refresh();
+}
+
 CdGDSObj *CdGDSFolder::ObjItemEx(int Index)
 {
 	if ((Index < 0) || (Index >= (int)fList.size()))
@@ -1648,16 +2122,16 @@ CdGDSObj *CdGDSFolder::ObjItemEx(int Index)
 
 CdGDSObj *CdGDSFolder::ObjItemEx(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-	{
-		if (it->Name == Name)
-		{
-			_LoadItem(*it);
-			return it->Obj;
-		}
-	}
-	return NULL;
+	return ObjItemEx(Name.data(), Name.size());
+}
+
+CdGDSObj *CdGDSFolder::ObjItemEx(const char *Name, size_t Len)
+{
+	int i = fNameIndex.Find(fList.size(), Name, Len);
+	if (i < 0) return NULL;
+	CdGDSFolder::TNode &I = fList[i];
+	_LoadItem(I);
+	return I.Obj;
 }
 
 CdGDSObj *CdGDSFolder::Path(const UTF8String &FullName)
@@ -1685,7 +2159,12 @@ CdGDSObj *CdGDSFolder::PathEx(const UTF8String &FullName)
 			p ++;
 		if (s == p)
 			return rv;
-		rv = ((CdGDSAbsFolder*)rv)->ObjItemEx(UTF8String(s, p));
+		// avoid a temporary string for the regular folders
+		CdGDSFolder *Dir = dynamic_cast<CdGDSFolder*>(rv);
+		if (Dir)
+			rv = Dir->ObjItemEx(s, p - s);
+		else
+			rv = ((CdGDSAbsFolder*)rv)->ObjItemEx(UTF8String(s, p));
 	}
 
 	return rv;
@@ -1724,20 +2203,72 @@ int CdGDSFolder::NodeCount()
 	return fList.size();
 }
 
-static const char *VAR_DIRCNT   = "DIRCNT";
-static const char *VAR_DIRLIST  = "DIRLIST";
-static const char *VAR_DIR_ID   = "ID";
-static const char *VAR_DIR_FLAG = "FLAG";
-static const char *VAR_DIR_NAME = "NAME";
+const UTF8String &CdGDSFolder::NodeName(int Index)
+{
+	if ((Index < 0) || (Index >= (int)fList.size()))
+		throw ErrGDSObj(ERR_OBJ_INDEX, Index);
+	return fList[Index].Name;
+}
 
-void CdGDSFolder::Loading(CdReader &Reader, TdVersion Version)
+bool CdGDSFolder::NodeIsFolder(int Index)
 {
-	// Load directory inforamtion
-	fList.clear();
-	C_Int32 L = 0;
-	Reader[VAR_DIRCNT] >> L;
+	if ((Index < 0) || (Index >= (int)fList.size()))
+		throw ErrGDSObj(ERR_OBJ_INDEX, Index);
+	TNode &I = fList[Index];
+	return I.IsFlagType(TNode::FLAG_TYPE_FOLDER) ||
+		I.IsFlagType(TNode::FLAG_TYPE_VIRTUAL_FOLDER);
+}
 
-	if (L > 0)
+bool CdGDSFolder::NodeHidden(int Index)
+{
+	if ((Index < 0) || (Index >= (int)fList.size()))
+		throw ErrGDSObj(ERR_OBJ_INDEX, Index);
+	return (fList[Index].Flag & TNode::FLAG_ATTR_HIDDEN) != 0;
+}
+
+bool CdGDSFolder::NodeHasAttr(int Index, const UTF8String &Name)
+{
+	if ((Index < 0) || (Index >= (int)fList.size()))
+		throw ErrGDSObj(ERR_OBJ_INDEX, Index);
+	TNode &I = fList[Index];
+	if (!I.Obj)
+	{
+		// read the attribute names without creating the object
+		try {
+			_CheckGDSStream();
+			CdBlockStream *IStream = fGDSStream->Collection()[I.StreamID];
+			CdReader Reader(IStream, &GDSFile()->Log());
+			if (I.IsFlagType(TNode::FLAG_TYPE_CLASS))
+				Reader.BeginObjNameSpace();
+			else
+				Reader.BeginNameSpace();
+			bool rv = CdObjAttr::PeekName(Reader, Name);
+			Reader.EndStruct();
+			return rv;
+		}
+		catch (exception &E) {
+			// load the object instead
+		}
+		_LoadItem(I);
+	}
+	return I.Obj->Attribute().HasName(Name);
+}
+
+static const char *VAR_DIRCNT   = "DIRCNT";
+static const char *VAR_DIRLIST  = "DIRLIST";
+static const char *VAR_DIR_ID   = "ID";
+static const char *VAR_DIR_FLAG = "FLAG";
+static const char *VAR_DIR_NAME = "NAME";
+
+void CdGDSFolder::Loading(CdReader &Reader, TdVersion Version)
+{
+	// Load directory inforamtion
+	fList.clear();
+	fNameIndex.Reset();
+	C_Int32 L = 0;
+	Reader[VAR_DIRCNT] >> L;
+
+	if (L > 0)
 	{
 		Reader[VAR_DIRLIST].BeginStruct();
 		for (C_Int32 k = 0; k < L; k++)
@@ -1803,15 +2334,17 @@ void CdGDSFolder::_ClearFolder()
 		}
 	}
 	fList.clear();
+	fNameIndex.Reset();
+
+	vector<CdGDSObj*>::iterator p;
+	for (p = fDetached.begin(); p != fDetached.end(); p++)
+		(*p)->Release();
+	fDetached.clear();
 }
 
 bool CdGDSFolder::_HasName(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-		if (it->Name == Name)
-			return true;
-	return false;
+	return (fNameIndex.Find(fList.size(), Name.data(), Name.size()) >= 0);
 }
 
 bool CdGDSFolder::_ValidName(const UTF8String &Name)
@@ -1826,11 +2359,15 @@ bool CdGDSFolder::_ValidName(const UTF8String &Name)
 
 CdGDSFolder::TNode &CdGDSFolder::_NameItem(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-		if (it->Name == Name)
-			return *it;
-	throw ErrGDSObj(ERR_FOLDER_NAME, Name.c_str());
+	int i = fNameIndex.Find(fList.size(), Name.data(), Name.size());
+	if (i < 0)
+		throw ErrGDSObj(ERR_FOLDER_NAME, Name.c_str());
+	return fList[i];
+}
+
+const UTF8String &CdGDSFolder::_NodeName(const void *List, size_t Index)
+{
+	return (*(const vector<TNode>*)List)[Index].Name;
 }
 
 void CdGDSFolder::_LoadItem(TNode &I)
@@ -1838,6 +2375,7 @@ void CdGDSFolder::_LoadItem(TNode &I)
 	static const char *ERR_INVALID_GDS_OBJ =
 		"Invalid GDS object (it should be inherited from CdGDSObj).";
 
+	bool Loaded = false;
 	if (I.Obj == NULL)
 	{
 		_CheckGDSStream();
@@ -1933,7 +2471,12 @@ void CdGDSFolder::_LoadItem(TNode &I)
 		}
 
 		I.Obj->AddRef();
+		Loaded = true;
 	}
+
+	CdGDSFile *File = GDSFile();
+	if (File && (File->NodeCacheLimit() > 0))
+		File->_TouchNode(I, Loaded);
 }
 
 void CdGDSFolder::_UpdateAll()
@@ -1985,16 +2528,14 @@ vector<CdGDSFolder::TNode>::const_iterator CdGDSFolder::FindObj(
 CdGDSVirtualFolder::CdGDSVirtualFolder(): CdGDSAbsFolder()
 {
 	fLinkFile = NULL;
+	fLinkRoot = NULL;
+	fLinkShared = false;
 	fHasTried = true;
 }
 
 CdGDSVirtualFolder::~CdGDSVirtualFolder()
 {
-	if (fLinkFile)
-	{
-		delete fLinkFile;
-		fLinkFile = NULL;
-	}
+	_CloseLink();
 }
 
 CdGDSObj *CdGDSVirtualFolder::NewObject()
@@ -2013,11 +2554,7 @@ void CdGDSVirtualFolder::Assign(CdGDSObj &Source, bool Full)
 		fLinkFileName = S->fLinkFileName;
 		fErrMsg = S->fErrMsg;
 		fHasTried = false;
-		if (fLinkFile)
-		{
-			delete fLinkFile;
-			fLinkFile = NULL;
-		}
+		_CloseLink();
 	} else
 		RaiseInvalidAssign("CdGDSVirtualFolder", &Source);
 }
@@ -2041,27 +2578,92 @@ bool CdGDSVirtualFolder::IsLoaded(bool Silent)
 		fn.resize(i+1);
 		fn.append(fLinkFileName);
 
-		// open the linking GDS file
-		CdGDSFile *f = new CdGDSFile;
+		// open the linking GDS file, shared if read-only
+		CdGDSFile *f = NULL;
+		CdGDSRoot *r = NULL;
 		try {
-			f->LoadFile(fn.c_str(), file->ReadOnly());
-			f->fRoot.fFolder = fFolder;
-			f->fRoot.fVFolder = this;
+			if (file->ReadOnly())
+			{
+				f = GDSFileRegistry().Open(fn.c_str());
+				fLinkShared = true;
+				r = _LoadProxyRoot(f);
+			} else {
+				f = new CdGDSFile;
+				f->LoadFile(fn.c_str(), false);
+				r = &f->fRoot;
+			}
 		}
 		catch (exception &E)
 		{
 			fErrMsg = E.what();
-			delete f; f = NULL;
+			if (f)
+			{
+				if (fLinkShared)
+					GDSFileRegistry().Close(f);
+				else
+					delete f;
+			}
+			fLinkShared = false;
+			f = NULL; r = NULL;
 			if (!Silent)
 				throw;
 		}
 
 		fLinkFile = f;
+		fLinkRoot = r;
+		if (r) r->fVFolder = this;
 	}
 
+	// the parent of this folder, which may have been moved
+	if (fLinkRoot) fLinkRoot->fFolder = fFolder;
+
 	return (fLinkFile != NULL);
 }
 
+CdGDSRoot *CdGDSVirtualFolder::_LoadProxyRoot(CdGDSFile *File)
+{
+	// the nodes of a shared file are loaded again for this folder, so that
+	// each of them has a parent in this folder, while the block streams are
+	// shared
+	CdGDSRoot *r = new CdGDSRoot;
+	r->AddRef();
+	try {
+		r->fGDSStream = File->fRoot.fGDSStream;
+		r->fGDSStream->AddRef();
+		CdReader Reader(r->fGDSStream, &File->Log());
+		Reader.BeginNameSpace();
+		_INTERNAL::CdObject_LoadStruct(*r, Reader, File->Version());
+		Reader.EndStruct();
+	}
+	catch (...) {
+		r->Release();
+		throw;
+	}
+	return r;
+}
+
+void CdGDSVirtualFolder::_CloseLink()
+{
+	CdGDSFile *file = fLinkFile;
+	CdGDSRoot *root = fLinkRoot;
+	fLinkFile = NULL;
+	fLinkRoot = NULL;
+	if (file)
+	{
+		if (fLinkShared)
+		{
+			// the nodes of the proxy root refer to the streams of the file
+			root->Release();
+			GDSFileRegistry().Close(file);
+		} else {
+			root->fFolder = NULL;
+			root->fVFolder = NULL;
+			delete file;
+		}
+	}
+	fLinkShared = false;
+}
+
 void CdGDSVirtualFolder::_CheckLinked()
 {
 	if (!IsLoaded(false))
@@ -2075,12 +2677,7 @@ void CdGDSVirtualFolder::SetLinkFile(const UTF8String &FileName)
 {
 	if (FileName != fLinkFileName)
 	{
-		if (fLinkFile)
-		{
-			CdGDSFile *file = fLinkFile;
-			fLinkFile = NULL;
-			delete file;
-		}
+		_CloseLink();
 		fLinkFileName = FileName;
 		fHasTried = false;
 		fChanged = true;
@@ -2091,110 +2688,110 @@ void CdGDSVirtualFolder::SetLinkFile(const UTF8String &FileName)
 CdGDSObj *CdGDSVirtualFolder::AddFolder(const UTF8String &Name)
 {
 	_CheckLinked();
-	return fLinkFile->Root().AddFolder(Name);
+	return fLinkRoot->AddFolder(Name);
 }
 
 CdGDSObj *CdGDSVirtualFolder::AddObj(const UTF8String &Name, CdGDSObj *val)
 {
 	_CheckLinked();
-	return fLinkFile->Root().AddObj(Name, val);
+	return fLinkRoot->AddObj(Name, val);
 }
 
 CdGDSObj *CdGDSVirtualFolder::InsertObj(int index, const UTF8String &Name,
 	CdGDSObj *val)
 {
 	_CheckLinked();
-	return fLinkFile->Root().AddObj(Name, val);
+	return fLinkRoot->AddObj(Name, val);
 }
 
 void CdGDSVirtualFolder::MoveTo(int Index, int NewPos)
 {
 	_CheckLinked();
-	fLinkFile->Root().MoveTo(Index, NewPos);
+	fLinkRoot->MoveTo(Index, NewPos);
 }
 
 void CdGDSVirtualFolder::UnloadObj(int Index)
 {
 	_CheckLinked();
-	fLinkFile->Root().UnloadObj(Index);
+	fLinkRoot->UnloadObj(Index);
 }
 
 void CdGDSVirtualFolder::UnloadObj(CdGDSObj *val)
 {
 	_CheckLinked();
-	fLinkFile->Root().UnloadObj(val);
+	fLinkRoot->UnloadObj(val);
 }
 
 void CdGDSVirtualFolder::DeleteObj(int Index, bool force)
 {
 	_CheckLinked();
-	fLinkFile->Root().DeleteObj(Index, force);
+	fLinkRoot->DeleteObj(Index, force);
 }
 
 void CdGDSVirtualFolder::DeleteObj(CdGDSObj *val, bool force)
 {
 	_CheckLinked();
-	fLinkFile->Root().DeleteObj(val, force);
+	fLinkRoot->DeleteObj(val, force);
 }
 
 void CdGDSVirtualFolder::ClearObj(bool force)
 {
 	_CheckLinked();
-	fLinkFile->Root().ClearObj(force);
+	fLinkRoot->ClearObj(force);
 }
 
 CdGDSObj *CdGDSVirtualFolder::ObjItem(int Index)
 {
 	_CheckLinked();
-	return fLinkFile->Root().ObjItem(Index);
+	return fLinkRoot->ObjItem(Index);
 }
 
 CdGDSObj *CdGDSVirtualFolder::ObjItem(const UTF8String &Name)
 {
 	_CheckLinked();
-	return fLinkFile->Root().ObjItem(Name);
+	return fLinkRoot->ObjItem(Name);
 }
 
 CdGDSObj *CdGDSVirtualFolder::ObjItemEx(int Index)
 {
 	_CheckLinked();
-	return fLinkFile->Root().ObjItemEx(Index);
+	return fLinkRoot->ObjItemEx(Index);
 }
 
 CdGDSObj *CdGDSVirtualFolder::ObjItemEx(const UTF8String &Name)
 {
 	_CheckLinked();
-	return fLinkFile->Root().ObjItemEx(Name);
+	return fLinkRoot->ObjItemEx(Name);
 }
 
 CdGDSObj *CdGDSVirtualFolder::Path(const UTF8String &FullName)
 {
 	_CheckLinked();
-	return fLinkFile->Root().Path(FullName);
+	return fLinkRoot->Path(FullName);
 }
 
 CdGDSObj *CdGDSVirtualFolder::PathEx(const UTF8String &FullName)
 {
 	_CheckLinked();
-	return fLinkFile->Root().PathEx(FullName);
+	return fLinkRoot->PathEx(FullName);
 }
 
 int CdGDSVirtualFolder::IndexObj(CdGDSObj *Obj)
 {
 	_CheckLinked();
-	return fLinkFile->Root().IndexObj(Obj);
+	return fLinkRoot->IndexObj(Obj);
 }
 
 bool CdGDSVirtualFolder::HasChild(CdGDSObj *Obj, bool Recursive)
 {
 	_CheckLinked();
-	return fLinkFile->Root().HasChild(Obj, Recursive);
+	return fLinkRoot->HasChild(Obj, Recursive);
 }
 
 int CdGDSVirtualFolder::NodeCount()
 {
 	_CheckLinked();
-	return fLinkFile->Root().NodeCount();
+	return fLinkRoot->NodeCount();
 }
 
 static const char *VAR_FILENAME = "FILENAME";
@@ -2218,8 +2815,8 @@ void CdGDSVirtualFolder::Saving(CdWriter &Writer)
 void CdGDSVirtualFolder::Synchronize()
 {
 	CdGDSAbsFolder::Synchronize();
-	if (fLinkFile)
-		fLinkFile->fRoot.Synchronize();
+	if (fLinkRoot)
+		fLinkRoot->Synchronize();
 }
 
 
@@ -2507,6 +3104,7 @@ void CdGDSStreamContainer::GetOwnBlockStream(vector<CdStream*> &Out)
 CdGDSRoot::CdGDSRoot(): CdGDSFolder()
 {
 	fVFolder = NULL;
+	fGeneration = 0;
 }
 
 UTF8String CdGDSRoot::Name() const
@@ -2529,6 +3127,24 @@ void CdGDSRoot::SetName(const UTF8String &NewName)
 		throw ErrGDSFile(ERR_ROOT_NAME);
 }
 
+static const char *VAR_GENERATION = "GENERATION";
+
+void CdGDSRoot::Loading(CdReader &Reader, TdVersion Version)
+{
+	fGeneration = 0;
+	if (Reader.HaveProperty(VAR_GENERATION))
+		Reader[VAR_GENERATION] >> fGeneration;
+	CdGDSFolder::Loading(Reader, Version);
+}
+
+void CdGDSRoot::Saving(CdWriter &Writer)
+{
+	// not written without metadata index, unknown to the older versions
+	if (fGeneration > 0)
+		Writer[VAR_GENERATION] << fGeneration;
+	CdGDSFolder::Saving(Writer);
+}
+
 
 
 // =====================================================================
@@ -2583,6 +3199,16 @@ void CdGDSFile::_Init()
 	fReadOnly = false;
 	fLog = new CdLogRecord; fLog->AddRef();
 	fprocess_id = GetCurrentProcessID();
+	fCommitGen = 0;
+	fCommitPos = 0;
+	fNodeLimit = fNodeLoads = 0;
+	fNodeClock = 0;
+	fNodeInUse = NULL;
+	(fArena = new CdArena)->AddRef();
+	fMetaIndex = false;
+	fSyncStamp = 0;
+	fReadCopy = NULL;
+	fReadCopyStamp = 0;
 }
 
 CdGDSFile::CdGDSFile(): CdBlockCollection()
@@ -2628,14 +3254,81 @@ CdGDSFile::~CdGDSFile()
 {
 	CloseFile();
 	if (fLog) fLog->Release();
+	if (fArena) fArena->Release();
+}
+
+// the file of metadata index
+static const char *META_FILE_SUFFIX = ".meta";
+// 'GDSM' in little endian
+static const C_UInt32 META_MAGIC = 0x4D534447;
+static const C_UInt32 META_VERSION = 2;
+// magic, version and the identity of GDS file
+static const C_UInt32 META_HEADER_SIZE = 4 + 4 + 4*8;
+// the node headers larger than 1MiB are not copied into the index
+static const SIZE64 META_MAX_HEADER = 1024*1024;
+
+/// the identity of file: inode, size and modification time
+static bool file_stamp(const char *fn, C_Int64 stamp[4])
+{
+#if defined(COREARRAY_PLATFORM_UNIX)
+	struct stat st;
+	if (stat(fn, &st) != 0) return false;
+	stamp[0] = st.st_ino;
+	stamp[1] = st.st_size;
+	stamp[2] = st.st_mtime;
+#if defined(__APPLE__)
+	stamp[3] = st.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	stamp[3] = st.st_mtim.tv_nsec;
+#else
+	stamp[3] = 0;
+#endif
+	return true;
+#elif defined(COREARRAY_PLATFORM_WINDOWS)
+	HANDLE h = CreateFileA(fn, 0,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	BY_HANDLE_FILE_INFORMATION info;
+	BOOL ok = GetFileInformationByHandle(h, &info);
+	CloseHandle(h);
+	if (!ok) return false;
+	// the file index and volume serial number instead of inode
+	stamp[0] = ((C_Int64)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	stamp[1] = ((C_Int64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	// in 100 nanoseconds
+	stamp[2] = ((C_Int64)info.ftLastWriteTime.dwHighDateTime << 32) |
+		info.ftLastWriteTime.dwLowDateTime;
+	stamp[3] = info.dwVolumeSerialNumber;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// replace a file, which may exist
+static bool replace_file(const char *src, const char *dst)
+{
+#if defined(COREARRAY_PLATFORM_WINDOWS)
+	return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(src, dst) == 0;
+#endif
 }
 
 void CdGDSFile::LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError)
+{
+	_LoadStream(Stream, ReadOnly, AllowError, NULL);
+}
+
+void CdGDSFile::_LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError,
+	const char *MetaFile)
 {
 	// Initialize
 	CloseFile();
 	fLog->List().clear();
 	fReadOnly = ReadOnly;
+	fSyncStamp = WriteCount();
 
 	// Check the prefix
 	const char *prefix = GDSFilePrefix();
@@ -2658,9 +3351,37 @@ void CdGDSFile::LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError)
 	TdGDSBlockID Entry;
 	BYTE_LE<CdStream>(Stream) >> Entry;
 
-	// Block construction
+	// Block construction, from the metadata index if it is up to date
+	C_UInt64 MetaGen = 0;
+	if (MetaFile && _LoadMetaIndex(Stream, MetaFile, Entry, MetaGen))
+	{
+		// the root header is read from the file for its generation
+		if (_LoadRoot(Entry, true) && (fRoot.fGeneration == MetaGen))
+		{
+		#ifdef COREARRAY_CODE_USING_LOG
+			Log().Add(CdLogRecord::LOG_INFO,
+				"Load the block table from the metadata index.");
+		#endif
+			return;
+		}
+	#ifdef COREARRAY_CODE_USING_LOG
+		Log().Add(CdLogRecord::LOG_INFO,
+			"The metadata index is out of date.");
+	#endif
+		fRoot._ClearFolder();
+		if (fRoot.fGDSStream)
+		{
+			fRoot.fGDSStream->Release();
+			fRoot.fGDSStream = NULL;
+		}
+		CdBlockCollection::Detach();
+	}
 	CdBlockCollection::LoadStream(Stream, ReadOnly, AllowError, &Log());
+	_LoadRoot(Entry, false);
+}
 
+bool CdGDSFile::_LoadRoot(TdGDSBlockID Entry, bool NoThrow)
+{
 #ifdef COREARRAY_CODE_USING_LOG
 	Log().Add(CdLogRecord::LOG_INFO,
 		"Load all data stream (%d in total) with an entry id (0x%04X).",
@@ -2678,12 +3399,21 @@ void CdGDSFile::LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError)
 			(double)fRoot.fGDSStream->Size());
 	#endif
 
-		CdReader Reader(fRoot.fGDSStream, &Log());
-		Reader.BeginNameSpace();
-		_INTERNAL::CdObject_LoadStruct(fRoot, Reader, fVersion);
-		Reader.EndStruct();
-	} else
+		try {
+			CdReader Reader(fRoot.fGDSStream, &Log());
+			Reader.BeginNameSpace();
+			_INTERNAL::CdObject_LoadStruct(fRoot, Reader, fVersion);
+			Reader.EndStruct();
+		}
+		catch (exception &) {
+			if (!NoThrow) throw;
+			return false;
+		}
+	} else {
+		if (NoThrow) return false;
 		throw ErrGDSFile(ERR_GDS_ENTRY, Entry.Get());
+	}
+	return true;
 }
 
 void CdGDSFile::SaveStream(CdStream *Stream)
@@ -2718,17 +3448,17 @@ void CdGDSFile::SaveStream(CdStream *Stream)
 
 void CdGDSFile::LoadFile(const UTF8String &fn, bool ReadOnly, bool AllowError)
 {
-	TdAutoRef<CdStream> F(new CdFileStream(RawText(fn).c_str(),
-		ReadOnly ? CdFileStream::fmOpenRead : CdFileStream::fmOpenReadWrite));
-	LoadStream(F.get(), ReadOnly, AllowError);
+	LoadFile(RawText(fn).c_str(), ReadOnly, AllowError);
 	fFileName = fn;
 }
 
 void CdGDSFile::LoadFile(const char *fn, bool ReadOnly, bool AllowError)
 {
+	// a metadata index is kept when opening for writing, since the stale one
+	// is rejected by the identity of file and the generation of root
 	TdAutoRef<CdStream> F(new CdFileStream(fn,
 		ReadOnly ? CdFileStream::fmOpenRead : CdFileStream::fmOpenReadWrite));
-	LoadStream(F.get(), ReadOnly, AllowError);
+	_LoadStream(F.get(), ReadOnly, AllowError, ReadOnly ? fn : NULL);
 	fFileName = UTF8Text(fn);
 }
 
@@ -2736,7 +3466,7 @@ void CdGDSFile::LoadFileFork(const char *fn, bool ReadOnly, bool AllowError)
 {
 	TdAutoRef<CdStream> F(new CdForkFileStream(fn,
 		ReadOnly ? CdFileStream::fmOpenRead : CdFileStream::fmOpenReadWrite));
-	LoadStream(F.get(), ReadOnly, AllowError);
+	_LoadStream(F.get(), ReadOnly, AllowError, ReadOnly ? fn : NULL);
 	fFileName = UTF8Text(fn);
 }
 
@@ -2745,6 +3475,25 @@ void CdGDSFile::SyncFile()
 	if (fStream == NULL)
 		throw ErrGDSFile(ERR_GDS_SAVE);
 	fRoot._UpdateAll();
+	// a new generation once the file with metadata index is modified
+	if (!fReadOnly && (fMetaIndex || (fRoot.fGeneration > 0)) &&
+		(WriteCount() != fSyncStamp))
+	{
+		fRoot.fGeneration ++;
+		fRoot.SaveToBlockStream();
+	}
+	if (fSWMR && !fReadOnly)
+		CommitSWMR();
+	if (fMetaIndex && !fReadOnly && !fFileName.empty())
+	{
+		// not rebuilt if nothing is written
+		if (fMetaBuf.empty() || (WriteCount() != fSyncStamp))
+		{
+			_BuildMetaIndex();
+			_WriteMetaIndex(RawText(fFileName).c_str());
+		}
+	}
+	fSyncStamp = WriteCount();
 }
 
 void CdGDSFile::SaveAsFile(const UTF8String &fn)
@@ -2806,9 +3555,15 @@ void CdGDSFile::DuplicateFile(const char *fn, bool deep)
 
 void CdGDSFile::CloseFile()
 {
+	if (fReadCopy)
+	{
+		delete fReadCopy;
+		fReadCopy = NULL;
+	}
 	if (fStream)
 	{
 		SyncFile();
+		const string meta_fn = fMetaBuf.empty() ? string() : RawText(fFileName);
 		fFileName.clear();
 		fLog->List().clear();
 		fRoot.Attribute().Clear();
@@ -2821,6 +3576,17 @@ void CdGDSFile::CloseFile()
 			fRoot.fGDSStream = NULL;
 		}
 		CdBlockCollection::Clear();
+
+		// the records of nodes still referred elsewhere keep the old arena
+		fArena->Release();
+		(fArena = new CdArena)->AddRef();
+
+		// the blocks have been flushed, update the identity of file
+		if (!fMetaBuf.empty())
+		{
+			_WriteMetaIndex(meta_fn.c_str());
+			vector<C_UInt8>().swap(fMetaBuf);
+		}
     }
 }
 
@@ -2838,6 +3604,547 @@ void CdGDSFile::TidyUp(bool deep)
 	LoadFile(fn, TempReadOnly);
 }
 
+CdGDSObj *CdGDSFile::ReadOnlyObj(CdGDSObj &Obj)
+{
+	if (!fStream || fFileName.empty() || (Obj.GDSFile() != this))
+		return NULL;
+
+	// the handle can be reused if the streams of the object have not been
+	//   modified since opening it, an object without its own streams (e.g.,
+	//   depending on other objects) is always read from a new handle
+	if (fReadCopy)
+	{
+		vector<const CdBlockStream*> List;
+		Obj.GetOwnBlockStream(List);
+		bool stale = List.empty() || !Obj.fGDSStream ||
+			(Obj.fGDSStream->WriteStamp() > fReadCopyStamp);
+		vector<const CdBlockStream*>::iterator it;
+		for (it=List.begin(); (it != List.end()) && !stale; it++)
+			stale = !*it || ((*it)->WriteStamp() > fReadCopyStamp);
+		if (!stale)
+		{
+			CdGDSObj *p = fReadCopy->Root().PathEx(Obj.FullName());
+			if (p && p->fGDSStream &&
+					(p->fGDSStream->ID() == Obj.fGDSStream->ID()))
+				return p;
+		}
+		delete fReadCopy;
+		fReadCopy = NULL;
+	}
+
+	// open a new handle
+	CdGDSFile *F = new CdGDSFile;
+	try {
+		F->LoadFile(fFileName, true);
+	}
+	catch (exception &) {
+		delete F;
+		return NULL;
+	}
+	fReadCopy = F;
+	fReadCopyStamp = WriteCount();
+	return F->Root().PathEx(Obj.FullName());
+}
+
+// the file of commit records
+static const char *SWMR_FILE_SUFFIX = ".swmr";
+// 'GDSC' in little endian
+static const C_UInt32 SWMR_MAGIC = 0x43534447;
+// magic, length, generation, file size, number of streams, and checksum
+static const C_UInt32 SWMR_RECORD_BASE = 4 + 4 + 8 + 8 + 4 + 4;
+// stream ID, size and write stamp
+static const C_UInt32 SWMR_RECORD_ITEM = GDS_BLOCK_ID_SIZE + 8 + 8;
+
+void CdGDSFile::SetSWMR(bool Enable)
+{
+	static const char *ERR_SWMR_FILE =
+		"The single-writer/multi-reader mode requires an opened GDS file.";
+
+	if (Enable == fSWMR) return;
+	if (Enable)
+	{
+		if (!fStream || fFileName.empty())
+			throw ErrGDSFile(ERR_SWMR_FILE);
+		fSWMR = true;
+		fCommitGen = 0;
+		fCommitPos = 0;
+		if (!fReadOnly)
+		{
+			// start a new list of commit records
+			{
+				TdAutoRef<CdStream> F(new CdFileStream(
+					(RawText(fFileName) + SWMR_FILE_SUFFIX).c_str(),
+					CdFileStream::fmCreate));
+			}
+			SyncFile();
+		} else
+			Refresh();
+	} else
+		fSWMR = false;
+}
+
+void CdGDSFile::CommitSWMR()
+{
+	if (!fSWMR || fReadOnly || !fStream) return;
+
+	// the committed sizes of all block streams
+	const C_UInt32 n = fBlockList.size();
+	const C_UInt32 len = SWMR_RECORD_BASE + n * SWMR_RECORD_ITEM;
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream(len));
+	BYTE_LE<CdStream> W(M.get());
+	W << SWMR_MAGIC << len << C_UInt64(fCommitGen + 1) << C_Int64(fStreamSize)
+		<< n;
+	vector<CdBlockStream*>::const_iterator it;
+	for (it = fBlockList.begin(); it != fBlockList.end(); it++)
+		W << (*it)->ID() << C_Int64((*it)->Size()) << (*it)->WriteStamp();
+	const C_UInt8 *buf = (const C_UInt8*)M->BufPointer();
+	W << C_UInt32(crc32(0, buf, len - 4));
+
+	// append the record
+	TdAutoRef<CdStream> F(new CdFileStream(
+		(RawText(fFileName) + SWMR_FILE_SUFFIX).c_str(),
+		CdFileStream::fmOpenReadWrite));
+	F->SetPosition(F->GetSize());
+	F->WriteData(buf, len);
+	fCommitGen ++;
+}
+
+/// a commit record in the SWMR mode
+struct TSWMRRecord
+{
+	C_UInt64 Gen;
+	C_Int64 FileSize;
+	vector<TdGDSBlockID> ID;
+	vector<SIZE64> Size;
+	vector<C_Int64> Stamp;
+};
+
+/// load the new records from 'Pos' to 'Size', and parse the last complete
+/// one, return false if there is no new complete record
+static bool swmr_read_record(CdStream &F, SIZE64 &Pos, SIZE64 Size,
+	TSWMRRecord &Rec)
+{
+	if (Size - Pos < SWMR_RECORD_BASE) return false;
+	const ssize_t n = Size - Pos;
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream(n));
+	F.SetPosition(Pos);
+	F.ReadData(M->BufPointer(), n);
+	const C_UInt8 *buf = (const C_UInt8*)M->BufPointer();
+
+	// find the last complete record, a partial one is still being written
+	BYTE_LE<CdStream> R(M.get());
+	ssize_t pos = 0, last = -1;
+	while (pos + (ssize_t)SWMR_RECORD_BASE <= n)
+	{
+		C_UInt32 magic, len;
+		R.SetPosition(pos);
+		R >> magic >> len;
+		if ((magic != SWMR_MAGIC) || (len < SWMR_RECORD_BASE) ||
+				(pos + (ssize_t)len > n))
+			break;
+		C_UInt32 crc;
+		R.SetPosition(pos + len - 4);
+		R >> crc;
+		if (crc != crc32(0, buf + pos, len - 4))
+			break;
+		last = pos;
+		pos += len;
+	}
+	if (last < 0) return false;
+	Pos += pos;
+
+	// parse the record
+	C_UInt32 cnt;
+	R.SetPosition(last + 8);
+	R >> Rec.Gen >> Rec.FileSize >> cnt;
+	Rec.ID.resize(cnt);
+	Rec.Size.resize(cnt);
+	Rec.Stamp.resize(cnt);
+	for (C_UInt32 i=0; i < cnt; i++)
+	{
+		C_Int64 sz;
+		R >> Rec.ID[i] >> sz >> Rec.Stamp[i];
+		Rec.Size[i] = sz;
+	}
+	return true;
+}
+
+bool CdGDSFile::Refresh()
+{
+	static const char *ERR_SWMR_CHANGED =
+		"The header in the block stream (%u) is rewritten by the writer during refreshing.";
+
+	if (!fSWMR || !fReadOnly || !fStream) return false;
+
+	// the file of commit records might not be created by the writer yet
+	TdAutoRef<CdStream> F;
+	try {
+		F = new CdFileStream((RawText(fFileName) + SWMR_FILE_SUFFIX).c_str(),
+			CdFileStream::fmOpenRead);
+	}
+	catch (ErrStream &) {
+		return false;
+	}
+
+	const SIZE64 size = F->GetSize();
+	if (size < fCommitPos) fCommitPos = 0;  // the writer restarted
+	const SIZE64 pos = fCommitPos;
+	TSWMRRecord Rec;
+	if (!swmr_read_record(*F, fCommitPos, size, Rec))
+		return false;
+
+	try {
+		// update the block streams, and the GDS nodes reload the headers
+		//   with changed write stamps
+		fRefreshed.clear();
+		CdBlockCollection::RefreshStream(Rec.FileSize, Rec.ID, Rec.Size,
+			Rec.Stamp);
+		fRoot.Refresh();
+
+		// the headers are rewritten in place by the writer, so a header
+		//   changed by a newer commit might be read partially
+		SIZE64 next = fCommitPos;
+		TSWMRRecord New;
+		if (!fRefreshed.empty() &&
+			swmr_read_record(*F, next, F->GetSize(), New))
+		{
+			map<C_UInt32, C_Int64> stamp;
+			for (size_t i=0; i < New.ID.size(); i++)
+				stamp[New.ID[i].Get()] = New.Stamp[i];
+			vector<CdBlockStream*>::iterator it;
+			for (it=fRefreshed.begin(); it != fRefreshed.end(); it++)
+			{
+				map<C_UInt32, C_Int64>::iterator p = stamp.find((*it)->ID().Get());
+				if ((p == stamp.end()) || (p->second != (*it)->CommitStamp()))
+					throw ErrGDSFile(ERR_SWMR_CHANGED, (*it)->ID().Get());
+			}
+		}
+	}
+	catch (...) {
+		// the record is applied again in the next call
+		fCommitPos = pos;
+		fRefreshed.clear();
+		throw;
+	}
+	fRefreshed.clear();
+	fCommitGen = Rec.Gen;
+	return true;
+}
+
+void CdGDSFile::RefreshedHeader(CdBlockStream *Stream)
+{
+	fRefreshed.push_back(Stream);
+}
+
+void CdGDSFile::SetMetaIndex(bool Enable)
+{
+	fMetaIndex = Enable;
+	if (!Enable) vector<C_UInt8>().swap(fMetaBuf);
+}
+
+void CdGDSFile::_MetaHeaders(CdGDSFolder &Folder, vector<CdBlockStream*> &List)
+{
+	// the root header is always read from the file for its generation
+	if ((&Folder != &fRoot) && Folder.fGDSStream &&
+			(Folder.fGDSStream->Size() <= META_MAX_HEADER))
+		List.push_back(Folder.fGDSStream);
+	vector<CdGDSFolder::TNode>::iterator it;
+	for (it=Folder.fList.begin(); it != Folder.fList.end(); it++)
+	{
+		if (it->IsFlagType(CdGDSFolder::TNode::FLAG_TYPE_FOLDER) && it->Obj)
+		{
+			_MetaHeaders(*static_cast<CdGDSFolder*>(it->Obj), List);
+		} else if (HaveID(it->StreamID))
+		{
+			CdBlockStream *s = (*this)[it->StreamID];
+			if (s->Size() <= META_MAX_HEADER)
+				List.push_back(s);
+			// the folder is not loaded
+			if (it->IsFlagType(CdGDSFolder::TNode::FLAG_TYPE_FOLDER))
+				_MetaHeaders(s, List);
+		}
+	}
+}
+
+void CdGDSFile::_MetaHeaders(CdBlockStream *Folder, vector<CdBlockStream*> &List)
+{
+	// read the child list without loading the folder
+	vector<CdGDSFolder::TNode> L;
+	{
+		CdReader Reader(Folder, &Log());
+		Reader.BeginNameSpace();
+		C_Int32 n = 0;
+		Reader[VAR_DIRCNT] >> n;
+		if (n > 0)
+		{
+			Reader[VAR_DIRLIST].BeginStruct();
+			for (C_Int32 k=0; k < n; k++)
+			{
+				CdGDSFolder::TNode I;
+				Reader.BeginNameSpace();
+				Reader[VAR_DIR_ID] >> I.StreamID;
+				Reader[VAR_DIR_FLAG] >> I.Flag;
+				Reader.EndStruct();
+				L.push_back(I);
+			}
+			Reader.EndStruct();
+		}
+		Reader.EndStruct();
+	}
+
+	vector<CdGDSFolder::TNode>::iterator it;
+	for (it=L.begin(); it != L.end(); it++)
+	{
+		if (HaveID(it->StreamID))
+		{
+			CdBlockStream *s = (*this)[it->StreamID];
+			if (s->Size() <= META_MAX_HEADER)
+				List.push_back(s);
+			if (it->IsFlagType(CdGDSFolder::TNode::FLAG_TYPE_FOLDER))
+				_MetaHeaders(s, List);
+		}
+	}
+}
+
+void CdGDSFile::_BuildMetaIndex()
+{
+	// the node headers
+	vector<CdBlockStream*> List;
+	_MetaHeaders(fRoot, List);
+
+	// the generation and the table of blocks, followed by the copies of
+	// node headers
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream);
+	BYTE_LE<CdStream> W(M.get());
+	W << fRoot.fGeneration;
+	CdBlockCollection::SaveBlockTable(W);
+	W << C_UInt32(List.size());
+	vector<C_UInt8> buf;
+	vector<CdBlockStream*>::iterator it;
+	for (it=List.begin(); it != List.end(); it++)
+	{
+		const C_UInt32 n = (*it)->Size();
+		W << (*it)->ID() << n;
+		if (n > 0)
+		{
+			buf.resize(n);
+			const SIZE64 pos = (*it)->Position();
+			(*it)->SetPosition(0);
+			(*it)->ReadData(&buf[0], n);
+			(*it)->SetPosition(pos);
+			M->WriteData(&buf[0], n);
+		}
+	}
+
+	const C_UInt8 *p = (const C_UInt8*)M->BufPointer();
+	fMetaBuf.assign(p, p + M->GetSize());
+}
+
+void CdGDSFile::_WriteMetaIndex(const char *fn)
+{
+	C_Int64 stamp[4];
+	if (fMetaBuf.empty() || !file_stamp(fn, stamp)) return;
+
+	const size_t len = META_HEADER_SIZE + fMetaBuf.size() + 4;
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream(len));
+	BYTE_LE<CdStream> W(M.get());
+	W << META_MAGIC << META_VERSION << stamp[0] << stamp[1] << stamp[2] <<
+		stamp[3];
+	M->WriteData(&fMetaBuf[0], fMetaBuf.size());
+	const C_UInt8 *buf = (const C_UInt8*)M->BufPointer();
+	W << C_UInt32(crc32(0, buf, len - 4));
+
+	// replace the old index, which is optional and a failure is ignored
+	const string meta_fn = string(fn) + META_FILE_SUFFIX;
+	const string tmp_fn = meta_fn + ".tmp";
+	try {
+		TdAutoRef<CdStream> F(new CdFileStream(tmp_fn.c_str(),
+			CdFileStream::fmCreate));
+		F->WriteData(buf, len);
+	}
+	catch (ErrStream &) {
+		remove(tmp_fn.c_str());
+		return;
+	}
+	if (!replace_file(tmp_fn.c_str(), meta_fn.c_str()))
+		remove(tmp_fn.c_str());
+}
+
+bool CdGDSFile::_LoadMetaIndex(CdStream *Stream, const char *fn,
+	TdGDSBlockID Entry, C_UInt64 &Gen)
+{
+	C_Int64 stamp[4];
+	if (!file_stamp(fn, stamp)) return false;
+
+	// read the whole index
+	TdAutoRef<CdStream> F;
+	try {
+		F = new CdFileStream((string(fn) + META_FILE_SUFFIX).c_str(),
+			CdFileStream::fmOpenRead);
+	}
+	catch (ErrStream &) {
+		return false;
+	}
+	const SIZE64 n = F->GetSize();
+	if (n < (SIZE64)META_HEADER_SIZE + 4) return false;
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream(n));
+	F->ReadData(M->BufPointer(), n);
+	const C_UInt8 *buf = (const C_UInt8*)M->BufPointer();
+
+	// check the checksum and the identity of file
+	BYTE_LE<CdStream> R(M.get());
+	C_UInt32 crc;
+	R.SetPosition(n - 4);
+	R >> crc;
+	if (crc != crc32(0, buf, n - 4)) return false;
+	C_UInt32 magic, ver;
+	C_Int64 s[4];
+	R.SetPosition(0);
+	R >> magic >> ver >> s[0] >> s[1] >> s[2] >> s[3];
+	if ((magic != META_MAGIC) || (ver != META_VERSION)) return false;
+	if (memcmp(s, stamp, sizeof(s)) != 0) return false;
+
+	// the generation, the table of blocks and the node headers
+	try {
+		R >> Gen;
+		CdBlockCollection::LoadBlockTable(Stream, fReadOnly, R);
+		C_UInt32 cnt;
+		R >> cnt;
+		for (C_UInt32 i=0; i < cnt; i++)
+		{
+			TdGDSBlockID id;
+			C_UInt32 len;
+			R >> id >> len;
+			const SIZE64 pos = R.Position();
+			if (pos + len > n - 4)
+				throw ErrGDSFile("Invalid metadata index.");
+			if ((id.Get() != Entry.Get()) && HaveID(id))
+				(*this)[id]->SetCopy(buf + pos, len);
+			R.SetPosition(pos + len);
+		}
+	}
+	catch (exception &) {
+		CdBlockCollection::Detach();
+		return false;
+	}
+	return true;
+}
+
+void CdGDSFile::SetNodeCache(int Limit, TdNodeInUse InUse)
+{
+	fNodeLimit = (Limit > 0) ? Limit : 0;
+	fNodeInUse = InUse;
+	fNodeLoads = 0;
+}
+
+int CdGDSFile::NodeCacheCount()
+{
+	int n = 0;
+	vector<CdGDSFolder*> Stack;
+	Stack.push_back(&fRoot);
+	while (!Stack.empty())
+	{
+		CdGDSFolder *F = Stack.back();
+		Stack.pop_back();
+		vector<CdGDSFolder::TNode>::iterator it;
+		for (it = F->fList.begin(); it != F->fList.end(); it++)
+		{
+			if (it->Obj)
+			{
+				n ++;
+				if (dynamic_cast<CdGDSFolder*>(it->Obj))
+					Stack.push_back(static_cast<CdGDSFolder*>(it->Obj));
+			}
+		}
+	}
+	return n;
+}
+
+void CdGDSFile::_TouchNode(CdGDSFolder::TNode &I, bool Loaded)
+{
+	I._used = ++fNodeClock;
+	// only the nodes of a read-only file are unloaded
+	if (Loaded && fReadOnly)
+	{
+		// trim the cache after loading a quarter of the limit
+		if (++fNodeLoads > fNodeLimit/4)
+		{
+			fNodeLoads = 0;
+			_TrimNodes(I.Obj);
+		}
+	}
+}
+
+namespace CoreArray
+{
+	/// a loaded child node in the node cache
+	struct TNodeUse
+	{
+		CdGDSFolder *Folder;
+		int Index;
+		C_UInt32 Used;
+		bool operator< (const TNodeUse &val) const { return Used < val.Used; }
+	};
+}
+
+void CdGDSFile::_TrimNodes(CdGDSObj *Keep)
+{
+	// the node being accessed and its ancestors are kept
+	set<CdGDSObj*> Path;
+	for (CdGDSObj *p = Keep; p; p = p->fFolder)
+		Path.insert(p);
+
+	// collect all loaded nodes
+	vector<TNodeUse> List;
+	vector<CdGDSFolder*> Stack;
+	Stack.push_back(&fRoot);
+	while (!Stack.empty())
+	{
+		CdGDSFolder *F = Stack.back();
+		Stack.pop_back();
+		for (size_t i=0; i < F->fList.size(); i++)
+		{
+			CdGDSFolder::TNode &I = F->fList[i];
+			if (I.Obj)
+			{
+				TNodeUse U;
+				U.Folder = F; U.Index = i; U.Used = I._used;
+				List.push_back(U);
+				if (dynamic_cast<CdGDSFolder*>(I.Obj))
+					Stack.push_back(static_cast<CdGDSFolder*>(I.Obj));
+			}
+		}
+	}
+	if ((int)List.size() <= fNodeLimit) return;
+
+	// unload the least recently used nodes
+	sort(List.begin(), List.end());
+	size_t n = List.size();
+	const size_t n_keep = fNodeLimit - fNodeLimit/4;
+	vector<TNodeUse>::iterator it;
+	for (it = List.begin(); (it != List.end()) && (n > n_keep); it++)
+	{
+		CdGDSFolder::TNode &I = it->Folder->fList[it->Index];
+		CdGDSObj *Obj = I.Obj;
+		if (!Obj || (Obj->Reference() > 1) || Obj->fChanged) continue;
+		if (Path.count(Obj)) continue;
+		if (dynamic_cast<CdGDSVirtualFolder*>(Obj)) continue;
+		if (dynamic_cast<CdGDSFolder*>(Obj))
+		{
+			// keep a folder with loaded children
+			vector<CdGDSFolder::TNode> &L = static_cast<CdGDSFolder*>(Obj)->fList;
+			vector<CdGDSFolder::TNode>::iterator p;
+			for (p = L.begin(); p != L.end(); p++)
+				if (p->Obj) break;
+			if (p != L.end()) continue;
+		}
+		if (fNodeInUse && fNodeInUse(Obj)) continue;
+		I.Obj = NULL;
+		Obj->Release();
+		n --;
+	}
+}
+
 bool CdGDSFile::_HaveModify(CdGDSFolder *folder)
 {
 	if (folder->fChanged) return true;
@@ -2887,3 +4194,102 @@ void CdGDSFile::SetProcessID()
 {
 	fprocess_id = GetCurrentProcessID();
 }
+
+
+
+// =====================================================================
+// CdGDSFileRegistry
+// =====================================================================
+
+static CdGDSFileRegistry GDSFileReg;
+
+CdGDSFileRegistry &CoreArray::GDSFileRegistry()
+{
+	return GDSFileReg;
+}
+
+/// the canonical path of a file
+static string canonical_path(const char *fn)
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	char *s = realpath(fn, NULL);
+	if (s)
+	{
+		string rv(s);
+		free(s);
+		return rv;
+	}
+#endif
+	return string(fn);
+}
+
+CdGDSFile *CdGDSFileRegistry::Open(const char *FileName)
+{
+	const string key = canonical_path(FileName);
+	C_Int64 stamp[4] = { 0, 0, 0, 0 };
+	file_stamp(key.c_str(), stamp);
+
+	TdAutoMutex _m(&fMutex);
+	map<string, TEntry*>::iterator it = fKeyMap.find(key);
+	if (it != fKeyMap.end())
+	{
+		TEntry *p = it->second;
+		if (memcmp(p->Stamp, stamp, sizeof(stamp)) == 0)
+		{
+			p->RefCount ++;
+			return p->File;
+		}
+		// the file has been changed, and the old one is kept for its users
+		p->Key.clear();
+		fKeyMap.erase(it);
+	}
+
+	CdGDSFile *file = new CdGDSFile;
+	try {
+		file->LoadFile(FileName, true);
+	}
+	catch (...) {
+		delete file;
+		throw;
+	}
+
+	TEntry *p = new TEntry;
+	p->File = file;
+	p->RefCount = 1;
+	memcpy(p->Stamp, stamp, sizeof(stamp));
+	p->Key = key;
+	fKeyMap[key] = p;
+	fFileMap[file] = p;
+	return file;
+}
+
+void CdGDSFileRegistry::Close(CdGDSFile *File)
+{
+	TEntry *p = NULL;
+	{
+		TdAutoMutex _m(&fMutex);
+		map<const CdGDSFile*, TEntry*>::iterator it = fFileMap.find(File);
+		if (it == fFileMap.end())
+			throw ErrGDSFile("Invalid shared GDS file.");
+		p = it->second;
+		if (--p->RefCount > 0) return;
+		fFileMap.erase(it);
+		if (!p->Key.empty())
+			fKeyMap.erase(p->Key);
+	}
+	delete p->File;
+	delete p;
+}
+
+int CdGDSFileRegistry::RefCount(const CdGDSFile *File)
+{
+	TdAutoMutex _m(&fMutex);
+	map<const CdGDSFile*, TEntry*>::iterator it = fFileMap.find(File);
+	return (it != fFileMap.end()) ? it->second->RefCount : 0;
+}
+
+size_t CdGDSFileRegistry::Count()
+{
+	TdAutoMutex _m(&fMutex);
+	return fFileMap.size();
+}
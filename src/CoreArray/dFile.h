@@ -52,6 +52,79 @@ namespace CoreArray
 	class CdGDSObj;
 	class CdGDSFolder;
 	class CdGDSFile;
+	class CdGDSRoot;
+
+	/// Bump allocator for the small records of GDS nodes
+	/** The records are carved from large chunks to reduce the allocator
+	 *  calls and to keep the records loaded together close in memory. A chunk
+	 *  is freed once all records in it are freed, and the owners of records
+	 *  hold a reference to the arena. It is not thread-safe, like the tree
+	 *  of GDS nodes. Only the attribute pairs of CdObjAttr are allocated in
+	 *  it; the node objects are reference counted and may outlive the file,
+	 *  so they are created on the heap by CdObjClassMgr.
+	**/
+	class COREARRAY_DLL_DEFAULT CdArena: public CdRef
+	{
+	public:
+		/// the size of a chunk
+		static const size_t CHUNK_SIZE = 64*1024;
+
+		/// constructor
+		CdArena();
+		/// destructor
+		virtual ~CdArena();
+
+		/// allocate a block aligned to 8 bytes
+		void *Alloc(size_t Size);
+		/// free a block returned by Alloc()
+		static void Free(void *Ptr);
+
+		/// the number of allocated chunks
+		COREARRAY_INLINE size_t ChunkCount() const { return fNumChunk; }
+
+	private:
+		struct TChunk;
+		TChunk *fList;     ///< all chunks in a doubly-linked list
+		TChunk *fCurrent;  ///< the chunk for new blocks
+		size_t fNumChunk;  ///< the number of chunks
+
+		TChunk *_NewChunk(size_t Size);
+		void _FreeChunk(TChunk *p);
+	};
+
+	/// Open-addressing hash index of the names in a list, built lazily
+	/** The short lists are scanned linearly, and the hash table is built at
+	 *  the first lookup once there are enough items. The owner calls Add(),
+	 *  Remove() and Shift() when modifying an indexed list.
+	**/
+	class COREARRAY_DLL_DEFAULT CdNameIndex
+	{
+	public:
+		/// return the name of the item at 'Index' in 'List'
+		typedef const UTF8String &(*TdGetName)(const void *List, size_t Index);
+
+		/// constructor
+		CdNameIndex(const void *List, TdGetName GetName);
+
+		/// return the index of a name of 'Len' bytes, or -1 if not found
+		int Find(size_t Count, const char *Name, size_t Len);
+		/// add the item 'Index' after the other indices have been shifted
+		void Add(size_t Count, int Index);
+		/// remove the item 'Index' before it is erased from the list
+		void Remove(int Index);
+		/// add 'Delta' to the indices not less than 'From'
+		void Shift(int From, int Delta);
+		/// drop the hash table, rebuilt at the next lookup
+		COREARRAY_INLINE void Reset() { fTable.clear(); }
+
+	protected:
+		const void *fList;
+		TdGetName fGetName;
+		/// the indices in the list, or -1 for empty slots
+		std::vector<C_Int32> fTable;
+
+		void Build(size_t Count);
+	};
 
 	/// Attribute class for GDS object
 	class COREARRAY_DLL_DEFAULT CdObjAttr: public CdObject
@@ -97,21 +170,46 @@ namespace CoreArray
 		void SetName(const UTF8String &OldName, const UTF8String &NewName);
 		void SetName(int Index, const UTF8String &NewName);
 
+		/// whether the attributes serialized in the current name space of
+		/// 'Reader' have a specified name, without decoding the values
+		static bool PeekName(CdReader &Reader, const UTF8String &Name);
+
 	protected:
 		struct TdPair {
 			UTF8String name;
 			CdAny val;
+			/// the serialized value not decoded yet, stored after the pair in
+			/// the same block, or raw_len = 0 if 'val' is used
+			C_UInt8 *raw;
+			C_UInt32 raw_len;
+
+			TdPair(): raw(NULL), raw_len(0) { }
 		};
 
 		CdGDSObj &fOwner;
 		std::vector<TdPair*> fList;
+		/// the hash index of attribute names
+		CdNameIndex fNameIndex;
+		/// the arena of the pairs loaded from a GDS file, or NULL for the heap
+		CdArena *fArena;
+		/// the lock of the list, the name index and the lazy decoding, since
+		/// the attributes can be read by several threads
+		CdThreadMutex fMutex;
 
 		virtual void Loading(CdReader &Reader, TdVersion Version);
 		virtual void Saving(CdWriter &Writer);
 
 	private:
+		// _Find(), _Value(), _Delete() and _Clear() are called with fMutex held
 		std::vector<TdPair*>::iterator _Find(const UTF8String &Name);
         void _ValidateName(const UTF8String &name);
+		/// return the value, decoded at the first access
+		CdAny &_Value(TdPair &p);
+		void _Delete(int Index);
+		void _Clear();
+		TdPair *_NewPair(const UTF8String &Name, size_t RawSize);
+		void _FreePair(TdPair *p);
+		static const UTF8String &_PairName(const void *List, size_t Index);
 	};
 
 
@@ -152,6 +250,8 @@ namespace CoreArray
 
 		/// synchronize, save data to disk
 		virtual void Synchronize();
+		/// reload the information committed by a writer in the SWMR mode
+		virtual void Refresh();
 
 		/// get a list of CdBlockStream owned by this object, except fGDSStream
 		virtual void GetOwnBlockStream(vector<const CdBlockStream*> &Out) const;
@@ -164,6 +264,17 @@ namespace CoreArray
 		COREARRAY_INLINE CdBlockStream *GDSStream() const { return fGDSStream; }
 		COREARRAY_INLINE CdGDSFolder *Folder() const { return fFolder; }
 
+		/// a function called in the destructor of GDS object
+		typedef void (*TdOnDestroy)(CdGDSObj *Obj);
+		/// set the function called when a GDS object is destroyed, e.g., to
+		/// release the handles referring to it, or NULL
+		static void SetOnDestroy(TdOnDestroy Proc);
+
+		/// a counter increased when a GDS object is destroyed, renamed or
+		/// moved to another folder, so that the objects found by paths can
+		/// be cached while it is not changed
+		COREARRAY_INLINE static C_UInt32 PathStamp() { return fPathStamp; }
+
 	protected:
 		CdObjAttr fAttr;
 		CdGDSFolder *fFolder;
@@ -191,6 +302,11 @@ namespace CoreArray
 		static void RaiseInvalidAssign(const char *ThisClass, CdGDSObj *Source);
 
 	private:
+		static TdOnDestroy fOnDestroy;
+		static volatile C_UInt32 fPathStamp;
+
+		static void _PathChanged();
+
 		static void _GDSObjInitProc(CdObjClassMgr &Sender, CdObject *dObj,
 			void *Data);
 	};
@@ -426,6 +542,8 @@ namespace CoreArray
 		friend class CdGDSObj;
 		friend class CdGDSFile;
 
+		/// constructor
+		CdGDSFolder();
 		/// destructor
 		virtual ~CdGDSFolder();
 
@@ -453,8 +571,13 @@ namespace CoreArray
 		virtual CdGDSObj *ObjItem(int Index);
 		virtual CdGDSObj *ObjItem(const UTF8String &Name);
 
+		/// reload the child list, and refresh the loaded child nodes
+		virtual void Refresh();
+
 		virtual CdGDSObj *ObjItemEx(int Index);
 		virtual CdGDSObj *ObjItemEx(const UTF8String &Name);
+		/// return a GDS object with a name of 'Len' bytes, or NULL if fails
+		CdGDSObj *ObjItemEx(const char *Name, size_t Len);
 
 		virtual CdGDSObj *Path(const UTF8String &FullName);
 		virtual CdGDSObj *PathEx(const UTF8String &FullName);
@@ -465,6 +588,16 @@ namespace CoreArray
 		/// the number of child nodes in the folder
 		virtual int NodeCount();
 
+		/// the name of a child node, without loading it
+		const UTF8String &NodeName(int Index);
+		/// whether a child node is a folder, without loading it
+		bool NodeIsFolder(int Index);
+		/// whether a child node is hidden, without loading it
+		bool NodeHidden(int Index);
+		/// whether a child node has an attribute, only reading the attribute
+		/// names from its stream if the node is not loaded
+		bool NodeHasAttr(int Index, const UTF8String &Name);
+
 		CdGDSFolder &DirItem(int Index);
 		CdGDSFolder &DirItem(const UTF8String &Name);
 
@@ -496,6 +629,7 @@ namespace CoreArray
 			C_UInt32 Flag;          //< type and attribute flags
 			UTF8String Name;
 			SIZE64 _pos;
+			C_UInt32 _used;         //< the last access in the node cache
 
 			TNode();
 			bool IsFlagType(C_UInt32 val) const;
@@ -504,6 +638,13 @@ namespace CoreArray
 			void SetFlagAttr(C_UInt32 val);
 		};
 		std::vector<TNode> fList;
+		/// the nodes removed by a writer in the SWMR mode, kept until closing
+		std::vector<CdGDSObj*> fDetached;
+		/// the committed write stamp of the header when the child list is
+		/// reloaded in Refresh(), or -1
+		C_Int64 fCommitStamp;
+		/// the hash index of child names
+		CdNameIndex fNameIndex;
 
 		virtual void Loading(CdReader &Reader, TdVersion Version);
 		virtual void Saving(CdWriter &Writer);
@@ -519,6 +660,8 @@ namespace CoreArray
 		TNode &_NameItem(const UTF8String &Name);
 		void _LoadItem(TNode &I);
 		void _UpdateAll();
+
+		static const UTF8String &_NodeName(const void *List, size_t Index);
 	};
 
 	/// The pointer to a GDS folder
@@ -582,11 +725,17 @@ namespace CoreArray
 	protected:
 		UTF8String fLinkFileName;
 		CdGDSFile *fLinkFile;
+		/// the root of the linked file seen from this folder, a proxy root
+		/// with its own nodes if fLinkFile is shared
+		CdGDSRoot *fLinkRoot;
+		bool fLinkShared;  ///< whether fLinkFile is in GDSFileRegistry()
 		bool fHasTried;
 		string fErrMsg;
 
 	private:
 		void _CheckLinked();
+		void _CloseLink();
+		CdGDSRoot *_LoadProxyRoot(CdGDSFile *File);
 	};
 
 
@@ -647,6 +796,7 @@ namespace CoreArray
 	{
 	public:
 		friend class CdGDSVirtualFolder;
+		friend class CdGDSFile;
 
 		/// constructor
 		CdGDSRoot();
@@ -656,6 +806,10 @@ namespace CoreArray
 
 	protected:
 		CdGDSVirtualFolder *fVFolder;
+		C_UInt64 fGeneration;  ///< see CdGDSFile::Generation()
+
+		virtual void Loading(CdReader &Reader, TdVersion Version);
+		virtual void Saving(CdWriter &Writer);
 	};
 
 
@@ -687,6 +841,7 @@ namespace CoreArray
 	class COREARRAY_DLL_DEFAULT CdGDSFile: protected CdBlockCollection
 	{
 	public:
+		friend class CdGDSFolder;
 		friend class CdGDSVirtualFolder;
 
 		/// opening mode flags
@@ -719,6 +874,77 @@ namespace CoreArray
 		/// Clean up all fragments
 		void TidyUp(bool deep);
 
+		/// enable or disable the single-writer/multi-reader (SWMR) mode
+		/** A writer only appends blocks to the file, and publishes the
+		 *  committed sizes of block streams in SyncFile() by appending a
+		 *  record to the file 'FileName().swmr'; a reader loads the latest
+		 *  record in Refresh() without rescanning the whole file.
+		 *  \param Enable    true for the SWMR mode
+		**/
+		void SetSWMR(bool Enable);
+		/// append a commit record of the block streams (writer)
+		void CommitSWMR();
+		/// load the changes committed by the writer, return true if updated
+		/** Only the headers committed in the latest record are read, and an
+		 *  exception is raised without retrying if a header is not in the
+		 *  record or is rewritten by a newer commit while being read; the
+		 *  record is applied again in the next call.
+		**/
+		bool Refresh();
+		/// add a header reloaded by a GDS node in Refresh()
+		void RefreshedHeader(CdBlockStream *Stream);
+
+		/// whether in the single-writer/multi-reader mode
+		COREARRAY_INLINE bool SWMR() const { return fSWMR; }
+
+		/// enable or disable the metadata index written in SyncFile()
+		/** The index file 'FileName().meta' holds the table of blocks and
+		 *  a copy of all node headers with a checksum, and a read-only
+		 *  LoadFile() builds the tree from it with one sequential read
+		 *  instead of scanning the blocks. The generation of file, stored in
+		 *  the root header and increased in SyncFile() once the file is
+		 *  modified, is also kept in the index, and a stale index is ignored.
+		 *  \param Enable    true for writing the metadata index
+		**/
+		void SetMetaIndex(bool Enable);
+		/// whether the metadata index is written in SyncFile()
+		COREARRAY_INLINE bool MetaIndex() const { return fMetaIndex; }
+		/// the generation of file stored in the root header, or 0 if the
+		/// metadata index has never been written
+		COREARRAY_INLINE C_UInt64 Generation() const
+			{ return fRoot.fGeneration; }
+
+		/// whether a loaded node is still in use and cannot be unloaded
+		typedef bool (*TdNodeInUse)(CdGDSObj *Obj);
+		/// limit the number of loaded nodes in a read-only file
+		/** The child nodes are loaded on first access, and the least recently
+		 *  used nodes are unloaded once more than 'Limit' nodes are loaded.
+		 *  A node is kept if it is being accessed or is one of its ancestors,
+		 *  has been modified, is referenced elsewhere, is a folder with loaded
+		 *  children, or 'InUse' returns true.
+		 *  \param Limit     the maximum number of loaded nodes, 0 for no limit
+		 *  \param InUse     NULL or a function to keep the nodes in use
+		**/
+		void SetNodeCache(int Limit, TdNodeInUse InUse=NULL);
+		/// the maximum number of loaded nodes, 0 for no limit
+		COREARRAY_INLINE int NodeCacheLimit() const { return fNodeLimit; }
+		/// the number of loaded nodes, except the root
+		int NodeCacheCount();
+		/// the arena of node records, replaced when closing the file
+		COREARRAY_INLINE CdArena *Arena() const { return fArena; }
+		/// the generation of the last commit record written or loaded
+		COREARRAY_INLINE C_UInt64 CommitGeneration() const { return fCommitGen; }
+
+		/// the object in another read-only handle of the same file
+		/** The handle is kept and reused until the block streams of the
+		 *  requested object are modified; the caller should call SyncFile()
+		 *  first. The object is owned by the handle, which is closed in
+		 *  CloseFile() or when it is opened again.
+		 *  \param Obj       a GDS object in this file
+		 *  \return the object with the same path, or NULL if fails
+		**/
+		CdGDSObj *ReadOnlyObj(CdGDSObj &Obj);
+
 		bool Modified();
 
 		/// Return file size of the CdGDSFile object
@@ -749,15 +975,78 @@ namespace CoreArray
 	private:
         CdLogRecord *fLog;
         TProcessID fprocess_id;
+		C_UInt64 fCommitGen;   ///< the generation of commit record
+		SIZE64 fCommitPos;     ///< the position of next commit record
+		/// the headers reloaded in Refresh()
+		vector<CdBlockStream*> fRefreshed;
+		int fNodeLimit;        ///< the maximum number of loaded nodes
+		int fNodeLoads;        ///< the nodes loaded since the last trimming
+		C_UInt32 fNodeClock;   ///< the access clock of the node cache
+		TdNodeInUse fNodeInUse;
+		CdArena *fArena;              ///< the arena of node records
+		bool fMetaIndex;              ///< whether to write the metadata index
+		vector<C_UInt8> fMetaBuf;     ///< the last metadata index built
+		C_Int64 fSyncStamp;           ///< WriteCount() at the last SyncFile()
+		CdGDSFile *fReadCopy;         ///< the handle used by ReadOnlyObj()
+		C_Int64 fReadCopyStamp;       ///< WriteCount() when opening fReadCopy
 
 		void _Init();
+		void _LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError,
+			const char *MetaFile);
+		bool _LoadMetaIndex(CdStream *Stream, const char *fn,
+			TdGDSBlockID Entry, C_UInt64 &Gen);
+		bool _LoadRoot(TdGDSBlockID Entry, bool NoThrow);
+		void _BuildMetaIndex();
+		void _WriteMetaIndex(const char *fn);
+		void _MetaHeaders(CdGDSFolder &Folder, vector<CdBlockStream*> &List);
+		void _MetaHeaders(CdBlockStream *Folder, vector<CdBlockStream*> &List);
 		bool _HaveModify(CdGDSFolder *folder);
+		void _TouchNode(CdGDSFolder::TNode &I, bool Loaded);
+		/// unload the least recently used nodes, except 'Keep' and its
+		/// ancestors
+		void _TrimNodes(CdGDSObj *Keep);
 	};
 
 	/// The pointer to a CoreArray GDS File
 	typedef CdGDSFile* PdGDSFile;
 
 
+	/// The process-wide registry of read-only GDS files shared by links
+	/** The files linked by virtual folders in read-only GDS files are opened
+	 *  once and shared, keyed by the canonical path. The inode, size and
+	 *  modification time are checked when sharing, and a file changed on
+	 *  disk is opened again.
+	**/
+	class COREARRAY_DLL_DEFAULT CdGDSFileRegistry
+	{
+	public:
+		/// open a GDS file in the read-only mode, or share the opened one
+		CdGDSFile *Open(const char *FileName);
+		/// release a shared file, and close it if it is not used any more
+		void Close(CdGDSFile *File);
+		/// the number of users of a shared file, 0 if not in the registry
+		int RefCount(const CdGDSFile *File);
+		/// the number of shared files
+		size_t Count();
+
+	protected:
+		struct TEntry
+		{
+			CdGDSFile *File;     ///< the shared GDS file
+			int RefCount;        ///< the number of users
+			C_Int64 Stamp[4];    ///< inode, size and modification time
+			std::string Key;     ///< the canonical path, empty if outdated
+		};
+
+		std::map<std::string, TEntry*> fKeyMap;
+		std::map<const CdGDSFile*, TEntry*> fFileMap;
+		CdThreadMutex fMutex;
+	};
+
+	/// The registry of shared GDS files
+	COREARRAY_DLL_DEFAULT CdGDSFileRegistry &GDSFileRegistry();
+
+
 
 	/// Exception for CdGDSObj
 	class COREARRAY_DLL_EXPORT ErrGDSObj: public ErrObject
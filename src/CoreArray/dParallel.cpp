@@ -27,6 +27,7 @@
 
 
 #include "dParallel.h"
+#include <new>
 
 
 extern "C"
@@ -47,22 +48,21 @@ namespace CoreArray
 			struct COREARRAY_DLL_DEFAULT _pThreadStruct
 			{
 				void (*proc)(CoreArray::CdThread *, int, void*);
-				int ThreadIndex;
 				void *Param;
 				CoreArray::Parallel::CParallelBase *cpBase;
 			};
 
-			int _pDoThread(CoreArray::CdThread *Thread, _pThreadStruct Data)
+			void _pDoThread(CoreArray::CdThread *Thread, int Index, void *Param)
 			{
+				_pThreadStruct &Data = *((_pThreadStruct*)Param);
 				Data.cpBase->InitThread();
 
 				COREARRAY_PARALLEL_TRY
 					COREARRAY_Parallel_Call((TCallProc)Data.proc,
-						Thread, Data.ThreadIndex, Data.Param);
+						Thread, Index, Data.Param);
 				COREARRAY_PARALLEL_CATCH
 
 				Data.cpBase->DoneThread();
-				return 0;
 			}
 		}
 	}
@@ -157,6 +157,328 @@ void CdConsoleProgress::ShowProgress()
 }
 
 
+// CdCancelToken
+
+void CdCancelToken::Cancel()
+{
+	AtomicStore(fFlag, (C_Int32)1);
+}
+
+void CdCancelToken::Reset()
+{
+	AtomicStore(fFlag, (C_Int32)0);
+}
+
+
+// CdThreadPool
+
+struct CdThreadPool::TJob
+{
+	TProc Proc;
+	void *Param;
+	int Remaining;  ///< the number of unfinished tasks
+	bool Failed;    ///< true if any task raises an exception
+	string ErrMsg;  ///< the message of the first exception
+};
+
+/// call the task, and return false with the error message if it fails
+static bool pool_call_task(CdThreadPool::TProc Proc, CdThread *Thread,
+	int Index, void *Param, string &Msg)
+{
+	try {
+		(*Proc)(Thread, Index, Param);
+		return true;
+	}
+	catch (exception &E) {
+		Msg = E.what();
+	}
+	catch (const char *E) {
+		Msg = E;
+	}
+	catch (...) {
+		Msg.clear();
+	}
+	return false;
+}
+
+CdThreadPool::CdThreadPool()
+{
+	fNumActive = 0;
+	fStop = false;
+	fPID = GetCurrentProcessID();
+	fNuma = false;
+	fNumaGen = 0;
+}
+
+CdThreadPool::~CdThreadPool()
+{
+	try {
+		Shutdown();
+	} catch (...) { }
+}
+
+void CdThreadPool::Run(TProc Proc, void *Param, int nThread)
+{
+	if (!Proc) return;
+
+	TJob Job;
+	Job.Proc = Proc; Job.Param = Param;
+	Job.Remaining = (nThread > 1) ? (nThread - 1) : 0;
+	Job.Failed = false;
+
+	if (Job.Remaining > 0)
+	{
+		_CheckFork();
+		TdAutoMutex _m(&fMutex);
+		// one worker for each task at least
+		_Reserve(fNumActive + Job.Remaining);
+		for (int i=1; i < nThread; i++)
+		{
+			TTask T = { &Job, i };
+			fQueue.push_back(T);
+		}
+		fNumActive += Job.Remaining;
+		fCond.Broadcast();
+	}
+
+	// the first index in the current thread
+	string msg;
+	if (!pool_call_task(Proc, NULL, 0, Param, msg))
+	{
+		TdAutoMutex _m(&fMutex);
+		if (!Job.Failed)
+			{ Job.Failed = true; Job.ErrMsg = msg; }
+	}
+
+	_WaitJob(Job);
+}
+
+CdThreadPool::TJob *CdThreadPool::Start(TProc Proc, void *Param)
+{
+	if (!Proc) return NULL;
+	TJob *Job = new TJob;
+	Job->Proc = Proc; Job->Param = Param;
+	Job->Remaining = 1;
+	Job->Failed = false;
+	try {
+		_CheckFork();
+		TdAutoMutex _m(&fMutex);
+		_Reserve(fNumActive + 1);
+		TTask T = { Job, 0 };
+		fQueue.push_back(T);
+		fNumActive ++;
+		fCond.Broadcast();
+	}
+	catch (...) {
+		delete Job;
+		throw;
+	}
+	return Job;
+}
+
+void CdThreadPool::Wait(TJob *Job)
+{
+	if (!Job) return;
+	try {
+		_WaitJob(*Job);
+	}
+	catch (...) {
+		delete Job;
+		throw;
+	}
+	delete Job;
+}
+
+void CdThreadPool::_CheckFork()
+{
+	// only the calling thread exists in a forked process
+	if (fPID != GetCurrentProcessID())
+	{
+		// the mutex and the condition might be left locked or waited by the
+		// threads of the parent process, so they are re-created without
+		// destroying the old ones
+		new (&fMutex) CdThreadMutex;
+		new (&fCond) CdThreadCondition;
+		// the threads of the workers can not be joined, so the thread
+		// handles are cleared before deleting
+		for (size_t i=0; i < fWorkers.size(); i++)
+		{
+			TWorker *W = fWorkers[i];
+			memset((void*)&W->Thread->Thread(), 0, sizeof(CdThread::TThread));
+			delete W->Thread;
+			delete W;
+		}
+		fWorkers.clear();
+		// the tasks belong to the jobs of the parent process
+		fQueue.clear();
+		fNumActive = 0;
+		fStop = false;
+		fPID = GetCurrentProcessID();
+	}
+}
+
+void CdThreadPool::_WaitJob(TJob &Job)
+{
+	// wait for the tasks, and run the queued tasks when waiting
+	while (true)
+	{
+		fMutex.Lock();
+		if (Job.Remaining <= 0)
+		{
+			fMutex.Unlock();
+			break;
+		} else if (!fQueue.empty())
+		{
+			TTask T = fQueue.front();
+			fQueue.pop_front();
+			fMutex.Unlock();
+			_RunTask(NULL, T);
+		} else {
+			fCond.Wait(fMutex);
+			fMutex.Unlock();
+		}
+	}
+
+	if (Job.Failed)
+	{
+		if (Job.ErrMsg.empty())
+			throw ErrParallel("An exception is raised in the parallel task.");
+		else
+			throw ErrParallel(Job.ErrMsg);
+	}
+}
+
+void CdThreadPool::Shutdown()
+{
+	vector<TWorker*> lst;
+	_CheckFork();
+	{
+		TdAutoMutex _m(&fMutex);
+		fStop = true;
+		lst.swap(fWorkers);
+		fCond.Broadcast();
+	}
+	for (size_t i=0; i < lst.size(); i++)
+	{
+		lst[i]->Thread->EndThread();
+		delete lst[i]->Thread;
+		delete lst[i];
+	}
+	TdAutoMutex _m(&fMutex);
+	fStop = false;
+}
+
+int CdThreadPool::NumWorker()
+{
+	_CheckFork();
+	TdAutoMutex _m(&fMutex);
+	return fWorkers.size();
+}
+
+void CdThreadPool::SetNumaPlacement(bool Enable)
+{
+	_CheckFork();
+	TdAutoMutex _m(&fMutex);
+	if (fNuma != Enable)
+	{
+		fNuma = Enable;
+		fNumaGen ++;
+	}
+}
+
+bool CdThreadPool::NumaPlacement()
+{
+	_CheckFork();
+	TdAutoMutex _m(&fMutex);
+	return fNuma;
+}
+
+int CdThreadPool::NumPinnedWorker()
+{
+	_CheckFork();
+	TdAutoMutex _m(&fMutex);
+	int n = 0;
+	for (size_t i=0; i < fWorkers.size(); i++)
+		if (fWorkers[i]->Node >= 0) n ++;
+	return n;
+}
+
+void CdThreadPool::_RunTask(CdThread *Thread, TTask &Task)
+{
+	string msg;
+	bool ok = pool_call_task(Task.Job->Proc, Thread, Task.Index,
+		Task.Job->Param, msg);
+	TdAutoMutex _m(&fMutex);
+	if (!ok && !Task.Job->Failed)
+		{ Task.Job->Failed = true; Task.Job->ErrMsg = msg; }
+	fNumActive --;
+	if ((--Task.Job->Remaining) <= 0)
+		fCond.Broadcast();
+}
+
+void CdThreadPool::_Reserve(int nTask)
+{
+	while ((int)fWorkers.size() < nTask)
+	{
+		TWorker *W = new TWorker;
+		W->Pool = this;
+		W->Thread = new CdThread;
+		W->Index = fWorkers.size();
+		W->Node = -1;
+		W->NumaGen = 0;
+		fWorkers.push_back(W);
+		W->Thread->BeginThread(_WorkerProc, W);
+	}
+}
+
+void CdThreadPool::_PlaceWorker(TWorker *Worker)
+{
+	int node = -1;
+	{
+		TdAutoMutex _m(&fMutex);
+		if (Worker->NumaGen == fNumaGen) return;
+		Worker->NumaGen = fNumaGen;
+		const int nNode = Mach::GetNUMA_NumOfNodes();
+		if (fNuma && (nNode > 1))
+			node = Worker->Index % nNode;
+	}
+	// bind to the node, or release the binding
+	bool ok = true;
+	if ((node >= 0) || (Worker->Node >= 0))
+		ok = Mach::SetNUMA_ThreadNode(node);
+	TdAutoMutex _m(&fMutex);
+	Worker->Node = ok ? node : -1;
+}
+
+int CdThreadPool::_WorkerProc(CdThread *Thread, TWorker *Worker)
+{
+	CdThreadPool *P = Worker->Pool;
+	while (true)
+	{
+		P->_PlaceWorker(Worker);
+		P->fMutex.Lock();
+		while (P->fQueue.empty() && !P->fStop)
+			P->fCond.Wait(P->fMutex);
+		if (P->fStop)
+		{
+			P->fMutex.Unlock();
+			break;
+		}
+		TTask T = P->fQueue.front();
+		P->fQueue.pop_front();
+		P->fMutex.Unlock();
+		P->_RunTask(Thread, T);
+	}
+	return 0;
+}
+
+CdThreadPool &CoreArray::Parallel::ThreadPool()
+{
+	static CdThreadPool Pool;
+	return Pool;
+}
+
+
 // CParallelBase
 
 static const char *ERR_NUM_THREAD = "Invalid number of threads (%d)";
@@ -167,6 +489,8 @@ CParallelBase::CParallelBase(int _nThread)
 		throw ErrParallel(ERR_NUM_THREAD, _nThread);
 	fnThread = _nThread;
 	fProgress = NULL;
+	fProgStep = 1;
+	fCancel = &fCancelOwn;
 }
 
 CParallelBase::~CParallelBase()
@@ -187,13 +511,7 @@ void CParallelBase::DoneThread()
 
 void CParallelBase::CloseThreads()
 {
-	vector<CdThread*>::iterator it;
-	for (it=fThreads.begin(); it!=fThreads.end(); it++)
-	{
-		delete *it;
-		*it = NULL;
-	}
-	fThreads.clear();
+	// do nothing, the threads are kept in ThreadPool()
 }
 
 void CParallelBase::SetNumThread(int _nThread)
@@ -214,35 +532,11 @@ void CParallelBase::AutoSetnThread()
 void CParallelBase::RunThreads(CParallelBase::TProc Proc, void *param)
 {
 	if (!Proc) return;
-	CloseThreads();
-
-	if (fnThread > 1)
-	{
-		fThreads.resize(fnThread-1);
-		for (int i=0; i < fnThread-1; i++)
-		{
-			_INTERNAL::_pThreadStruct pd;
-			pd.proc = Proc;
-			pd.ThreadIndex = i+1;
-			pd.cpBase = this;
-			pd.Param = param;
-			fThreads[i] = new CdThread;
-			fThreads[i]->BeginThread(_INTERNAL::_pDoThread, pd);
-		}
-	}
-
-	InitThread();
-
-	COREARRAY_PARALLEL_TRY
-		COREARRAY_Parallel_Call((TCallProc)Proc, NULL, 0, param);
-	COREARRAY_PARALLEL_CATCH
-
-	DoneThread();
-
-	for (int i=0; i < fnThread-1; i++)
-		fThreads[i]->EndThread();
-
-	CloseThreads();
+	_INTERNAL::_pThreadStruct pd;
+	pd.proc = Proc;
+	pd.Param = param;
+	pd.cpBase = this;
+	ThreadPool().Run(_INTERNAL::_pDoThread, &pd, fnThread);
 }
 
 void CParallelBase::SetProgress(CdBaseProgression *Val)
@@ -259,6 +553,54 @@ void CParallelBase::SetConsoleProgress(CdBaseProgression::TPercentMode mode)
     fProgress = new CdConsoleProgress(mode);
 }
 
+C_Int64 CParallelBase::ProgressCount() const
+{
+	C_Int64 n = 0;
+	for (size_t i=0; i < fProgCount.size(); i++)
+		n += AtomicLoad(fProgCount[i].Count);
+	return n;
+}
+
+void CParallelBase::SetCancelToken(CdCancelToken *Token)
+{
+	fCancel = Token ? Token : &fCancelOwn;
+}
+
+void CParallelBase::_InitProgress(C_Int64 TotalSize)
+{
+	TProgressCounter C;
+	memset((void*)&C, 0, sizeof(C));
+	fProgCount.assign(fnThread, C);
+	if (fProgress)
+	{
+		fProgress->Init(TotalSize);
+		// each thread reports about every 1/100 of its share
+		fProgStep = TotalSize / (100 * (C_Int64)fnThread);
+		if (fProgStep < 1) fProgStep = 1;
+	}
+}
+
+void CParallelBase::_SyncProgress(bool Wait)
+{
+	if (Wait)
+		fProgMutex.Lock();
+	else if (!fProgMutex.TryLock())
+		return;
+	C_Int64 n = ProgressCount() - fProgress->Current();
+	if (n > 0) fProgress->Forward(n);
+	fProgMutex.Unlock();
+}
+
+void CParallelBase::_DoneRun()
+{
+	if (fProgress) _SyncProgress(true);
+	if (fCancel->Cancelled())
+	{
+		if (fCancel == &fCancelOwn) fCancelOwn.Reset();
+		throw ErrParallel("The parallel computing is cancelled.");
+	}
+}
+
 
 // CParallelSection
 
@@ -41,11 +41,15 @@
 #include "dTrait.h"
 
 #include <vector>
+#include <deque>
 #include <memory>
 #include <algorithm>
 #ifndef COREARRAY_NO_STD_IN_OUT
 #	include <iostream>
 #endif
+#ifdef COREARRAY_CC_MSC
+#	include <intrin.h>
+#endif
 
 
 namespace CoreArray
@@ -81,6 +85,8 @@ namespace CoreArray
 		COREARRAY_INLINE int Percent() const { return fPercent; }
 		/// Return the total number
 		COREARRAY_INLINE C_Int64 Total() const { return fTotal; }
+		/// Return the current number of steps
+		COREARRAY_INLINE C_Int64 Current() const { return vCurrent; }
 
 	protected:
 		TPercentMode fMode;
@@ -97,6 +103,87 @@ namespace CoreArray
     };
 
 
+	/// compare 'Target' with 'Old' and replace it by 'New' if equal atomically
+	/// (4-byte or 8-byte integer), and return the previous value
+	template<typename TYPE> COREARRAY_INLINE
+		TYPE AtomicCompareExchange(volatile TYPE &Target, TYPE Old, TYPE New)
+	{
+	#if defined(__GNUC__)
+		return __sync_val_compare_and_swap(&Target, Old, New);
+	#elif defined(COREARRAY_CC_MSC)
+		if (sizeof(TYPE) == 8)
+			return (TYPE)_InterlockedCompareExchange64(
+				(volatile __int64*)&Target, (__int64)New, (__int64)Old);
+		else
+			return (TYPE)_InterlockedCompareExchange(
+				(volatile long*)&Target, (long)New, (long)Old);
+	#else
+		TYPE rv = Target;
+		if (rv == Old) Target = New;
+		return rv;
+	#endif
+	}
+
+	/// add 'Val' to 'Target' atomically, and return the previous value
+	template<typename TYPE> COREARRAY_INLINE
+		TYPE AtomicFetchAdd(volatile TYPE &Target, TYPE Val)
+	{
+	#if defined(__GNUC__)
+		return __sync_fetch_and_add(&Target, Val);
+	#elif defined(COREARRAY_CC_MSC)
+		if (sizeof(TYPE) == 8)
+			return (TYPE)_InterlockedExchangeAdd64(
+				(volatile __int64*)&Target, (__int64)Val);
+		else
+			return (TYPE)_InterlockedExchangeAdd(
+				(volatile long*)&Target, (long)Val);
+	#else
+		TYPE rv = Target;
+		Target += Val;
+		return rv;
+	#endif
+	}
+
+	/// read 'Target' atomically with a full memory barrier
+	template<typename TYPE> COREARRAY_INLINE
+		TYPE AtomicLoad(const volatile TYPE &Target)
+	{
+		return AtomicCompareExchange(const_cast<volatile TYPE&>(Target),
+			(TYPE)0, (TYPE)0);
+	}
+
+	/// write 'Val' to 'Target' atomically with a full memory barrier
+	template<typename TYPE> COREARRAY_INLINE
+		void AtomicStore(volatile TYPE &Target, TYPE Val)
+	{
+		TYPE Old = Target;
+		TYPE Cur;
+		while ((Cur = AtomicCompareExchange(Target, Old, Val)) != Old)
+			Old = Cur;
+	}
+
+
+	/// The cancellation token shared by the working threads
+	/** Cancel() can be called from any thread, and the workers check
+	 *  Cancelled() before taking the next task.
+	**/
+	class COREARRAY_DLL_DEFAULT CdCancelToken
+	{
+	public:
+		CdCancelToken(): fFlag(0) { }
+
+		/// request the cancellation
+		void Cancel();
+		/// clear the request
+		void Reset();
+		/// whether the cancellation is requested
+		COREARRAY_INLINE bool Cancelled() const { return AtomicLoad(fFlag) != 0; }
+
+	protected:
+		volatile C_Int32 fFlag;
+	};
+
+
 	namespace Parallel
 	{
 		/// Exceptions for conversion
@@ -130,6 +217,103 @@ namespace CoreArray
 	#endif
 
 
+        // Thread Pool
+
+		/// The process-lifetime pool of worker threads
+		/** The tasks are queued in one first-in-first-out queue, and taken by
+		 *  the idle workers. The waiting caller also runs queued tasks, so
+		 *  nested calls do not dead-lock. A task is the whole share of a
+		 *  thread index, and the load is balanced by the callers claiming the
+		 *  items dynamically (e.g., CParallelSection claims the indices by an
+		 *  atomic counter). The pool grows when the workers are not enough,
+		 *  and it is re-created in a forked process.
+		 *  With NUMA placement, the k-th worker is bound to the CPUs of the
+		 *  NUMA node (k mod the number of nodes).
+		**/
+		class COREARRAY_DLL_DEFAULT CdThreadPool
+		{
+		public:
+			/// the task procedure, called with a thread index
+			typedef void (*TProc)(CdThread *Thread, int Index, void *Param);
+
+			/// constructor
+			CdThreadPool();
+			/// destructor, stop all workers
+			~CdThreadPool();
+
+			/// call 'Proc' with the indices 0, ..., nThread-1, and wait
+			/** the index 0 is called in the current thread **/
+			void Run(TProc Proc, void *Param, int nThread);
+
+			struct TJob;
+			/// call 'Proc' with the index 0 in a worker without waiting
+			/** the returned job should be passed to Wait() **/
+			TJob *Start(TProc Proc, void *Param);
+			/// wait for a job returned by Start(), and release it
+			/** the queued tasks are run in the current thread when waiting,
+			 *  and the exception raised in the job is thrown again **/
+			void Wait(TJob *Job);
+			/// stop and release all workers
+			void Shutdown();
+
+			/// the number of worker threads
+			int NumWorker();
+
+			/// enable or disable binding the workers to NUMA nodes
+			/** the workers apply the new placement before taking next task **/
+			void SetNumaPlacement(bool Enable);
+			/// whether the workers are bound to NUMA nodes
+			bool NumaPlacement();
+			/// the number of workers bound to a NUMA node
+			int NumPinnedWorker();
+
+		protected:
+			struct TTask
+			{
+				TJob *Job;
+				int Index;
+			};
+			struct TWorker
+			{
+				CdThreadPool *Pool;
+				CdThread *Thread;
+				int Index;    ///< the index in the list of workers
+				int Node;     ///< the bound NUMA node, or -1
+				int NumaGen;  ///< the applied generation of NUMA placement
+			};
+
+			/// the mutex for the counters and conditions
+			CdThreadMutex fMutex;
+			/// signaled if a task is queued, or a job is finished
+			CdThreadCondition fCond;
+			/// the list of workers
+			std::vector<TWorker*> fWorkers;
+			/// the queued tasks
+			std::deque<TTask> fQueue;
+			/// the number of queued and running tasks
+			int fNumActive;
+			/// true for stopping workers
+			bool fStop;
+			/// the process creating the workers
+			TProcessID fPID;
+			/// true for binding the workers to NUMA nodes
+			bool fNuma;
+			/// increased when the NUMA placement is changed
+			int fNumaGen;
+
+			/// reset the pool in a forked process, called without locking
+			void _CheckFork();
+			void _WaitJob(TJob &Job);
+			void _RunTask(CdThread *Thread, TTask &Task);
+			void _Reserve(int nTask);
+			void _PlaceWorker(TWorker *Worker);
+			static int _WorkerProc(CdThread *Thread, TWorker *Worker);
+		};
+
+		/// the process-wide thread pool
+		COREARRAY_DLL_DEFAULT CdThreadPool &ThreadPool();
+
+
         // Parallel Mechanism
 
 		class CParallelBase;
@@ -140,21 +324,20 @@ namespace CoreArray
 			{
 				TCLASS * obj;
 				void (TCLASS::*proc)(CdThread *, int);
-				int ThreadIndex;
 				CParallelBase *cpBase;
 			};
 
 			template<class TCLASS> COREARRAY_DLL_DEFAULT
-				int _pDoThreadEx(CdThread *Thread, _pThreadStructEx<TCLASS> Data)
+				void _pDoThreadEx(CdThread *Thread, int Index, void *Param)
 			{
+				_pThreadStructEx<TCLASS> &Data = *((_pThreadStructEx<TCLASS>*)Param);
 				Data.cpBase->InitThread();
 
 				COREARRAY_PARALLEL_TRY
-                	(Data.obj->*Data.proc)(Thread, Data.ThreadIndex);
+                	(Data.obj->*Data.proc)(Thread, Index);
 				COREARRAY_PARALLEL_CATCH
 
 				Data.cpBase->DoneThread();
-				return 0;
 			}
 		}
 
@@ -170,7 +353,7 @@ namespace CoreArray
 			void InitThread();
 			/// Free resource when a thread finishes
 			void DoneThread();
-			/// Close all threads
+			/// Close all threads (the threads are kept in ThreadPool())
 			void CloseThreads();
 			/// Return the total number of thread used
 			COREARRAY_INLINE int nThread() const { return fnThread; }
@@ -192,51 +375,67 @@ namespace CoreArray
 				void RunThreads(void (TCLASS::*Proc)(CdThread *, int), TCLASS *obj)
 			{
 				if (!Proc || !obj) return;
-				CloseThreads();
-
-				if (fnThread > 1)
-				{
-					fThreads.resize(fnThread-1);
-					for (int i=0; i < fnThread-1; i++)
-					{
-						_INTERNAL::_pThreadStructEx<TCLASS> pd;
-						pd.obj = obj; pd.proc = Proc;
-						pd.ThreadIndex = i+1; pd.cpBase = this;
-						fThreads[i] = new CdThread;
-						fThreads[i]->BeginThread(_INTERNAL::_pDoThreadEx<TCLASS>, pd);
-					}
-				}
-
-				InitThread();
-
-				COREARRAY_PARALLEL_TRY
-					(obj->*Proc)(NULL, 0);
-				COREARRAY_PARALLEL_CATCH
-
-				DoneThread();
-
-				for (int i=0; i < fnThread-1; i++)
-					fThreads[i]->EndThread();
-
-				CloseThreads();
+				_INTERNAL::_pThreadStructEx<TCLASS> pd;
+				pd.obj = obj; pd.proc = Proc; pd.cpBase = this;
+				ThreadPool().Run(_INTERNAL::_pDoThreadEx<TCLASS>, &pd, fnThread);
 			}
 
 			COREARRAY_INLINE CdBaseProgression *Progress() const { return fProgress; }
 			void SetProgress(CdBaseProgression *Val);
 			void SetConsoleProgress(CdBaseProgression::TPercentMode mode = CdBaseProgression::tp01);
+			/// the number of finished steps, polled without locking
+			C_Int64 ProgressCount() const;
+
+			/// request the workers to stop, RunThreads throws ErrParallel
+			COREARRAY_INLINE void Cancel() { fCancel->Cancel(); }
+			/// whether the cancellation is requested
+			COREARRAY_INLINE bool Cancelled() const { return fCancel->Cancelled(); }
+			/// the cancellation token checked by the workers
+			COREARRAY_INLINE CdCancelToken &CancelToken() { return *fCancel; }
+			/// use an external token (e.g., shared by several objects), or
+			/// the internal token if it is NULL
+			void SetCancelToken(CdCancelToken *Token);
 
 		protected:
+			/// the progress counter of a thread, in its own cache line
+			struct TProgressCounter
+			{
+				volatile C_Int64 Count;  ///< increased by the owner thread only
+				C_Int64 Reported;        ///< the count of last aggregation
+				C_UInt8 Pad[48];
+			};
+
 			int fnThread;
-			std::vector<CdThread*> fThreads;
 			CdThreadMutex fMutex;
 			CdBaseProgression *fProgress;
-
-			COREARRAY_INLINE void ForwardProgress()
+			/// the per-thread counters, aggregated into fProgress lazily
+			std::vector<TProgressCounter> fProgCount;
+			/// the number of steps of a thread before aggregating
+			C_Int64 fProgStep;
+			/// the mutex for aggregating fProgCount
+			CdThreadMutex fProgMutex;
+			CdCancelToken fCancelOwn, *fCancel;
+
+			/// initialize the progress and the counters before running
+			void _InitProgress(C_Int64 TotalSize);
+			/// add the counters to fProgress, skip if 'Wait=false' and
+			/// another thread is aggregating
+			void _SyncProgress(bool Wait);
+			/// finalize the progress, and throw an exception if cancelled
+			void _DoneRun();
+
+			/// forward the progress of the thread 'Index' without locking
+			COREARRAY_INLINE void ForwardProgress(int Index, C_Int64 Step=1)
 			{
 				if (fProgress)
 				{
-					TdAutoMutex AutoMutex(&fMutex);
-					fProgress->Forward();
+					TProgressCounter &C = fProgCount[Index];
+					C_Int64 n = AtomicFetchAdd(C.Count, Step) + Step;
+					if (n - C.Reported >= fProgStep)
+					{
+						C.Reported = n;
+						_SyncProgress(false);
+					}
 				}
 			}
 		};
@@ -262,17 +461,19 @@ namespace CoreArray
 					throw ErrParallel("CParallelSection is working.");
 				// Initialize
 				if (TotalSize <= 0) return;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 
 				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
 				Rec.Obj = Obj; Rec.Proc = Proc; Rec.InBuf = InBuf;
 				Rec.Index = StartIndex; Rec.TotalSize = TotalSize;
+				Rec.Next = 0;
                 // Working
 				_ptr = (void*)&Rec;
 				CParallelBase::RunThreads<CParallelSection>(
 					&CParallelSection::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
 				// finally
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -287,19 +488,21 @@ namespace CoreArray
 					throw ErrParallel("CParallelSection is working.");
 				// Initialize
 				if (TotalSize <= 0) return;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 
 				_IStructEx<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
 				Rec.Obj = Obj; Rec.Proc = Proc;
 				Rec.InternalFunc = InternalFunc;
 				Rec.InBuf = InBuf;
 				Rec.Index = StartIndex; Rec.TotalSize = TotalSize;
+				Rec.Next = 0;
                 // Working
 				_ptr = (void*)&Rec;
 				CParallelBase::RunThreads<CParallelSection>(
 					&CParallelSection::_pThreadEx<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
 				// finally
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 		protected:
@@ -313,27 +516,22 @@ namespace CoreArray
 				OUTTYPE *InBuf;
 				TINDEX Index;
 				size_t TotalSize;
+				volatile ssize_t Next;  ///< the number of claimed indices
 			};
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
 				void _pThread(CdThread *Thread, int Index)
 			{
 				_IStruct<TCLASS, TINDEX, OUTTYPE> &Rec =
                 	*((_IStruct<TCLASS, TINDEX, OUTTYPE>*)_ptr);
-                TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.TotalSize > 0)
-					{
-						OUTTYPE *pBuf = Rec.InBuf++;
-						Idx = Rec.Index; ++Rec.Index; --Rec.TotalSize;
-						fMutex.Unlock();
-						(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
-						ForwardProgress();
-					} else {
-						fMutex.Unlock();
-						break;
-					}
-				} while (true);
+				// claim the next index without locking
+				ssize_t i;
+				while (!fCancel->Cancelled() &&
+					((size_t)(i = AtomicFetchAdd(Rec.Next, (ssize_t)1)) < Rec.TotalSize))
+				{
+					const TINDEX Idx = Rec.Index + (TINDEX)i;
+					(Rec.Obj->*Rec.Proc)(Idx, Rec.InBuf[i]);
+					ForwardProgress(Index);
+				}
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -345,6 +543,7 @@ namespace CoreArray
 				OUTTYPE *InBuf;
 				TINDEX Index;
 				size_t TotalSize;
+				volatile ssize_t Next;  ///< the number of claimed indices
 			};
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
 				void _pThreadEx(CdThread *Thread, int Index)
@@ -355,21 +554,15 @@ namespace CoreArray
 				THREADDATA ThreadData;
 				(Rec.Obj->*Rec.InternalFunc)(ThreadData, Thread, Index);
 
-                TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.TotalSize > 0)
-					{
-						OUTTYPE *pBuf = Rec.InBuf++;
-						Idx = Rec.Index; ++Rec.Index; --Rec.TotalSize;
-						fMutex.Unlock();
-						(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
-						ForwardProgress();
-					} else {
-						fMutex.Unlock();
-						break;
-					}
-				} while (true);
+				// claim the next index without locking
+				ssize_t i;
+				while (!fCancel->Cancelled() &&
+					((size_t)(i = AtomicFetchAdd(Rec.Next, (ssize_t)1)) < Rec.TotalSize))
+				{
+					const TINDEX Idx = Rec.Index + (TINDEX)i;
+					(Rec.Obj->*Rec.Proc)(Idx, Rec.InBuf[i], ThreadData);
+					ForwardProgress(Index);
+				}
 			}
 		};
 
@@ -393,18 +586,20 @@ namespace CoreArray
                 	throw ErrParallel("Invalid 'SubBufSize' in the function 'RunThreads'");
 				// Initialize
 				if (TotalSize <= 0) return;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 
 				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
 				Rec.Obj = Obj; Rec.Proc = Proc; Rec.InBuf = InBuf;
 				Rec.Index = StartIndex;
 				Rec.TotalSize = TotalSize; Rec.SubBufSize = SubBufSize;
+				Rec.Next = 0;
                 // Working
 				_ptr = (void*)&Rec;
 				CParallelBase::RunThreads<CParallelSectionEx>(
 					&CParallelSectionEx::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
 				// finally
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -421,7 +616,7 @@ namespace CoreArray
                 	throw ErrParallel("Invalid 'SubBufSize' in the function 'RunThreads'");
 				// Initialize
 				if (TotalSize <= 0) return;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 
 				_IStructEx<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
 				Rec.Obj = Obj; Rec.Proc = Proc;
@@ -429,11 +624,13 @@ namespace CoreArray
 				Rec.InBuf = InBuf;
 				Rec.Index = StartIndex;
 				Rec.TotalSize = TotalSize; Rec.SubBufSize = SubBufSize;
+				Rec.Next = 0;
                 // Working
 				_ptr = (void*)&Rec;
 				CParallelBase::RunThreads<CParallelSection>(
 					&CParallelSectionEx::_pThreadEx<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 		protected:
@@ -445,38 +642,29 @@ namespace CoreArray
 				OUTTYPE *InBuf;
 				TINDEX Index;
 				size_t TotalSize, SubBufSize;
+				volatile ssize_t Next;  ///< the number of claimed indices
 			};
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
 				void _pThread(CdThread *Thread, int Index)
 			{
 				_IStruct<TCLASS, TINDEX, OUTTYPE> &Rec =
                 	*((_IStruct<TCLASS, TINDEX, OUTTYPE>*)_ptr);
-                TINDEX Idx;
-				do {
-					fMutex.Lock();
-					size_t S = min(Rec.SubBufSize, Rec.TotalSize);
-					if (S > 0)
+				// claim the next sub-buffer without locking
+				ssize_t i;
+				while (!fCancel->Cancelled() &&
+					((size_t)(i = AtomicFetchAdd(Rec.Next, (ssize_t)Rec.SubBufSize)) <
+					Rec.TotalSize))
+				{
+					size_t S = std::min(Rec.SubBufSize, Rec.TotalSize - i);
+					OUTTYPE *pBuf = Rec.InBuf + i;
+					TINDEX Idx = Rec.Index + (TINDEX)i;
+					for (size_t k=S; k > 0; k--)
 					{
-						OUTTYPE *pBuf = Rec.InBuf;
-						Rec.InBuf += S;
-						Idx = Rec.Index; Rec.Index += S;
-						Rec.TotalSize -= S;
-						fMutex.Unlock();
-						for (size_t i=S; i > 0; i--)
-						{
-							(Rec.Obj->*Rec.Proc)(Idx, *pBuf++);
-							++Idx;
-						}
-						if (fProgress)
-						{
-							TdAutoMutex AutoMutex(&fMutex);
-							fProgress->Forward(S);
-						}
-					} else {
-						fMutex.Unlock();
-						break;
+						(Rec.Obj->*Rec.Proc)(Idx, *pBuf++);
+						++Idx;
 					}
-				} while (true);
+					ForwardProgress(Index, S);
+				}
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -488,6 +676,7 @@ namespace CoreArray
 				OUTTYPE *InBuf;
 				TINDEX Index;
 				size_t TotalSize, SubBufSize;
+				volatile ssize_t Next;  ///< the number of claimed indices
 			};
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
 				void _pThreadEx(CdThread *Thread, int Index)
@@ -498,32 +687,22 @@ namespace CoreArray
 				THREADDATA ThreadData;
 				(Rec.Obj->*Rec.InternalFunc)(ThreadData, Thread, Index);
 
-                TINDEX Idx;
-				do {
-					fMutex.Lock();
-					size_t S = min(Rec.SubBufSize, Rec.TotalSize);
-					if (S > 0)
+				// claim the next sub-buffer without locking
+				ssize_t i;
+				while (!fCancel->Cancelled() &&
+					((size_t)(i = AtomicFetchAdd(Rec.Next, (ssize_t)Rec.SubBufSize)) <
+					Rec.TotalSize))
+				{
+					size_t S = std::min(Rec.SubBufSize, Rec.TotalSize - i);
+					OUTTYPE *pBuf = Rec.InBuf + i;
+					TINDEX Idx = Rec.Index + (TINDEX)i;
+					for (size_t k=S; k > 0; k--)
 					{
-						OUTTYPE *pBuf = Rec.InBuf;
-						Rec.InBuf += S;
-						Idx = Rec.Index; Rec.Index += S;
-						Rec.TotalSize -= S;
-						fMutex.Unlock();
-						for (size_t i = S; i > 0; i--)
-						{
-							(Rec.Obj->*Rec.Proc)(Idx, *pBuf++, ThreadData);
-                            ++Idx;
-						}
-						if (fProgress)
-						{
-							TdAutoMutex AutoMutex(&fMutex);
-							fProgress->Forward(S);
-						}
-					} else {
-						fMutex.Unlock();
-						break;
+						(Rec.Obj->*Rec.Proc)(Idx, *pBuf++, ThreadData);
+						++Idx;
 					}
-				} while (true);
+					ForwardProgress(Index, S);
+				}
 			}
 		};
 
@@ -550,7 +729,7 @@ namespace CoreArray
                     throw ErrParallel("The size of buffer should be > 0.");
 				if (TotalSize <= 0) return;
 				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 				// Initialize
 				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
@@ -566,6 +745,7 @@ namespace CoreArray
 				CParallelBase::RunThreads<CParallelQueue>(
 					&CParallelQueue::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -582,7 +762,7 @@ namespace CoreArray
                     throw ErrParallel("The size of buffer should be > 0.");
 				if (TotalSize <= 0) return;
 				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 				// Initialize
 				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
@@ -598,6 +778,7 @@ namespace CoreArray
 				CParallelBase::RunThreads<CParallelQueue>(
 					&CParallelQueue::_pThread2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
@@ -613,7 +794,7 @@ namespace CoreArray
                     throw ErrParallel("The size of buffer should be > 0.");
 				if (TotalSize <= 0) return;
 				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 				// Initialize
 				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStructEx<TCLASS, TINDEX, OUTTYPE> Rec;
@@ -629,6 +810,7 @@ namespace CoreArray
 				CParallelBase::RunThreads<CParallelQueue>(
 					&CParallelQueue::_pThreadEx<TCLASS, TINDEX, OUTTYPE>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 		protected:
@@ -654,6 +836,10 @@ namespace CoreArray
 				TINDEX Idx;
 				do {
 					fMutex.Lock();
+					if (fCancel->Cancelled())
+					{
+						fMutex.Unlock(); WakeUp(); break;  // cancelled
+					}
 					if (Rec.WorkingIndex >= Rec.IndexEnd)
 					{
 						if (Rec.IndexEnd >= Rec.TotalSize)
@@ -669,11 +855,10 @@ namespace CoreArray
 						fMutex.Unlock();
 						// call ...
 						(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
+						ForwardProgress(Index);
 						// update FinishIndex
 						{
 							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
 							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
 							{
 								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
@@ -714,6 +899,10 @@ namespace CoreArray
 				TINDEX Idx;
 				do {
 					fMutex.Lock();
+					if (fCancel->Cancelled())
+					{
+						fMutex.Unlock(); WakeUp(); break;  // cancelled
+					}
 					if (Rec.WorkingIndex >= Rec.IndexEnd)
 					{
 						if (Rec.IndexEnd >= Rec.TotalSize)
@@ -729,11 +918,10 @@ namespace CoreArray
 						fMutex.Unlock();
 						// call ...
 						(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
+						ForwardProgress(Index);
 						// update FinishIndex
 						{
 							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
 							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
 							{
 								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
@@ -769,6 +957,10 @@ namespace CoreArray
 				TINDEX Idx;
 				do {
 					fMutex.Lock();
+					if (fCancel->Cancelled())
+					{
+						fMutex.Unlock(); WakeUp(); break;  // cancelled
+					}
 					if (Rec.WorkingIndex >= Rec.IndexEnd)
 					{
 						if (Rec.IndexEnd >= Rec.TotalSize)
@@ -784,11 +976,10 @@ namespace CoreArray
 						fMutex.Unlock();
 						// call ...
 						(Rec.Obj->*Rec.Proc)(Thread, Index, Idx, *pBuf);
+						ForwardProgress(Index);
 						// update FinishIndex
 						{
 							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
 							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
 							{
 								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
@@ -827,7 +1018,7 @@ namespace CoreArray
 				if (TotalSize <= 0) return;
 				if (BufSize > TotalSize) BufSize = TotalSize;
 				if (SubBufSize > BufSize) SubBufSize = BufSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 				// Initialize
 				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
@@ -844,6 +1035,7 @@ namespace CoreArray
 				CParallelBase::RunThreads<CParallelQueueEx>(
 					&CParallelQueueEx::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -860,7 +1052,7 @@ namespace CoreArray
                     throw ErrParallel("The size of buffer should be > 0.");
 				if (TotalSize <= 0) return;
 				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				_InitProgress(TotalSize);
 				// Initialize
 				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
@@ -876,6 +1068,7 @@ namespace CoreArray
 				CParallelBase::RunThreads<CParallelQueue>(
 					&CParallelQueue::_pThread2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
 				_ptr = NULL;
+				_DoneRun();
 			}
 
 		protected:
@@ -899,6 +1092,10 @@ namespace CoreArray
 				TINDEX Idx;
 				do {
 					fMutex.Lock();
+					if (fCancel->Cancelled())
+					{
+						fMutex.Unlock(); WakeUp(); break;  // cancelled
+					}
 					if (Rec.WorkingIndex >= Rec.IndexEnd)
 					{
 						if (Rec.IndexEnd >= Rec.TotalSize)
@@ -921,11 +1118,10 @@ namespace CoreArray
 							(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
 							++Idx; pBuf++;
                         }
+						ForwardProgress(Index, tmpL);
 						// update FinishIndex
 						{
 							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward(tmpL);
 							Rec.FinishIndex += tmpL;
 							if (Rec.FinishIndex >= Rec.IndexEnd)
 							{
@@ -967,6 +1163,10 @@ namespace CoreArray
 				TINDEX Idx;
 				do {
 					fMutex.Lock();
+					if (fCancel->Cancelled())
+					{
+						fMutex.Unlock(); WakeUp(); break;  // cancelled
+					}
 					if (Rec.WorkingIndex >= Rec.IndexEnd)
 					{
 						if (Rec.IndexEnd >= Rec.TotalSize)
@@ -989,11 +1189,10 @@ namespace CoreArray
 							(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
 							++Idx; pBuf++;
 						}
+						ForwardProgress(Index, tmpL);
 						// update FinishIndex
 						{
 							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward(tmpL);
 							Rec.FinishIndex += tmpL;
 							if (Rec.FinishIndex >= Rec.IndexEnd)
 							{
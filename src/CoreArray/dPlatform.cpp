@@ -59,6 +59,11 @@
 	#  include <sys/sysinfo.h>
 	#endif
 
+	#if defined(COREARRAY_PLATFORM_LINUX)
+	#  include <sched.h>
+	#  include <sys/syscall.h>
+	#endif
+
 #endif
 
 
@@ -1534,6 +1539,173 @@ C_UInt64 CoreArray::Mach::GetCPU_LevelCache(int level)
 }
 
 
+#if defined(COREARRAY_PLATFORM_LINUX)
+
+/// read a list like "0-3,8-11" from the first line of a file
+static bool numa_read_list(const char *fn, vector<int> &out)
+{
+	out.clear();
+	FILE *f = fopen(fn, "r");
+	if (!f) return false;
+	char line[4096];
+	if (fgets(line, sizeof(line), f))
+	{
+		for (char *s = line; *s; )
+		{
+			char *e;
+			long a = strtol(s, &e, 10), b = a;
+			if (e == s) break;
+			if (*e == '-') { s = e + 1; b = strtol(s, &e, 10); }
+			for (long k=a; k <= b; k++) out.push_back(k);
+			s = (*e == ',') ? e + 1 : e;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+/// the NUMA topology from /sys/devices/system/node
+struct TNumaTopology
+{
+	vector< vector<int> > NodeCPU;  ///< the CPUs of each node
+	vector<int> CPUNode;            ///< the node of each CPU
+
+	TNumaTopology()
+	{
+		// the online nodes, whose ids might not be contiguous
+		vector<int> node;
+		if (!numa_read_list("/sys/devices/system/node/online", node))
+			return;
+		for (size_t i=0; i < node.size(); i++)
+		{
+			const int nd = node[i];
+			if ((nd < 0) || (nd >= 1024)) continue;
+			char fn[64];
+			snprintf(fn, sizeof(fn), "/sys/devices/system/node/node%d/cpulist", nd);
+			vector<int> cpu;
+			if (!numa_read_list(fn, cpu)) continue;
+			if (nd >= (int)NodeCPU.size())
+				NodeCPU.resize(nd + 1);
+			NodeCPU[nd] = cpu;
+			for (size_t j=0; j < cpu.size(); j++)
+			{
+				if (cpu[j] >= (int)CPUNode.size())
+					CPUNode.resize(cpu[j] + 1, -1);
+				CPUNode[cpu[j]] = nd;
+			}
+		}
+	}
+};
+
+static TNumaTopology &NumaTopology()
+{
+	static TNumaTopology T;
+	return T;
+}
+
+#endif
+
+int CoreArray::Mach::GetNUMA_NumOfNodes()
+{
+#if defined(COREARRAY_PLATFORM_LINUX)
+	int n = NumaTopology().NodeCPU.size();
+	return (n > 0) ? n : 1;
+#else
+	return 1;
+#endif
+}
+
+bool CoreArray::Mach::GetNUMA_NodeCPU(int node, vector<int> &cpu)
+{
+	cpu.clear();
+#if defined(COREARRAY_PLATFORM_LINUX)
+	TNumaTopology &T = NumaTopology();
+	if ((node >= 0) && (node < (int)T.NodeCPU.size()))
+	{
+		cpu = T.NodeCPU[node];
+		return !cpu.empty();
+	}
+#endif
+	return false;
+}
+
+int CoreArray::Mach::GetNUMA_CurrentNode()
+{
+#if defined(COREARRAY_PLATFORM_LINUX) && defined(CPU_SETSIZE)
+	int c = sched_getcpu();
+	TNumaTopology &T = NumaTopology();
+	if ((c >= 0) && (c < (int)T.CPUNode.size()))
+		return T.CPUNode[c];
+#endif
+	return -1;
+}
+
+#if defined(COREARRAY_PLATFORM_LINUX) && defined(CPU_SETSIZE)
+/// the CPU affinity of the calling thread before binding to a NUMA node
+static __thread bool numa_has_saved = false;
+static __thread cpu_set_t numa_saved_set;
+#endif
+
+bool CoreArray::Mach::SetNUMA_ThreadNode(int node)
+{
+#if defined(COREARRAY_PLATFORM_LINUX) && defined(CPU_SETSIZE)
+	if (node >= 0)
+	{
+		vector<int> cpu;
+		if (!GetNUMA_NodeCPU(node, cpu)) return false;
+		if (!numa_has_saved)
+		{
+			if (sched_getaffinity(0, sizeof(cpu_set_t), &numa_saved_set) != 0)
+				return false;
+			numa_has_saved = true;
+		}
+		// the CPUs of the node allowed before binding
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		bool any = false;
+		for (size_t i=0; i < cpu.size(); i++)
+		{
+			if ((cpu[i] < CPU_SETSIZE) && CPU_ISSET(cpu[i], &numa_saved_set))
+				{ CPU_SET(cpu[i], &set); any = true; }
+		}
+		if (!any) return false;
+		return sched_setaffinity(0, sizeof(set), &set) == 0;
+	} else {
+		// restore the CPUs before binding
+		if (!numa_has_saved) return true;
+		if (sched_setaffinity(0, sizeof(cpu_set_t), &numa_saved_set) != 0)
+			return false;
+		numa_has_saved = false;
+		return true;
+	}
+#else
+	return false;
+#endif
+}
+
+bool CoreArray::Mach::SetNUMA_MemoryNode(void *ptr, size_t size, int node)
+{
+#if defined(COREARRAY_PLATFORM_LINUX) && defined(SYS_mbind)
+	static const int MPOL_PREFERRED_ = 1;
+	static const unsigned MPOL_MF_MOVE_ = 1 << 1;
+	static const int NUM_BIT = 8 * sizeof(unsigned long);
+	if (!ptr || (node < 0) || (node >= 16*NUM_BIT)) return false;
+	// the pages inside the memory block
+	const size_t pg = sysconf(_SC_PAGESIZE);
+	size_t st = ((size_t)ptr + pg - 1) & ~(pg - 1);
+	size_t ed = ((size_t)ptr + size) & ~(pg - 1);
+	if (ed <= st) return false;
+	unsigned long mask[16];
+	memset(mask, 0, sizeof(mask));
+	mask[node / NUM_BIT] = 1UL << (node % NUM_BIT);
+	return syscall(SYS_mbind, st, ed - st, MPOL_PREFERRED_, mask,
+		16*NUM_BIT + 1, MPOL_MF_MOVE_) == 0;
+#else
+	return false;
+#endif
+}
+
+
 TProcessID CoreArray::GetCurrentProcessID()
 {
 #if defined(COREARRAY_PLATFORM_WINDOWS)
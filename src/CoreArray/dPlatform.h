@@ -376,6 +376,39 @@ namespace CoreArray
 		 *  \return cache size, or 0 if unable to determine.
 		**/
 		COREARRAY_DLL_DEFAULT C_UInt64 GetCPU_LevelCache(int level);
+
+		/// Return the number of NUMA nodes, or 1 if unable to determine
+		COREARRAY_DLL_DEFAULT int GetNUMA_NumOfNodes();
+
+		/// Get the logical CPUs of a NUMA node
+		/** \param node     the index of NUMA node, starting from 0
+		 *  \param cpu      the output list of CPU indices
+		 *  \return false if unable to determine
+		**/
+		COREARRAY_DLL_DEFAULT bool GetNUMA_NodeCPU(int node,
+			std::vector<int> &cpu);
+
+		/// Return the NUMA node of the CPU running the calling thread
+		/** return -1, if unable to determine. **/
+		COREARRAY_DLL_DEFAULT int GetNUMA_CurrentNode();
+
+		/// Bind the calling thread to the CPUs of a NUMA node
+		/** The CPUs not allowed before binding are excluded, and node = -1
+		 *  restores the CPUs allowed before the first binding.
+		 *  \param node     the index of NUMA node, or -1 for releasing
+		 *  \return false if not supported or failed
+		**/
+		COREARRAY_DLL_DEFAULT bool SetNUMA_ThreadNode(int node);
+
+		/// Prefer a NUMA node for the pages of a memory block (Linux only)
+		/** The pages already touched are moved to the node if possible.
+		 *  \param ptr      the start of memory
+		 *  \param size     the size of memory in bytes
+		 *  \param node     the index of NUMA node
+		 *  \return false if not supported or failed
+		**/
+		COREARRAY_DLL_DEFAULT bool SetNUMA_MemoryNode(void *ptr, size_t size,
+			int node);
 	}
 
 
@@ -26,6 +26,7 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "dSerial.h"
+#include <algorithm>
 
 
 namespace CoreArray
@@ -105,6 +106,28 @@ static const char *ERR_NOT_NULL = "CdSerialization(): %s should not be NULL.";
 #endif
 
 
+/// FNV-1a hash of a string
+static inline C_UInt32 str_hash(const char *s)
+{
+	C_UInt32 h = 2166136261U;
+	for (; *s; s++)
+	{
+		h ^= (C_UInt8)(*s);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/// the finalizer of MurmurHash3, to derive independent hashes
+static inline C_UInt32 hash_mix(C_UInt32 h)
+{
+	h ^= h >> 16; h *= 0x85EBCA6BU;
+	h ^= h >> 13; h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+	return h;
+}
+
+
 // =====================================================================
 // Serialization -- Root class
 // =====================================================================
@@ -260,6 +283,8 @@ CdSerialization::CVarList::CVarList()
 	Start = Length = 0;
 	VarCount = 0;
 	Next = NULL;
+	HashCount = 0;
+	HasDupName = false;
 }
 
 CdSerialization::CVarList::~CVarList()
@@ -270,6 +295,18 @@ CdSerialization::CVarList::~CVarList()
 CdSerialization::TVariable* CdSerialization::CVarList::Name2Variable(
 	const char *Name)
 {
+	if (!HasDupName)
+	{
+		if (HashTable.empty()) return NULL;
+		const size_t Mask = HashTable.size() - 1;
+		for (size_t k = str_hash(Name) & Mask; HashTable[k]; k = (k+1) & Mask)
+		{
+			if (HashTable[k]->Name.compare(Name) == 0)
+				return HashTable[k];
+		}
+		return NULL;
+	}
+	// the first one in the list, which might be reordered by FindVar()
 	TVariable *p = VarHead;
 	while (p != NULL)
 	{
@@ -280,6 +317,44 @@ CdSerialization::TVariable* CdSerialization::CVarList::Name2Variable(
 	return NULL;
 }
 
+void CdSerialization::CVarList::AddVar(TVariable *Var)
+{
+	if (VarTail == NULL)
+	{
+		VarHead = VarTail = Var;
+	} else {
+		VarTail->Next = Var;
+		VarTail = Var;
+	}
+
+	// grow the hash table
+	if (2*(HashCount + 1) > HashTable.size())
+	{
+		size_t n = HashTable.empty() ? 16 : 2*HashTable.size();
+		HashTable.assign(n, NULL);
+		HashCount = 0;
+		for (TVariable *p = VarHead; p != Var; p = p->Next)
+		{
+			size_t k = str_hash(p->Name.c_str()) & (n - 1);
+			for (; HashTable[k]; k = (k+1) & (n - 1))
+				if (HashTable[k]->Name == p->Name) break;
+			if (!HashTable[k])
+				{ HashTable[k] = p; HashCount ++; }
+		}
+	}
+
+	// insert the first variable of a name
+	const size_t Mask = HashTable.size() - 1;
+	size_t k = str_hash(Var->Name.c_str()) & Mask;
+	for (; HashTable[k]; k = (k+1) & Mask)
+	{
+		if (HashTable[k]->Name == Var->Name)
+			{ HasDupName = true; return; }
+	}
+	HashTable[k] = Var;
+	HashCount ++;
+}
+
 void CdSerialization::CVarList::ClearVarList()
 {
 	TVariable *p = VarHead;
@@ -290,6 +365,9 @@ void CdSerialization::CVarList::ClearVarList()
 		delete tmp;
 	}
 	VarHead = VarTail = NULL;
+	HashTable.clear();
+	HashCount = 0;
+	HasDupName = false;
 }
 
 
@@ -372,14 +450,7 @@ CdWriter::TVariable* CdWriter::NewVar(const char *Name,
 	p->TypeID = TypeID;
 	p->Start = fStorage.Position();
 	p->Length = Size;
-
-	if (Cur.VarTail == NULL)
-	{
-		Cur.VarHead = Cur.VarTail = p;
-	} else {
-		Cur.VarTail->Next = p;
-		Cur.VarTail = p;
-	}
+	Cur.AddVar(p);
 	Cur.VarCount ++;
 
 	return p;
@@ -480,6 +551,20 @@ void CdWriter::TdVar::operator << (C_UInt32 val)
 	Obj->fStorage << val;
 }
 
+void CdWriter::TdVar::operator << (C_Int64 val)
+{
+	if (Obj == NULL) return;
+	Obj->NewVar(Name, osInt64, sizeof(val));
+	Obj->fStorage << val;
+}
+
+void CdWriter::TdVar::operator << (C_UInt64 val)
+{
+	if (Obj == NULL) return;
+	Obj->NewVar(Name, osUInt64, sizeof(val));
+	Obj->fStorage << val;
+}
+
 void CdWriter::TdVar::operator << (C_Float32 val)
 {
 	if (Obj == NULL) return;
@@ -701,6 +786,17 @@ SIZE64 CdReader::BeginNameSpace()
 	return rv;
 }
 
+SIZE64 CdReader::BeginObjNameSpace(string *ClassName)
+{
+	SIZE64 rv = _BeginNameSpace();
+	// skip the version number
+	fStorage.R8b(); fStorage.R8b();
+	string Name = ReadClassName();
+	if (ClassName) *ClassName = Name;
+	_InitNameSpace();
+	return rv;
+}
+
 void CdReader::EndStruct()
 {
 	CVarList &p = CurrentStruct();
@@ -869,7 +965,17 @@ CdSerialization::TVariable* CdReader::FindVar(const char *Name)
 	if (Cur.VarCount < 0)
 		throw ErrSerial(ERR_NO_NAMESPACE);
 
-	// find it
+	// find it in the hash table if the names are unique
+	if (!Cur.HasDupName)
+	{
+		TVariable *p = Cur.Name2Variable(Name);
+		if (p == NULL)
+			throw ErrSerial(ERR_NO_PROPERTY, Name);
+		return p;
+	}
+
+	// the variables with the same name are read in order, by moving the
+	// found one to the end of list
 	TVariable *p=Cur.VarHead, *pH=NULL;
 	while (p != NULL)
 	{
@@ -1206,29 +1312,111 @@ void CdObjClassMgr::AddClass(const char *ClassName,
 		TClassMap::iterator i = fClassMap.insert(fClassMap.begin(),
 			pair<const char *, TClassStruct>(ClassName, p));
 		fClassList.push_back(i);
+		_BuildHash();
 	} else
 		throw ErrObject(ERR_DUP_CLASS, ClassName);
 }
 
 void CdObjClassMgr::RemoveClass(const char * const ClassName)
 {
-	fClassMap.erase(ClassName);
+	TClassMap::iterator it = fClassMap.find(ClassName);
+	if (it != fClassMap.end())
+	{
+		vector<TClassMap::iterator>::iterator p =
+			find(fClassList.begin(), fClassList.end(), it);
+		if (p != fClassList.end()) fClassList.erase(p);
+		fClassMap.erase(it);
+		_BuildHash();
+	}
 }
 
 void CdObjClassMgr::Clear()
 {
 	fClassMap.clear();
 	fClassList.clear();
+	_BuildHash();
 }
 
 CdObjClassMgr::TdOnObjCreate CdObjClassMgr::NameToClass(const char *ClassName)
 {
-	map<const char *, TClassStruct, TStrCmp>::const_iterator it;
-	it = fClassMap.find(ClassName);
-	if (it != fClassMap.end())
-		return it->second.OnCreate;
-	else
-		return NULL;
+	const TClassStruct *p = FindClass(ClassName);
+	return p ? p->OnCreate : NULL;
+}
+
+const CdObjClassMgr::TClassStruct *CdObjClassMgr::FindClass(
+	const char *ClassName) const
+{
+	if (ClassName == NULL) return NULL;
+	if (!fHashTable.empty())
+	{
+		// one probe in the perfect hash table
+		const C_UInt32 h = str_hash(ClassName);
+		const C_UInt32 d = fHashDisp[hash_mix(h) & (fHashDisp.size() - 1)];
+		const TClassMap::value_type *p =
+			fHashTable[hash_mix(h ^ (d * 0x9E3779B9U)) & (fHashTable.size() - 1)];
+		return (p && (strcmp(p->first, ClassName) == 0)) ? &p->second : NULL;
+	}
+	TClassMap::const_iterator it = fClassMap.find(ClassName);
+	return (it != fClassMap.end()) ? &it->second : NULL;
+}
+
+void CdObjClassMgr::_BuildHash()
+{
+	// hash and displace: the classes are grouped into buckets by a hash,
+	// and each bucket has a displacement placing its classes in free slots
+	fHashDisp.clear();
+	fHashTable.clear();
+	if (fClassMap.empty()) return;
+
+	size_t nb = 1;
+	while (nb < fClassMap.size()) nb <<= 1;
+	const size_t m = 2 * nb;
+	vector< vector<const TClassMap::value_type*> > Bucket(nb);
+	size_t max_size = 0;
+	TClassMap::const_iterator it;
+	for (it = fClassMap.begin(); it != fClassMap.end(); it++)
+	{
+		vector<const TClassMap::value_type*> &B =
+			Bucket[hash_mix(str_hash(it->first)) & (nb - 1)];
+		B.push_back(&*it);
+		if (B.size() > max_size) max_size = B.size();
+	}
+
+	vector<C_UInt32> Disp(nb, 0);
+	vector<const TClassMap::value_type*> Table(m, NULL);
+	vector<size_t> Slot;
+	// place the larger buckets first
+	for (size_t sz = max_size; sz > 0; sz--)
+	{
+		for (size_t b = 0; b < nb; b++)
+		{
+			if (Bucket[b].size() != sz) continue;
+			C_UInt32 d = 1;
+			for (; d < 65536; d++)
+			{
+				Slot.clear();
+				size_t i = 0;
+				for (; i < sz; i++)
+				{
+					size_t k = hash_mix(str_hash(Bucket[b][i]->first) ^
+						(d * 0x9E3779B9U)) & (m - 1);
+					if (Table[k] || (find(Slot.begin(), Slot.end(), k) !=
+							Slot.end()))
+						break;
+					Slot.push_back(k);
+				}
+				if (i >= sz) break;
+			}
+			// not found, e.g., the same hash of two names, use the class map
+			if (d >= 65536) return;
+			for (size_t i = 0; i < sz; i++)
+				Table[Slot[i]] = Bucket[b][i];
+			Disp[b] = d;
+		}
+	}
+
+	fHashDisp.swap(Disp);
+	fHashTable.swap(Table);
 }
 
 CdObjRef* CdObjClassMgr::ToObj(CdReader &Reader, TdInit OnInit, void *Data,
@@ -1277,13 +1465,34 @@ CdObjRef* CdObjClassMgr::ToObj(CdReader &Reader, TdInit OnInit, void *Data,
 	return Obj;
 }
 
+void CdObjClassMgr::ReloadObj(CdReader &Reader, CdObjRef &Obj)
+{
+	Reader._BeginNameSpace();
+	try {
+		// get version number
+		TdVersion Version = Reader.Storage().R8b();
+		Version |= ((TdVersion)Reader.Storage().R8b()) << 8;
+		// check class name
+		string Name = Reader.ReadClassName();
+		if (Name != Obj.dName())
+			throw ErrSerial(ERR_INV_CLASS_NAME, Name.c_str());
+		// initialize and load object
+		Reader._InitNameSpace();
+		_INTERNAL::CdObject_LoadStruct(Obj, Reader, Version);
+	} catch (exception &E) {
+		Reader.Log().Add(E.what());
+		Reader.EndStruct();
+		throw;
+	}
+	Reader.EndStruct();
+}
+
 const CdObjClassMgr::TClassStruct &CdObjClassMgr::ClassStruct(
 	const char *ClassName) const
 {
-	map<const char *, TClassStruct, TStrCmp>::const_iterator it;
-	it = fClassMap.find(ClassName);
-	if (it != fClassMap.end())
-		return it->second;
+	const TClassStruct *p = FindClass(ClassName);
+	if (p)
+		return *p;
 	else
 		throw ErrSerial(ERR_INV_CLASS_NAME, ClassName);
 }
@@ -209,12 +209,19 @@ namespace CoreArray
 			SIZE64 Length;  ///< the block length in a stream
 			int VarCount;   ///< the number of variables, or -1 indicating no name space
 			CVarList *Next; ///< next object in a list
+			/// the open-addressing hash table of the first variable of each
+			/// name, with a load factor not greater than 0.5
+			std::vector<TVariable*> HashTable;
+			size_t HashCount;  ///< the number of names in HashTable
+			bool HasDupName;   ///< whether two variables have the same name
 
 			CVarList();
 			~CVarList();
 
 			/// return a pointer to TVariable with Name, NULL if not exist
 			TVariable* Name2Variable(const char *Name);
+			/// append a variable to the list and the hash table
+			void AddVar(TVariable *Var);
 			/// remove variables in VarHead
 			void ClearVarList();
 		};
@@ -375,6 +382,9 @@ namespace CoreArray
 		SIZE64 BeginStruct();
 		/// begin a namespace
 		SIZE64 BeginNameSpace();
+		/// begin the namespace of a serialized object, skipping its version
+		/// and class name
+		SIZE64 BeginObjNameSpace(std::string *ClassName=NULL);
 		/// end a block or namespace
 		void EndStruct();
 
@@ -412,14 +422,7 @@ namespace CoreArray
 			p->TypeID = TypeID;
 			p->Start = fStorage.Position();
 			p->Length = 0;
-
-			if (Cur.VarTail == NULL)
-			{
-				Cur.VarHead = Cur.VarTail = p;
-			} else {
-				Cur.VarTail->Next = p;
-				Cur.VarTail = p;
-			}
+			Cur.AddVar(p);
 
 			return p->Data;
 		}
@@ -584,9 +587,16 @@ namespace CoreArray
 		**/
 		virtual CdObjRef* ToObj(CdReader &Reader, TdInit OnInit, void *Data,
 			bool Silent);
+		/// Reload an existing object from a filter
+		/** \param Reader  a filter
+		 *  \param Obj     the object, its class should match the filter
+		**/
+		void ReloadObj(CdReader &Reader, CdObjRef &Obj);
 
 		/// return class structure given by the class name
 		const TClassStruct &ClassStruct(const char *ClassName) const;
+		/// return class structure given by the class name, or NULL
+		const TClassStruct *FindClass(const char *ClassName) const;
 
 		/// class mapping object
 		COREARRAY_INLINE const TClassMap &ClassMap() const { return fClassMap; }
@@ -594,11 +604,18 @@ namespace CoreArray
 		/// get a list of class description
 		void GetClassDesp(vector<string> &Key, vector<string> &Desp);
 
-	protected:
-		/// a map from a class name to class structure
+	private:
+		/// a map from a class name to class structure, modified only by
+		/// AddClass(), RemoveClass() and Clear() which rebuild the hash table
 		TClassMap fClassMap;
 		/// a list of class structure
 		std::vector<TClassMap::iterator> fClassList;
+		/// the displacements of the perfect hash, one per bucket
+		std::vector<C_UInt32> fHashDisp;
+		/// the perfect hash table of registered classes, built at runtime
+		std::vector<const TClassMap::value_type*> fHashTable;
+
+		void _BuildHash();
 	};
 
 
@@ -28,6 +28,20 @@
 #include "dStream.h"
 #include <cctype>
 #include <limits>
+#include <algorithm>
+
+#ifdef COREARRAY_PLATFORM_UNIX
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sched.h>
+#   include <errno.h>
+#   include <signal.h>
+#   if defined(__linux__)
+#       include <dirent.h>
+#   endif
+#endif
 
 #ifndef COREARRAY_NO_STD_IN_OUT
 #   include <iostream>
@@ -481,6 +495,608 @@ CdRecodeLevel::CdRecodeLevel(CdRecodeStream::TLevel level)
 
 
 
+// =====================================================================
+// Shared cache of decompressed blocks
+
+static const C_UInt32 BLOCK_CACHE_MAGIC = 0x43424447;  // "GDBC"
+static const C_UInt32 BLOCK_CACHE_VERSION = 2;
+static const int BLOCK_CACHE_NUM_SHARD = 16;
+static const int BLOCK_CACHE_ALIGN = 64;
+static const int BLOCK_CACHE_MAX_PROC = 256;
+
+/// the header of shared memory
+struct CdBlockCache::THeader
+{
+	C_UInt32 Magic;             ///< BLOCK_CACHE_MAGIC
+	C_UInt32 Version;           ///< BLOCK_CACHE_VERSION
+	volatile C_Int32 Ready;     ///< 1 if initialized by the creator
+	C_Int32 Reserved;           ///< unused
+	C_Int64 MapSize;            ///< the total size of shared memory
+	C_Int32 NumShard;           ///< the number of shards
+	C_Int32 NumSlot;            ///< the number of slots in a shard
+	C_Int64 ShardSize;          ///< the size of a shard
+	C_Int64 ArenaSize;          ///< the size of block data in a shard
+	volatile C_Int64 Used, Hit, Miss, Evict;  ///< the statistics
+	/// the processes attached, 0 for an empty entry
+	volatile C_Int32 PID[BLOCK_CACHE_MAX_PROC];
+};
+
+/// the header of a shard, followed by the slots and the ring buffer
+struct CdBlockCache::TShard
+{
+	volatile C_Int32 Lock;      ///< spin lock, the PID of holder or 0
+	C_Int32 Count;              ///< the number of cached blocks
+	C_Int64 Head;               ///< the next position in the ring buffer
+};
+
+/// a slot in the open-addressing table
+struct CdBlockCache::TSlot
+{
+	C_UInt32 ID;                ///< the stream ID
+	C_Int32 Block;              ///< the block index
+	C_Int64 Offset;             ///< the position in the ring buffer
+	C_UInt32 Size;              ///< the size of block data
+	C_UInt32 Used;              ///< 1 if used
+};
+
+static inline C_Int64 block_cache_align(C_Int64 n)
+{
+	return (n + BLOCK_CACHE_ALIGN - 1) & ~C_Int64(BLOCK_CACHE_ALIGN - 1);
+}
+
+static inline C_UInt64 block_cache_hash(C_UInt64 h)
+{
+	h ^= h >> 33; h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline C_UInt64 block_cache_key(C_UInt32 ID, C_Int32 Idx)
+{
+	return block_cache_hash(((C_UInt64)ID << 32) | (C_UInt32)Idx);
+}
+
+#ifdef COREARRAY_PLATFORM_UNIX
+
+/// return true if the process exists
+static bool block_cache_alive(C_Int32 pid)
+{
+	return (kill(pid, 0) == 0) || (errno != ESRCH);
+}
+
+/// the spin lock shared among processes, stamped with the PID of the holder
+/** \return 0 if giving up after a while, 1 if locked, or 2 if the lock is
+ *          taken over from a dead process
+**/
+static int block_cache_lock(volatile C_Int32 *p)
+{
+	const C_Int32 pid = getpid();
+	for (int i=0; i < 20000; i++)
+	{
+		if (__sync_bool_compare_and_swap(p, 0, pid)) return 1;
+		if (i >= 100)
+		{
+			// the holder died with the lock
+			if ((i % 1000) == 100)
+			{
+				C_Int32 v = *p;
+				if ((v != 0) && !block_cache_alive(v) &&
+					__sync_bool_compare_and_swap(p, v, pid))
+				{
+					return 2;
+				}
+			}
+			sched_yield();
+		}
+	}
+	return 0;
+}
+
+static inline void block_cache_unlock(volatile C_Int32 *p)
+{
+	__sync_lock_release(p);
+}
+
+/// remove the dead processes, and return the number of live ones
+static int block_cache_clean_pid(volatile C_Int32 PID[])
+{
+	int n = 0;
+	for (int i=0; i < BLOCK_CACHE_MAX_PROC; i++)
+	{
+		C_Int32 v = PID[i];
+		if (v != 0)
+		{
+			if (block_cache_alive(v))
+				n ++;
+			else
+				__sync_bool_compare_and_swap(&PID[i], v, 0);
+		}
+	}
+	return n;
+}
+
+static int block_cache_open(const string &name, int flag)
+{
+#if defined(__linux__)
+	return open(("/dev/shm" + name).c_str(), flag, 0600);
+#else
+	return shm_open(name.c_str(), flag, 0600);
+#endif
+}
+
+static void block_cache_unlink(const string &name)
+{
+#if defined(__linux__)
+	unlink(("/dev/shm" + name).c_str());
+#else
+	shm_unlink(name.c_str());
+#endif
+}
+
+/// register the process in the shared memory, return false if it is full
+static bool block_cache_register(volatile C_Int32 PID[], C_Int32 pid)
+{
+	block_cache_clean_pid(PID);
+	for (int i=0; i < BLOCK_CACHE_MAX_PROC; i++)
+	{
+		if (__sync_bool_compare_and_swap(&PID[i], 0, pid))
+			return true;
+	}
+	return false;
+}
+
+#endif
+
+/// the attached caches in the current process
+static vector<CdBlockCache*> &block_cache_list()
+{
+	static vector<CdBlockCache*> List;
+	return List;
+}
+static CdThreadMutex block_cache_mutex;
+static C_Int64 block_cache_default_limit = 0;
+
+CdBlockCache::CdBlockCache(): CdRef()
+{
+	fHeader = NULL;
+	fMapSize = 0;
+	fPID = 0;
+}
+
+CdBlockCache::~CdBlockCache()
+{
+	Detach();
+}
+
+bool CdBlockCache::Attach(const char *FileName, C_Int64 Limit)
+{
+	Detach();
+#ifdef COREARRAY_PLATFORM_UNIX
+	if ((Limit <= 0) || !FileName) return false;
+
+	// the name from the identity of file
+	struct stat st;
+	if (stat(FileName, &st) != 0) return false;
+	C_UInt64 h = block_cache_hash((C_UInt64)getuid() + 1);
+	h = block_cache_hash(h ^ (C_UInt64)st.st_dev);
+	h = block_cache_hash(h ^ (C_UInt64)st.st_ino);
+	h = block_cache_hash(h ^ (C_UInt64)st.st_size);
+	h = block_cache_hash(h ^ (C_UInt64)st.st_mtime);
+#if defined(__APPLE__)
+	h = block_cache_hash(h ^ (C_UInt64)st.st_mtimespec.tv_nsec);
+#elif defined(__linux__)
+	h = block_cache_hash(h ^ (C_UInt64)st.st_mtim.tv_nsec);
+#endif
+	char name[64];
+	snprintf(name, sizeof(name), "/gdsfmt-%016llx", (unsigned long long)h);
+
+	// the layout
+	C_Int64 Arena = (Limit / BLOCK_CACHE_NUM_SHARD) &
+		~C_Int64(BLOCK_CACHE_ALIGN - 1);
+	if (Arena < 65536) Arena = 65536;
+	C_Int32 NumSlot = 64;
+	while ((NumSlot < (1 << 20)) && ((C_Int64)NumSlot * 8192 < Arena))
+		NumSlot <<= 1;
+	const C_Int64 ShardSize = block_cache_align(sizeof(TShard)) +
+		block_cache_align(NumSlot * sizeof(TSlot)) + Arena;
+	C_Int64 MapSize = block_cache_align(sizeof(THeader)) +
+		BLOCK_CACHE_NUM_SHARD * ShardSize;
+
+	// remove the caches left by the crashed processes
+	_Reclaim();
+	const C_Int32 pid = getpid();
+
+	// create or open the shared memory, and try again if the existing one
+	// was left by a creator which died
+	THeader *H = NULL;
+	for (int attempt=0; !H && (attempt < 2); attempt++)
+	{
+		int fd = block_cache_open(name, O_RDWR | O_CREAT | O_EXCL);
+		const bool Creator = (fd >= 0);
+		if (Creator)
+		{
+			if (ftruncate(fd, MapSize) != 0)
+			{
+				close(fd);
+				block_cache_unlink(name);
+				return false;
+			}
+		} else {
+			if (errno != EEXIST) return false;
+			fd = block_cache_open(name, O_RDWR);
+			if (fd < 0) return false;
+			// wait for the creator setting the size
+			struct stat s;
+			for (int i=0; i < 1000; i++)
+			{
+				if ((fstat(fd, &s) == 0) &&
+						(s.st_size >= (off_t)sizeof(THeader)))
+					break;
+				usleep(1000);
+			}
+			MapSize = s.st_size;
+			if (MapSize < (C_Int64)sizeof(THeader))
+			{
+				close(fd);
+				block_cache_unlink(name);
+				continue;
+			}
+		}
+		void *ptr = mmap(NULL, MapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+		close(fd);
+		if (ptr == MAP_FAILED)
+		{
+			if (Creator) block_cache_unlink(name);
+			return false;
+		}
+
+		H = (THeader*)ptr;
+		if (Creator)
+		{
+			// the memory has been filled with zero
+			H->Magic = BLOCK_CACHE_MAGIC;
+			H->Version = BLOCK_CACHE_VERSION;
+			H->MapSize = MapSize;
+			H->NumShard = BLOCK_CACHE_NUM_SHARD;
+			H->NumSlot = NumSlot;
+			H->ShardSize = ShardSize;
+			H->ArenaSize = Arena;
+			block_cache_register(H->PID, pid);
+			__sync_synchronize();
+			H->Ready = 1;
+		} else {
+			for (int i=0; (i < 1000) && !H->Ready; i++) usleep(1000);
+			__sync_synchronize();
+			if (!H->Ready && (block_cache_clean_pid(H->PID) <= 0))
+			{
+				// the creator died before initializing
+				munmap(ptr, MapSize);
+				block_cache_unlink(name);
+				H = NULL;
+				continue;
+			}
+			if (!H->Ready || (H->Magic != BLOCK_CACHE_MAGIC) ||
+				(H->Version != BLOCK_CACHE_VERSION) ||
+				(H->MapSize != MapSize) || !block_cache_register(H->PID, pid))
+			{
+				munmap(ptr, MapSize);
+				return false;
+			}
+		}
+	}
+	if (!H) return false;
+
+	fHeader = H;
+	fMapSize = MapSize;
+	fName = name;
+	fPID = getpid();
+	TdAutoMutex _m(&block_cache_mutex);
+	block_cache_list().push_back(this);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CdBlockCache::Detach()
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	if (fHeader)
+	{
+		{
+			TdAutoMutex _m(&block_cache_mutex);
+			vector<CdBlockCache*> &L = block_cache_list();
+			vector<CdBlockCache*>::iterator it = find(L.begin(), L.end(), this);
+			if (it != L.end()) L.erase(it);
+		}
+		// a forked process does not own the attachment
+		if (fPID == getpid())
+		{
+			for (int i=0; i < BLOCK_CACHE_MAX_PROC; i++)
+			{
+				if (__sync_bool_compare_and_swap(&fHeader->PID[i], fPID, 0))
+					break;
+			}
+			if (block_cache_clean_pid(fHeader->PID) <= 0)
+				block_cache_unlink(fName);
+		}
+		munmap(fHeader, fMapSize);
+		fHeader = NULL;
+		fMapSize = 0;
+	}
+#endif
+}
+
+/// remove the shared memory left by the processes which did not detach,
+/// e.g., crashed
+void CdBlockCache::_Reclaim()
+{
+#if defined(__linux__)
+	DIR *dir = opendir("/dev/shm");
+	if (!dir) return;
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL)
+	{
+		if (strncmp(ent->d_name, "gdsfmt-", 7) != 0) continue;
+		string name = string("/") + ent->d_name;
+		int fd = block_cache_open(name, O_RDWR);
+		if (fd < 0) continue;
+		struct stat st;
+		void *ptr = MAP_FAILED;
+		const size_t size = sizeof(THeader);
+		if ((fstat(fd, &st) == 0) && (st.st_size >= (off_t)size))
+			ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (ptr == MAP_FAILED) continue;
+		THeader *H = (THeader*)ptr;
+		// a segment being created is not ready
+		if ((H->Magic == BLOCK_CACHE_MAGIC) &&
+			(H->Version == BLOCK_CACHE_VERSION) && H->Ready &&
+			(block_cache_clean_pid(H->PID) <= 0))
+		{
+			block_cache_unlink(name);
+		}
+		munmap(ptr, size);
+	}
+	closedir(dir);
+#endif
+}
+
+CdBlockCache::TShard *CdBlockCache::_Shard(int i) const
+{
+	return (TShard*)((C_UInt8*)fHeader + block_cache_align(sizeof(THeader)) +
+		i * fHeader->ShardSize);
+}
+
+CdBlockCache::TSlot *CdBlockCache::_Slots(TShard *p) const
+{
+	return (TSlot*)((C_UInt8*)p + block_cache_align(sizeof(TShard)));
+}
+
+C_UInt8 *CdBlockCache::_Arena(TShard *p) const
+{
+	return (C_UInt8*)p + block_cache_align(sizeof(TShard)) +
+		block_cache_align(fHeader->NumSlot * sizeof(TSlot));
+}
+
+int CdBlockCache::_Find(TShard *p, C_UInt32 ID, C_Int32 Idx,
+	bool &Found) const
+{
+	const C_UInt32 mask = fHeader->NumSlot - 1;
+	TSlot *S = _Slots(p);
+	C_UInt32 i = (block_cache_key(ID, Idx) >> 8) & mask;
+	for (C_UInt32 n=0; n <= mask; n++, i=(i+1) & mask)
+	{
+		if (!S[i].Used)
+			{ Found = false; return i; }
+		if ((S[i].ID == ID) && (S[i].Block == Idx))
+			{ Found = true; return i; }
+	}
+	Found = false;
+	return -1;
+}
+
+void CdBlockCache::_Remove(TShard *p, int i)
+{
+	// backward-shift deletion with linear probing
+	const int mask = fHeader->NumSlot - 1;
+	TSlot *S = _Slots(p);
+	S[i].Used = 0;
+	p->Count --;
+	for (int j=(i+1) & mask; S[j].Used; j=(j+1) & mask)
+	{
+		int k = (block_cache_key(S[j].ID, S[j].Block) >> 8) & mask;
+		bool move = (i <= j) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j));
+		if (move)
+		{
+			S[i] = S[j];
+			S[j].Used = 0;
+			i = j;
+		}
+	}
+}
+
+#ifdef COREARRAY_PLATFORM_UNIX
+bool CdBlockCache::_Lock(TShard *p)
+{
+	int rv = block_cache_lock(&p->Lock);
+	if (rv == 2)
+	{
+		// the shard may be left inconsistent by the dead holder
+		TSlot *S = _Slots(p);
+		for (int i=0; i < fHeader->NumSlot; i++)
+		{
+			if (S[i].Used)
+				__sync_fetch_and_sub(&fHeader->Used, (C_Int64)S[i].Size);
+		}
+		memset(S, 0, sizeof(TSlot) * fHeader->NumSlot);
+		p->Count = 0;
+		p->Head = 0;
+	}
+	return (rv != 0);
+}
+#endif
+
+bool CdBlockCache::Get(C_UInt32 StreamID, C_Int32 BlockIdx,
+	vector<C_UInt8> &Buffer)
+{
+	bool Found = false;
+#ifdef COREARRAY_PLATFORM_UNIX
+	if (!fHeader) return false;
+	C_UInt64 h = block_cache_key(StreamID, BlockIdx);
+	TShard *p = _Shard(h % fHeader->NumShard);
+	if (_Lock(p))
+	{
+		int i = _Find(p, StreamID, BlockIdx, Found);
+		if (Found)
+		{
+			TSlot &s = _Slots(p)[i];
+			Buffer.resize(s.Size);
+			memcpy(&Buffer[0], _Arena(p) + s.Offset, s.Size);
+		}
+		block_cache_unlock(&p->Lock);
+	}
+	__sync_fetch_and_add(Found ? &fHeader->Hit : &fHeader->Miss, 1);
+#endif
+	return Found;
+}
+
+void CdBlockCache::Put(C_UInt32 StreamID, C_Int32 BlockIdx,
+	const void *Buffer, size_t Size)
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	if (!fHeader || (Size <= 0) || ((C_Int64)Size > fHeader->ArenaSize) ||
+		(Size > 0xFFFFFFFFu))
+		return;
+	C_UInt64 h = block_cache_key(StreamID, BlockIdx);
+	TShard *p = _Shard(h % fHeader->NumShard);
+	if (!_Lock(p)) return;
+
+	bool Found;
+	_Find(p, StreamID, BlockIdx, Found);
+	if (!Found)
+	{
+		const C_Int64 Arena = fHeader->ArenaSize;
+		const int NumSlot = fHeader->NumSlot;
+		TSlot *S = _Slots(p);
+
+		// allocate in the ring buffer, and evict the overlapping blocks
+		C_Int64 st = p->Head;
+		if (st + (C_Int64)Size > Arena) st = 0;
+		const C_Int64 ed = st + Size;
+		for (int i=0; i < NumSlot; )
+		{
+			if (S[i].Used && (S[i].Offset < ed) &&
+				(st < S[i].Offset + (C_Int64)S[i].Size))
+			{
+				__sync_fetch_and_sub(&fHeader->Used, (C_Int64)S[i].Size);
+				__sync_fetch_and_add(&fHeader->Evict, 1);
+				_Remove(p, i);
+			} else
+				i ++;
+		}
+		// keep the table no more than 3/4 full, by evicting the oldest
+		while (p->Count >= NumSlot / 4 * 3)
+		{
+			int k = -1;
+			C_Int64 d = Arena;
+			for (int i=0; i < NumSlot; i++)
+			{
+				if (S[i].Used)
+				{
+					C_Int64 v = (S[i].Offset - ed + Arena) % Arena;
+					if (v < d) { d = v; k = i; }
+				}
+			}
+			if (k < 0) break;
+			__sync_fetch_and_sub(&fHeader->Used, (C_Int64)S[k].Size);
+			__sync_fetch_and_add(&fHeader->Evict, 1);
+			_Remove(p, k);
+		}
+
+		// add
+		int i = _Find(p, StreamID, BlockIdx, Found);
+		if (i >= 0)
+		{
+			memcpy(_Arena(p) + st, Buffer, Size);
+			S[i].ID = StreamID;
+			S[i].Block = BlockIdx;
+			S[i].Offset = st;
+			S[i].Size = Size;
+			S[i].Used = 1;
+			p->Count ++;
+			p->Head = ed;
+			__sync_fetch_and_add(&fHeader->Used, (C_Int64)Size);
+		}
+	}
+	block_cache_unlock(&p->Lock);
+#endif
+}
+
+void CdBlockCache::GetStat(TStat &Stat) const
+{
+	memset(&Stat, 0, sizeof(Stat));
+	if (fHeader)
+	{
+		Stat.Limit = fHeader->ArenaSize * fHeader->NumShard;
+		Stat.Used = fHeader->Used;
+		Stat.Hit = fHeader->Hit;
+		Stat.Miss = fHeader->Miss;
+		Stat.Evict = fHeader->Evict;
+	}
+}
+
+void CdBlockCache::SetDefaultLimit(C_Int64 Limit)
+{
+	block_cache_default_limit = (Limit > 0) ? Limit : 0;
+}
+
+C_Int64 CdBlockCache::DefaultLimit()
+{
+	return block_cache_default_limit;
+}
+
+int CdBlockCache::GetAllStat(TStat &Stat)
+{
+	memset(&Stat, 0, sizeof(Stat));
+	TdAutoMutex _m(&block_cache_mutex);
+	vector<CdBlockCache*> &L = block_cache_list();
+	vector<string> Names;
+	for (size_t i=0; i < L.size(); i++)
+	{
+		// count each shared memory once
+		if (find(Names.begin(), Names.end(), L[i]->Name()) != Names.end())
+			continue;
+		Names.push_back(L[i]->Name());
+		TStat S;
+		L[i]->GetStat(S);
+		Stat.Limit += S.Limit; Stat.Used += S.Used;
+		Stat.Hit += S.Hit; Stat.Miss += S.Miss; Stat.Evict += S.Evict;
+	}
+	return Names.size();
+}
+
+C_Int64 CdBlockCache::MappedSize()
+{
+	C_Int64 rv = 0;
+	TdAutoMutex _m(&block_cache_mutex);
+	vector<CdBlockCache*> &L = block_cache_list();
+	vector<string> Names;
+	for (size_t i=0; i < L.size(); i++)
+	{
+		// count each shared memory once
+		if (find(Names.begin(), Names.end(), L[i]->Name()) != Names.end())
+			continue;
+		Names.push_back(L[i]->Name());
+		rv += L[i]->fMapSize;
+	}
+	return rv;
+}
+
+
+
 // =====================================================================
 // Algorithm of random access
 
@@ -514,11 +1130,17 @@ CdRA_Read::CdRA_Read(CdRecodeStream *owner):
 	fIndexingStart = 0;
 	fIndex = NULL;
 	fIndexSize = 0;
+	fCache = NULL;
+	fCacheFill = false;
+	fCacheID = 0;
+	fCacheBlock = -1;
+	fCacheStart = fCachePos = 0;
 }
 
 CdRA_Read::~CdRA_Read()
 {
 	if (fIndex) delete []fIndex;
+	if (fCache) fCache->Release();
 }
 
 void CdRA_Read::InitReadStream()
@@ -587,6 +1209,86 @@ void CdRA_Read::InitReadStream()
 			fCB_UZSize = fCB_ZSize = 0;
 	} else
 		throw ErrStream(ERR_UNSUPPORT, fVersion >> 4, fVersion & 0x0F);
+
+	InitCache();
+}
+
+void CdRA_Read::InitCache()
+{
+	CdBlockStream *bs = dynamic_cast<CdBlockStream*>(fOwner.fStream);
+	if (bs && bs->Collection().ReadOnly() && bs->Collection().BlockCache())
+	{
+		GetUpdated();
+		fCache = bs->Collection().BlockCache();
+		fCache->AddRef();
+		fCacheID = bs->ID();
+		fCacheBlock = -1;
+		fCacheStart = fCachePos = 0;
+	}
+}
+
+ssize_t CdRA_Read::CacheRead(void *Buffer, ssize_t Count)
+{
+	C_UInt8 *p = (C_UInt8*)Buffer;
+	ssize_t OldCount = Count;
+	while (Count > 0)
+	{
+		if ((fCacheBlock < 0) || (fCachePos < fCacheStart) ||
+			(fCachePos >= fCacheStart + (SIZE64)fCacheBuf.size()))
+		{
+			if (fCachePos >= fIndex[fIndexSize].RawStart) break;
+			// find the block by binary searching
+			ssize_t lo = 0, hi = fIndexSize - 1;
+			while (lo < hi)
+			{
+				ssize_t mid = lo + ((hi - lo + 1) >> 1);
+				if (fIndex[mid].RawStart <= fCachePos)
+					lo = mid;
+				else
+					hi = mid - 1;
+			}
+			const SIZE64 st = fIndex[lo].RawStart;
+			const ssize_t n = fIndex[lo+1].RawStart - st;
+			// get the block from the cache, or decompress it
+			fCacheBlock = -1;
+			if (!fCache->Get(fCacheID, lo, fCacheBuf) ||
+				((ssize_t)fCacheBuf.size() != n))
+			{
+				fCacheBuf.resize(n);
+				fCacheFill = true;
+				try {
+					fOwner.SetPosition(st);
+					fOwner.ReadData(&fCacheBuf[0], n);
+				} catch (...) {
+					fCacheFill = false;
+					throw;
+				}
+				fCacheFill = false;
+				fCache->Put(fCacheID, lo, &fCacheBuf[0], n);
+			}
+			fCacheBlock = lo;
+			fCacheStart = st;
+		}
+		ssize_t L = fCacheStart + fCacheBuf.size() - fCachePos;
+		if (L > Count) L = Count;
+		memcpy(p, &fCacheBuf[fCachePos - fCacheStart], L);
+		p += L; Count -= L;
+		fCachePos += L;
+	}
+	return OldCount - Count;
+}
+
+SIZE64 CdRA_Read::CacheSeek(SIZE64 Offset, TdSysSeekOrg Origin)
+{
+	static const char *ERR_SEEK = "'Seek' out of the range with position (%lld).";
+	if (Origin == soCurrent)
+		Offset += fCachePos;
+	else if (Origin == soEnd)
+		Offset += fIndex[fIndexSize].RawStart;
+	if (Offset < 0)
+		throw ErrStream(ERR_SEEK, Offset);
+	fCachePos = Offset;
+	return Offset;
 }
 
 bool CdRA_Read::SeekStream(SIZE64 Position)
@@ -633,7 +1335,19 @@ bool CdRA_Read::SeekStream(SIZE64 Position)
 
 void CdRA_Read::GetUpdated()
 {
-	if (fIndexSize < fBlockNum) while (NextBlock());
+	if (fIndexSize < fBlockNum)
+	{
+		// keep the current block while scanning the block headers
+		const C_Int32 Idx = fBlockIdx;
+		const SIZE64 ZStart = fCB_ZStart, ZSize = fCB_ZSize;
+		const SIZE64 UZStart = fCB_UZStart, UZSize = fCB_UZSize;
+		const SIZE64 Pos = fOwner.fStreamPos;
+		while (NextBlock());
+		fBlockIdx = Idx;
+		fCB_ZStart = ZStart; fCB_ZSize = ZSize;
+		fCB_UZStart = UZStart; fCB_UZSize = UZSize;
+		fOwner.fStreamPos = Pos;
+	}
 }
 
 void CdRA_Read::GetBlockInfo(vector<SIZE64> &RawSize, vector<SIZE64> &CmpSize)
@@ -648,6 +1362,35 @@ void CdRA_Read::GetBlockInfo(vector<SIZE64> &RawSize, vector<SIZE64> &CmpSize)
 	}
 }
 
+bool CdRA_Read::SetBlockInfo(const vector<SIZE64> &RawSize,
+	const vector<SIZE64> &CmpSize)
+{
+	if ((fIndexSize >= fBlockNum) || (RawSize.size() != CmpSize.size()) ||
+		((C_Int64)RawSize.size() != fBlockNum))
+	{
+		return false;
+	}
+	// check the blocks already loaded
+	for (ssize_t i=0; i < fIndexSize; i++)
+	{
+		if ((fIndex[i+1].RawStart - fIndex[i].RawStart != RawSize[i]) ||
+			(fIndex[i+1].CmpStart - fIndex[i].CmpStart != CmpSize[i]))
+			return false;
+	}
+	// fill the indexing without scanning the block headers
+	for (ssize_t i=fIndexSize; i < fBlockNum; i++)
+	{
+		if ((RawSize[i] < 0) || (CmpSize[i] <= 0)) return false;
+	}
+	for (ssize_t i=fIndexSize; i < fBlockNum; i++)
+	{
+		fIndex[i+1].RawStart = fIndex[i].RawStart + RawSize[i];
+		fIndex[i+1].CmpStart = fIndex[i].CmpStart + CmpSize[i];
+	}
+	fIndexSize = fBlockNum;
+	return true;
+}
+
 bool CdRA_Read::NextBlock()
 {
 	fCB_ZStart += fCB_ZSize;
@@ -1305,6 +2048,10 @@ void CdZEncoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 		CdZDecoder_RA *Src = static_cast<CdZDecoder_RA*>(&Source);
 		if ((Src->SizeType() == SizeType()) && (Src->fVersion == fVersion))
 		{
+			// copy compressed blocks directly, rather than from the cache
+			const bool OldFill = Src->fCacheFill;
+			Src->fCacheFill = true;
+
 			Src->SetPosition(Pos);
 			if (Count < 0)
 				Count = Src->GetSize() - Pos;
@@ -1365,6 +2112,8 @@ void CdZEncoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 				Count -= N;
 			}
 
+			Src->fCacheFill = OldFill;
+			Src->fCachePos = Src->fCurPosition;
 			return;
 		}
 	}
@@ -1386,6 +2135,7 @@ CdZDecoder_RA::CdZDecoder_RA(CdStream &Source):
 ssize_t CdZDecoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (fCache && !fCacheFill) return CacheRead(Buffer, Count);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	C_UInt8 *pBuf = (C_UInt8*)Buffer;
@@ -1449,6 +2199,7 @@ ssize_t CdZDecoder_RA::Read(void *Buffer, ssize_t Count)
 
 SIZE64 CdZDecoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 {
+	if (fCache && !fCacheFill) return CacheSeek(Offset, Origin);
 	if (Origin == soCurrent)
 	{
 		Offset += fCurPosition;
@@ -1993,6 +2744,10 @@ void CdLZ4Encoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 		CdLZ4Decoder_RA *Src = static_cast<CdLZ4Decoder_RA*>(&Source);
 		if ((Src->SizeType() == SizeType()) && (Src->fVersion == fVersion))
 		{
+			// copy compressed blocks directly, rather than from the cache
+			const bool OldFill = Src->fCacheFill;
+			Src->fCacheFill = true;
+
 			Src->SetPosition(Pos);
 			if (Count < 0)
 				Count = Src->GetSize() - Pos;
@@ -2058,6 +2813,8 @@ void CdLZ4Encoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 				Count -= N;
 			}
 
+			Src->fCacheFill = OldFill;
+			Src->fCachePos = Src->fCurPosition;
 			return;
 		}
 	}
@@ -2083,6 +2840,7 @@ CdLZ4Decoder_RA::CdLZ4Decoder_RA(CdStream &Source):
 ssize_t CdLZ4Decoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (fCache && !fCacheFill) return CacheRead(Buffer, Count);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	C_UInt8 *pBuf = (C_UInt8*)Buffer;
@@ -2157,6 +2915,7 @@ ssize_t CdLZ4Decoder_RA::Write(const void *Buffer, ssize_t Count)
 
 SIZE64 CdLZ4Decoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 {
+	if (fCache && !fCacheFill) return CacheSeek(Offset, Origin);
 	if (Origin == soCurrent)
 	{
 		Offset += fCurPosition;
@@ -2658,6 +3417,10 @@ void CdXZEncoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 		CdXZDecoder_RA *Src = static_cast<CdXZDecoder_RA*>(&Source);
 		if ((Src->SizeType() == SizeType()) && (Src->fVersion == fVersion))
 		{
+			// copy compressed blocks directly, rather than from the cache
+			const bool OldFill = Src->fCacheFill;
+			Src->fCacheFill = true;
+
 			Src->SetPosition(Pos);
 			if (Count < 0)
 				Count = Src->GetSize() - Pos;
@@ -2718,6 +3481,8 @@ void CdXZEncoder_RA::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
 				Count -= N;
 			}
 
+			Src->fCacheFill = OldFill;
+			Src->fCachePos = Src->fCurPosition;
 			return;
 		}
 	}
@@ -2737,6 +3502,7 @@ CdXZDecoder_RA::CdXZDecoder_RA(CdStream &Source): CdRA_Read(this),
 ssize_t CdXZDecoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (fCache && !fCacheFill) return CacheRead(Buffer, Count);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	ssize_t OriCount = Count;
@@ -2798,6 +3564,7 @@ ssize_t CdXZDecoder_RA::Read(void *Buffer, ssize_t Count)
 
 SIZE64 CdXZDecoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 {
+	if (fCache && !fCacheFill) return CacheSeek(Offset, Origin);
 	if (Origin == soCurrent)
 	{
 		Offset += fCurPosition;
@@ -2926,6 +3693,8 @@ CdBlockStream::CdBlockStream(CdBlockCollection &vCollection):
 	CdStream(), fCollection(vCollection)
 {
 	fID = 0;
+	fWriteStamp = 0;
+	fCommitStamp = -1;
 	fList = fCurrent = NULL;
 	fPosition = fBlockCapacity = 0;
 	fBlockSize = 0;
@@ -2950,7 +3719,15 @@ ssize_t CdBlockStream::Read(void *Buffer, ssize_t Count)
 	if ((LastPos+Count) > fBlockSize)
 		Count = fBlockSize - LastPos;
 
-	if (fCurrent && (Count>0))
+	if (!fCopy.empty())
+	{
+		// the contents are held in memory
+		if (Count > 0)
+		{
+			memcpy(Buffer, &fCopy[LastPos], Count);
+			fPosition += Count;
+		}
+	} else if (fCurrent && (Count>0))
 	{
 		CdStream *vStream = fCollection.Stream();
 		if (!vStream) return 0;
@@ -2991,6 +3768,8 @@ ssize_t CdBlockStream::Write(const void *Buffer, ssize_t Count)
 
 	if (Count > 0)
 	{
+		if (!fCopy.empty()) _DropCopy();
+		_Touch();
 		SIZE64 L = fPosition + Count;
 		if (L > fBlockCapacity)
 			fCollection._IncStreamSize(*this, L);
@@ -3078,6 +3857,8 @@ void CdBlockStream::SetSize(SIZE64 NewSize)
 {
 	if ((0<=NewSize) && (NewSize!=fBlockSize))
 	{
+		if (!fCopy.empty()) _DropCopy();
+		_Touch();
 		if (NewSize > fBlockCapacity)
 			fCollection._IncStreamSize(*this, NewSize);
 		else if (NewSize < fBlockCapacity)
@@ -3097,6 +3878,8 @@ void CdBlockStream::SetSizeOnly(SIZE64 NewSize)
 {
 	if ((0<=NewSize) && (NewSize!=fBlockSize))
 	{
+		if (!fCopy.empty()) _DropCopy();
+		_Touch();
 		if (NewSize > fBlockCapacity)
 		{
 			SetSize(NewSize);
@@ -3113,6 +3896,23 @@ void CdBlockStream::SetSizeOnly(SIZE64 NewSize)
 	}
 }
 
+void CdBlockStream::SetCopy(const void *Buffer, SIZE64 Count)
+{
+	if (Count == fBlockSize)
+	{
+		const C_UInt8 *p = (const C_UInt8*)Buffer;
+		fCopy.assign(p, p + Count);
+	} else
+		_DropCopy();
+}
+
+void CdBlockStream::_DropCopy()
+{
+	vector<C_UInt8>().swap(fCopy);
+	// the reads from the copy did not move the current block
+	fCurrent = _FindCur(fPosition);
+}
+
 bool CdBlockStream::ReadOnly() const
 {
     return fCollection.fReadOnly;
@@ -3126,6 +3926,11 @@ int CdBlockStream::ListCount() const
 	return rv;
 }
 
+void CdBlockStream::_Touch()
+{
+	fWriteStamp = ++ fCollection.fWriteCount;
+}
+
 void CdBlockStream::SyncSizeInfo()
 {
 	if (fNeedSyncSize)
@@ -3174,6 +3979,9 @@ CdBlockCollection::CdBlockCollection(const SIZE64 vCodeStart)
 	fCodeStart = vCodeStart;
 	fClassMgr = &dObjManager();
 	fReadOnly = false;
+	fSWMR = false;
+	fBlockCache = NULL;
+	fWriteCount = 0;
 }
 
 CdBlockCollection::~CdBlockCollection()
@@ -3286,7 +4094,8 @@ CdBlockStream::TBlockInfo *CdBlockCollection::_NeedBlock(
 		Size += CdBlockStream::TBlockInfo::HEAD_SIZE;
 
 	// First, find a suitable block for Unuse
-	CdBlockStream::TBlockInfo *p = fUnuse;
+	//   (never reused in the SWMR mode, since readers might still refer to it)
+	CdBlockStream::TBlockInfo *p = fSWMR ? NULL : fUnuse;
 	CdBlockStream::TBlockInfo *rv, *q, *qrv;
 	rv = q = qrv = NULL;
 	while (p != NULL)
@@ -3355,6 +4164,7 @@ CdBlockStream *CdBlockCollection::NewBlockStream()
 	CdBlockStream *rv = new CdBlockStream(*this);
 	rv->AddRef();
 	rv->fID = vNextID; ++vNextID;
+	rv->_Touch();
 	fBlockList.push_back(rv);
 	return rv;
 }
@@ -3378,6 +4188,25 @@ int CdBlockCollection::NumOfFragment()
 	return Cnt;
 }
 
+void CdBlockCollection::_AttachStream(CdStream *vStream, bool vReadOnly)
+{
+	if (fStream) throw ErrStream(ERR_INTERNAL_CALL);
+	(fStream=vStream)->AddRef();
+	fReadOnly = vReadOnly;
+
+	// attach to the shared cache of decompressed blocks
+	CdFileStream *fs = dynamic_cast<CdFileStream*>(vStream);
+	if (vReadOnly && fs && (CdBlockCache::DefaultLimit() > 0))
+	{
+		CdBlockCache *c = new CdBlockCache;
+		c->AddRef();
+		if (c->Attach(fs->FileName().c_str(), CdBlockCache::DefaultLimit()))
+			fBlockCache = c;
+		else
+			c->Release();
+	}
+}
+
 void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	bool vAllowError, CdLogRecord *Log)
 {
@@ -3390,9 +4219,7 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	static const char *INFO_UNUSED = "# of unused blocks: %d.";
 
 	// initialize
-	if (fStream) throw ErrStream(ERR_INTERNAL_CALL);
-	(fStream=vStream)->AddRef();
-	fReadOnly = vReadOnly;
+	_AttachStream(vStream, vReadOnly);
 	CdBlockStream::TBlockInfo *p = fUnuse;
 	fStream->SetPosition(fCodeStart);
 	fStreamSize = fStream->GetSize();
@@ -3541,6 +4368,101 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	}
 }
 
+static void SaveBlockList(BYTE_LE<CdStream> &W,
+	const CdBlockStream::TBlockInfo *p)
+{
+	C_UInt32 n = 0;
+	for (const CdBlockStream::TBlockInfo *q=p; q; q=q->Next) n++;
+	W << n;
+	for (; p; p=p->Next)
+	{
+		W << C_UInt8(p->Head ? 1 : 0) << C_Int64(p->BlockSize) <<
+			C_Int64(p->StreamStart) << C_Int64(p->StreamNext);
+	}
+}
+
+static CdBlockStream::TBlockInfo *LoadBlockList(BYTE_LE<CdStream> &R,
+	SIZE64 StreamSize, SIZE64 &Capacity)
+{
+	static const char *ERR_TABLE = "Invalid block (%lld, %lld) in the block table.";
+
+	C_UInt32 n;
+	R >> n;
+	CdBlockStream::TBlockInfo *head=NULL, *p=NULL;
+	Capacity = 0;
+	try {
+		for (C_UInt32 i=0; i < n; i++)
+		{
+			C_UInt8 h;
+			C_Int64 bs, ss, sn;
+			R >> h >> bs >> ss >> sn;
+			if ((bs < 0) || (ss < 0) || (ss + bs > StreamSize) ||
+					(sn < 0) || (sn >= StreamSize))
+				throw ErrStream(ERR_TABLE, ss, bs);
+			CdBlockStream::TBlockInfo *q =
+				new CdBlockStream::TBlockInfo(h != 0, bs, ss, sn);
+			q->BlockStart = Capacity;
+			Capacity += bs;
+			if (p) p->Next = q; else head = q;
+			p = q;
+		}
+	}
+	catch (...) {
+		xClearList(head);
+		throw;
+	}
+	return head;
+}
+
+void CdBlockCollection::SaveBlockTable(BYTE_LE<CdStream> &W)
+{
+	// the streams without any block are not in the file, as in a scan
+	C_UInt32 n = 0;
+	vector<CdBlockStream*>::const_iterator it;
+	for (it = fBlockList.begin(); it != fBlockList.end(); it++)
+		if ((*it)->fList) n ++;
+	W << C_Int64(fStreamSize) << n;
+	for (it = fBlockList.begin(); it != fBlockList.end(); it++)
+	{
+		if (!(*it)->fList) continue;
+		W << (*it)->ID() << C_Int64((*it)->Size());
+		SaveBlockList(W, (*it)->fList);
+	}
+	SaveBlockList(W, fUnuse);
+}
+
+void CdBlockCollection::LoadBlockTable(CdStream *vStream, bool vReadOnly,
+	BYTE_LE<CdStream> &R)
+{
+	static const char *ERR_SIZE = "The block table does not match the file size.";
+	static const char *ERR_STREAM = "Invalid stream block (ID: %u) in the block table.";
+
+	_AttachStream(vStream, vReadOnly);
+	fStreamSize = fStream->GetSize();
+	C_Int64 file_size;
+	C_UInt32 n;
+	R >> file_size >> n;
+	if (file_size != fStreamSize)
+		throw ErrStream(ERR_SIZE);
+
+	for (C_UInt32 i=0; i < n; i++)
+	{
+		CdBlockStream *bs = new CdBlockStream(*this);
+		bs->AddRef();
+		fBlockList.push_back(bs);
+		C_Int64 size;
+		R >> bs->fID >> size;
+		bs->fBlockSize = size;
+		bs->fList = bs->fCurrent =
+			LoadBlockList(R, fStreamSize, bs->fBlockCapacity);
+		if (!bs->fList || !bs->fList->Head || (size < 0) ||
+				(size > bs->fBlockCapacity))
+			throw ErrStream(ERR_STREAM, bs->fID.Get());
+	}
+	SIZE64 unused;
+	fUnuse = LoadBlockList(R, fStreamSize, unused);
+}
+
 void CdBlockCollection::WriteStream(CdStream *vStream)
 {
 	if (fStream) throw ErrStream(ERR_INTERNAL_CALL);
@@ -3550,6 +4472,16 @@ void CdBlockCollection::WriteStream(CdStream *vStream)
 }
 
 void CdBlockCollection::Clear()
+{
+	_Clear(false);
+}
+
+void CdBlockCollection::Detach()
+{
+	_Clear(true);
+}
+
+void CdBlockCollection::_Clear(bool Shared)
 {
 #ifdef COREARRAY_CODE_DEBUG
 	static const char *ERR_INTERNAL =
@@ -3574,7 +4506,8 @@ void CdBlockCollection::Clear()
 	if (fStream)
 	{
 	#ifdef COREARRAY_CODE_DEBUG
-		if (fStream->Release() != 0) throw ErrStream(ERR_INTERNAL);
+		if ((fStream->Release() != 0) && !Shared)
+			throw ErrStream(ERR_INTERNAL);
 	#else
 		fStream->Release();
 	#endif
@@ -3582,6 +4515,191 @@ void CdBlockCollection::Clear()
 	}
 	xClearList(fUnuse);
 	fUnuse = NULL;
+	fSWMR = false;
+	if (fBlockCache)
+	{
+		fBlockCache->Release();
+		fBlockCache = NULL;
+	}
+}
+
+void CdBlockCollection::RefreshStream(SIZE64 FileSize,
+	const vector<TdGDSBlockID> &ID, const vector<SIZE64> &Size,
+	const vector<C_Int64> &Stamp)
+{
+	static const char *ERR_SIZE = "Invalid block size (%lld) at position (%lld) in refreshing.";
+	static const char *ERR_ID = "Invalid block ID (%u) in refreshing.";
+	typedef CdBlockStream::TBlockInfo TInfo;
+
+	if (!fStream) throw ErrStream(ERR_INTERNAL_CALL);
+
+	// the copies of stream contents become stale, and the streams not in
+	//   the record are not committed
+	vector<CdBlockStream*>::iterator ic;
+	for (ic=fBlockList.begin(); ic != fBlockList.end(); ic++)
+	{
+		if (!(*ic)->fCopy.empty()) (*ic)->_DropCopy();
+		(*ic)->fCommitStamp = -1;
+	}
+
+	if (FileSize > fStreamSize)
+	{
+		// the last block in the file might be enlarged in place
+		SIZE64 pos = fStreamSize;
+		CdBlockStream *tail_bs = NULL;
+		TInfo *tail = NULL;
+		vector<CdBlockStream*>::iterator it;
+		for (it=fBlockList.begin(); it != fBlockList.end() && !tail; it++)
+		{
+			for (TInfo *p = (*it)->fList; p; p = p->Next)
+			{
+				if (p->StreamStart + p->BlockSize == fStreamSize)
+					{ tail = p; tail_bs = *it; break; }
+			}
+		}
+		if (tail && !tail->Next)
+		{
+			const SIZE64 L = tail->StreamStart - tail->AbsStart();
+			fStream->SetPosition(tail->AbsStart());
+			TdGDSPos sSize;
+			BYTE_LE<CdStream>(fStream) >> sSize;
+			SIZE64 sz = (sSize & GDS_STREAM_POS_MASK) - L;
+			if (tail->StreamStart + sz > FileSize)
+				sz = FileSize - tail->StreamStart;
+			if (sz > tail->BlockSize)
+			{
+				tail_bs->fBlockCapacity += sz - tail->BlockSize;
+				tail->BlockSize = sz;
+			}
+			pos = tail->StreamStart + tail->BlockSize;
+		}
+
+		// scan the new blocks
+		TInfo *New = NULL, *last = NULL;
+		try {
+			while (pos + 2*GDS_POS_SIZE <= FileSize)
+			{
+				TdGDSPos sSize, sNext;
+				fStream->SetPosition(pos);
+				BYTE_LE<CdStream>(fStream) >> sSize >> sNext;
+				const SIZE64 sz = sSize & GDS_STREAM_POS_MASK;
+				const bool head = (sSize & GDS_STREAM_POS_MASK_HEAD_BIT) != 0;
+				const SIZE64 L = 2*GDS_POS_SIZE + (head ? TInfo::HEAD_SIZE : 0);
+				if (sz < L)
+					throw ErrStream(ERR_SIZE, sz, pos);
+				// the last block might be enlarged after the commit
+				SIZE64 end = pos + sz;
+				if (end > FileSize) end = FileSize;
+				if (end - pos < L)
+					throw ErrStream(ERR_SIZE, sz, pos);
+				TInfo *n = new TInfo(head, end - pos - L, pos + L, sNext);
+				if (last) last->Next = n; else New = n;
+				last = n;
+				pos = end;
+			}
+		} catch (...) {
+			xClearList(New);
+			throw;
+		}
+		fStreamSize = FileSize;
+
+		// extract a non-head block starting at 'Next' from the new list
+		struct TExtract {
+			static TInfo *Get(TInfo *&List, SIZE64 Next)
+			{
+				for (TInfo *p = List, *q = NULL; p; q = p, p = p->Next)
+				{
+					if (!p->Head && (p->AbsStart() == Next))
+					{
+						if (q) q->Next = p->Next; else List = p->Next;
+						p->Next = NULL;
+						return p;
+					}
+				}
+				return NULL;
+			}
+		};
+
+		// append the new blocks to the existing streams
+		for (it=fBlockList.begin(); New && (it != fBlockList.end()); it++)
+		{
+			TInfo *p = (*it)->fList;
+			if (!p) continue;
+			while (p->Next) p = p->Next;
+			// the next position of the tail might be updated by the writer
+			fStream->SetPosition(p->StreamStart -
+				(p->Head ? (TInfo::HEAD_SIZE + GDS_POS_SIZE) : GDS_POS_SIZE));
+			TdGDSPos sNext;
+			BYTE_LE<CdStream>(fStream) >> sNext;
+			p->StreamNext = sNext;
+			TInfo *n;
+			while ((p->StreamNext != 0) && (n = TExtract::Get(New, p->StreamNext)))
+			{
+				n->BlockStart = p->BlockStart + p->BlockSize;
+				(*it)->fBlockCapacity += n->BlockSize;
+				p->Next = n; p = n;
+			}
+		}
+
+		// new block streams
+		while (New)
+		{
+			TInfo *p = New, *q = NULL;
+			for (; p && !p->Head; q = p, p = p->Next);
+			if (!p) break;
+			if (q) q->Next = p->Next; else New = p->Next;
+			p->Next = NULL;
+
+			CdBlockStream *bs = new CdBlockStream(*this);
+			bs->AddRef();
+			fBlockList.push_back(bs);
+			fStream->SetPosition(p->StreamStart - TInfo::HEAD_SIZE);
+			BYTE_LE<CdStream>(fStream) >> bs->fID >> bs->fBlockSize;
+			bs->fBlockCapacity = p->BlockSize;
+			bs->fList = bs->fCurrent = p;
+			if (vNextID.Get() <= bs->fID.Get()) vNextID = bs->fID.Get() + 1;
+			TInfo *n;
+			while ((p->StreamNext != 0) && (n = TExtract::Get(New, p->StreamNext)))
+			{
+				n->BlockStart = p->BlockStart + p->BlockSize;
+				bs->fBlockCapacity += n->BlockSize;
+				p->Next = n; p = n;
+			}
+		}
+
+		// the others are unused or not linked yet
+		if (New)
+		{
+			TInfo *p = New;
+			while (p->Next) p = p->Next;
+			p->Next = fUnuse;
+			fUnuse = New;
+		}
+	}
+
+	// the committed sizes of block streams
+	map<C_UInt32, CdBlockStream*> id_map;
+	vector<CdBlockStream*>::iterator it;
+	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
+		id_map[(*it)->fID.Get()] = *it;
+	for (size_t i=0; i < ID.size(); i++)
+	{
+		map<C_UInt32, CdBlockStream*>::iterator p = id_map.find(ID[i].Get());
+		CdBlockStream *bs;
+		if (p == id_map.end())
+		{
+			// an empty stream has no block in the file
+			if (Size[i] > 0)
+				throw ErrStream(ERR_ID, ID[i].Get());
+			bs = (*this)[ID[i]];
+		} else
+			bs = p->second;
+		SIZE64 sz = Size[i];
+		if (sz > bs->fBlockCapacity) sz = bs->fBlockCapacity;
+		if (sz < 0) sz = 0;
+		bs->fBlockSize = sz;
+		bs->fCommitStamp = Stamp[i];
+	}
 }
 
 void CdBlockCollection::DeleteBlockStream(TdGDSBlockID id)
@@ -339,6 +339,84 @@ namespace CoreArray
 
 
 
+	// =====================================================================
+	// Shared cache of decompressed blocks
+	// =====================================================================
+
+	/// The cache of decompressed blocks shared among processes
+	/** The cache is stored in POSIX shared memory named by the identity of
+	 *  GDS file (device, inode, size and modification time), and all processes
+	 *  opening the same file in the read-only mode attach to it, including the
+	 *  forked ones. The memory is split into shards, each of which has a spin
+	 *  lock, an open-addressing table keyed by (stream ID, block index) and a
+	 *  ring buffer of block data with first-in-first-out eviction.
+	 *  The attached processes are recorded by PID in the shared memory, and
+	 *  the spin lock is stamped with the PID of its holder, so the lock and
+	 *  the shared memory left by a crashed process are reclaimed.
+	**/
+	class COREARRAY_DLL_DEFAULT CdBlockCache: public CdRef
+	{
+	public:
+		CdBlockCache();
+		virtual ~CdBlockCache();
+
+		/// attach to (or create) the cache of a file, return false if fails
+		bool Attach(const char *FileName, C_Int64 Limit);
+		/// detach from the shared memory, and remove it if no one attaches
+		void Detach();
+
+		/// copy the block to Buffer and return true if it is in the cache
+		bool Get(C_UInt32 StreamID, C_Int32 BlockIdx, vector<C_UInt8> &Buffer);
+		/// add a block to the cache, evicting the oldest ones if needed
+		void Put(C_UInt32 StreamID, C_Int32 BlockIdx, const void *Buffer,
+			size_t Size);
+
+		/// the statistics shared by all attached processes
+		struct TStat
+		{
+			C_Int64 Limit;  ///< the total size of block data
+			C_Int64 Used;   ///< the size of cached blocks
+			C_Int64 Hit;    ///< the number of hits
+			C_Int64 Miss;   ///< the number of misses
+			C_Int64 Evict;  ///< the number of evicted blocks
+		};
+		/// get the statistics
+		void GetStat(TStat &Stat) const;
+
+		COREARRAY_INLINE bool Attached() const { return fHeader != NULL; }
+		COREARRAY_INLINE const string &Name() const { return fName; }
+
+		/// the default limit for the files opened afterward, 0 for no cache
+		static void SetDefaultLimit(C_Int64 Limit);
+		/// the default limit
+		static C_Int64 DefaultLimit();
+		/// sum the statistics of all caches attached in the current process
+		static int GetAllStat(TStat &Stat);
+		/// the size of shared memory mapped by the current process
+		static C_Int64 MappedSize();
+
+	protected:
+		struct THeader;
+		struct TShard;
+		struct TSlot;
+
+		THeader *fHeader;   ///< the mapped shared memory
+		size_t fMapSize;    ///< the size of mapping
+		string fName;       ///< the name of shared memory
+		int fPID;           ///< the process attaching to the shared memory
+
+		TShard *_Shard(int i) const;
+		TSlot *_Slots(TShard *p) const;
+		C_UInt8 *_Arena(TShard *p) const;
+		int _Find(TShard *p, C_UInt32 ID, C_Int32 Idx, bool &Found) const;
+		void _Remove(TShard *p, int i);
+		/// lock the shard, and reset it if taken over from a dead process
+		bool _Lock(TShard *p);
+		/// remove the shared memory not attached by any live process
+		static void _Reclaim();
+	};
+
+
 	// =====================================================================
 	// Algorithm of random access
 	// =====================================================================
@@ -391,6 +469,10 @@ namespace CoreArray
 		void GetUpdated();
 		/// get block lists
 		void GetBlockInfo(vector<SIZE64> &RawSize, vector<SIZE64> &CmpSize);
+		/// set block lists parsed somewhere else (e.g., by another process)
+		/** return false if the lists do not match or are not needed **/
+		bool SetBlockInfo(const vector<SIZE64> &RawSize,
+			const vector<SIZE64> &CmpSize);
 
 	protected:
 		/// the version number
@@ -435,6 +517,27 @@ namespace CoreArray
 		/// load the indexing information for version 0x11
 		void LoadIndexing();
 
+		/// the shared cache of decompressed blocks, or NULL
+		CdBlockCache *fCache;
+		/// true if filling a block for the cache
+		bool fCacheFill;
+		/// the stream ID in the key of cache
+		C_UInt32 fCacheID;
+		/// the current decompressed block
+		vector<C_UInt8> fCacheBuf;
+		/// the block index and the start position of fCacheBuf
+		C_Int32 fCacheBlock;
+		SIZE64 fCacheStart;
+		/// the current position of reading through the cache
+		SIZE64 fCachePos;
+
+		/// use the cache of the GDS file if it is available
+		void InitCache();
+		/// read via the cache
+		ssize_t CacheRead(void *Buffer, ssize_t Count);
+		/// seek via the cache
+		SIZE64 CacheSeek(SIZE64 Offset, TdSysSeekOrg Origin);
+
 	private:
 		/// get the header of block used in Version_1.0
 		inline void GetBlockHeader_v1_0();
@@ -974,6 +1077,10 @@ namespace CoreArray
 		virtual void SetSize(SIZE64 NewSize);
         void SetSizeOnly(SIZE64 NewSize);
 
+		/// serve reads from a copy of the stream contents, e.g., loaded from
+		/// a metadata index, until the stream is written or resized
+		void SetCopy(const void *Buffer, SIZE64 Count);
+
 		void SyncSizeInfo();
 		SIZE64 GetSize() const;
 
@@ -985,17 +1092,27 @@ namespace CoreArray
 		COREARRAY_INLINE SIZE64 Size() const { return fBlockSize; }
 		COREARRAY_INLINE CdBlockCollection &Collection() const { return fCollection; }
 		COREARRAY_INLINE const TBlockInfo *List() const { return fList; }
+		/// the write counter of the collection when last written or resized
+		COREARRAY_INLINE C_Int64 WriteStamp() const { return fWriteStamp; }
+		/// the write stamp in the commit record loaded by a reader in the
+		/// SWMR mode, or -1 if the stream is not in the record
+		COREARRAY_INLINE C_Int64 CommitStamp() const { return fCommitStamp; }
 
 	protected:
 		CdBlockCollection &fCollection;
 		TdGDSBlockID fID;
+		C_Int64 fWriteStamp;
+		C_Int64 fCommitStamp;
 		TBlockInfo *fList, *fCurrent;
 		SIZE64 fPosition, fBlockCapacity;
 		TdGDSPos fBlockSize;
+		vector<C_UInt8> fCopy;  ///< a copy of the stream contents, or empty
 
 	private:
     	bool fNeedSyncSize;
 		TBlockInfo *_FindCur(const SIZE64 Pos);
+		void _DropCopy();
+		void _Touch();
 	};
 
 	/// The pointer to the chunk stream
@@ -1017,6 +1134,31 @@ namespace CoreArray
 			CdLogRecord *Log);
 		void WriteStream(CdStream *vStream);
 		void Clear();
+		/// remove all block streams like Clear(), and detach the stream
+		/// still held by the caller
+		void Detach();
+
+		/// save the lists of blocks, used by LoadBlockTable()
+		void SaveBlockTable(BYTE_LE<CdStream> &W);
+		/// construct the block streams from a table saved by SaveBlockTable()
+		/** The blocks are not scanned, the caller should check whether the
+		 *  table matches the file. An exception is raised if the table is
+		 *  inconsistent with the file size, and Detach() should be called.
+		 *  \param vStream    the stream of GDS file
+		 *  \param vReadOnly  if true, the file is read-only
+		 *  \param R          the table saved by SaveBlockTable()
+		**/
+		void LoadBlockTable(CdStream *vStream, bool vReadOnly,
+			BYTE_LE<CdStream> &R);
+
+		/// load the blocks committed by a writer in the SWMR mode
+		/** \param FileSize  the committed size of the file
+		 *  \param ID        the IDs of committed block streams
+		 *  \param Size      the committed sizes of block streams
+		 *  \param Stamp     the write stamps of block streams in the writer
+		**/
+		void RefreshStream(SIZE64 FileSize, const vector<TdGDSBlockID> &ID,
+			const vector<SIZE64> &Size, const vector<C_Int64> &Stamp);
 
     	CdBlockStream *NewBlockStream();
 		/// remove the stream object associated with ID
@@ -1035,10 +1177,19 @@ namespace CoreArray
 			{ return fClassMgr; }
 		COREARRAY_INLINE bool ReadOnly() const
 			{ return fReadOnly; }
+		/// whether in the single-writer/multi-reader (append-only) mode
+		COREARRAY_INLINE bool SWMR() const
+			{ return fSWMR; }
 		COREARRAY_INLINE const vector<CdBlockStream*> &BlockList() const
 			{ return fBlockList; }
 		COREARRAY_INLINE const CdBlockStream::TBlockInfo* UnusedBlock() const
         	{ return fUnuse; }
+		/// the shared cache of decompressed blocks, or NULL
+		COREARRAY_INLINE CdBlockCache *BlockCache() const
+			{ return fBlockCache; }
+		/// increased when a block stream is created, written or resized
+		COREARRAY_INLINE C_Int64 WriteCount() const
+			{ return fWriteCount; }
 
 	protected:
 		CdStream *fStream;
@@ -1048,6 +1199,9 @@ namespace CoreArray
 		SIZE64 fCodeStart;
 		CdObjClassMgr *fClassMgr;
 		bool fReadOnly;
+		bool fSWMR;
+		CdBlockCache *fBlockCache;
+		C_Int64 fWriteCount;
 
 		void _IncStreamSize(CdBlockStream &Block, const SIZE64 NewSize);
 		void _DecStreamSize(CdBlockStream &Block, const SIZE64 NewSize);
@@ -1055,6 +1209,8 @@ namespace CoreArray
 
 	private:
 		TdGDSBlockID vNextID;
+		void _AttachStream(CdStream *vStream, bool vReadOnly);
+		void _Clear(bool Shared);
 	};
 }
 
@@ -26,6 +26,7 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "dStruct.h"
+#include "dParallel.h"
 #include <memory>
 #include <algorithm>
 #include <typeinfo>
@@ -371,6 +372,10 @@ static const char *ERR_READ_INV_SV   = "ReadData: Invalid SVType.";
 static const char *ERR_READEX_INV_SV = "ReadDataEx: Invalid SVType.";
 static const char *ERR_WRITE_INV_SV  = "WriteData: Invalid SVType.";
 static const char *ERR_INV_DIM_RECT  = "Invalid dimension 'Start' and 'Length'.";
+static const char *ERR_READIDX_INV_SV = "ReadDataIdx: Invalid SVType.";
+static const char *ERR_READIDX_INDEX  = "ReadDataIdx: Invalid index (%d) of the %d dimension.";
+static const char *ERR_READMULTI_INV_SV = "ReadDataMulti: Invalid SVType.";
+static const char *ERR_READMULTI_BUF    = "ReadDataMulti: Invalid output buffer.";
 
 namespace CoreArray
 {
@@ -450,6 +455,107 @@ namespace CoreArray
 			return p;
 		}
 
+		/// scatter the elements of a compact buffer to the output order
+		template<typename TYPE> static TYPE *IDX_Scatter(const TYPE *p,
+			TYPE *out, const vector<C_Int32> *Rank, const C_Int64 *Stride,
+			int DimCnt)
+		{
+			const vector<C_Int32> &R = *Rank;
+			if (DimCnt > 1)
+			{
+				for (size_t i=0; i < R.size(); i++)
+				{
+					out = IDX_Scatter(p + R[i] * (*Stride), out, Rank+1,
+						Stride+1, DimCnt-1);
+				}
+			} else {
+				for (size_t i=0; i < R.size(); i++)
+					*out++ = p[R[i]];
+			}
+			return out;
+		}
+
+		/// read the selected elements once, then scatter to the output order
+		template<typename TYPE> static TYPE *IDX_Read(CdAbstractArray &Obj,
+			const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Sel[], C_SVType SV, C_Int64 Cnt,
+			const vector<C_Int32> *Rank, const C_Int64 *Stride, TYPE *out)
+		{
+			vector<TYPE> buf(Cnt);
+			Obj.ReadDataEx(Start, Length, Sel, &buf[0], SV);
+			return IDX_Scatter(&buf[0], out, Rank, Stride, Obj.DimCnt());
+		}
+
+		/// a hyperslab in a merged range of the first dimension
+		struct TMultiSlab
+		{
+			const C_Int32 *Start;  ///< the starting positions
+			const C_Int32 *Len;    ///< the lengths
+			void *Out;             ///< the output buffer
+			TMultiSlab(const C_Int32 *s, const C_Int32 *l, void *o)
+				{ Start = s; Len = l; Out = o; }
+		};
+
+		/// sort hyperslabs by the starting positions in the flat order
+		struct TMultiSlabLess
+		{
+			const C_Int32 *Start, *Length;
+			int DimCnt;
+			TMultiSlabLess(const C_Int32 *s, const C_Int32 *l, int n)
+				{ Start = s; Length = l; DimCnt = n; }
+			bool operator()(int i, int j) const
+			{
+				const C_Int32 *s1 = Start + (size_t)i*DimCnt;
+				const C_Int32 *s2 = Start + (size_t)j*DimCnt;
+				const C_Int32 *l1 = Length + (size_t)i*DimCnt;
+				const C_Int32 *l2 = Length + (size_t)j*DimCnt;
+				for (int k=0; k < DimCnt; k++)
+					if (s1[k] != s2[k]) return s1[k] < s2[k];
+				for (int k=0; k < DimCnt; k++)
+					if (l1[k] != l2[k]) return l1[k] < l2[k];
+				return i < j;
+			}
+		};
+
+		/// read the bounding box of merged hyperslabs once, then copy to
+		/// the output of each hyperslab
+		template<typename TYPE> static void MULTI_Read(CdAbstractArray &Obj,
+			const C_Int32 *Start, const C_Int32 *Length, int DCnt,
+			C_SVType SV, const vector<TMultiSlab> &Slab)
+		{
+			vector<C_Int64> Stride(DCnt);
+			C_Int64 n = 1;
+			for (int k=DCnt-1; k >= 0; k--)
+				{ Stride[k] = n; n *= Length[k]; }
+			vector<TYPE> buf(n);
+			Obj.ReadData(Start, Length, &buf[0], SV);
+
+			const int last = DCnt - 1;
+			vector<C_Int32> Idx(DCnt);
+			vector<TMultiSlab>::const_iterator it;
+			for (it=Slab.begin(); it != Slab.end(); it++)
+			{
+				TYPE *p = (TYPE*)it->Out;
+				fill(Idx.begin(), Idx.end(), 0);
+				while (true)
+				{
+					// copy along the last dimension
+					C_Int64 off = 0;
+					for (int k=0; k < DCnt; k++)
+						off += (it->Start[k] - Start[k] + Idx[k]) * Stride[k];
+					p = copy(&buf[off], &buf[off] + it->Len[last], p);
+					int k = last - 1;
+					for (; k >= 0; k--)
+					{
+						if (++Idx[k] < it->Len[k]) break;
+						Idx[k] = 0;
+					}
+					if (k < 0) break;
+				}
+			}
+		}
+
+
 		/// write an array to an iterator
 		static const UTF8String *ITER_STR8_Write(CdIterator &I, const UTF8String *p, ssize_t n)
 		{
@@ -611,6 +717,278 @@ void *CdAbstractArray::ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
 	}
 }
 
+void *CdAbstractArray::ReadDataIdx(const C_Int32 *const Index[],
+	const C_Int32 IdxCnt[], void *OutBuffer, C_SVType OutSV)
+{
+	const int DCnt = DimCnt();
+	if ((Index == NULL) || (DCnt <= 0))
+		return ReadData(NULL, NULL, OutBuffer, OutSV);
+	if (!COREARRAY_SV_VALID(OutSV))
+		throw ErrArray(ERR_READIDX_INV_SV);
+
+	TArrayDim DStart, DLength;
+	vector< vector<C_BOOL> > sel(DCnt);
+	vector<const C_BOOL*> sel_ptr(DCnt);
+	vector< vector<C_Int32> > rank(DCnt);
+	C_Int64 Stride[MAX_ARRAY_DIM];
+	bool need_scatter = false;
+
+	for (int i=0; i < DCnt; i++)
+	{
+		const C_Int32 DLen = GetDLen(i);
+		const C_Int32 *idx = Index[i];
+		const C_Int32 n = idx ? IdxCnt[i] : DLen;
+		if (n <= 0) return OutBuffer;
+
+		// the bounding range and whether the indices are strictly increasing
+		C_Int32 lo = idx ? idx[0] : 0, hi = idx ? idx[0] : DLen-1;
+		bool inc = true;
+		if (idx)
+		{
+			for (C_Int32 k=0; k < n; k++)
+			{
+				C_Int32 v = idx[k];
+				if ((v < 0) || (v >= DLen))
+					throw ErrArray(ERR_READIDX_INDEX, v, i);
+				if (v < lo) lo = v;
+				if (v > hi) hi = v;
+				if ((k > 0) && (v <= idx[k-1])) inc = false;
+			}
+		}
+		DStart[i] = lo; DLength[i] = hi - lo + 1;
+
+		// the selection of sorted runs within the bounding range
+		vector<C_BOOL> &s = sel[i];
+		s.assign(DLength[i], idx ? 0 : 1);
+		if (idx)
+			for (C_Int32 k=0; k < n; k++) s[idx[k] - lo] = 1;
+		sel_ptr[i] = &s[0];
+
+		// the rank of each index in the compact buffer
+		if (!inc)
+		{
+			need_scatter = true;
+			vector<C_Int32> cum(DLength[i]);
+			C_Int32 m = 0;
+			for (C_Int32 k=0; k < DLength[i]; k++)
+				{ cum[k] = m; if (s[k]) m++; }
+			rank[i].resize(n);
+			for (C_Int32 k=0; k < n; k++)
+				rank[i][k] = cum[idx[k] - lo];
+			Stride[i] = m;
+		} else {
+			rank[i].resize(n);
+			for (C_Int32 k=0; k < n; k++) rank[i][k] = k;
+			Stride[i] = n;
+		}
+	}
+
+	// strictly increasing indices, read into the output buffer directly
+	if (!need_scatter)
+		return ReadDataEx(DStart, DLength, &sel_ptr[0], OutBuffer, OutSV);
+
+	// the strides of the compact buffer
+	C_Int64 Cnt = 1;
+	for (int i=DCnt-1; i >= 0; i--)
+	{
+		C_Int64 m = Stride[i];
+		Stride[i] = Cnt;
+		Cnt *= m;
+	}
+	switch (OutSV)
+	{
+		case svInt8: case svUInt8:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (C_UInt8*)OutBuffer);
+		case svInt16: case svUInt16:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (C_UInt16*)OutBuffer);
+		case svInt32: case svUInt32: case svFloat32:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (C_UInt32*)OutBuffer);
+		case svInt64: case svUInt64: case svFloat64:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (C_UInt64*)OutBuffer);
+		case svStrUTF8:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (UTF8String*)OutBuffer);
+		case svStrUTF16:
+			return IDX_Read(*this, DStart, DLength, &sel_ptr[0], OutSV, Cnt,
+				&rank[0], Stride, (UTF16String*)OutBuffer);
+		default:
+			throw ErrArray(ERR_READIDX_INV_SV);
+	}
+}
+
+void CdAbstractArray::ReadDataMulti(int NumSlab, const C_Int32 Start[],
+	const C_Int32 Length[], void *const OutBuffer[], C_SVType OutSV)
+{
+	if (NumSlab <= 0) return;
+	ssize_t ElmSize;
+	switch (OutSV)
+	{
+		case svInt8: case svUInt8:
+			ElmSize = 1; break;
+		case svInt16: case svUInt16:
+			ElmSize = 2; break;
+		case svInt32: case svUInt32: case svFloat32:
+			ElmSize = 4; break;
+		case svInt64: case svUInt64: case svFloat64:
+			ElmSize = 8; break;
+		case svStrUTF8:
+			ElmSize = sizeof(UTF8String); break;
+		case svStrUTF16:
+			ElmSize = sizeof(UTF16String); break;
+		default:
+			throw ErrArray(ERR_READMULTI_INV_SV);
+	}
+	if (!OutBuffer || !OutBuffer[0])
+		throw ErrArray(ERR_READMULTI_BUF);
+
+	// check hyperslabs, and determine the output buffers
+	const int DCnt = DimCnt();
+	vector<void*> Out(NumSlab);
+	vector<C_Int64> RowCnt(NumSlab);
+	C_UInt8 *p = NULL;
+	for (int i=0; i < NumSlab; i++)
+	{
+		const C_Int32 *st = Start + (size_t)i*DCnt;
+		const C_Int32 *len = Length + (size_t)i*DCnt;
+		_CheckRect(st, len);
+		C_Int64 m = 1;
+		for (int k=1; k < DCnt; k++) m *= len[k];
+		RowCnt[i] = m;
+		if (OutBuffer[i]) p = (C_UInt8*)OutBuffer[i];
+		Out[i] = p;
+		p += ElmSize * m * len[0];
+	}
+
+	// the flat positions of the last elements in compressed blocks
+	vector<C_Int64> BlockEnd;
+	CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(this);
+	if (Arr && COREARRAY_SV_NUMERIC(SVType()))
+	{
+		vector<SIZE64> RawSize, CmpSize;
+		if (Arr->GetRABlockInfo(RawSize, CmpSize))
+		{
+			const double Bits = BitOf();
+			SIZE64 Pos = 0;
+			for (size_t i=0; i < RawSize.size(); i++)
+			{
+				Pos += RawSize[i];
+				BlockEnd.push_back((C_Int64)ceil(Pos * 8.0 / Bits) - 1);
+			}
+		}
+	}
+
+	// the flat positions of the first and last elements of hyperslabs
+	TArrayDim DLen;
+	GetDim(DLen);
+	vector<C_Int64> Stride(DCnt);
+	C_Int64 TotalCnt = 1;
+	for (int k=DCnt-1; k >= 0; k--)
+		{ Stride[k] = TotalCnt; TotalCnt *= DLen[k]; }
+	vector<C_Int64> First(NumSlab), Last(NumSlab);
+	for (int i=0; i < NumSlab; i++)
+	{
+		const C_Int32 *st = Start + (size_t)i*DCnt;
+		const C_Int32 *len = Length + (size_t)i*DCnt;
+		First[i] = Last[i] = 0;
+		for (int k=0; k < DCnt; k++)
+		{
+			First[i] += st[k] * Stride[k];
+			Last[i] += (st[k] + len[k] - 1) * Stride[k];
+		}
+	}
+
+	// sort the hyperslabs
+	vector<int> ord(NumSlab);
+	for (int i=0; i < NumSlab; i++) ord[i] = i;
+	sort(ord.begin(), ord.end(), TMultiSlabLess(Start, Length, DCnt));
+
+	// merge the hyperslabs overlapping or starting in the compressed block
+	// where the previous ones end (or nearby without compression), so that
+	// each block is read and decoded only once, and read the bounding box
+	TArrayDim St, Len;
+	vector<TMultiSlab> grp;
+	for (int k=0; k < NumSlab; )
+	{
+		const int i = ord[k++];
+		const C_Int32 *st = Start + (size_t)i*DCnt;
+		const C_Int32 *len = Length + (size_t)i*DCnt;
+		if (RowCnt[i] * len[0] <= 0) continue;
+
+		memcpy(St, st, sizeof(C_Int32)*DCnt);
+		memcpy(Len, len, sizeof(C_Int32)*DCnt);
+		C_Int64 end = Last[i];
+		grp.clear();
+		grp.push_back(TMultiSlab(st, len, Out[i]));
+		for (; k < NumSlab; k++)
+		{
+			const int j = ord[k];
+			const C_Int32 *st2 = Start + (size_t)j*DCnt;
+			const C_Int32 *len2 = Length + (size_t)j*DCnt;
+			if (RowCnt[j] * len2[0] <= 0) continue;
+			bool merge = (First[j] <= end);
+			if (!merge)
+			{
+				if (BlockEnd.empty())
+				{
+					merge = (First[j] - end <= ARRAY_SEL_SEEK_GAP);
+				} else {
+					merge = (lower_bound(BlockEnd.begin(), BlockEnd.end(), end) ==
+						lower_bound(BlockEnd.begin(), BlockEnd.end(), First[j]));
+				}
+			}
+			if (!merge) break;
+
+			// the bounding box, not too large
+			TArrayDim S2, L2;
+			C_Int64 n = ElmSize;
+			for (int m=0; m < DCnt; m++)
+			{
+				S2[m] = min(St[m], st2[m]);
+				L2[m] = max(St[m] + Len[m], st2[m] + len2[m]) - S2[m];
+				n *= L2[m];
+			}
+			if (n > ARRAY_MULTI_MAX_BUFFER) break;
+			memcpy(St, S2, sizeof(C_Int32)*DCnt);
+			memcpy(Len, L2, sizeof(C_Int32)*DCnt);
+			grp.push_back(TMultiSlab(st2, len2, Out[j]));
+			if (Last[j] > end) end = Last[j];
+		}
+
+		if (grp.size() == 1)
+		{
+			ReadData(St, Len, grp[0].Out, OutSV);
+			continue;
+		}
+		switch (OutSV)
+		{
+			case svInt8: case svUInt8:
+				MULTI_Read<C_UInt8>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			case svInt16: case svUInt16:
+				MULTI_Read<C_UInt16>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			case svInt32: case svUInt32: case svFloat32:
+				MULTI_Read<C_UInt32>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			case svInt64: case svUInt64: case svFloat64:
+				MULTI_Read<C_UInt64>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			case svStrUTF8:
+				MULTI_Read<UTF8String>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			case svStrUTF16:
+				MULTI_Read<UTF16String>(*this, St, Len, DCnt, OutSV, grp);
+				break;
+			default:
+				throw ErrArray(ERR_READMULTI_INV_SV);
+		}
+	}
+}
+
 const void *CdAbstractArray::WriteData(const C_Int32 *Start,
 	const C_Int32 *Length, const void *InBuffer, C_SVType InSV)
 {
@@ -747,6 +1125,66 @@ void CdAbstractArray::IIndex(CdAbstractArray &Obj, CdIterator &I,
 }
 
 
+// =====================================================================
+// Selection scanning
+
+#if defined(COREARRAY_CC_GNU)
+#   define SEL_CTZ64(x)    __builtin_ctzll(x)
+#   define SEL_CLZ64(x)    __builtin_clzll(x)
+#endif
+
+static const C_UInt64 SEL_LOW7  = 0x7F7F7F7F7F7F7F7FULL;
+static const C_UInt64 SEL_HIGH1 = 0x8080808080808080ULL;
+
+/// the high bit of each byte is set if the byte is nonzero
+static COREARRAY_INLINE C_UInt64 sel_nonzero_bytes(const C_BOOL *p)
+{
+	C_UInt64 w;
+	memcpy(&w, p, sizeof(w));
+	return (((w & SEL_LOW7) + SEL_LOW7) | w) & SEL_HIGH1;
+}
+
+/// the index of the first byte with the high bit set in a nonzero mask
+static COREARRAY_INLINE size_t sel_first_byte(C_UInt64 mask)
+{
+#if defined(SEL_CTZ64) && defined(COREARRAY_ENDIAN_LITTLE)
+	return SEL_CTZ64(mask) >> 3;
+#elif defined(SEL_CLZ64) && defined(COREARRAY_ENDIAN_BIG)
+	return SEL_CLZ64(mask) >> 3;
+#else
+	C_UInt8 b[8];
+	memcpy(b, &mask, sizeof(b));
+	size_t i = 0;
+	while (!b[i]) i++;
+	return i;
+#endif
+}
+
+size_t CoreArray::SelSkipFalse(const C_BOOL *Sel, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		C_UInt64 m = sel_nonzero_bytes(Sel + i);
+		if (m) return i + sel_first_byte(m);
+	}
+	while ((i < n) && !Sel[i]) i++;
+	return i;
+}
+
+size_t CoreArray::SelSkipTrue(const C_BOOL *Sel, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		C_UInt64 m = ~sel_nonzero_bytes(Sel + i) & SEL_HIGH1;
+		if (m) return i + sel_first_byte(m);
+	}
+	while ((i < n) && Sel[i]) i++;
+	return i;
+}
+
+
 // fill selection, return true if it is a block
 static bool fill_selection(C_Int32 DimSize, const C_BOOL Selection[],
 	C_Int32 &OutStart, C_Int32 &OutCnt, C_Int32 &OutCntValid)
@@ -888,6 +1326,8 @@ CdAllocArray::CdAllocArray(ssize_t vElmSize): CdAbstractArray()
 	vAllocID = 0;
 	vAllocStream = NULL;
 	vAlloc_Ptr = vCnt_Ptr = 0;
+	vAllocSize = 0;
+	vCommitStamp = -1;
 	fNeedUpdate = false;
 }
 
@@ -1110,11 +1550,36 @@ void CdAllocArray::Synchronize()
 {
 	CdAbstractArray::Synchronize();
 
-	if (fGDSStream && (!fGDSStream->ReadOnly()) && fNeedUpdate)
+	if (fGDSStream && (!fGDSStream->ReadOnly()))
 	{
+		// also the data written in place without changing the size
 		if (fAllocator.BufStream())
 			fAllocator.BufStream()->FlushWrite();
-		UpdateInfo(NULL);
+		if (fNeedUpdate) UpdateInfo(NULL);
+	}
+}
+
+void CdAllocArray::Refresh()
+{
+	static const char *ERR_NOT_COMMITTED =
+		"The header of '%s' is not in the commit record.";
+
+	if (!fGDSStream || !fGDSStream->ReadOnly() || !vAllocStream) return;
+	const C_Int64 stamp = fGDSStream->CommitStamp();
+	if (stamp < 0)
+		throw ErrArray(ERR_NOT_COMMITTED, FullName().c_str());
+
+	// the header might be rewritten without extending the data, e.g., by
+	//   changing the dimensions, which is seen from its committed write stamp
+	if ((stamp != vCommitStamp) || (vAllocStream->Size() != vAllocSize))
+	{
+		// reload the dimensions and reinitialize the data stream
+		vCommitStamp = -1;
+		GDSFile()->RefreshedHeader(fGDSStream);
+		fAllocator.Free();
+		CdReader Reader(fGDSStream, &GDSFile()->Log());
+		fGDSStream->Collection().ClassMgr()->ReloadObj(Reader, *this);
+		vCommitStamp = stamp;
 	}
 }
 
@@ -1339,6 +1804,29 @@ void CdAllocArray::GetOwnBlockStream(vector<CdStream*> &Out)
 	if (vAllocStream) Out.push_back(vAllocStream);
 }
 
+bool CdAllocArray::GetRABlockInfo(vector<SIZE64> &RawSize,
+	vector<SIZE64> &CmpSize)
+{
+	CdRA_Read *s = fAllocator.BufStream() ?
+		dynamic_cast<CdRA_Read*>(fAllocator.BufStream()->Stream()) : NULL;
+	if (s)
+	{
+		s->GetBlockInfo(RawSize, CmpSize);
+		return true;
+	} else {
+		RawSize.clear(); CmpSize.clear();
+		return false;
+	}
+}
+
+bool CdAllocArray::SetRABlockInfo(const vector<SIZE64> &RawSize,
+	const vector<SIZE64> &CmpSize)
+{
+	CdRA_Read *s = fAllocator.BufStream() ?
+		dynamic_cast<CdRA_Read*>(fAllocator.BufStream()->Stream()) : NULL;
+	return s ? s->SetBlockInfo(RawSize, CmpSize) : false;
+}
+
 void CdAllocArray::_CheckRange(const C_Int32 DimI[])
 {
 	vector<TDimItem>::iterator it;
@@ -1427,6 +1915,7 @@ void CdAllocArray::Loading(CdReader &Reader, TdVersion Version)
 		fAllocator.Initialize(*vAllocStream, true, !fGDSStream->ReadOnly());
 		if (fPipeInfo)
 			fPipeInfo->PushReadPipe(*fAllocator.BufStream());
+		vAllocSize = vAllocStream->Size();
 	}
 
 	fChanged = fNeedUpdate = false;
@@ -1475,6 +1964,11 @@ void CdAllocArray::GetPipeInfo()
 
 void CdAllocArray::UpdateInfo(CdBufStream *Sender)
 {
+	// in the SWMR mode, the dimensions are written in Synchronize() right
+	//   before the commit record, to be consistent with the committed data
+	if (Sender && fGDSStream && fGDSStream->Collection().SWMR())
+		return;
+
 	if (fNeedUpdate)
 	{
 		// update pipe information
@@ -1614,6 +2108,77 @@ void CdAllocArray::_SetFlushEvent()
 C_Int64 CoreArray::ARRAY_READ_MEM_BUFFER_SIZE = 1024*1024*1024;
 
 
+// =====================================================================
+// The memory governor
+
+CdMemGovernor::CdMemGovernor()
+{
+	fLimit = fUsed = fPeak = 0;
+	fNumAcquire = fNumShrink = 0;
+}
+
+C_Int64 CdMemGovernor::Acquire(C_Int64 size)
+{
+	if (size < 0) size = 0;
+	TdAutoMutex _m(&fMutex);
+	const C_Int64 cache = CacheSize();
+	if (fLimit > 0)
+	{
+		C_Int64 n = fLimit - fUsed - cache;
+		if (size > n) size = (n > 0) ? n : 0;
+	}
+	fUsed += size;
+	if (fUsed + cache > fPeak) fPeak = fUsed + cache;
+	fNumAcquire ++;
+	return size;
+}
+
+void CdMemGovernor::Release(C_Int64 size)
+{
+	TdAutoMutex _m(&fMutex);
+	fUsed -= size;
+	if (fUsed < 0) fUsed = 0;
+}
+
+void CdMemGovernor::Shrunk(C_Int64 size)
+{
+	TdAutoMutex _m(&fMutex);
+	fUsed -= size;
+	if (fUsed < 0) fUsed = 0;
+	fNumShrink ++;
+}
+
+bool CdMemGovernor::UnderPressure()
+{
+	TdAutoMutex _m(&fMutex);
+	return (fLimit > 0) && (fUsed + CacheSize() > fLimit);
+}
+
+C_Int64 CdMemGovernor::CacheSize() const
+{
+	return CdBlockCache::MappedSize();
+}
+
+void CdMemGovernor::SetLimit(C_Int64 limit)
+{
+	TdAutoMutex _m(&fMutex);
+	fLimit = (limit > 0) ? limit : 0;
+}
+
+void CdMemGovernor::ResetStat()
+{
+	TdAutoMutex _m(&fMutex);
+	fPeak = fUsed + CacheSize();
+	fNumAcquire = fNumShrink = 0;
+}
+
+CdMemGovernor &CoreArray::MemGovernor()
+{
+	static CdMemGovernor Governor;
+	return Governor;
+}
+
+
 // read an array-oriented object margin by margin
 
 CdArrayRead::CdArrayRead()
@@ -1630,14 +2195,31 @@ CdArrayRead::CdArrayRead()
 	_Have_Selection = false;
 	_Call_rData = _Margin_Call_rData = true;
 	_Margin_Buf_Need = false;
+	_Prefetch = false;
+	_Prefetch_File = NULL;
+	_Prefetch_Obj = NULL;
+	_Prefetch_Job = NULL;
+	_Prefetch_Buffer_Ptr = NULL;
+	_Prefetch_Start = _Prefetch_DCount = _Prefetch_Cnt = 0;
+	_Margin_Buffer_Ptr = NULL;
+	_Mem_Size = 0;
 }
 
 CdArrayRead::~CdArrayRead()
-{ }
+{
+	try {
+		_WaitPrefetch();
+	} catch (...) { }
+	_ReleaseBuffer();
+}
 		
 void CdArrayRead::Init(CdAbstractArray &vObj, int vMargin, C_SVType vSVType,
 	const C_BOOL *const vSelection[], bool buf_if_need)
 {
+	// stop reading in background
+	_WaitPrefetch();
+	_ReleaseBuffer();
+
 	// set object
 	fObject = &vObj;
 
@@ -1740,6 +2322,7 @@ void CdArrayRead::Init(CdAbstractArray &vObj, int vMargin, C_SVType vSVType,
 
 
 	// make a margin buffer
+	_Margin_Buf_IncCnt = 1;
 	if (vMargin > 0)
 	{
 		_Margin_Buf_Cnt = 0;
@@ -1752,54 +2335,27 @@ void CdArrayRead::Init(CdAbstractArray &vObj, int vMargin, C_SVType vSVType,
 		for (int i=vMargin+1; i < DCnt; i++)
 			_Margin_Buf_MinorSize *= _DCntValid[i];
 
-		// determine buffer
-		if (buf_if_need)
-		{
-			// need a memory buffer to speed up
-			_Margin_Buf_IncCnt = ARRAY_READ_MEM_BUFFER_SIZE /
-				(fElmSize * fMarginCount);
+		// need a memory buffer to speed up
+		if (buf_if_need && (fCount > 0))
+			AllocBuffer(-1);
+	}
+}
 
-			if (_Margin_Buf_IncCnt > 1)
-			{
-				if (_Margin_Buf_IncCnt > fCount)
-					_Margin_Buf_IncCnt = fCount;
-				switch (fSVType)
-				{
-				case svStrUTF8:      // UTF-8 string
-					_Margin_Buffer_UTF8.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF8[0];
-					break;
-				case svStrUTF16:     // UTF-16 string
-					_Margin_Buffer_UTF16.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF16[0];
-					break;
-				default:
-					_Margin_Buffer.resize(
-						fElmSize * _Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer[0];
-				}
-			} else {
-				_Margin_Buf_IncCnt = 1;
-				_Margin_Buffer.clear();
-				_Margin_Buffer_UTF8.clear();
-				_Margin_Buffer_UTF16.clear();
-				_Margin_Buffer_Ptr = NULL;
-			}
-		} else {
-			_Margin_Buf_IncCnt = 1;
-			_Margin_Buffer.clear();
-			_Margin_Buffer_UTF8.clear();
-			_Margin_Buffer_UTF16.clear();
-			_Margin_Buffer_Ptr = NULL;
-		}
-	} else {
-		_Margin_Buf_IncCnt = 1;
-		_Margin_Buffer.clear();
-		_Margin_Buffer_UTF8.clear();
-		_Margin_Buffer_UTF16.clear();
-		_Margin_Buffer_Ptr = NULL;
+static void *alloc_margin_buffer(C_SVType sv, ssize_t elm_size, C_Int64 n,
+	vector<C_UInt8> &buf, vector<UTF8String> &buf_utf8,
+	vector<UTF16String> &buf_utf16)
+{
+	switch (sv)
+	{
+		case svStrUTF8:      // UTF-8 string
+			buf_utf8.resize(n);
+			return &buf_utf8[0];
+		case svStrUTF16:     // UTF-16 string
+			buf_utf16.resize(n);
+			return &buf_utf16[0];
+		default:
+			buf.resize(elm_size * n);
+			return &buf[0];
 	}
 }
 
@@ -1810,48 +2366,262 @@ void CdArrayRead::AllocBuffer(C_Int64 buffer_size)
 		throw ErrArray("call CdArrayRead::Init first.");
 	}
 
-	if (fMargin > 0)
+	_WaitPrefetch();
+	_ReleaseBuffer();
+
+	if ((fMargin > 0) && (fMarginCount > 0))
 	{
 		if (buffer_size < 0)
 			buffer_size = ARRAY_READ_MEM_BUFFER_SIZE;
 
-		// need a memory buffer to speed up
-		_Margin_Buf_IncCnt = buffer_size / (fElmSize * fMarginCount);
+		// the size granted by the memory governor
+		C_Int64 size = MemGovernor().Acquire(buffer_size);
+		C_Int64 margin_size = fElmSize * fMarginCount;
+		// two buffers share the memory if prefetching
+		_Margin_Buf_IncCnt = (_Prefetch ? size/2 : size) / margin_size;
 
 		if (_Margin_Buf_IncCnt > 1)
 		{
 			if (_Margin_Buf_IncCnt > fCount)
 				_Margin_Buf_IncCnt = fCount;
-			switch (fSVType)
+			_Margin_Buffer_Ptr = alloc_margin_buffer(fSVType, fElmSize,
+				_Margin_Buf_IncCnt * fMarginCount, _Margin_Buffer,
+				_Margin_Buffer_UTF8, _Margin_Buffer_UTF16);
+			_Mem_Size = _Margin_Buf_IncCnt * margin_size;
+			// no need to prefetch if all data are in one buffer
+			if (_Prefetch && (_Margin_Buf_IncCnt < fCount) &&
+				_OpenPrefetch())
 			{
-				case svStrUTF8:      // UTF-8 string
-					_Margin_Buffer_UTF8.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF8[0];
-					break;
-				case svStrUTF16:     // UTF-16 string
-					_Margin_Buffer_UTF16.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF16[0];
-					break;
-				default:
-					_Margin_Buffer.resize(
-						fElmSize * _Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer[0];
+				_Prefetch_Buffer_Ptr = alloc_margin_buffer(fSVType, fElmSize,
+					_Margin_Buf_IncCnt * fMarginCount, _Prefetch_Buffer,
+					_Prefetch_Buffer_UTF8, _Prefetch_Buffer_UTF16);
+				_Mem_Size *= 2;
 			}
-		} else {
+		} else
 			_Margin_Buf_IncCnt = 1;
-			_Margin_Buffer.clear();
-			_Margin_Buffer_UTF8.clear();
-			_Margin_Buffer_UTF16.clear();
-			_Margin_Buffer_Ptr = NULL;
+
+		// move the pages to the NUMA node of the calling thread
+		if (!_Margin_Buffer.empty() && Parallel::ThreadPool().NumaPlacement())
+		{
+			int node = Mach::GetNUMA_CurrentNode();
+			if (node >= 0)
+			{
+				Mach::SetNUMA_MemoryNode(&_Margin_Buffer[0],
+					_Margin_Buffer.size(), node);
+			}
 		}
-	} else {
+
+		// return the unused memory
+		MemGovernor().Release(size - _Mem_Size);
+	} else
 		_Margin_Buf_IncCnt = 1;
-		_Margin_Buffer.clear();
-		_Margin_Buffer_UTF8.clear();
-		_Margin_Buffer_UTF16.clear();
+}
+
+void CdArrayRead::_ReleaseBuffer()
+{
+	vector<C_UInt8>().swap(_Margin_Buffer);
+	vector<UTF8String>().swap(_Margin_Buffer_UTF8);
+	vector<UTF16String>().swap(_Margin_Buffer_UTF16);
+	_Margin_Buffer_Ptr = NULL;
+	_ClearPrefetch();
+	if (_Mem_Size > 0)
+	{
+		MemGovernor().Release(_Mem_Size);
+		_Mem_Size = 0;
+	}
+}
+
+void CdArrayRead::_ShrinkBuffer()
+{
+	if (_Prefetch_Buffer_Ptr)
+	{
+		// stop prefetching first
+		C_Int64 n = _Margin_Buf_IncCnt * fMarginCount * fElmSize;
+		_ClearPrefetch();
+		_Mem_Size -= n;
+		MemGovernor().Shrunk(n);
+	} else if (_Margin_Buffer_Ptr)
+	{
+		// half the block size, or no buffer
+		C_Int32 IncCnt = _Margin_Buf_IncCnt / 2;
+		if (IncCnt <= 1) IncCnt = 1;
+		C_Int64 n = (_Margin_Buf_IncCnt - IncCnt) * fMarginCount * fElmSize;
+		vector<C_UInt8>().swap(_Margin_Buffer);
+		vector<UTF8String>().swap(_Margin_Buffer_UTF8);
+		vector<UTF16String>().swap(_Margin_Buffer_UTF16);
 		_Margin_Buffer_Ptr = NULL;
+		_Margin_Buf_IncCnt = IncCnt;
+		if (IncCnt > 1)
+		{
+			_Margin_Buffer_Ptr = alloc_margin_buffer(fSVType, fElmSize,
+				IncCnt * fMarginCount, _Margin_Buffer,
+				_Margin_Buffer_UTF8, _Margin_Buffer_UTF16);
+		}
+		_Mem_Size -= n;
+		MemGovernor().Shrunk(n);
+	}
+}
+
+void CdArrayRead::SetPrefetch(bool prefetch)
+{
+	_WaitPrefetch();
+	if (_Prefetch_Buffer_Ptr)
+	{
+		_Mem_Size -= _Margin_Buf_IncCnt * fMarginCount * fElmSize;
+		MemGovernor().Release(_Margin_Buf_IncCnt * fMarginCount * fElmSize);
+		_ClearPrefetch();
+	}
+	_Prefetch = prefetch;
+}
+
+C_Int32 CdArrayRead::_CountBuffer(C_Int32 Start, C_Int32 &DCount)
+{
+	C_Int32 rv;
+	if (_Have_Selection)
+	{
+		rv = 0;
+		// count by selected runs
+		const C_BOOL *s = &_sel_array[fMargin][0];
+		C_Int32 k = Start, Cnt = _Margin_Buf_IncCnt;
+		while ((k < _MarginEnd) && (Cnt > 0))
+		{
+			C_Int32 m = SelSkipTrue(s + (k - _MarginStart), _MarginEnd - k);
+			if (m > Cnt) m = Cnt;
+			k += m; Cnt -= m;
+			rv += m;
+			if ((Cnt > 0) && (k < _MarginEnd))
+				k += SelSkipFalse(s + (k - _MarginStart), _MarginEnd - k);
+		}
+		DCount = k - Start;
+	} else {
+		C_Int32 I = Start + _Margin_Buf_IncCnt;
+		if (I > _MarginEnd) I = _MarginEnd;
+		rv = DCount = I - Start;
+	}
+	return rv;
+}
+
+void CdArrayRead::_ReadBuffer(CdAbstractArray *Obj, C_Int32 Start,
+	C_Int32 DCount, void *Buffer, bool CallRData)
+{
+	// local copies, since it may be called in a background thread
+	CdAbstractArray::TArrayDim DStart, DCnt;
+	const C_BOOL *Sel[CdAbstractArray::MAX_ARRAY_DIM];
+	const int DimCnt = Obj->DimCnt();
+	for (int i=0; i < DimCnt; i++)
+	{
+		if (i != fMargin)
+		{
+			DStart[i] = _DStart[i]; DCnt[i] = _DCount[i];
+			Sel[i] = _Selection[i];
+		}
+	}
+	DStart[fMargin] = Start;
+	DCnt[fMargin] = DCount;
+
+	if (CallRData)
+	{
+		Obj->ReadData(DStart, DCnt, Buffer, fSVType);
+	} else {
+		// call reading with a selection
+		Sel[fMargin] = &(_sel_array[fMargin][Start - _MarginStart]);
+		Obj->ReadDataEx(DStart, DCnt, Sel, Buffer, fSVType);
+	}
+}
+
+bool CdArrayRead::_OpenPrefetch()
+{
+	if (_Prefetch_Obj) return true;
+	// not for virtual arrays, which read the linked files shared by handles
+	CdGDSFile *f = fObject->GDSFile();
+	CdAllocArray *a = dynamic_cast<CdAllocArray*>(fObject);
+	if (!f || f->FileName().empty() || !fObject->GDSStream() || !a)
+		return false;
+	// not for a compressed array being written
+	CdBufStream *buf = a->Allocator().BufStream();
+	if (a->PipeInfo() && buf && a->PipeInfo()->WriteMode(*buf))
+		return false;
+
+	// the block streams and their positions are not shared with the
+	//   calling thread, which may read other objects of the same file
+	if (!f->ReadOnly()) f->SyncFile();
+	CdGDSFile *F = new CdGDSFile;
+	CdAbstractArray *p = NULL;
+	try {
+		F->LoadFile(f->FileName(), true);
+		p = dynamic_cast<CdAbstractArray*>(
+			F->Root().PathEx(fObject->FullName()));
+		// the same object with all data written
+		if (p && (!p->GDSStream() ||
+			(p->GDSStream()->ID() != fObject->GDSStream()->ID()) ||
+			(p->SVType() != fObject->SVType()) ||
+			(p->DimCnt() != fObject->DimCnt()) ||
+			(p->TotalCount() != fObject->TotalCount())))
+		{
+			p = NULL;
+		}
+	}
+	catch (exception &) {
+		p = NULL;
+	}
+	if (!p)
+	{
+		delete F;
+		return false;
+	}
+
+	// share the block indices instead of scanning them again
+	CdAllocArray *b = dynamic_cast<CdAllocArray*>(p);
+	vector<SIZE64> RawSize, CmpSize;
+	if (a && b && a->GetRABlockInfo(RawSize, CmpSize))
+		b->SetRABlockInfo(RawSize, CmpSize);
+
+	_Prefetch_File = F;
+	_Prefetch_Obj = p;
+	return true;
+}
+
+void CdArrayRead::_PrefetchProc(CdThread *Thread, int Index, void *Param)
+{
+	CdArrayRead *Obj = (CdArrayRead*)Param;
+	Obj->_ReadBuffer(Obj->_Prefetch_Obj, Obj->_Prefetch_Start,
+		Obj->_Prefetch_DCount, Obj->_Prefetch_Buffer_Ptr,
+		Obj->_Margin_Call_rData);
+}
+
+void CdArrayRead::_StartPrefetch(C_Int32 Start)
+{
+	_Prefetch_Start = Start;
+	_Prefetch_Cnt = _CountBuffer(Start, _Prefetch_DCount);
+	_Prefetch_Job = Parallel::ThreadPool().Start(_PrefetchProc, this);
+}
+
+void CdArrayRead::_WaitPrefetch()
+{
+	if (_Prefetch_Job)
+	{
+		Parallel::CdThreadPool::TJob *job = _Prefetch_Job;
+		_Prefetch_Job = NULL;
+		try {
+			Parallel::ThreadPool().Wait(job);
+		}
+		catch (exception &E) {
+			throw ErrArray(E.what());
+		}
+	}
+}
+
+void CdArrayRead::_ClearPrefetch()
+{
+	vector<C_UInt8>().swap(_Prefetch_Buffer);
+	vector<UTF8String>().swap(_Prefetch_Buffer_UTF8);
+	vector<UTF16String>().swap(_Prefetch_Buffer_UTF16);
+	_Prefetch_Buffer_Ptr = NULL;
+	if (_Prefetch_File)
+	{
+		delete _Prefetch_File;
+		_Prefetch_File = NULL;
+		_Prefetch_Obj = NULL;
 	}
 }
 
@@ -1878,82 +2648,77 @@ void CdArrayRead::Read(void *Buffer)
 			// next ``Index'', ``MarginIndex''
 			fIndex ++;
 			fMarginIndex ++;
-			if (_Have_Selection)
+			if (_Have_Selection && (fMarginIndex < _MarginEnd))
 			{
 				// skip unselected layout
-				while ((fMarginIndex < _MarginEnd) &&
-					!_sel_array[0][fMarginIndex - _MarginStart])
-				{
-					fMarginIndex ++;
-				}
+				fMarginIndex += SelSkipFalse(
+					&_sel_array[0][fMarginIndex - _MarginStart],
+					_MarginEnd - fMarginIndex);
 			}
 		} else {
 
 			// determine buffer size
 			if (_Margin_Buf_Cnt <= 0)
 			{
-				// determine '_Margin_Buf_Cnt' first
-				if (_Margin_Buf_IncCnt > 1)
+				if (_Prefetch_Job)
 				{
-					if (_Have_Selection)
-					{
-						_DCount[fMargin] = 0;
-						_Margin_Buf_Cnt = 0;
-
-						C_Int32 Cnt = _Margin_Buf_IncCnt;
-						for (C_Int32 k=fMarginIndex; (k < _MarginEnd) && (Cnt > 0); k++)
-						{
-							_DCount[fMargin] ++;
-							if (_Selection[fMargin][k - _MarginStart])
-							{
-								_Margin_Buf_Cnt ++;
-								Cnt --;
-							}
-						}
-					} else {
-						C_Int32 I = fMarginIndex + _Margin_Buf_IncCnt;
-						if (I > _MarginEnd) I = _MarginEnd;
-						_Margin_Buf_Cnt = I - fMarginIndex;
-						_DCount[fMargin] = _Margin_Buf_Cnt;
-					}
+					// the block has been read in background
+					_WaitPrefetch();
+					std::swap(_Margin_Buffer, _Prefetch_Buffer);
+					std::swap(_Margin_Buffer_UTF8, _Prefetch_Buffer_UTF8);
+					std::swap(_Margin_Buffer_UTF16, _Prefetch_Buffer_UTF16);
+					std::swap(_Margin_Buffer_Ptr, _Prefetch_Buffer_Ptr);
+					_Margin_Buf_Cnt = _Prefetch_Cnt;
+					_DCount[fMargin] = _Prefetch_DCount;
+					_Margin_Buf_Need = true;
+					// stop prefetching if too much memory in use
+					if (MemGovernor().UnderPressure())
+						_ShrinkBuffer();
 				} else {
-					_Margin_Buf_Cnt = 1;
-				}
-
-				// read sub data to margin buffer
-				_Margin_Buf_Need = (_Margin_Buf_Cnt > 1);
-				_DStart[fMargin] = fMarginIndex;
-
-				if (_Margin_Buf_Need)
-				{
-					if (_Margin_Call_rData)
+					// release memory if too much in use
+					if ((_Mem_Size > 0) && MemGovernor().UnderPressure())
+						_ShrinkBuffer();
+					// determine '_Margin_Buf_Cnt' first
+					if (_Margin_Buf_IncCnt > 1)
 					{
-						fObject->ReadData(_DStart, _DCount, _Margin_Buffer_Ptr,
-							fSVType);
+						_Margin_Buf_Cnt = _CountBuffer(fMarginIndex,
+							_DCount[fMargin]);
 					} else {
-						// call reading with a selection
-						_Selection[fMargin] =
-							&(_sel_array[fMargin][fMarginIndex - _MarginStart]);
-						fObject->ReadDataEx(_DStart, _DCount, _Selection,
-							_Margin_Buffer_Ptr, fSVType);
+						_Margin_Buf_Cnt = 1;
+						_DCount[fMargin] = 1;
 					}
-				} else {
-					if (_Call_rData)
+
+					// read sub data to margin buffer
+					_Margin_Buf_Need = (_Margin_Buf_Cnt > 1);
+					if (_Margin_Buf_Need)
 					{
-						fObject->ReadData(_DStart, _DCount, Buffer, fSVType);
+						_ReadBuffer(fObject, fMarginIndex, _DCount[fMargin],
+							_Margin_Buffer_Ptr, _Margin_Call_rData);
 					} else {
-						// call reading with a selection
-						_Selection[fMargin] =
-							&(_sel_array[fMargin][fMarginIndex - _MarginStart]);
-						fObject->ReadDataEx(_DStart, _DCount, _Selection,
-							Buffer, fSVType);
+						_ReadBuffer(fObject, fMarginIndex, _DCount[fMargin],
+							Buffer, _Call_rData);
 					}
 				}
+				_DStart[fMargin] = fMarginIndex;
 
 				if (_Margin_Buf_Need)
 				{
 					_Margin_Buf_MinorSize2 =
 						_Margin_Buf_MinorSize * _Margin_Buf_Cnt;
+
+					// read the next block in background
+					if (_Prefetch_Buffer_Ptr)
+					{
+						C_Int32 I = fMarginIndex + _DCount[fMargin];
+						if (_Have_Selection && (I < _MarginEnd))
+						{
+							I += SelSkipFalse(
+								&_sel_array[fMargin][I - _MarginStart],
+								_MarginEnd - I);
+						}
+						if (I < _MarginEnd)
+							_StartPrefetch(I);
+					}
 				}
 
 				_Margin_Buf_Old_Index = fIndex;
@@ -2014,14 +2779,12 @@ void CdArrayRead::Read(void *Buffer)
 			// next ``Index'', ``MarginIndex''
 			fIndex ++;
 			fMarginIndex ++;
-			if (_Have_Selection)
+			if (_Have_Selection && (fMarginIndex < _MarginEnd))
 			{
 				// skip unselected layout
-				while ((fMarginIndex < _MarginEnd) &&
-					!_sel_array[fMargin][fMarginIndex - _MarginStart])
-				{
-					fMarginIndex ++;
-				}
+				fMarginIndex += SelSkipFalse(
+					&_sel_array[fMargin][fMarginIndex - _MarginStart],
+					_MarginEnd - fMarginIndex);
 			}
 		}
 	} else {
@@ -2087,3 +2850,320 @@ void CoreArray::Balance_ArrayRead_Buffer(CdArrayRead array[], int n,
 		list[i] = &array[i];
 	Balance_ArrayRead_Buffer(&list[0], n, buffer_size);
 }
+
+void CoreArray::Split_ArrayRead_Margin(CdAbstractArray &Obj, int Margin,
+	const C_BOOL *Selection, int n, vector<C_Int32> &Split)
+{
+	CdAbstractArray::TArrayDim DLen;
+	Obj.GetDim(DLen);
+	const C_Int32 L = DLen[Margin];
+
+	// the cumulative number of selected margins
+	vector<C_Int32> Cum(L + 1);
+	Cum[0] = 0;
+	for (C_Int32 i=0; i < L; i++)
+		Cum[i+1] = Cum[i] + ((!Selection || Selection[i]) ? 1 : 0);
+	const C_Int32 Total = Cum[L];
+	if (n > Total) n = Total;
+
+	// the margins starting at or after the boundaries of blocks
+	vector<C_Int32> BlockStart;
+	CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(&Obj);
+	if ((Margin == 0) && Arr && COREARRAY_SV_NUMERIC(Obj.SVType()))
+	{
+		vector<SIZE64> RawSize, CmpSize;
+		if (Arr->GetRABlockInfo(RawSize, CmpSize))
+		{
+			double MarginBits = Obj.BitOf();
+			for (int i=1; i < Obj.DimCnt(); i++) MarginBits *= DLen[i];
+			SIZE64 Pos = 0;
+			for (size_t i=0; i+1 < RawSize.size(); i++)
+			{
+				Pos += RawSize[i];
+				double m = ceil(Pos * 8.0 / MarginBits);
+				if ((m > 0) && (m < L))
+				{
+					if (BlockStart.empty() || (BlockStart.back() < m))
+						BlockStart.push_back((C_Int32)m);
+				}
+			}
+		}
+	}
+
+	Split.clear();
+	Split.push_back(0);
+	for (int k=1; k < n; k++)
+	{
+		// the position of the (k*Total/n)-th selected margin
+		C_Int32 target = (C_Int32)((C_Int64)k * Total / n);
+		C_Int32 p = lower_bound(Cum.begin(), Cum.end(), target + 1) -
+			Cum.begin() - 1;
+		// move to the nearest boundary of blocks
+		if (!BlockStart.empty())
+		{
+			vector<C_Int32>::iterator it =
+				lower_bound(BlockStart.begin(), BlockStart.end(), p);
+			C_Int32 q = (it != BlockStart.end()) ? *it : L;
+			if (it != BlockStart.begin())
+			{
+				C_Int32 q0 = *(it - 1);
+				if ((p - q0) <= (q - p)) q = q0;
+			}
+			p = q;
+		}
+		// each range has at least one selected margin
+		if ((p < L) && (Cum[p] > Cum[Split.back()]) && (Cum[p] < Total))
+			Split.push_back(p);
+	}
+	Split.push_back(L);
+}
+
+
+
+// =====================================================================
+// Pipeline of reading, transforming and appending margins
+// =====================================================================
+
+CdArrayPipeline::CdArrayPipeline(int QueueSize)
+{
+	fQSize = (QueueSize > 0) ? QueueSize : 1;
+	fNumRead = fNumTrans = fNumWritten = 0;
+	fAbort = false;
+	fRead = NULL;
+	fTarget = NULL;
+	memset((void*)&fInfo, 0, sizeof(fInfo));
+	fTransform = NULL;
+	fParam = NULL;
+}
+
+CdArrayPipeline::~CdArrayPipeline()
+{ }
+
+/// the storage type used in the buffers
+static C_SVType PipelineSVType(C_SVType sv)
+{
+	if (COREARRAY_SV_VALID(sv))
+		return (sv == svStrUTF16) ? svStrUTF8 : sv;
+	switch (sv)
+	{
+		case svCustomInt:   return svInt64;
+		case svCustomUInt:  return svUInt64;
+		case svCustomFloat: return svFloat64;
+		case svCustomStr:   return svStrUTF8;
+		default:
+			throw ErrArray("CdArrayPipeline: invalid data type.");
+	}
+}
+
+C_Int64 CdArrayPipeline::Run(CdAbstractArray &Source, int Margin,
+	const C_BOOL *const Selection[], CdAbstractArray &Target,
+	TdTransform Transform, void *Param)
+{
+	const C_SVType SV = PipelineSVType(Source.SVType());
+	CdAbstractArray *Src = &Source;
+	bool serial = false;
+
+	// the source and target in the same file, read with another file handle
+	CdGDSFile *f = Source.GDSFile();
+	if (f && (f == Target.GDSFile()))
+	{
+		serial = true;
+		if (!f->FileName().empty())
+		{
+			f->SyncFile();
+			Src = dynamic_cast<CdAbstractArray*>(f->ReadOnlyObj(Source));
+			if (Src && (Src->DimCnt() == Source.DimCnt()) &&
+				(Src->TotalCount() == Source.TotalCount()) &&
+				(Src->SVType() == Source.SVType()))
+			{
+				// share the block indices instead of scanning them again
+				CdAllocArray *p = dynamic_cast<CdAllocArray*>(&Source);
+				CdAllocArray *q = dynamic_cast<CdAllocArray*>(Src);
+				vector<SIZE64> RawSize, CmpSize;
+				if (p && q && p->GetRABlockInfo(RawSize, CmpSize))
+					q->SetRABlockInfo(RawSize, CmpSize);
+				serial = false;
+			} else
+				Src = &Source;
+		}
+	}
+
+	C_Int64 rv = 0;
+	try {
+		CdArrayRead Read;
+		Read.Init(*Src, Margin, SV, Selection, false);
+		if (Read.Count() > 0) Read.AllocBuffer(-1);
+
+		fRead = &Read;
+		fTarget = &Target;
+		fInfo.Index = -1;
+		fInfo.Count = Read.MarginCount();
+		fInfo.ElmSize = Read.ElmSize();
+		fInfo.SVType = SV;
+		fInfo.DimCnt = Src->DimCnt();
+		fInfo.Margin = Margin;
+		fInfo.DimLen = Read.DimCntValid();
+		fTransform = Transform;
+		fParam = Param;
+		fNumRead = fNumTrans = fNumWritten = 0;
+		fAbort = false;
+		fErrMsg.clear();
+		fSlot.clear();
+		fSlot.resize(serial ? 1 : fQSize);
+
+		if (fInfo.Count <= 0)
+			fNumWritten = Read.Count();  // nothing to append
+		else if (serial || (Read.Count() <= 1))
+			_DoSerial();
+		else
+			Parallel::ThreadPool().Run(_Proc, this, 3);
+
+		fSlot.clear();
+		fRead = NULL;
+		fTarget = NULL;
+		rv = fNumWritten;
+	} catch (...) {
+		fSlot.clear();
+		fRead = NULL;
+		fTarget = NULL;
+		throw;
+	}
+
+	if (fAbort)
+		throw ErrArray("%s", fErrMsg.c_str());
+	return rv;
+}
+
+void CdArrayPipeline::_Proc(CdThread *Thread, int Index, void *Param)
+{
+	CdArrayPipeline *P = (CdArrayPipeline*)Param;
+	try {
+		switch (Index)
+		{
+			case 0:  P->_DoTransform(); break;
+			case 1:  P->_DoRead(); break;
+			default: P->_DoWrite();
+		}
+	} catch (std::exception &E) {
+		P->_SetError(E.what());
+	} catch (...) {
+		P->_SetError("CdArrayPipeline: unknown error.");
+	}
+}
+
+void *CdArrayPipeline::_InBuf(TSlot &S)
+{
+	if (fInfo.SVType == svStrUTF8)
+	{
+		S.InStr.resize(fInfo.Count);
+		return &S.InStr[0];
+	} else {
+		S.In.resize(fInfo.Count * fInfo.ElmSize);
+		return &S.In[0];
+	}
+}
+
+void *CdArrayPipeline::_OutBuf(TSlot &S)
+{
+	if (!fTransform) return _InBuf(S);
+	if (fInfo.SVType == svStrUTF8)
+	{
+		S.OutStr.resize(fInfo.Count);
+		return &S.OutStr[0];
+	} else {
+		S.Out.resize(fInfo.Count * fInfo.ElmSize);
+		return &S.Out[0];
+	}
+}
+
+void CdArrayPipeline::_ReadSlot(TSlot &S)
+{
+	S.Index = fRead->MarginIndex();
+	fRead->Read(_InBuf(S));
+}
+
+bool CdArrayPipeline::_Wait(const C_Int64 &Counter, C_Int64 Need)
+{
+	TdAutoMutex _m(&fMutex);
+	while (!fAbort && (Counter < Need))
+		fCond.Wait(fMutex);
+	return !fAbort;
+}
+
+void CdArrayPipeline::_Finish(C_Int64 &Counter, C_Int64 Value)
+{
+	TdAutoMutex _m(&fMutex);
+	Counter = Value;
+	fCond.Broadcast();
+}
+
+void CdArrayPipeline::_SetError(const char *msg)
+{
+	TdAutoMutex _m(&fMutex);
+	if (!fAbort)
+	{
+		fAbort = true;
+		fErrMsg = msg;
+	}
+	fCond.Broadcast();
+}
+
+void CdArrayPipeline::_DoRead()
+{
+	const C_Int64 n = fRead->Count();
+	for (C_Int64 k=0; k < n; k++)
+	{
+		// wait until the slot has been appended
+		if (!_Wait(fNumWritten, k - fQSize + 1)) return;
+		_ReadSlot(fSlot[k % fQSize]);
+		_Finish(fNumRead, k + 1);
+	}
+}
+
+void CdArrayPipeline::_DoTransform()
+{
+	const C_Int64 n = fRead->Count();
+	for (C_Int64 k=0; k < n; k++)
+	{
+		if (!_Wait(fNumRead, k + 1)) return;
+		if (fTransform)
+		{
+			TSlot &S = fSlot[k % fQSize];
+			TMargin M = fInfo;
+			M.Index = S.Index;
+			(*fTransform)(_InBuf(S), _OutBuf(S), M, fParam);
+		}
+		_Finish(fNumTrans, k + 1);
+	}
+}
+
+void CdArrayPipeline::_DoWrite()
+{
+	const C_Int64 n = fRead->Count();
+	for (C_Int64 k=0; k < n; k++)
+	{
+		if (!_Wait(fNumTrans, k + 1)) return;
+		fTarget->Append(_OutBuf(fSlot[k % fQSize]), fInfo.Count,
+			fInfo.SVType);
+		_Finish(fNumWritten, k + 1);
+	}
+}
+
+void CdArrayPipeline::_DoSerial()
+{
+	const C_Int64 n = fRead->Count();
+	TSlot &S = fSlot[0];
+	for (C_Int64 k=0; k < n; k++)
+	{
+		_ReadSlot(S);
+		void *p = _OutBuf(S);
+		if (fTransform)
+		{
+			TMargin M = fInfo;
+			M.Index = S.Index;
+			(*fTransform)(_InBuf(S), p, M, fParam);
+		}
+		fTarget->Append(p, fInfo.Count, fInfo.SVType);
+		fNumRead = fNumTrans = fNumWritten = k + 1;
+	}
+}
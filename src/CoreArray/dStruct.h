@@ -39,6 +39,7 @@
 
 #include "dFile.h"
 #include "dAllocator.h"
+#include "dParallel.h"
 
 
 namespace CoreArray
@@ -237,6 +238,35 @@ namespace CoreArray
 		virtual void *ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
 			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
 
+		/// read array-oriented data from integer indices
+		/** The indices could be in any order with duplicates, the elements are
+		 *  read in sorted runs only once and then scattered to the output order
+		 *  \param Index       the zero-based indices of each dimension, it could
+		 *                     be NULL, or Index[i] = NULL for the whole dimension
+		 *  \param IdxCnt      the number of indices of each dimension
+		 *  \param OutBuffer   the pointer to the output buffer
+		 *  \param OutSV       data type of output buffer
+		**/
+		void *ReadDataIdx(const C_Int32 *const Index[], const C_Int32 IdxCnt[],
+			void *OutBuffer, C_SVType OutSV);
+
+		/// read multiple hyperslabs of array-oriented data
+		/** The hyperslabs are sorted, and the ones overlapping or starting in
+		 *  the compressed block where the previous ones end (or nearby without
+		 *  compression) are merged and read in their bounding box, so that
+		 *  each compressed block is decoded only once
+		 *  \param NumSlab     the number of hyperslabs
+		 *  \param Start       the starting positions (from ZERO) of hyperslabs,
+		 *                     NumSlab*DimCnt() integers
+		 *  \param Length      the lengths of hyperslabs, NumSlab*DimCnt() integers
+		 *  \param OutBuffer   the output buffers of hyperslabs, OutBuffer[0]
+		 *                     should not be NULL, and OutBuffer[i] = NULL to
+		 *                     follow the data of the previous hyperslab
+		 *  \param OutSV       data type of output buffers
+		**/
+		void ReadDataMulti(int NumSlab, const C_Int32 Start[],
+			const C_Int32 Length[], void *const OutBuffer[], C_SVType OutSV);
+
 		/// write array-oriented data
 		/** \param Start       the starting positions (from ZERO), it could be NULL
 		 *  \param Length      the lengths of each dimension, it could be NULL
@@ -293,6 +323,21 @@ namespace CoreArray
 
 
 
+	/// return the number of leading unselected elements (at most n)
+	COREARRAY_DLL_DEFAULT size_t SelSkipFalse(const C_BOOL *Sel, size_t n);
+	/// return the number of leading selected elements (at most n)
+	COREARRAY_DLL_DEFAULT size_t SelSkipTrue(const C_BOOL *Sel, size_t n);
+
+	/// The minimum number of unselected elements to seek over
+	/** A shorter gap is read through with the neighboring runs, while a longer
+	 *  gap leads to seeking, e.g., the compressed blocks in the gap are skipped
+	**/
+	const ssize_t ARRAY_SEL_SEEK_GAP = 64;
+
+	/// The maximum bytes of the bounding box of merged hyperslabs
+	const C_Int64 ARRAY_MULTI_MAX_BUFFER = 64*1024*1024;
+
+
 	template<typename TYPE, typename TARRAY, typename F_ITER, typename F_PROC>
 	COREARRAY_DLL_DEFAULT
 	TYPE *ArrayRIterRect(const C_Int32 *Start, const C_Int32 *Length,
@@ -354,15 +399,34 @@ namespace CoreArray
 			{
 				if (ForI >= ForEnd)
 				{
-					SetI(Obj, I, DFor);
-					Buffer = Proc(I, Buffer, Cnt, Selection);
+					// read the selected runs, and seek over long unselected gaps
+					const C_Int32 St = *ForP;
+					ssize_t k = SelSkipFalse(Selection, Cnt);
+					while (k < Cnt)
+					{
+						ssize_t e = k + SelSkipTrue(Selection + k, Cnt - k);
+						ssize_t g = SelSkipFalse(Selection + e, Cnt - e);
+						while ((e + g < Cnt) && (g < ARRAY_SEL_SEEK_GAP))
+						{
+							e += g;
+							e += SelSkipTrue(Selection + e, Cnt - e);
+							g = SelSkipFalse(Selection + e, Cnt - e);
+						}
+						*ForP = St + k;
+						SetI(Obj, I, DFor);
+						Buffer = Proc(I, Buffer, e - k, Selection + k);
+						k = e + g;
+					}
+					*ForP = St;
 				} else if (Sel[ForI][*ForP - *Start])
 				{
 					++ForI; *(++ForP) = *(++Start);
 					*(++ForLenP) = *(++Length);
 					continue;
 				} else {
-					++(*ForP); --(*ForLenP);
+					C_Int32 m = SelSkipFalse(&Sel[ForI][*ForP - *Start],
+						*ForLenP);
+					*ForP += m; *ForLenP -= m;
 					continue;
 				}
 			}
@@ -459,6 +523,9 @@ namespace CoreArray
 		virtual void Synchronize();
 		/// close the writing mode and sync the file
         virtual void CloseWriter();
+		/// reload the array if the data or the header (e.g., the dimensions)
+		/// are changed by a writer in the SWMR mode
+		virtual void Refresh();
 
 		virtual void SetPackedMode(const char *Mode);
 
@@ -484,6 +551,14 @@ namespace CoreArray
 		/// the allocator
 		COREARRAY_FORCEINLINE CdAllocator &Allocator() { return fAllocator; }
 
+		/// get the raw and compressed sizes of blocks
+		/** return false if the data are not compressed with random access **/
+		bool GetRABlockInfo(vector<SIZE64> &RawSize, vector<SIZE64> &CmpSize);
+		/// set the raw and compressed sizes of blocks obtained by GetRABlockInfo
+		/** return false if the lists are not used **/
+		bool SetRABlockInfo(const vector<SIZE64> &RawSize,
+			const vector<SIZE64> &CmpSize);
+
 
 	protected:
 
@@ -554,6 +629,8 @@ namespace CoreArray
 		TdGDSBlockID vAllocID;
 		CdBlockStream *vAllocStream;
 		SIZE64 vAlloc_Ptr, vCnt_Ptr;
+		SIZE64 vAllocSize;  ///< the size of data stream when loading
+		C_Int64 vCommitStamp; ///< the committed write stamp of header when refreshing
 	};
 
 
@@ -1101,8 +1178,63 @@ namespace CoreArray
 	// =====================================================================
 
 	/// the size of memory buffer for reading dataset marginally, by default 1G
+	/** it is the default budget if no buffer size is given in
+	 *  CdArrayRead::AllocBuffer, and the granted size is limited by
+	 *  MemGovernor()
+	**/
 	extern C_Int64 ARRAY_READ_MEM_BUFFER_SIZE;
 
+
+	/// the process-wide memory governor of the buffers for reading
+	/** It tracks all buffers of CdArrayRead objects and the shared caches of
+	 *  decompressed blocks mapped by the current process. If the limit is set,
+	 *  a new buffer is granted no more than the free memory, and the existing
+	 *  buffers are shrunk at the next block when the memory in use exceeds
+	 *  the limit.
+	**/
+	class COREARRAY_DLL_DEFAULT CdMemGovernor
+	{
+	public:
+		/// constructor
+		CdMemGovernor();
+
+		/// request a buffer, return the granted size which can be zero
+		C_Int64 Acquire(C_Int64 size);
+		/// return the memory of a buffer
+		void Release(C_Int64 size);
+		/// return the memory of a buffer which is shrunk under pressure
+		void Shrunk(C_Int64 size);
+		/// return true if the memory in use exceeds the limit
+		bool UnderPressure();
+
+		/// set the limit in bytes, no limit if <= 0
+		void SetLimit(C_Int64 limit);
+		/// reset the statistics
+		void ResetStat();
+
+		/// the limit in bytes, no limit if <= 0
+		COREARRAY_INLINE C_Int64 Limit() const { return fLimit; }
+		/// the memory of buffers in use
+		COREARRAY_INLINE C_Int64 Used() const { return fUsed; }
+		/// the memory of the shared block caches, see CdBlockCache
+		C_Int64 CacheSize() const;
+		/// the peak of memory in use
+		COREARRAY_INLINE C_Int64 Peak() const { return fPeak; }
+		/// the number of granted requests
+		COREARRAY_INLINE C_Int64 NumAcquire() const { return fNumAcquire; }
+		/// the number of shrinking
+		COREARRAY_INLINE C_Int64 NumShrink() const { return fNumShrink; }
+
+	protected:
+		CdThreadMutex fMutex;
+		C_Int64 fLimit, fUsed, fPeak;
+		C_Int64 fNumAcquire, fNumShrink;
+	};
+
+	/// the process-wide memory governor
+	COREARRAY_DLL_DEFAULT CdMemGovernor &MemGovernor();
+
+
 	/// read an array-oriented object margin by margin
 	class COREARRAY_DLL_DEFAULT CdArrayRead
 	{
@@ -1119,9 +1251,22 @@ namespace CoreArray
 		/// allocate memory buffer if needed
 		/** \param  buffer_size  the size of memory buffer; if -1,
 		 *                       'buffer_size = ARRAY_READ_MEM_BUFFER_SIZE'
+		 *  \note   the size is granted by MemGovernor()
 		 */
 		void AllocBuffer(C_Int64 buffer_size);
 
+		/// enable or disable prefetching the next margin buffer in background
+		/** \param  prefetch  true for reading the next block by a worker of
+		 *                    ThreadPool() while the current block is being
+		 *                    consumed
+		 *  \note   call it before AllocBuffer, and the buffer size is split
+		 *          into two buffers; the background reading uses another
+		 *          read-only handle of the file, so it does not share the
+		 *          stream positions with the reading in the calling thread,
+		 *          and there is no prefetching if the handle cannot be opened
+		 */
+		void SetPrefetch(bool prefetch);
+
 		/// read data
 		void Read(void *Buffer);
 
@@ -1145,6 +1290,7 @@ namespace CoreArray
 		COREARRAY_INLINE C_Int64 MarginSize() { return fMarginCount * fElmSize; }
 
 		COREARRAY_INLINE const C_Int32 *DimCntValid() { return _DCntValid; }
+		COREARRAY_INLINE bool Prefetch() const { return _Prefetch; }
 
 	protected:
 		CdAbstractArray *fObject;
@@ -1189,6 +1335,47 @@ namespace CoreArray
 		C_Int64 _Margin_Buf_MajorCnt;
 		C_Int64 _Margin_Buf_MinorSize;
 		C_Int64 _Margin_Buf_MinorSize2;
+
+		/// true for prefetching the next margin buffer
+		bool _Prefetch;
+		/// the read-only handle of the file for reading in background
+		CdGDSFile *_Prefetch_File;
+		/// the object in _Prefetch_File read in background
+		CdAbstractArray *_Prefetch_Obj;
+		/// the job of ThreadPool() filling the prefetch buffer, or NULL
+		Parallel::CdThreadPool::TJob *_Prefetch_Job;
+		/// the second buffers for numeric data and strings
+		vector<C_UInt8> _Prefetch_Buffer;
+		vector<UTF8String> _Prefetch_Buffer_UTF8;
+		vector<UTF16String> _Prefetch_Buffer_UTF16;
+		/// the pointer to the prefetch buffer
+		void *_Prefetch_Buffer_Ptr;
+		/// the margin start, extent and selected count of the prefetched block
+		C_Int32 _Prefetch_Start, _Prefetch_DCount, _Prefetch_Cnt;
+
+		/// count the selected margins of the block starting from 'Start'
+		C_Int32 _CountBuffer(C_Int32 Start, C_Int32 &DCount);
+		/// read the block [Start, Start+DCount) along the margin of Obj
+		void _ReadBuffer(CdAbstractArray *Obj, C_Int32 Start, C_Int32 DCount,
+			void *Buffer, bool CallRData);
+		/// open the read-only handle for prefetching, return false if fails
+		bool _OpenPrefetch();
+		/// start reading the block starting from 'Start' in background
+		void _StartPrefetch(C_Int32 Start);
+		/// wait for the background thread
+		void _WaitPrefetch();
+		/// release the prefetch buffers and the read-only handle
+		void _ClearPrefetch();
+
+		/// the memory of the buffers granted by MemGovernor()
+		C_Int64 _Mem_Size;
+		/// release all buffers
+		void _ReleaseBuffer();
+		/// shrink the buffers under memory pressure
+		void _ShrinkBuffer();
+
+	private:
+		static void _PrefetchProc(CdThread *Thread, int Index, void *Param);
 	};
 
 	/// read an array-oriented object margin by margin
@@ -1196,12 +1383,120 @@ namespace CoreArray
 
 
 	/// reallocate the buffer with specified size with respect to array
+	/** the share of an object with prefetching is split into two buffers **/
 	COREARRAY_DLL_DEFAULT void Balance_ArrayRead_Buffer(
 		CdArrayRead *array[], int n, C_Int64 buffer_size=-1);
 
 	/// reallocate the buffer with specified size with respect to array
 	COREARRAY_DLL_DEFAULT void Balance_ArrayRead_Buffer(
 		CdArrayRead array[], int n, C_Int64 buffer_size=-1);
+
+
+	/// split the selected margins into ranges aligned to compressed blocks
+	/** \param  Obj        the array object
+	 *  \param  Margin     the margin index
+	 *  \param  Selection  the selection along the margin, or NULL for all
+	 *  \param  n          the maximum number of ranges
+	 *  \param  Split      output, the starting indices of ranges along the
+	 *                     margin followed by the dimension length; each range
+	 *                     has at least one selected margin
+	 *  \note   the splits are moved to the nearest boundaries of blocks, if
+	 *          the data are compressed with random access and Margin = 0
+	**/
+	COREARRAY_DLL_DEFAULT void Split_ArrayRead_Margin(CdAbstractArray &Obj,
+		int Margin, const C_BOOL *Selection, int n, vector<C_Int32> &Split);
+
+
+
+	// =====================================================================
+	// Pipeline of reading, transforming and appending margins
+	// =====================================================================
+
+	/// A pipeline reading, transforming and appending the margins of arrays
+	/** The margins of the source are read (and decompressed) by a worker of
+	 *  ThreadPool(), transformed in the calling thread, and appended (and
+	 *  compressed) to the target by another worker. The stages are connected
+	 *  by a bounded ring of margin buffers, so that they run concurrently.
+	 *  If the source and target are in the same GDS file, the reading stage
+	 *  uses another read-only handle of the file (CdGDSFile::ReadOnlyObj),
+	 *  which is reused by the later runs while the source is not modified.
+	**/
+	class COREARRAY_DLL_DEFAULT CdArrayPipeline
+	{
+	public:
+		/// the information of a margin passed to the transform
+		struct TMargin
+		{
+			C_Int32 Index;          ///< the index of margin in the source
+			C_Int64 Count;          ///< the number of elements in the margin
+			ssize_t ElmSize;        ///< the size of element in the buffer
+			C_SVType SVType;        ///< the data type of the buffer
+			int DimCnt;             ///< the number of dimensions of the source
+			int Margin;             ///< the margin dimension
+			const C_Int32 *DimLen;  ///< the selected lengths of dimensions
+		};
+
+		/// transform 'In' to 'Out' with the same number of elements
+		/** the buffers are arrays of UTF8String if SVType = svStrUTF8 **/
+		typedef void (*TdTransform)(const void *In, void *Out,
+			const TMargin &Margin, void *Param);
+
+		/// constructor
+		/** \param QueueSize  the number of margin buffers in the ring **/
+		CdArrayPipeline(int QueueSize=8);
+		/// destructor
+		~CdArrayPipeline();
+
+		/// read, transform and append margin by margin
+		/** \param Source     the source array
+		 *  \param Margin     the margin dimension of the source
+		 *  \param Selection  the selection of the source, or NULL for all
+		 *  \param Target     the target array, the margins are appended
+		 *  \param Transform  the transform, or NULL for copying
+		 *  \param Param      passed to Transform
+		 *  \return the number of margins appended
+		**/
+		C_Int64 Run(CdAbstractArray &Source, int Margin,
+			const C_BOOL *const Selection[], CdAbstractArray &Target,
+			TdTransform Transform, void *Param);
+
+	protected:
+		/// a margin buffer in the ring
+		struct TSlot
+		{
+			vector<C_UInt8> In, Out;
+			vector<UTF8String> InStr, OutStr;
+			C_Int32 Index;
+		};
+
+		int fQSize;
+		vector<TSlot> fSlot;
+		CdThreadMutex fMutex;
+		CdThreadCondition fCond;
+		C_Int64 fNumRead, fNumTrans, fNumWritten;
+		bool fAbort;
+		string fErrMsg;
+
+		CdArrayRead *fRead;
+		CdAbstractArray *fTarget;
+		TMargin fInfo;
+		TdTransform fTransform;
+		void *fParam;
+
+		void _DoRead();
+		void _DoTransform();
+		void _DoWrite();
+		void _DoSerial();
+		void _ReadSlot(TSlot &S);
+		void *_InBuf(TSlot &S);
+		void *_OutBuf(TSlot &S);
+		bool _Wait(const C_Int64 &Counter, C_Int64 Need);
+		void _Finish(C_Int64 &Counter, C_Int64 Value);
+		void _SetError(const char *msg);
+
+	private:
+		static void _Proc(CdThread *Thread, int Index, void *Param);
+	};
 }
 
 #endif /* _HEADER_COREARRAY_STRUCT_ */
@@ -0,0 +1,1866 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dVirtual.cpp: Virtual arrays in GDS format
+//
+// Copyright (C) 2026    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "dVirtual.h"
+#include <algorithm>
+#include <set>
+#include <limits>
+#include <math.h>
+#include <ctype.h>
+
+
+namespace CoreArray
+{
+	template<typename TClass> static CdObjRef *OnObjCreate()
+	{
+		return new TClass();
+	}
+
+	COREARRAY_DLL_LOCAL void RegisterClass_Virtual()
+	{
+		dObjManager().AddClass("dConcatArray", OnObjCreate<CdConcatArray>,
+			CdObjClassMgr::ctArray, "concatenated array");
+		dObjManager().AddClass("dComputedArray", OnObjCreate<CdComputedArray>,
+			CdObjClassMgr::ctArray, "computed array");
+	}
+}
+
+using namespace std;
+using namespace CoreArray;
+
+
+// =====================================================================
+// Concatenated array
+// =====================================================================
+
+static const char *VAR_DCNT = "DCNT";
+static const char *VAR_DIM  = "DIM";
+static const char *VAR_SV   = "SVTYPE";
+static const char *VAR_TRAIT = "TRAIT";
+static const char *VAR_BIT  = "BITOF";
+static const char *VAR_PRIM = "PRIMITIVE";
+static const char *VAR_CNT  = "CNT";
+static const char *VAR_LIST = "LIST";
+static const char *VAR_PATH = "PATH";
+static const char *VAR_LEN  = "LEN";
+
+static const char *ERR_READ_ONLY =
+	"The concatenated array is read-only.";
+static const char *ERR_NO_MEMBER =
+	"A concatenated array should have at least one member.";
+static const char *ERR_NO_FILE =
+	"The concatenated array should be added to a GDS file first.";
+static const char *ERR_NOT_IN_FILE =
+	"'%s' is not in the GDS file or the files linked by virtual folders.";
+static const char *ERR_INV_MEMBER =
+	"'%s' should be an array with the same data type and the same "
+	"dimensions except the last one.";
+static const char *ERR_MEMBER_CHANGED =
+	"The member '%s' of the concatenated array has been changed.";
+static const char *ERR_INV_LIST =
+	"Invalid list of members in the concatenated array.";
+
+/// the array from the path in the GDS file or the linked files
+static CdAbstractArray *path_array(CdGDSObj *Obj, const UTF8String &Path)
+{
+	CdGDSFile *file = Obj->GDSFile();
+	CdAbstractArray *p = file ?
+		dynamic_cast<CdAbstractArray*>(file->Root().PathEx(Path)) : NULL;
+	if (!p)
+		throw ErrArray(ERR_NOT_IN_FILE, Path.c_str());
+	return p;
+}
+
+/// whether 's' is 'Path' or a path under it
+static bool path_under(const UTF8String &s, const UTF8String &Path)
+{
+	return (s.compare(0, Path.size(), Path) == 0) &&
+		((s.size() == Path.size()) || (s[Path.size()] == '/'));
+}
+
+static bool depends_on(CdAbstractArray *Obj, const UTF8String &Path,
+	set<CdAbstractArray*> &Visited)
+{
+	if (!Visited.insert(Obj).second) return false;
+	if (path_under(Obj->FullName(), Path)) return true;
+
+	// the paths referred by a virtual array
+	vector<UTF8String> Ref;
+	if (dynamic_cast<CdConcatArray*>(Obj))
+	{
+		CdConcatArray *p = static_cast<CdConcatArray*>(Obj);
+		for (int i=0; i < p->MemberCount(); i++)
+			Ref.push_back(p->MemberPath(i));
+	} else if (dynamic_cast<CdComputedArray*>(Obj))
+	{
+		CdComputedArray *p = static_cast<CdComputedArray*>(Obj);
+		for (int i=0; i < p->SourceCount(); i++)
+			Ref.push_back(p->SourcePath(i));
+	}
+
+	CdGDSFile *file = Obj->GDSFile();
+	for (size_t i=0; i < Ref.size(); i++)
+	{
+		if (path_under(Ref[i], Path)) return true;
+		CdAbstractArray *p = NULL;
+		try {
+			if (file)
+				p = dynamic_cast<CdAbstractArray*>(file->Root().PathEx(Ref[i]));
+		}
+		catch (exception &) {
+			// e.g., a broken link, not referring to any node
+		}
+		if (p && depends_on(p, Path, Visited)) return true;
+	}
+	return false;
+}
+
+bool CoreArray::ArrayDependsOn(CdAbstractArray *Obj, const UTF8String &Path)
+{
+	set<CdAbstractArray*> Visited;
+	return depends_on(Obj, Path, Visited);
+}
+
+
+CdConcatArray::CdConcatArray(): CdAbstractArray()
+{
+	fRowCount = 0;
+	fSVType = svCustom;
+	fTraitFlag = 0;
+	fBitOf = 0;
+	fIsPrimitive = false;
+}
+
+CdGDSObj *CdConcatArray::NewObject()
+{
+	return new CdConcatArray;
+}
+
+void CdConcatArray::Assign(CdGDSObj &Source, bool Full)
+{
+	if (dynamic_cast<CdConcatArray*>(&Source))
+	{
+		if (Full)
+			AssignAttribute(Source);
+		CdConcatArray *S = static_cast<CdConcatArray*>(&Source);
+		fMember = S->fMember;
+		fDim = S->fDim;
+		fRowCount = S->fRowCount;
+		fSVType = S->fSVType;
+		fTraitFlag = S->fTraitFlag;
+		fBitOf = S->fBitOf;
+		fIsPrimitive = S->fIsPrimitive;
+		fChanged = true;
+	} else
+		RaiseInvalidAssign("CdConcatArray", &Source);
+}
+
+const char *CdConcatArray::dName()
+{
+	return "dConcatArray";
+}
+
+const char *CdConcatArray::dTraitName()
+{
+	return "ConcatArray";
+}
+
+void CdConcatArray::CheckMembers(CdGDSFile *File,
+	CdAbstractArray *const List[], int Cnt)
+{
+	if (Cnt <= 0) throw ErrArray(ERR_NO_MEMBER);
+	if (!File) throw ErrArray(ERR_NO_FILE);
+
+	TArrayDim Dim, D;
+	const int DCnt = List[0]->DimCnt();
+	List[0]->GetDim(Dim);
+	C_Int64 Total = 0;
+	for (int i=0; i < Cnt; i++)
+	{
+		CdAbstractArray *p = List[i];
+		UTF8String nm = p->FullName();
+		if (File->Root().PathEx(nm) != p)
+			throw ErrArray(ERR_NOT_IN_FILE, nm.c_str());
+		bool valid = (DCnt > 0) && (p->DimCnt() == DCnt) &&
+			(p->SVType() == List[0]->SVType()) &&
+			COREARRAY_SV_VALID(p->SVType());
+		if (valid)
+		{
+			p->GetDim(D);
+			for (int j=1; j < DCnt; j++)
+				if (D[j] != Dim[j]) valid = false;
+		}
+		if (!valid)
+			throw ErrArray(ERR_INV_MEMBER, nm.c_str());
+		Total += D[0];
+	}
+	if (Total > INT32_MAX)
+		throw ErrArray("The concatenated array is too large.");
+}
+
+void CdConcatArray::SetMembers(CdAbstractArray *const List[], int Cnt)
+{
+	CheckMembers(GDSFile(), List, Cnt);
+
+	vector<TMember> Member(Cnt);
+	TArrayDim Dim, D;
+	const int DCnt = List[0]->DimCnt();
+	List[0]->GetDim(Dim);
+	C_Int64 Total = 0;
+	for (int i=0; i < Cnt; i++)
+	{
+		CdAbstractArray *p = List[i];
+		if (p == this)
+			throw ErrArray(ERR_NOT_IN_FILE, FullName().c_str());
+		p->GetDim(D);
+		Member[i].Path = p->FullName();
+		Member[i].Len = D[0];
+		Total += D[0];
+	}
+
+	fMember.swap(Member);
+	Dim[0] = Total;
+	fDim.assign(Dim, Dim + DCnt);
+	fSVType = List[0]->SVType();
+	fTraitFlag = List[0]->TraitFlag();
+	fBitOf = List[0]->BitOf();
+	fIsPrimitive = List[0]->IsPrimitive();
+	_UpdateStart();
+	// e.g., the attributes of a factor
+	AssignAttribute(*List[0]);
+	fChanged = true;
+}
+
+CdAbstractArray *CdConcatArray::Member(int Index)
+{
+	const TMember &M = fMember[Index];
+	CdAbstractArray *p = path_array(this, M.Path);
+
+	// check the dimensions and data type
+	bool valid = (p->DimCnt() == (int)fDim.size()) &&
+		(p->SVType() == fSVType);
+	if (valid)
+	{
+		TArrayDim D;
+		p->GetDim(D);
+		valid = (D[0] == M.Len);
+		for (size_t j=1; j < fDim.size(); j++)
+			if (D[j] != fDim[j]) valid = false;
+	}
+	if (!valid)
+		throw ErrArray(ERR_MEMBER_CHANGED, M.Path.c_str());
+	return p;
+}
+
+C_SVType CdConcatArray::SVType()
+{
+	return fSVType;
+}
+
+int CdConcatArray::TraitFlag()
+{
+	return fTraitFlag;
+}
+
+unsigned CdConcatArray::BitOf()
+{
+	return fBitOf;
+}
+
+bool CdConcatArray::IsPrimitive()
+{
+	return fIsPrimitive;
+}
+
+void CdConcatArray::Clear()
+{
+	_ReadOnly();
+}
+
+bool CdConcatArray::Empty()
+{
+	return (TotalCount() <= 0);
+}
+
+C_Int64 CdConcatArray::TotalCount()
+{
+	return fDim.empty() ? 0 : (fRowCount * fDim[0]);
+}
+
+void CdConcatArray::CloseWriter()
+{ }
+
+void CdConcatArray::SetPackedMode(const char *)
+{
+	_ReadOnly();
+}
+
+int CdConcatArray::DimCnt() const
+{
+	return fDim.size();
+}
+
+void CdConcatArray::GetDim(C_Int32 DimLen[]) const
+{
+	for (size_t i=0; i < fDim.size(); i++)
+		DimLen[i] = fDim[i];
+}
+
+void CdConcatArray::ResetDim(const C_Int32[], int)
+{
+	_ReadOnly();
+}
+
+C_Int32 CdConcatArray::GetDLen(int I) const
+{
+	if ((I < 0) || (I >= (int)fDim.size()))
+		throw ErrArray("Invalid dimension index %d.", I);
+	return fDim[I];
+}
+
+void CdConcatArray::SetDLen(int, C_Int32)
+{
+	_ReadOnly();
+}
+
+C_Int64 CdConcatArray::TotalArrayCount()
+{
+	return TotalCount();
+}
+
+CdIterator CdConcatArray::IterBegin()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = 0;
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdConcatArray::IterEnd()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = TotalCount();
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdConcatArray::Iterator(const C_Int32 DimIndex[])
+{
+	CdIterator I = IterBegin();
+	for (size_t i=0; i < fDim.size(); i++)
+	{
+		if ((DimIndex[i] < 0) || (DimIndex[i] >= fDim[i]))
+			throw ErrArray("Invalid index %d of the %d dimension.",
+				DimIndex[i], (int)i+1);
+		I.Ptr = I.Ptr * fDim[i] + DimIndex[i];
+	}
+	return I;
+}
+
+void *CdConcatArray::ReadData(const C_Int32 *Start, const C_Int32 *Length,
+	void *OutBuffer, C_SVType OutSV)
+{
+	if (fDim.empty()) return OutBuffer;
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*fDim.size());
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+
+	// the members covering the first dimension
+	TArrayDim St, Len;
+	memcpy(St, Start, sizeof(C_Int32)*fDim.size());
+	memcpy(Len, Length, sizeof(C_Int32)*fDim.size());
+	C_Int32 i = Start[0];
+	const C_Int32 end = Start[0] + Length[0];
+	for (int k = _FindMember(i); i < end; k++)
+	{
+		const TMember &M = fMember[k];
+		C_Int32 n = min(end, M.Start + M.Len) - i;
+		if (n > 0)
+		{
+			St[0] = i - M.Start; Len[0] = n;
+			OutBuffer = Member(k)->ReadData(St, Len, OutBuffer, OutSV);
+			i += n;
+		}
+	}
+	return OutBuffer;
+}
+
+void *CdConcatArray::ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+	const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV)
+{
+	if ((Selection == NULL) || fDim.empty())
+		return ReadData(Start, Length, OutBuffer, OutSV);
+
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*fDim.size());
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+
+	// the members covering the first dimension
+	TArrayDim St, Len;
+	memcpy(St, Start, sizeof(C_Int32)*fDim.size());
+	memcpy(Len, Length, sizeof(C_Int32)*fDim.size());
+	vector<const C_BOOL*> Sel(Selection, Selection + fDim.size());
+	C_Int32 i = Start[0];
+	const C_Int32 end = Start[0] + Length[0];
+	for (int k = _FindMember(i); i < end; k++)
+	{
+		const TMember &M = fMember[k];
+		C_Int32 n = min(end, M.Start + M.Len) - i;
+		if (n > 0)
+		{
+			const C_BOOL *s = Selection[0] + (i - Start[0]);
+			// skip the member without any selected element
+			if (SelSkipFalse(s, n) < (size_t)n)
+			{
+				St[0] = i - M.Start; Len[0] = n; Sel[0] = s;
+				OutBuffer = Member(k)->ReadDataEx(St, Len, &Sel[0],
+					OutBuffer, OutSV);
+			}
+			i += n;
+		}
+	}
+	return OutBuffer;
+}
+
+const void *CdConcatArray::WriteData(const C_Int32 *,
+	const C_Int32 *, const void *InBuffer, C_SVType)
+{
+	_ReadOnly();
+	return InBuffer;
+}
+
+const void *CdConcatArray::Append(const void *Buffer, ssize_t,
+	C_SVType)
+{
+	_ReadOnly();
+	return Buffer;
+}
+
+void CdConcatArray::Loading(CdReader &Reader, TdVersion Version)
+{
+	CdAbstractArray::Loading(Reader, Version);
+
+	C_UInt16 DCnt = 0;
+	Reader[VAR_DCNT] >> DCnt;
+	TArrayDim DimBuf;
+	Reader[VAR_DIM].GetAutoArray(DimBuf, DCnt);
+	fDim.assign(DimBuf, DimBuf + DCnt);
+
+	C_UInt8 sv = svCustom, prim = 0;
+	C_Int32 trait = 0;
+	C_UInt32 bits = 0;
+	Reader[VAR_SV] >> sv;
+	Reader[VAR_TRAIT] >> trait;
+	Reader[VAR_BIT] >> bits;
+	Reader[VAR_PRIM] >> prim;
+	fSVType = (C_SVType)sv;
+	fTraitFlag = trait;
+	fBitOf = bits;
+	fIsPrimitive = (prim != 0);
+
+	C_Int32 L = 0;
+	Reader[VAR_CNT] >> L;
+	fMember.resize(L);
+	if (L > 0)
+	{
+		Reader[VAR_LIST].BeginStruct();
+		for (C_Int32 k = 0; k < L; k++)
+		{
+			Reader.BeginNameSpace();
+			{
+				Reader[VAR_PATH] >> fMember[k].Path;
+				Reader[VAR_LEN]  >> fMember[k].Len;
+			}
+			Reader.EndStruct();
+		}
+		Reader.EndStruct();
+	}
+	_UpdateStart();
+
+	// the first dimension is the total length of members
+	C_Int64 Total = 0;
+	for (C_Int32 k = 0; k < L; k++) Total += fMember[k].Len;
+	if (fDim.empty() ? (L > 0) : (Total != fDim[0]))
+		throw ErrArray(ERR_INV_LIST);
+	fChanged = false;
+}
+
+void CdConcatArray::Saving(CdWriter &Writer)
+{
+	CdAbstractArray::Saving(Writer);
+
+	TArrayDim DimBuf;
+	GetDim(DimBuf);
+	Writer[VAR_DCNT] << C_UInt16(fDim.size());
+	Writer[VAR_DIM].NewAutoArray(DimBuf, fDim.size());
+
+	Writer[VAR_SV] << C_UInt8(fSVType);
+	Writer[VAR_TRAIT] << C_Int32(fTraitFlag);
+	Writer[VAR_BIT] << C_UInt32(fBitOf);
+	Writer[VAR_PRIM] << C_UInt8(fIsPrimitive ? 1 : 0);
+
+	C_Int32 L = fMember.size();
+	Writer[VAR_CNT] << L;
+	if (L > 0)
+	{
+		Writer[VAR_LIST].NewStruct();
+		{
+			vector<TMember>::iterator it;
+			for (it = fMember.begin(); it != fMember.end(); it++)
+			{
+				Writer.BeginNameSpace();
+				Writer[VAR_PATH] << it->Path;
+				Writer[VAR_LEN]  << it->Len;
+				Writer.EndStruct();
+			}
+		}
+		Writer.EndStruct();
+	}
+}
+
+void CdConcatArray::IterOffset(CdIterator &I, SIZE64 val)
+{
+	I.Ptr += val;
+}
+
+C_Int64 CdConcatArray::IterGetInteger(CdIterator &I)
+{
+	int k; C_Int64 n;
+	CdIterator J = _MemberIter(I, k, n);
+	return J.GetInteger();
+}
+
+double CdConcatArray::IterGetFloat(CdIterator &I)
+{
+	int k; C_Int64 n;
+	CdIterator J = _MemberIter(I, k, n);
+	return J.GetFloat();
+}
+
+UTF16String CdConcatArray::IterGetString(CdIterator &I)
+{
+	int k; C_Int64 n;
+	CdIterator J = _MemberIter(I, k, n);
+	return J.GetString();
+}
+
+void CdConcatArray::IterSetInteger(CdIterator &, C_Int64)
+{
+	_ReadOnly();
+}
+
+void CdConcatArray::IterSetFloat(CdIterator &, double)
+{
+	_ReadOnly();
+}
+
+void CdConcatArray::IterSetString(CdIterator &, const UTF16String &)
+{
+	_ReadOnly();
+}
+
+void *CdConcatArray::IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV)
+{
+	while (n > 0)
+	{
+		int k; C_Int64 m;
+		CdIterator J = _MemberIter(I, k, m);
+		if (m > n) m = n;
+		OutBuf = J.ReadData(OutBuf, m, OutSV);
+		I.Ptr += m; n -= m;
+	}
+	return OutBuf;
+}
+
+void *CdConcatArray::IterRDataEx(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV, const C_BOOL Selection[])
+{
+	while (n > 0)
+	{
+		// skip the unselected elements
+		size_t s = SelSkipFalse(Selection, n);
+		I.Ptr += s; Selection += s; n -= s;
+		if (n <= 0) break;
+
+		int k; C_Int64 m;
+		CdIterator J = _MemberIter(I, k, m);
+		if (m > n) m = n;
+		OutBuf = J.ReadDataEx(OutBuf, m, OutSV, Selection);
+		I.Ptr += m; Selection += m; n -= m;
+	}
+	return OutBuf;
+}
+
+const void *CdConcatArray::IterWData(CdIterator &, const void *InBuf,
+	ssize_t, C_SVType)
+{
+	_ReadOnly();
+	return InBuf;
+}
+
+void CdConcatArray::_UpdateStart()
+{
+	C_Int32 s = 0;
+	vector<TMember>::iterator it;
+	for (it = fMember.begin(); it != fMember.end(); it++)
+	{
+		it->Start = s;
+		s += it->Len;
+	}
+	fRowCount = fDim.empty() ? 0 : 1;
+	for (size_t i=1; i < fDim.size(); i++)
+		fRowCount *= fDim[i];
+}
+
+int CdConcatArray::_FindMember(C_Int32 Index) const
+{
+	// the last member starting at or before Index
+	int lo = 0, hi = fMember.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (fMember[mid].Start <= Index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo > 0) ? (lo - 1) : 0;
+}
+
+CdIterator CdConcatArray::_MemberIter(const CdIterator &I, int &Index,
+	C_Int64 &Cnt)
+{
+	if ((I.Ptr < 0) || (I.Ptr >= TotalCount()))
+		throw ErrArray("Invalid iterator position.");
+	Index = _FindMember(I.Ptr / fRowCount);
+	const TMember &M = fMember[Index];
+	const C_Int64 Off = I.Ptr - (C_Int64)M.Start * fRowCount;
+	Cnt = (C_Int64)M.Len * fRowCount - Off;
+	CdIterator J = Member(Index)->IterBegin();
+	J += Off;
+	return J;
+}
+
+void CdConcatArray::_ReadOnly()
+{
+	throw ErrArray(ERR_READ_ONLY);
+}
+
+
+
+// =====================================================================
+// Computed array
+// =====================================================================
+
+static const char *VAR_EXPR = "EXPR";
+static const char *VAR_NAME = "NAME";
+static const char *VAR_INT  = "INT";
+
+static const char *ERR_COMP_READ_ONLY =
+	"The computed array is read-only.";
+static const char *ERR_NO_SOURCE =
+	"A computed array should have at least one source array.";
+static const char *ERR_COMP_NO_FILE =
+	"The computed array should be added to a GDS file first.";
+static const char *ERR_INV_SOURCE =
+	"'%s' should be a numeric array.";
+static const char *ERR_INV_SOURCE_DIM =
+	"The dimensions of '%s' should be the dimensions of the result, or "
+	"the leading or trailing ones.";
+static const char *ERR_INV_NAME =
+	"Invalid or duplicated variable name '%s'.";
+static const char *ERR_UNUSED_SOURCE =
+	"'%s' is not used in the expression.";
+static const char *ERR_SOURCE_CHANGED =
+	"The source '%s' of the computed array has been changed.";
+static const char *ERR_INV_EXPR =
+	"Invalid expression '%s' at position %d.";
+static const char *ERR_UNKNOWN_FUNC =
+	"Unknown function '%s' in the expression.";
+static const char *ERR_UNKNOWN_VAR =
+	"Unknown variable '%s' in the expression.";
+
+/// the number of elements read from the source arrays at a time
+static const C_Int64 COMPUTE_BLOCK_SIZE = 16384;
+/// the number of elements of all nodes evaluated at a time
+static const size_t COMPUTE_TILE_SIZE = 256;
+
+/// the missing value of 32-bit integers (NA in R)
+static const double INT32_NA = -2147483648.0;
+static const C_Int32 NA_INT32 = INT32_MIN;
+
+static const C_BOOL SEL_TRUE = 1;
+
+/// whether it is a missing value (vectorizable)
+static COREARRAY_INLINE bool is_na(double v) { return v != v; }
+
+/// whether it is the first character of a variable or function name
+static COREARRAY_INLINE bool is_name_first(char c)
+{
+	return isalpha((unsigned char)c) || (c == '.') || (c == '_');
+}
+
+/// whether it is a character of a variable or function name
+static COREARRAY_INLINE bool is_name_char(char c)
+{
+	return isalnum((unsigned char)c) || (c == '.') || (c == '_');
+}
+
+static COREARRAY_INLINE void skip_space(const char *&p)
+{
+	while (isspace((unsigned char)*p)) p++;
+}
+
+/// whether it is a valid variable name
+static bool is_valid_name(const char *s)
+{
+	if (!is_name_first(*s)) return false;
+	if ((s[0] == '.') && isdigit((unsigned char)s[1])) return false;
+	for (s++; *s; s++)
+		if (!is_name_char(*s)) return false;
+	return true;
+}
+
+/// convert to integers, missing values as a converted 32-bit integer NA
+template<typename TYPE>
+	static TYPE *cvt_int_out(TYPE *p, const double *s, size_t n, bool IsInt)
+{
+	const double lo = numeric_limits<TYPE>::min();
+	const double hi = ldexp(1.0, numeric_limits<TYPE>::digits);
+	const TYPE na = TYPE(C_Int32(INT32_NA));
+	if (IsInt)
+	{
+		// no rounding needed
+		for (; n > 0; n--, s++)
+			*p++ = ((lo <= *s) && (*s < hi)) ? TYPE(*s) : na;
+	} else {
+		for (; n > 0; n--)
+		{
+			const double v = round(*s++);
+			*p++ = ((lo <= v) && (v < hi)) ? TYPE(v) : na;
+		}
+	}
+	return p;
+}
+
+/// convert the computed values to the output type
+static void *cvt_out(void *Out, const double *s, size_t n, C_SVType OutSV,
+	bool IsInt)
+{
+	switch (OutSV)
+	{
+		case svInt8:
+			return cvt_int_out((C_Int8*)Out, s, n, IsInt);
+		case svUInt8:
+			return cvt_int_out((C_UInt8*)Out, s, n, IsInt);
+		case svInt16:
+			return cvt_int_out((C_Int16*)Out, s, n, IsInt);
+		case svUInt16:
+			return cvt_int_out((C_UInt16*)Out, s, n, IsInt);
+		case svInt32:
+			return cvt_int_out((C_Int32*)Out, s, n, IsInt);
+		case svUInt32:
+			return cvt_int_out((C_UInt32*)Out, s, n, IsInt);
+		case svInt64:
+			return cvt_int_out((C_Int64*)Out, s, n, IsInt);
+		case svUInt64:
+			return cvt_int_out((C_UInt64*)Out, s, n, IsInt);
+		case svFloat32:
+			{
+				C_Float32 *p = (C_Float32*)Out;
+				for (; n > 0; n--) *p++ = *s++;
+				return p;
+			}
+		case svFloat64:
+			memcpy(Out, s, sizeof(double)*n);
+			return (double*)Out + n;
+		case svStrUTF8:
+			return VAL_CONV<UTF8String, C_Float64>::Cvt((UTF8String*)Out, s, n);
+		case svStrUTF16:
+			return VAL_CONV<UTF16String, C_Float64>::Cvt((UTF16String*)Out, s, n);
+		default:
+			throw ErrArray("Invalid SVType in reading a computed array.");
+	}
+}
+
+/// convert 32-bit integers to the output integer type
+template<typename TYPE>
+	static TYPE *cvt_int32_out(TYPE *p, const C_Int32 *s, size_t n)
+{
+	const double lo = numeric_limits<TYPE>::min();
+	const double hi = ldexp(1.0, numeric_limits<TYPE>::digits);
+	const TYPE na = TYPE(NA_INT32);
+	for (; n > 0; n--)
+	{
+		const C_Int32 v = *s++;
+		*p++ = ((v != NA_INT32) && (lo <= v) && (v < hi)) ? TYPE(v) : na;
+	}
+	return p;
+}
+
+/// convert the computed 32-bit integers to the output type, or return
+/// NULL if OutSV is not an integer type
+static void *cvt_int32_out(void *Out, const C_Int32 *s, size_t n,
+	C_SVType OutSV)
+{
+	switch (OutSV)
+	{
+		case svInt8:
+			return cvt_int32_out((C_Int8*)Out, s, n);
+		case svUInt8:
+			return cvt_int32_out((C_UInt8*)Out, s, n);
+		case svInt16:
+			return cvt_int32_out((C_Int16*)Out, s, n);
+		case svUInt16:
+			return cvt_int32_out((C_UInt16*)Out, s, n);
+		case svInt32:
+			memcpy(Out, s, sizeof(C_Int32)*n);
+			return (C_Int32*)Out + n;
+		case svUInt32:
+			return cvt_int32_out((C_UInt32*)Out, s, n);
+		case svInt64:
+			return cvt_int32_out((C_Int64*)Out, s, n);
+		case svUInt64:
+			return cvt_int32_out((C_UInt64*)Out, s, n);
+		default:
+			return NULL;
+	}
+}
+
+/// elementwise binary operators
+struct op_add
+{
+	static double f(double a, double b) { return a + b; }
+	static C_Int64 f(C_Int64 a, C_Int64 b) { return a + b; }
+};
+struct op_sub
+{
+	static double f(double a, double b) { return a - b; }
+	static C_Int64 f(C_Int64 a, C_Int64 b) { return a - b; }
+};
+struct op_mul
+{
+	static double f(double a, double b) { return a * b; }
+	static C_Int64 f(C_Int64 a, C_Int64 b) { return a * b; }
+};
+struct op_div { static double f(double a, double b) { return a / b; } };
+struct op_ifna { static double f(double a, double b) { return is_na(a) ? b : a; } };
+struct op_naif { static double f(double a, double b) { return (a == b) ? NaN : a; } };
+
+/// apply a binary operator
+template<typename OP> static void eval_binary(double *o,
+	const double *a, const double *b, size_t n)
+{
+	for (size_t i=0; i < n; i++) o[i] = OP::f(a[i], b[i]);
+}
+
+/// apply a binary operator to 32-bit integers, NA if either is NA or
+/// the result is out of the range
+template<typename OP> static void eval_int_binary(C_Int32 *o,
+	const C_Int32 *a, const C_Int32 *b, size_t n)
+{
+	for (size_t i=0; i < n; i++)
+	{
+		const C_Int64 v = OP::f(C_Int64(a[i]), C_Int64(b[i]));
+		o[i] = ((a[i] != NA_INT32) && (b[i] != NA_INT32) &&
+			(NA_INT32 < v) && (v <= INT32_MAX)) ? C_Int32(v) : NA_INT32;
+	}
+}
+
+/// repeat the m values read from a source to N elements
+template<typename TYPE>
+	static void expand_source(TYPE *p, size_t m, size_t N, bool Leading)
+{
+	if (m >= N) return;
+	if (Leading)
+	{
+		// repeated over the leading dimensions in R
+		const size_t rep = N / m;
+		for (size_t j=m; j > 0; j--)
+		{
+			const TYPE val = p[j-1];
+			TYPE *s = p + (j-1)*rep;
+			for (size_t l=0; l < rep; l++) s[l] = val;
+		}
+	} else {
+		// repeated over the trailing dimensions in R
+		for (size_t j=m; j < N; j += m)
+			memcpy(p + j, p, sizeof(TYPE)*m);
+	}
+}
+
+
+CdComputedArray::CdComputedArray(): CdAbstractArray()
+{
+	fSrcStamp = 0;
+}
+
+CdGDSObj *CdComputedArray::NewObject()
+{
+	return new CdComputedArray;
+}
+
+void CdComputedArray::Assign(CdGDSObj &Source, bool Full)
+{
+	if (dynamic_cast<CdComputedArray*>(&Source))
+	{
+		if (Full)
+			AssignAttribute(Source);
+		CdComputedArray *S = static_cast<CdComputedArray*>(&Source);
+		fExpr = S->fExpr;
+		fSource = S->fSource;
+		fNode = S->fNode;
+		fDim = S->fDim;
+		fSrcCache.clear();
+		fChanged = true;
+	} else
+		RaiseInvalidAssign("CdComputedArray", &Source);
+}
+
+const char *CdComputedArray::dName()
+{
+	return "dComputedArray";
+}
+
+const char *CdComputedArray::dTraitName()
+{
+	return "ComputedArray";
+}
+
+void CdComputedArray::SetExpression(const char *Expr,
+	const char *const Names[], CdAbstractArray *const List[], int Cnt)
+{
+	_SetExpression(GDSFile(), Expr, Names, List, Cnt);
+}
+
+void CdComputedArray::CheckExpression(CdGDSFile *File, const char *Expr,
+	const char *const Names[], CdAbstractArray *const List[], int Cnt)
+{
+	TdAutoRef<CdComputedArray> Tmp(new CdComputedArray);
+	Tmp->_SetExpression(File, Expr, Names, List, Cnt);
+}
+
+void CdComputedArray::_SetExpression(CdGDSFile *File, const char *Expr,
+	const char *const Names[], CdAbstractArray *const List[], int Cnt)
+{
+	if (Cnt <= 0) throw ErrArray(ERR_NO_SOURCE);
+	CdGDSFile *file = File;
+	if (!file) throw ErrArray(ERR_COMP_NO_FILE);
+
+	vector<TSource> Src(Cnt);
+	for (int i=0; i < Cnt; i++)
+	{
+		if (!is_valid_name(Names[i]))
+			throw ErrArray(ERR_INV_NAME, Names[i]);
+		for (int j=0; j < i; j++)
+			if (Src[j].Name == Names[i])
+				throw ErrArray(ERR_INV_NAME, Names[i]);
+		CdAbstractArray *p = List[i];
+		UTF8String nm = p->FullName();
+		if ((p == this) || (file->Root().PathEx(nm) != p))
+			throw ErrArray(ERR_NOT_IN_FILE, nm.c_str());
+		if (!COREARRAY_SV_NUMERIC(p->SVType()) || (p->DimCnt() <= 0))
+			throw ErrArray(ERR_INV_SOURCE, nm.c_str());
+		TArrayDim D;
+		p->GetDim(D);
+		Src[i].Name = Names[i];
+		Src[i].Path = nm;
+		Src[i].IsInt = COREARRAY_SV_INTEGER(p->SVType());
+		Src[i].Dim.assign(D, D + p->DimCnt());
+	}
+
+	// parse the expression, and keep the old one if failed
+	UTF8String OldExpr = Expr;
+	fExpr.swap(OldExpr);
+	fSource.swap(Src);
+	vector<C_Int32> OldDim = fDim;
+	vector<TNode> OldNode = fNode;
+	try {
+		_SetDim();
+		_Parse();
+		// all source arrays should be used
+		for (size_t i=0; i < fSource.size(); i++)
+		{
+			bool used = false;
+			for (size_t j=0; j < fNode.size(); j++)
+				if ((fNode[j].Op == opVar) && (fNode[j].Var == (int)i))
+					used = true;
+			if (!used)
+				throw ErrArray(ERR_UNUSED_SOURCE, fSource[i].Name.c_str());
+		}
+	}
+	catch (...) {
+		fExpr.swap(OldExpr);
+		fSource.swap(Src);
+		fDim.swap(OldDim);
+		fNode.swap(OldNode);
+		throw;
+	}
+	fSrcCache.clear();
+	fChanged = true;
+}
+
+CdAbstractArray *CdComputedArray::Source(int Index)
+{
+	return _CheckSource(Index, path_array(this, fSource[Index].Path));
+}
+
+CdAbstractArray *CdComputedArray::_CheckSource(int Index,
+	CdAbstractArray *p)
+{
+	const TSource &S = fSource[Index];
+	// check the dimensions and data type
+	bool valid = COREARRAY_SV_NUMERIC(p->SVType()) &&
+		(COREARRAY_SV_INTEGER(p->SVType()) == S.IsInt) &&
+		(p->DimCnt() == (int)S.Dim.size());
+	if (valid)
+	{
+		TArrayDim D;
+		p->GetDim(D);
+		for (size_t j=0; j < S.Dim.size(); j++)
+			if (D[j] != S.Dim[j]) valid = false;
+	}
+	if (!valid)
+		throw ErrArray(ERR_SOURCE_CHANGED, S.Path.c_str());
+	return p;
+}
+
+void CdComputedArray::_Sources(vector<CdAbstractArray*> &List)
+{
+	// the paths are resolved again only if any GDS object has been
+	// destroyed, renamed or moved, not for each element by an iterator
+	const C_UInt32 Stamp = CdGDSObj::PathStamp();
+	if ((fSrcStamp != Stamp) || (fSrcCache.size() != fSource.size()))
+	{
+		fSrcCache.clear();
+		for (size_t i=0; i < fSource.size(); i++)
+			fSrcCache.push_back(Source(i));
+		fSrcStamp = Stamp;
+	} else {
+		for (size_t i=0; i < fSource.size(); i++)
+			_CheckSource(i, fSrcCache[i]);
+	}
+	List = fSrcCache;
+}
+
+C_SVType CdComputedArray::SVType()
+{
+	return (!fNode.empty() && fNode.back().IsInt) ? svInt32 : svFloat64;
+}
+
+int CdComputedArray::TraitFlag()
+{
+	return (!fNode.empty() && fNode.back().IsInt) ?
+		COREARRAY_TR_INTEGER : COREARRAY_TR_FLOAT;
+}
+
+unsigned CdComputedArray::BitOf()
+{
+	return (!fNode.empty() && fNode.back().IsInt) ? 32 : 64;
+}
+
+bool CdComputedArray::IsPrimitive()
+{
+	return true;
+}
+
+void CdComputedArray::Clear()
+{
+	_ReadOnly();
+}
+
+bool CdComputedArray::Empty()
+{
+	return (TotalCount() <= 0);
+}
+
+C_Int64 CdComputedArray::TotalCount()
+{
+	if (fDim.empty()) return 0;
+	C_Int64 n = 1;
+	for (size_t i=0; i < fDim.size(); i++) n *= fDim[i];
+	return n;
+}
+
+void CdComputedArray::CloseWriter()
+{ }
+
+void CdComputedArray::SetPackedMode(const char *)
+{
+	_ReadOnly();
+}
+
+int CdComputedArray::DimCnt() const
+{
+	return fDim.size();
+}
+
+void CdComputedArray::GetDim(C_Int32 DimLen[]) const
+{
+	for (size_t i=0; i < fDim.size(); i++)
+		DimLen[i] = fDim[i];
+}
+
+void CdComputedArray::ResetDim(const C_Int32[], int)
+{
+	_ReadOnly();
+}
+
+C_Int32 CdComputedArray::GetDLen(int I) const
+{
+	if ((I < 0) || (I >= (int)fDim.size()))
+		throw ErrArray("Invalid dimension index %d.", I);
+	return fDim[I];
+}
+
+void CdComputedArray::SetDLen(int, C_Int32)
+{
+	_ReadOnly();
+}
+
+C_Int64 CdComputedArray::TotalArrayCount()
+{
+	return TotalCount();
+}
+
+CdIterator CdComputedArray::IterBegin()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = 0;
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdComputedArray::IterEnd()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = TotalCount();
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdComputedArray::Iterator(const C_Int32 DimIndex[])
+{
+	CdIterator I = IterBegin();
+	for (size_t i=0; i < fDim.size(); i++)
+	{
+		if ((DimIndex[i] < 0) || (DimIndex[i] >= fDim[i]))
+			throw ErrArray("Invalid index %d of the %d dimension.",
+				DimIndex[i], (int)i+1);
+		I.Ptr = I.Ptr * fDim[i] + DimIndex[i];
+	}
+	return I;
+}
+
+void *CdComputedArray::ReadData(const C_Int32 *Start, const C_Int32 *Length,
+	void *OutBuffer, C_SVType OutSV)
+{
+	return _ReadRect(Start, Length, NULL, OutBuffer, OutSV);
+}
+
+void *CdComputedArray::ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+	const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV)
+{
+	return _ReadRect(Start, Length, Selection, OutBuffer, OutSV);
+}
+
+const void *CdComputedArray::WriteData(const C_Int32 *,
+	const C_Int32 *, const void *InBuffer, C_SVType)
+{
+	_ReadOnly();
+	return InBuffer;
+}
+
+const void *CdComputedArray::Append(const void *Buffer, ssize_t,
+	C_SVType)
+{
+	_ReadOnly();
+	return Buffer;
+}
+
+void CdComputedArray::Loading(CdReader &Reader, TdVersion Version)
+{
+	CdAbstractArray::Loading(Reader, Version);
+
+	Reader[VAR_EXPR] >> fExpr;
+	C_Int32 L = 0;
+	Reader[VAR_CNT] >> L;
+	fSource.resize(L);
+	if (L > 0)
+	{
+		Reader[VAR_LIST].BeginStruct();
+		for (C_Int32 k = 0; k < L; k++)
+		{
+			Reader.BeginNameSpace();
+			{
+				TSource &S = fSource[k];
+				C_UInt8 IsInt = 0;
+				C_UInt16 DCnt = 0;
+				TArrayDim DimBuf;
+				Reader[VAR_NAME] >> S.Name;
+				Reader[VAR_PATH] >> S.Path;
+				Reader[VAR_INT]  >> IsInt;
+				Reader[VAR_DCNT] >> DCnt;
+				Reader[VAR_DIM].GetAutoArray(DimBuf, DCnt);
+				S.IsInt = (IsInt != 0);
+				S.Dim.assign(DimBuf, DimBuf + DCnt);
+			}
+			Reader.EndStruct();
+		}
+		Reader.EndStruct();
+	}
+
+	fDim.clear();
+	fNode.clear();
+	fSrcCache.clear();
+	if (L > 0)
+	{
+		_SetDim();
+		_Parse();
+	}
+	fChanged = false;
+}
+
+void CdComputedArray::Saving(CdWriter &Writer)
+{
+	CdAbstractArray::Saving(Writer);
+
+	Writer[VAR_EXPR] << fExpr;
+	C_Int32 L = fSource.size();
+	Writer[VAR_CNT] << L;
+	if (L > 0)
+	{
+		Writer[VAR_LIST].NewStruct();
+		{
+			vector<TSource>::iterator it;
+			for (it = fSource.begin(); it != fSource.end(); it++)
+			{
+				Writer.BeginNameSpace();
+				TArrayDim DimBuf;
+				for (size_t j=0; j < it->Dim.size(); j++)
+					DimBuf[j] = it->Dim[j];
+				Writer[VAR_NAME] << it->Name;
+				Writer[VAR_PATH] << it->Path;
+				Writer[VAR_INT]  << C_UInt8(it->IsInt ? 1 : 0);
+				Writer[VAR_DCNT] << C_UInt16(it->Dim.size());
+				Writer[VAR_DIM].NewAutoArray(DimBuf, it->Dim.size());
+				Writer.EndStruct();
+			}
+		}
+		Writer.EndStruct();
+	}
+}
+
+void CdComputedArray::IterOffset(CdIterator &I, SIZE64 val)
+{
+	I.Ptr += val;
+}
+
+C_Int64 CdComputedArray::IterGetInteger(CdIterator &I)
+{
+	C_Int64 v;
+	_ReadFlat(I.Ptr, 1, NULL, &v, svInt64);
+	return v;
+}
+
+double CdComputedArray::IterGetFloat(CdIterator &I)
+{
+	double v;
+	_ReadFlat(I.Ptr, 1, NULL, &v, svFloat64);
+	return v;
+}
+
+UTF16String CdComputedArray::IterGetString(CdIterator &I)
+{
+	UTF16String v;
+	_ReadFlat(I.Ptr, 1, NULL, &v, svStrUTF16);
+	return v;
+}
+
+void CdComputedArray::IterSetInteger(CdIterator &, C_Int64)
+{
+	_ReadOnly();
+}
+
+void CdComputedArray::IterSetFloat(CdIterator &, double)
+{
+	_ReadOnly();
+}
+
+void CdComputedArray::IterSetString(CdIterator &, const UTF16String &)
+{
+	_ReadOnly();
+}
+
+void *CdComputedArray::IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV)
+{
+	OutBuf = _ReadFlat(I.Ptr, n, NULL, OutBuf, OutSV);
+	I.Ptr += n;
+	return OutBuf;
+}
+
+void *CdComputedArray::IterRDataEx(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV, const C_BOOL Selection[])
+{
+	OutBuf = _ReadFlat(I.Ptr, n, Selection, OutBuf, OutSV);
+	I.Ptr += n;
+	return OutBuf;
+}
+
+const void *CdComputedArray::IterWData(CdIterator &, const void *InBuf,
+	ssize_t, C_SVType)
+{
+	_ReadOnly();
+	return InBuf;
+}
+
+void CdComputedArray::_Parse()
+{
+	fNode.clear();
+	const char *p = fExpr.c_str();
+	_ParseSum(p);
+	skip_space(p);
+	if (*p)
+		throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), int(p - fExpr.c_str()) + 1);
+}
+
+int CdComputedArray::_ParseSum(const char *&p)
+{
+	int a = _ParseProduct(p);
+	for (skip_space(p); (*p == '+') || (*p == '-'); skip_space(p))
+	{
+		TOp op = (*p++ == '+') ? opAdd : opSub;
+		int b = _ParseProduct(p);
+		a = _AddNode(op, fNode[a].IsInt && fNode[b].IsInt, a, b);
+	}
+	return a;
+}
+
+int CdComputedArray::_ParseProduct(const char *&p)
+{
+	int a = _ParseUnary(p);
+	for (skip_space(p); (*p == '*') || (*p == '/'); skip_space(p))
+	{
+		TOp op = (*p++ == '*') ? opMul : opDiv;
+		int b = _ParseUnary(p);
+		a = _AddNode(op, (op == opMul) && fNode[a].IsInt && fNode[b].IsInt,
+			a, b);
+	}
+	return a;
+}
+
+int CdComputedArray::_ParseUnary(const char *&p)
+{
+	skip_space(p);
+	if (*p == '-')
+	{
+		int a = _ParseUnary(++p);
+		return _AddNode(opNeg, fNode[a].IsInt, a, -1);
+	} else if (*p == '+')
+		return _ParseUnary(++p);
+	return _ParsePrimary(p);
+}
+
+int CdComputedArray::_ParsePrimary(const char *&p)
+{
+	skip_space(p);
+	const char *s = p;
+	if (*p == '(')
+	{
+		int a = _ParseSum(++p);
+		skip_space(p);
+		if (*p != ')')
+			throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), int(p - fExpr.c_str()) + 1);
+		p++;
+		return a;
+
+	} else if (isdigit((unsigned char)*p) ||
+		((*p == '.') && isdigit((unsigned char)p[1])))
+	{
+		// a number, an integer only with the suffix "L" like in R
+		char *e;
+		double v = strtod(p, &e);
+		bool is_int = false;
+		if (*e == 'L')
+		{
+			if (v != floor(v))
+				throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), int(e - fExpr.c_str()) + 1);
+			is_int = true; e++;
+		}
+		if (v > INT32_MAX) is_int = false;
+		p = e;
+		int a = _AddNode(opConst, is_int, -1, -1);
+		fNode[a].Value = v;
+		return a;
+
+	} else if (is_name_first(*p))
+	{
+		while (is_name_char(*p)) p++;
+		string nm(s, p);
+		skip_space(p);
+		if (*p == '(')
+		{
+			// a function
+			int a = _ParseSum(++p), b = -1;
+			skip_space(p);
+			if (*p == ',')
+			{
+				b = _ParseSum(++p);
+				skip_space(p);
+			}
+			if (*p != ')')
+				throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), int(p - fExpr.c_str()) + 1);
+			p++;
+			if ((nm == "as.integer") && (b < 0))
+				return _AddNode(opInt, true, a, -1);
+			else if (((nm == "as.numeric") || (nm == "as.double")) && (b < 0))
+				return _AddNode(opDbl, false, a, -1);
+			else if ((nm == "ifna") && (b >= 0))
+				return _AddNode(opIfNA, fNode[a].IsInt && fNode[b].IsInt, a, b);
+			else if ((nm == "na_if") && (b >= 0))
+				return _AddNode(opNAIf, fNode[a].IsInt, a, b);
+			throw ErrArray(ERR_UNKNOWN_FUNC, nm.c_str());
+		} else if ((nm == "NA") || (nm == "NaN"))
+		{
+			int a = _AddNode(opConst, nm == "NA", -1, -1);
+			fNode[a].Value = NaN;
+			return a;
+		}
+		for (size_t i=0; i < fSource.size(); i++)
+		{
+			if (fSource[i].Name == nm)
+			{
+				int a = _AddNode(opVar, fSource[i].IsInt, -1, -1);
+				fNode[a].Var = i;
+				return a;
+			}
+		}
+		throw ErrArray(ERR_UNKNOWN_VAR, nm.c_str());
+	}
+	throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), int(p - fExpr.c_str()) + 1);
+}
+
+int CdComputedArray::_AddNode(TOp Op, bool IsInt, int A, int B)
+{
+	TNode d;
+	d.Op = Op; d.IsInt = IsInt;
+	d.A = A; d.B = B;
+	d.Value = 0; d.Var = -1;
+	fNode.push_back(d);
+	return fNode.size() - 1;
+}
+
+void CdComputedArray::_SetDim()
+{
+	// the dimensions of the source with the most dimensions
+	size_t k = 0;
+	for (size_t i=1; i < fSource.size(); i++)
+		if (fSource[i].Dim.size() > fSource[k].Dim.size()) k = i;
+	fDim = fSource[k].Dim;
+
+	// the leading or trailing dimensions in R
+	const size_t n = fDim.size();
+	vector<TSource>::iterator it;
+	for (it = fSource.begin(); it != fSource.end(); it++)
+	{
+		const size_t m = it->Dim.size();
+		if ((m > 0) && equal(it->Dim.begin(), it->Dim.end(), fDim.begin()))
+			it->DimStart = 0;
+		else if ((m > 0) && equal(it->Dim.begin(), it->Dim.end(),
+				fDim.begin() + (n - m)))
+			it->DimStart = n - m;
+		else
+			throw ErrArray(ERR_INV_SOURCE_DIM, it->Path.c_str());
+	}
+}
+
+void *CdComputedArray::_ReadRect(const C_Int32 *Start, const C_Int32 *Length,
+	const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV)
+{
+	const int DCnt = fDim.size();
+	if (DCnt <= 0) return OutBuffer;
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*DCnt);
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+
+	// the numbers of selected elements in each dimension
+	TArrayDim SelCnt;
+	for (int i=0; i < DCnt; i++)
+	{
+		SelCnt[i] = Length[i];
+		if (Selection)
+		{
+			C_Int32 m = 0;
+			for (C_Int32 j=0; j < Length[i]; j++)
+				if (Selection[i][j]) m++;
+			SelCnt[i] = m;
+		}
+	}
+	C_Int64 RowSize = 1;
+	for (int i=1; i < DCnt; i++) RowSize *= SelCnt[i];
+	if ((RowSize <= 0) || (SelCnt[0] <= 0)) return OutBuffer;
+
+	// the number of rows evaluated at a time
+	C_Int64 NRow = COMPUTE_BLOCK_SIZE / RowSize;
+	if (NRow < 1) NRow = 1;
+	if (NRow > SelCnt[0]) NRow = SelCnt[0];
+	const size_t Stride = NRow * RowSize;
+
+	// the source arrays, an integer source is read as 32-bit integers if
+	// exact, or also as double for an int64 or uint32 source
+	const size_t nv = fSource.size();
+	vector<CdAbstractArray*> Src;
+	_Sources(Src);
+	vector<double*> DVar(nv, NULL);
+	vector<C_Int32*> IVar(nv, NULL);
+	size_t nDbl = 0, nInt = 0;
+	for (size_t v=0; v < nv; v++)
+	{
+		if (fSource[v].IsInt)
+		{
+			nInt ++;
+			C_SVType sv = Src[v]->SVType();
+			unsigned nbit = Src[v]->BitOf();
+			if (!(COREARRAY_SV_SINT(sv) ? (nbit <= 32) : (nbit < 32)))
+				nDbl ++;
+		} else
+			nDbl ++;
+	}
+	if (fBuffer.size() < nDbl*Stride)
+		fBuffer.resize(nDbl*Stride);
+	if (fIntBuf.size() < nInt*Stride)
+		fIntBuf.resize(nInt*Stride);
+	nDbl = nInt = 0;
+	for (size_t v=0; v < nv; v++)
+	{
+		if (fSource[v].IsInt)
+		{
+			IVar[v] = &fIntBuf[0] + (nInt++)*Stride;
+			C_SVType sv = Src[v]->SVType();
+			unsigned nbit = Src[v]->BitOf();
+			if (!(COREARRAY_SV_SINT(sv) ? (nbit <= 32) : (nbit < 32)))
+				DVar[v] = &fBuffer[0] + (nDbl++)*Stride;
+		} else
+			DVar[v] = &fBuffer[0] + (nDbl++)*Stride;
+	}
+
+	TArrayDim St, Len;
+	memcpy(St, Start, sizeof(C_Int32)*DCnt);
+	memcpy(Len, Length, sizeof(C_Int32)*DCnt);
+	vector<const C_BOOL*> Sel(DCnt);
+	if (Selection)
+		Sel.assign(Selection, Selection + DCnt);
+
+	for (C_Int32 i=0; i < Length[0]; )
+	{
+		// the rows in this block
+		C_Int32 e = i;
+		C_Int64 r = 0;
+		if (Selection)
+		{
+			for (; (e < Length[0]) && (r < NRow); e++)
+				if (Selection[0][e]) r++;
+		} else {
+			e = (C_Int32)min<C_Int64>(Length[0], i + NRow);
+			r = e - i;
+		}
+		St[0] = Start[0] + i; Len[0] = e - i;
+		if (Selection) Sel[0] = Selection[0] + i;
+		SelCnt[0] = r;
+		i = e;
+		const size_t N = r * RowSize;
+		if (N <= 0) continue;
+
+		// read the source arrays
+		for (size_t v=0; v < nv; v++)
+		{
+			const TSource &S = fSource[v];
+			const int k = S.Dim.size(), d = S.DimStart;
+			size_t m = 1;
+			for (int j=d; j < d+k; j++) m *= SelCnt[j];
+			if (DVar[v])
+			{
+				double *p = DVar[v];
+				Src[v]->ReadDataEx(St + d, Len + d,
+					Selection ? &Sel[d] : NULL, p, svFloat64);
+				expand_source(p, m, N, d == 0);
+			}
+			if (IVar[v])
+			{
+				C_Int32 *p = IVar[v];
+				if (DVar[v])
+				{
+					// out of the range of 32-bit integers
+					const double *s = DVar[v];
+					for (size_t j=0; j < N; j++)
+					{
+						p[j] = ((INT32_NA < s[j]) && (s[j] <= INT32_MAX)) ?
+							C_Int32(s[j]) : NA_INT32;
+					}
+				} else {
+					Src[v]->ReadDataEx(St + d, Len + d,
+						Selection ? &Sel[d] : NULL, p, svInt32);
+					expand_source(p, m, N, d == 0);
+				}
+			}
+		}
+
+		// evaluate
+		OutBuffer = _Evaluate(&DVar[0], &IVar[0], N, OutBuffer, OutSV);
+	}
+
+	// not to keep a large buffer for a long row
+	if (Stride > (size_t)COMPUTE_BLOCK_SIZE)
+	{
+		vector<double>().swap(fBuffer);
+		vector<C_Int32>().swap(fIntBuf);
+	}
+
+	return OutBuffer;
+}
+
+void *CdComputedArray::_ReadFlat(C_Int64 Ptr, ssize_t n,
+	const C_BOOL Selection[], void *OutBuf, C_SVType OutSV)
+{
+	if ((Ptr < 0) || (Ptr + n > TotalCount()))
+		throw ErrArray("Invalid iterator position.");
+
+	// read along the last dimension
+	const int DCnt = fDim.size();
+	TArrayDim St, Len;
+	vector<const C_BOOL*> Sel(DCnt, &SEL_TRUE);
+	while (n > 0)
+	{
+		C_Int64 q = Ptr;
+		for (int j=DCnt-1; j >= 0; j--)
+		{
+			St[j] = q % fDim[j]; q /= fDim[j];
+			Len[j] = 1;
+		}
+		C_Int32 m = (C_Int32)min<C_Int64>(n, fDim[DCnt-1] - St[DCnt-1]);
+		Len[DCnt-1] = m;
+		if (Selection)
+		{
+			Sel[DCnt-1] = Selection;
+			OutBuf = _ReadRect(St, Len, &Sel[0], OutBuf, OutSV);
+			Selection += m;
+		} else
+			OutBuf = _ReadRect(St, Len, NULL, OutBuf, OutSV);
+		Ptr += m; n -= m;
+	}
+	return OutBuf;
+}
+
+void *CdComputedArray::_Evaluate(const double *const DVar[],
+	const C_Int32 *const IVar[], size_t N, void *OutBuf, C_SVType OutSV)
+{
+	// all nodes are evaluated tile by tile, so that the intermediate values
+	// stay in the cache
+	const size_t T = COMPUTE_TILE_SIZE, nn = fNode.size();
+	if (fTileDbl.size() < nn*T) fTileDbl.resize(nn*T);
+	if (fTileInt.size() < nn*T) fTileInt.resize(nn*T);
+	vector<const double*> D(nn);
+	vector<const C_Int32*> I(nn);
+
+	for (size_t t=0; t < N; t += T)
+	{
+		const size_t n = min(T, N - t);
+		for (size_t k=0; k < nn; k++)
+		{
+			const TNode &d = fNode[k];
+			double *od = &fTileDbl[k*T];
+			C_Int32 *oi = &fTileInt[k*T];
+			D[k] = NULL; I[k] = NULL;
+			if (d.IsInt)
+			{
+				// 32-bit integers, NA_INT32 for missing values
+				const C_Int32 *a = (d.A >= 0) ? I[d.A] : NULL;
+				const C_Int32 *b = (d.B >= 0) ? I[d.B] : NULL;
+				switch (d.Op)
+				{
+				case opConst:
+					{
+						const C_Int32 v = is_na(d.Value) ? NA_INT32 :
+							C_Int32(d.Value);
+						for (size_t i=0; i < n; i++) oi[i] = v;
+						break;
+					}
+				case opVar:
+					oi = NULL; I[k] = IVar[d.Var] + t;
+					if (DVar[d.Var]) D[k] = DVar[d.Var] + t;
+					break;
+				case opNeg:
+					for (size_t i=0; i < n; i++)
+						oi[i] = (a[i] != NA_INT32) ? -a[i] : NA_INT32;
+					break;
+				case opAdd:
+					eval_int_binary<op_add>(oi, a, b, n); break;
+				case opSub:
+					eval_int_binary<op_sub>(oi, a, b, n); break;
+				case opMul:
+					eval_int_binary<op_mul>(oi, a, b, n); break;
+				case opInt:
+					if (fNode[d.A].IsInt)
+					{
+						oi = NULL; I[k] = a;
+					} else {
+						const double *x = _TileDbl(d.A, D, I, n);
+						for (size_t i=0; i < n; i++)
+						{
+							const double v = trunc(x[i]);
+							oi[i] = ((INT32_NA < v) && (v <= INT32_MAX)) ?
+								C_Int32(v) : NA_INT32;
+						}
+					}
+					break;
+				case opIfNA:
+					for (size_t i=0; i < n; i++)
+						oi[i] = (a[i] != NA_INT32) ? a[i] : b[i];
+					break;
+				case opNAIf:
+					if (fNode[d.B].IsInt)
+					{
+						for (size_t i=0; i < n; i++)
+							oi[i] = (a[i] != b[i]) ? a[i] : NA_INT32;
+					} else {
+						const double *y = _TileDbl(d.B, D, I, n);
+						for (size_t i=0; i < n; i++)
+							oi[i] = (double(a[i]) != y[i]) ? a[i] : NA_INT32;
+					}
+					break;
+				default:
+					throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), 0);
+				}
+				if (oi) I[k] = oi;
+			} else {
+				const double *a = (d.A >= 0) ? _TileDbl(d.A, D, I, n) : NULL;
+				const double *b = (d.B >= 0) ? _TileDbl(d.B, D, I, n) : NULL;
+				switch (d.Op)
+				{
+				case opConst:
+					for (size_t i=0; i < n; i++) od[i] = d.Value;
+					break;
+				case opVar:
+					od = NULL; D[k] = DVar[d.Var] + t;
+					break;
+				case opNeg:
+					for (size_t i=0; i < n; i++) od[i] = -a[i];
+					break;
+				case opAdd:
+					eval_binary<op_add>(od, a, b, n); break;
+				case opSub:
+					eval_binary<op_sub>(od, a, b, n); break;
+				case opMul:
+					eval_binary<op_mul>(od, a, b, n); break;
+				case opDiv:
+					eval_binary<op_div>(od, a, b, n); break;
+				case opDbl:
+					od = NULL; D[k] = a;
+					break;
+				case opIfNA:
+					eval_binary<op_ifna>(od, a, b, n); break;
+				case opNAIf:
+					eval_binary<op_naif>(od, a, b, n); break;
+				default:
+					throw ErrArray(ERR_INV_EXPR, fExpr.c_str(), 0);
+				}
+				if (od) D[k] = od;
+			}
+		}
+
+		// the output
+		const size_t r = nn - 1;
+		if (fNode[r].IsInt)
+		{
+			void *p = cvt_int32_out(OutBuf, I[r], n, OutSV);
+			if (!p)
+			{
+				double *v = &fTileDbl[r*T];
+				const C_Int32 *s = I[r];
+				for (size_t i=0; i < n; i++)
+					v[i] = (s[i] != NA_INT32) ? s[i] : NaN;
+				p = cvt_out(OutBuf, v, n, OutSV, true);
+			}
+			OutBuf = p;
+		} else
+			OutBuf = cvt_out(OutBuf, D[r], n, OutSV, false);
+	}
+	return OutBuf;
+}
+
+const double *CdComputedArray::_TileDbl(int Index,
+	vector<const double*> &D, const vector<const C_Int32*> &I, size_t n)
+{
+	if (!D[Index])
+	{
+		// converted from 32-bit integers
+		double *p = &fTileDbl[Index * COMPUTE_TILE_SIZE];
+		const C_Int32 *s = I[Index];
+		for (size_t i=0; i < n; i++)
+			p[i] = (s[i] != NA_INT32) ? s[i] : NaN;
+		D[Index] = p;
+	}
+	return D[Index];
+}
+
+void CdComputedArray::_ReadOnly()
+{
+	throw ErrArray(ERR_COMP_READ_ONLY);
+}
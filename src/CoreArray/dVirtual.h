@@ -0,0 +1,359 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dVirtual.h: Virtual arrays in GDS format
+//
+// Copyright (C) 2026    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ *	\file     dVirtual.h
+ *	\author   Xiuwen Zheng [zhengxwen@gmail.com]
+ *	\version  1.0
+ *	\date     2026
+ *	\brief    Virtual arrays in GDS format
+ *	\details
+**/
+
+#ifndef _HEADER_COREARRAY_VIRTUAL_GDS_
+#define _HEADER_COREARRAY_VIRTUAL_GDS_
+
+#include "dStruct.h"
+#include <vector>
+
+
+namespace CoreArray
+{
+	using namespace std;
+
+	// =====================================================================
+	// Concatenated array
+	// =====================================================================
+
+	/// Read-only array concatenating member arrays along the first dimension
+	/** The member arrays have the same data type and the same dimensions
+	 *  except the first one (the last dimension in R), and they are stored
+	 *  in the same GDS file or in the files linked by virtual folders. The
+	 *  paths of members are saved, and the members are loaded on demand
+	 *  when reading, so no data is copied.
+	**/
+	class COREARRAY_DLL_DEFAULT CdConcatArray: public CdAbstractArray
+	{
+	public:
+		/// constructor
+		CdConcatArray();
+
+		/// create a new CdConcatArray object
+		virtual CdGDSObj *NewObject();
+		/// assignment from a GDS object
+		virtual void Assign(CdGDSObj &Source, bool Full);
+
+		/// return a string specifying the class name in stream
+		virtual const char *dName();
+		/// return a string specifying the class name
+		virtual const char *dTraitName();
+
+		/// set the member arrays
+		/** \param List    the member arrays, in the GDS file of this object
+		 *                 or in the files linked by virtual folders
+		 *  \param Cnt     the number of member arrays
+		**/
+		void SetMembers(CdAbstractArray *const List[], int Cnt);
+		/// check the member arrays before SetMembers(), throw an exception
+		/// if they are invalid
+		/** \param File    the GDS file of the concatenated array
+		 *  \param List    the member arrays
+		 *  \param Cnt     the number of member arrays
+		**/
+		static void CheckMembers(CdGDSFile *File,
+			CdAbstractArray *const List[], int Cnt);
+		/// the number of member arrays
+		COREARRAY_INLINE int MemberCount() const { return fMember.size(); }
+		/// the path of a member array from the root
+		COREARRAY_INLINE const UTF8String &MemberPath(int Index) const
+			{ return fMember[Index].Path; }
+		/// return a member array, which is loaded if needed
+		CdAbstractArray *Member(int Index);
+
+		virtual C_SVType SVType();
+		virtual int TraitFlag();
+		virtual unsigned BitOf();
+		virtual bool IsPrimitive();
+
+		virtual void Clear();
+		virtual bool Empty();
+		virtual C_Int64 TotalCount();
+		virtual void CloseWriter();
+		virtual void SetPackedMode(const char *Mode);
+
+		virtual int DimCnt() const;
+		virtual void GetDim(C_Int32 DimLen[]) const;
+		virtual void ResetDim(const C_Int32 DimLen[], int DCnt);
+		virtual C_Int32 GetDLen(int I) const;
+		virtual void SetDLen(int I, C_Int32 Value);
+		virtual C_Int64 TotalArrayCount();
+
+		virtual CdIterator IterBegin();
+		virtual CdIterator IterEnd();
+		virtual CdIterator Iterator(const C_Int32 DimIndex[]);
+
+		virtual void *ReadData(const C_Int32 *Start, const C_Int32 *Length,
+			void *OutBuffer, C_SVType OutSV);
+		virtual void *ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		virtual const void *WriteData(const C_Int32 *Start,
+			const C_Int32 *Length, const void *InBuffer, C_SVType InSV);
+		virtual const void *Append(const void *Buffer, ssize_t Cnt,
+			C_SVType InSV);
+
+	protected:
+		/// a member array
+		struct TMember
+		{
+			UTF8String Path;  ///< the path from the root
+			C_Int32 Start;    ///< the starting index in the first dimension
+			C_Int32 Len;      ///< the length of the first dimension
+		};
+
+		vector<TMember> fMember;  ///< the list of member arrays
+		vector<C_Int32> fDim;     ///< the dimensions
+		C_Int64 fRowCount;        ///< the number of elements per first index
+		C_SVType fSVType;         ///< the data type of members
+		int fTraitFlag;           ///< the trait flag of the first member
+		unsigned fBitOf;          ///< the number of bits of the first member
+		bool fIsPrimitive;        ///< whether members are primitive
+
+		virtual void Loading(CdReader &Reader, TdVersion Version);
+		virtual void Saving(CdWriter &Writer);
+
+		virtual void IterOffset(CdIterator &I, SIZE64 val);
+		virtual C_Int64 IterGetInteger(CdIterator &I);
+		virtual double IterGetFloat(CdIterator &I);
+		virtual UTF16String IterGetString(CdIterator &I);
+		virtual void IterSetInteger(CdIterator &I, C_Int64 val);
+		virtual void IterSetFloat(CdIterator &I, double val);
+		virtual void IterSetString(CdIterator &I, const UTF16String &val);
+		virtual void *IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV);
+		virtual void *IterRDataEx(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV, const C_BOOL Selection[]);
+		virtual const void *IterWData(CdIterator &I, const void *InBuf,
+			ssize_t n, C_SVType InSV);
+
+	private:
+		void _UpdateStart();
+		int _FindMember(C_Int32 Index) const;
+		CdIterator _MemberIter(const CdIterator &I, int &Index, C_Int64 &Cnt);
+		void _ReadOnly();
+	};
+
+
+
+	// =====================================================================
+	// Computed array
+	// =====================================================================
+
+	/// Read-only array computed elementwise from source arrays
+	/** The values are defined by an expression of source arrays and
+	 *  constants, e.g., "2 - geno" or "(x - mean) / sd", with the operators
+	 *  +, -, *, / and the functions as.integer(x), as.numeric(x),
+	 *  ifna(x, v) (replacing missing values by v) and na_if(x, v)
+	 *  (replacing v by missing values). Integers are 32-bit with NA in R as
+	 *  the missing value, and other values are double with NaN as missing.
+	 *  A constant is an integer only with the suffix L (e.g., 2L), and the
+	 *  integer subexpressions are evaluated in 32-bit integers.
+	 *  The source arrays have the dimensions of the result, or the leading
+	 *  or trailing dimensions of the result which are repeated over the
+	 *  others (e.g., per-variant means). The expression is evaluated block
+	 *  by block when reading, and nothing is stored except the expression.
+	**/
+	class COREARRAY_DLL_DEFAULT CdComputedArray: public CdAbstractArray
+	{
+	public:
+		/// constructor
+		CdComputedArray();
+
+		/// create a new CdComputedArray object
+		virtual CdGDSObj *NewObject();
+		/// assignment from a GDS object
+		virtual void Assign(CdGDSObj &Source, bool Full);
+
+		/// return a string specifying the class name in stream
+		virtual const char *dName();
+		/// return a string specifying the class name
+		virtual const char *dTraitName();
+
+		/// set the expression
+		/** \param Expr    the expression
+		 *  \param Names   the variable names of source arrays in Expr
+		 *  \param List    the source arrays, in the GDS file of this object
+		 *                 or in the files linked by virtual folders
+		 *  \param Cnt     the number of source arrays
+		**/
+		void SetExpression(const char *Expr, const char *const Names[],
+			CdAbstractArray *const List[], int Cnt);
+		/// check the expression and source arrays before SetExpression(),
+		/// throw an exception if they are invalid
+		/** \param File    the GDS file of the computed array
+		 *  \param Expr    the expression
+		 *  \param Names   the variable names of source arrays in Expr
+		 *  \param List    the source arrays
+		 *  \param Cnt     the number of source arrays
+		**/
+		static void CheckExpression(CdGDSFile *File, const char *Expr,
+			const char *const Names[], CdAbstractArray *const List[], int Cnt);
+		/// the expression
+		COREARRAY_INLINE const UTF8String &Expression() const
+			{ return fExpr; }
+		/// the number of source arrays
+		COREARRAY_INLINE int SourceCount() const { return fSource.size(); }
+		/// the variable name of a source array
+		COREARRAY_INLINE const UTF8String &SourceName(int Index) const
+			{ return fSource[Index].Name; }
+		/// the path of a source array from the root
+		COREARRAY_INLINE const UTF8String &SourcePath(int Index) const
+			{ return fSource[Index].Path; }
+		/// return a source array, which is loaded if needed
+		CdAbstractArray *Source(int Index);
+
+		virtual C_SVType SVType();
+		virtual int TraitFlag();
+		virtual unsigned BitOf();
+		virtual bool IsPrimitive();
+
+		virtual void Clear();
+		virtual bool Empty();
+		virtual C_Int64 TotalCount();
+		virtual void CloseWriter();
+		virtual void SetPackedMode(const char *Mode);
+
+		virtual int DimCnt() const;
+		virtual void GetDim(C_Int32 DimLen[]) const;
+		virtual void ResetDim(const C_Int32 DimLen[], int DCnt);
+		virtual C_Int32 GetDLen(int I) const;
+		virtual void SetDLen(int I, C_Int32 Value);
+		virtual C_Int64 TotalArrayCount();
+
+		virtual CdIterator IterBegin();
+		virtual CdIterator IterEnd();
+		virtual CdIterator Iterator(const C_Int32 DimIndex[]);
+
+		virtual void *ReadData(const C_Int32 *Start, const C_Int32 *Length,
+			void *OutBuffer, C_SVType OutSV);
+		virtual void *ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		virtual const void *WriteData(const C_Int32 *Start,
+			const C_Int32 *Length, const void *InBuffer, C_SVType InSV);
+		virtual const void *Append(const void *Buffer, ssize_t Cnt,
+			C_SVType InSV);
+
+	protected:
+		/// operators in an expression
+		enum TOp
+		{
+			opConst, opVar, opNeg, opAdd, opSub, opMul, opDiv,
+			opInt, opDbl, opIfNA, opNAIf
+		};
+		/// a node in an expression, after its operands
+		struct TNode
+		{
+			TOp Op;        ///< the operator
+			bool IsInt;    ///< whether the result is integer
+			int A, B;      ///< the indices of operands
+			double Value;  ///< the value of a constant
+			int Var;       ///< the index of a source array
+		};
+		/// a source array
+		struct TSource
+		{
+			UTF8String Name;       ///< the variable name
+			UTF8String Path;       ///< the path from the root
+			bool IsInt;            ///< whether the values are integers
+			vector<C_Int32> Dim;   ///< the dimensions
+			int DimStart;          ///< the first dimension of the result covered
+		};
+
+		UTF8String fExpr;          ///< the expression
+		vector<TSource> fSource;   ///< the list of source arrays
+		vector<TNode> fNode;       ///< the parsed expression
+		vector<C_Int32> fDim;      ///< the dimensions
+		vector<double> fBuffer;    ///< the buffer of double sources, reused
+		vector<C_Int32> fIntBuf;   ///< the buffer of integer sources, reused
+		vector<double> fTileDbl;   ///< the double values of nodes in a tile
+		vector<C_Int32> fTileInt;  ///< the integer values of nodes in a tile
+		/// the source arrays found by paths, valid if fSrcStamp is
+		/// CdGDSObj::PathStamp()
+		vector<CdAbstractArray*> fSrcCache;
+		C_UInt32 fSrcStamp;        ///< the stamp of fSrcCache
+
+		virtual void Loading(CdReader &Reader, TdVersion Version);
+		virtual void Saving(CdWriter &Writer);
+
+		virtual void IterOffset(CdIterator &I, SIZE64 val);
+		virtual C_Int64 IterGetInteger(CdIterator &I);
+		virtual double IterGetFloat(CdIterator &I);
+		virtual UTF16String IterGetString(CdIterator &I);
+		virtual void IterSetInteger(CdIterator &I, C_Int64 val);
+		virtual void IterSetFloat(CdIterator &I, double val);
+		virtual void IterSetString(CdIterator &I, const UTF16String &val);
+		virtual void *IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV);
+		virtual void *IterRDataEx(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV, const C_BOOL Selection[]);
+		virtual const void *IterWData(CdIterator &I, const void *InBuf,
+			ssize_t n, C_SVType InSV);
+
+	private:
+		void _SetExpression(CdGDSFile *File, const char *Expr,
+			const char *const Names[], CdAbstractArray *const List[], int Cnt);
+		CdAbstractArray *_CheckSource(int Index, CdAbstractArray *Obj);
+		void _Sources(vector<CdAbstractArray*> &List);
+		void _Parse();
+		int _ParseSum(const char *&p);
+		int _ParseProduct(const char *&p);
+		int _ParseUnary(const char *&p);
+		int _ParsePrimary(const char *&p);
+		int _AddNode(TOp Op, bool IsInt, int A, int B);
+		void _SetDim();
+		void *_ReadRect(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		void *_ReadFlat(C_Int64 Ptr, ssize_t n, const C_BOOL Selection[],
+			void *OutBuf, C_SVType OutSV);
+		void *_Evaluate(const double *const DVar[],
+			const C_Int32 *const IVar[], size_t N, void *OutBuf,
+			C_SVType OutSV);
+		const double *_TileDbl(int Index, vector<const double*> &D,
+			const vector<const C_Int32*> &I, size_t n);
+		void _ReadOnly();
+	};
+
+
+	/// whether an array is at or under a path from the root, or refers to
+	/// such a node through the members of concatenated arrays or the
+	/// sources of computed arrays, e.g., before adding a virtual array
+	/// at the path
+	COREARRAY_DLL_DEFAULT bool ArrayDependsOn(CdAbstractArray *Obj,
+		const UTF8String &Path);
+
+}
+
+#endif /* _HEADER_COREARRAY_VIRTUAL_GDS_ */
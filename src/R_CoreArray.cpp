@@ -38,6 +38,7 @@
 #include <map>
 #include <set>
 #include <cstring>
+#include <algorithm>
 #include <R_GDS_CPP.h>
 #include <R_ext/Rdynload.h>
 
@@ -48,6 +49,8 @@ namespace gdsfmt
 
 	/// the number of preserved bytes for a pointer to a GDS object
 	#define GDSFMT_NUM_BYTE_FOR_GDSOBJ    (4 + 16)
+	/// the offset of the handle generation, after the slot and the pointer
+	#define GDSFMT_OFFSET_GDSOBJ_GEN      (4 + 8)
 
 
 	/// a list of GDS files in the gdsfmt package
@@ -84,11 +87,193 @@ namespace gdsfmt
 	}
 
 
-	/// a list of GDS objects
-	COREARRAY_DLL_LOCAL vector<PdGDSObj> GDSFMT_GDSObj_List;
+	/// the table of handles to the GDS objects referred by R objects
+	/** A handle is a slot in the table and the generation of the slot. The
+	 *  generation is increased when the slot is released, so a stale handle
+	 *  is detected in O(1), and the released slots are reused. A slot counts
+	 *  the R objects referring to it, and is released when the last one is
+	 *  garbage collected. The table is locked, since a GDS object can be
+	 *  destroyed in any thread.
+	**/
+	class COREARRAY_DLL_LOCAL CNodeHandleTable
+	{
+	public:
+		CNodeHandleTable() { fFree = -1; }
+
+		/// return the slot of a GDS object, or allocate a new slot
+		int Add(PdGDSObj Obj)
+		{
+			C_UInt32 Gen;
+			return Add(Obj, Gen);
+		}
+
+		/// return the slot and its generation, or allocate a new slot
+		int Add(PdGDSObj Obj, C_UInt32 &Gen)
+		{
+			TdAutoMutex _m(&fMutex);
+			return _Add(Obj, Gen);
+		}
+
+		/// return the slot and its generation referred by a new R object
+		int AddRef(PdGDSObj Obj, C_UInt32 &Gen)
+		{
+			TdAutoMutex _m(&fMutex);
+			int idx = _Add(Obj, Gen);
+			fSlots[idx].Ref ++;
+			return idx;
+		}
+
+		/// an R object referring to a slot is garbage collected, and the
+		/// slot is released if no R object refers to it
+		void Unref(int Slot, C_UInt32 Gen)
+		{
+			TdAutoMutex _m(&fMutex);
+			if ((Slot < 0) || (Slot >= (int)fSlots.size())) return;
+			TSlot &s = fSlots[Slot];
+			if ((s.Gen != Gen) || !s.Obj) return;
+			if (--s.Ref <= 0)
+			{
+				fMap.erase(s.Obj);
+				_Free(Slot);
+			}
+		}
+
+		/// whether a GDS object is referred by an R object
+		bool InUse(PdGDSObj Obj) const
+		{
+			TdAutoMutex _m(&fMutex);
+			map<PdGDSObj, int>::const_iterator it = fMap.find(Obj);
+			return (it != fMap.end()) && (fSlots[it->second].Ref > 0);
+		}
+
+		/// return the slot of a GDS object, or -1 if not found
+		int Find(PdGDSObj Obj) const
+		{
+			TdAutoMutex _m(&fMutex);
+			map<PdGDSObj, int>::const_iterator it = fMap.find(Obj);
+			return (it != fMap.end()) ? it->second : -1;
+		}
+
+		/// release the slot of a GDS object if any
+		void Remove(PdGDSObj Obj)
+		{
+			TdAutoMutex _m(&fMutex);
+			map<PdGDSObj, int>::iterator it = fMap.find(Obj);
+			if (it != fMap.end())
+			{
+				const int idx = it->second;
+				fMap.erase(it);
+				_Free(idx);
+			}
+		}
 
-	/// mapping from GDS objects to indices
-	COREARRAY_DLL_LOCAL map<PdGDSObj, int> GDSFMT_GDSObj_Map;
+		/// release a slot
+		void Release(int Slot)
+		{
+			TdAutoMutex _m(&fMutex);
+			PdGDSObj Obj = fSlots[Slot].Obj;
+			if (Obj)
+			{
+				fMap.erase(Obj);
+				_Free(Slot);
+			}
+		}
+
+		/// remove all handles
+		void Clear()
+		{
+			TdAutoMutex _m(&fMutex);
+			fSlots.clear(); fMap.clear();
+			fFree = -1;
+		}
+
+		/// the number of slots, including the released ones
+		int Count() const
+		{
+			TdAutoMutex _m(&fMutex);
+			return fSlots.size();
+		}
+		/// the GDS object in a slot, or NULL if released or out of range
+		PdGDSObj Obj(int Slot) const
+		{
+			TdAutoMutex _m(&fMutex);
+			if ((Slot < 0) || (Slot >= (int)fSlots.size())) return NULL;
+			return fSlots[Slot].Obj;
+		}
+		/// the generation of a slot
+		C_UInt32 Gen(int Slot) const
+		{
+			TdAutoMutex _m(&fMutex);
+			return fSlots[Slot].Gen;
+		}
+		/// validate a handle and return its GDS object in one locked step,
+		/// or NULL if the slot is out of range, released or reused
+		PdGDSObj Get(int Slot, C_UInt32 Gen) const
+		{
+			TdAutoMutex _m(&fMutex);
+			if ((Slot < 0) || (Slot >= (int)fSlots.size())) return NULL;
+			const TSlot &s = fSlots[Slot];
+			return (s.Gen == Gen) ? s.Obj : NULL;
+		}
+
+	private:
+		struct TSlot
+		{
+			PdGDSObj Obj;    ///< NULL if the slot is released
+			C_UInt32 Gen;    ///< increased when the slot is released
+			int Ref;         ///< the number of R objects referring to the slot
+			int NextFree;    ///< the next released slot
+		};
+		vector<TSlot> fSlots;
+		map<PdGDSObj, int> fMap;  ///< mapping from GDS objects to slots
+		int fFree;                ///< the first released slot, or -1
+		mutable CdThreadMutex fMutex;  ///< protecting the table
+
+		int _Add(PdGDSObj Obj, C_UInt32 &Gen)
+		{
+			map<PdGDSObj, int>::iterator it = fMap.find(Obj);
+			if (it != fMap.end())
+			{
+				Gen = fSlots[it->second].Gen;
+				return it->second;
+			}
+			int idx;
+			if (fFree >= 0)
+			{
+				idx = fFree;
+				fFree = fSlots[idx].NextFree;
+			} else {
+				idx = fSlots.size();
+				TSlot s = { NULL, 1, 0, -1 };
+				fSlots.push_back(s);
+			}
+			TSlot &s = fSlots[idx];
+			s.Obj = Obj;
+			s.NextFree = -1;
+			fMap[Obj] = idx;
+			Gen = s.Gen;
+			return idx;
+		}
+
+		void _Free(int idx)
+		{
+			TSlot &s = fSlots[idx];
+			s.Obj = NULL;
+			s.Ref = 0;
+			if (++s.Gen == 0) s.Gen = 1;  // 0 is never a valid generation
+			s.NextFree = fFree;
+			fFree = idx;
+		}
+	};
+
+	/// handles to the GDS objects
+	COREARRAY_DLL_LOCAL CNodeHandleTable GDSFMT_GDSObj_Handles;
+
+	/// release the handle of a GDS object when it is destroyed
+	COREARRAY_DLL_LOCAL void GDSObj_OnDestroy(CdGDSObj *Obj)
+	{
+		GDSFMT_GDSObj_Handles.Remove(Obj);
+	}
 
 
 	/// initialization and finalization
@@ -99,14 +284,14 @@ namespace gdsfmt
 		CInitObject()
 		{
 			memset(PKG_GDS_Files, 0, sizeof(PKG_GDS_Files));
-			GDSFMT_GDSObj_List.reserve(1024);
+			CdGDSObj::SetOnDestroy(GDSObj_OnDestroy);
 		}
 
 		/// finalization
 		~CInitObject()
 		{
-			GDSFMT_GDSObj_List.clear();
-			GDSFMT_GDSObj_Map.clear();
+			CdGDSObj::SetOnDestroy(NULL);
+			GDSFMT_GDSObj_Handles.Clear();
 
 			for (int i=0; i < GDSFMT_MAX_NUM_GDS_FILES; i++)
 			{
@@ -232,6 +417,34 @@ COREARRAY_DLL_LOCAL SEXP new_gdsptr_obj(CdGDSFile *file, SEXP id, bool do_free)
 }
 
 
+/// whether a GDS node is referenced by an R object, kept in the node cache
+COREARRAY_DLL_LOCAL bool gds_obj_in_use(CdGDSObj *Obj)
+{
+	return GDSFMT_GDSObj_Handles.InUse(Obj);
+}
+
+/// the attribute of a gdsn.class object holding its reference to the handle
+static SEXP gdsn_handle_symbol()
+{
+	static SEXP sym = NULL;
+	if (!sym) sym = Rf_install("gds.handle");
+	return sym;
+}
+
+/// the finalizer of the reference to a handle, when the gdsn.class object
+/// and its copies are garbage collected
+static void gdsn_handle_free(SEXP ptr_obj)
+{
+	SEXP h = R_ExternalPtrTag(ptr_obj);
+	if ((TYPEOF(h) == INTSXP) && (XLENGTH(h) == 2))
+	{
+		C_UInt32 gen;
+		memcpy(&gen, &INTEGER(h)[1], sizeof(gen));
+		GDSFMT_GDSObj_Handles.Unref(INTEGER(h)[0], gen);
+	}
+}
+
+
 /// Build a complete gds.class R list from PdGDSFile (requiring >= v1.49.1)
 COREARRAY_DLL_EXPORT SEXP GDS_R_MakeFileObj(PdGDSFile file,
 	const char *filename, C_BOOL readonly)
@@ -286,17 +499,19 @@ COREARRAY_INLINE static PdGDSObj CheckSEXPObject(SEXP Obj, bool Full)
 	Rbyte *p = RAW(Obj);
 	int idx;
 	PdGDSObj rv;
+	C_UInt32 gen;
 	memcpy(&idx, p            , sizeof(int));
 	memcpy(&rv,  p+sizeof(int), sizeof(PdGDSObj));
+	memcpy(&gen, p+GDSFMT_OFFSET_GDSOBJ_GEN, sizeof(gen));
 
 	if (Full)
 	{
 		// check
-		if ((idx < 0) || (idx >= (int)GDSFMT_GDSObj_List.size()))
+		if ((idx < 0) || (rv == NULL))
 			throw ErrGDSFmt(ERR_GDS_OBJ);
-		if (rv == NULL)
-			throw ErrGDSFmt(ERR_GDS_OBJ);
-		if (GDSFMT_GDSObj_List[idx] != rv)
+		// validate the slot and fetch its object under a single lock
+		PdGDSObj obj = GDSFMT_GDSObj_Handles.Get(idx, gen);
+		if (obj != rv)
 			throw ErrGDSFmt(ERR_GDS_OBJ2);
 	}
 
@@ -384,8 +599,6 @@ COREARRAY_DLL_EXPORT PdGDSObj GDS_R_SEXP2Obj(SEXP Obj, C_BOOL ReadOnly)
 /// convert "(CdGDSObj*)  -->  SEXP"
 COREARRAY_DLL_EXPORT SEXP GDS_R_Obj2SEXP(PdGDSObj Obj)
 {
-	static const char *ERR_OBJ2SEXP = "Internal error in 'GDS_R_Obj2SEXP'.";
-
 	SEXP rv = R_NilValue;
 	if (Obj != NULL)
 	{
@@ -394,33 +607,22 @@ COREARRAY_DLL_EXPORT SEXP GDS_R_Obj2SEXP(PdGDSObj Obj)
 		Rbyte *p = RAW(rv);
 		memset(p, 0, GDSFMT_NUM_BYTE_FOR_GDSOBJ);
 
-		int idx;
-		map<PdGDSObj, int>::iterator it = GDSFMT_GDSObj_Map.find(Obj);
-		if (it != GDSFMT_GDSObj_Map.end())
-		{
-			idx = it->second;
-			if ((idx < 0) || (idx >= (int)GDSFMT_GDSObj_List.size()))
-				throw ErrGDSFmt(ERR_OBJ2SEXP);
-			if (GDSFMT_GDSObj_List[idx] != Obj)
-				throw ErrGDSFmt(ERR_OBJ2SEXP);
-		} else {
-			vector<PdGDSObj>::iterator it =
-				find(GDSFMT_GDSObj_List.begin(), GDSFMT_GDSObj_List.end(),
-				(PdGDSObj)NULL);
-			if (it != GDSFMT_GDSObj_List.end())
-			{
-				idx = it - GDSFMT_GDSObj_List.begin();
-				*it = Obj;
-			} else {
-				idx = GDSFMT_GDSObj_List.size();
-				GDSFMT_GDSObj_List.push_back(Obj);
-			}
-			GDSFMT_GDSObj_Map[Obj] = idx;
-		}
+		C_UInt32 gen;
+		int idx = GDSFMT_GDSObj_Handles.AddRef(Obj, gen);
 		memcpy(p            , &idx, sizeof(int));
 		memcpy(p+sizeof(int), &Obj, sizeof(PdGDSObj));
-
-		UNPROTECT(1);
+		memcpy(p+GDSFMT_OFFSET_GDSOBJ_GEN, &gen, sizeof(gen));
+
+		// the reference to the handle, shared by the copies of rv and
+		//   released by the finalizer
+		SEXP h = PROTECT(NEW_INTEGER(2));
+		INTEGER(h)[0] = idx;
+		memcpy(&INTEGER(h)[1], &gen, sizeof(gen));
+		SEXP ptr = PROTECT(R_MakeExternalPtr(NULL, h, R_NilValue));
+		R_RegisterCFinalizerEx(ptr, gdsn_handle_free, (Rboolean)FALSE);
+		Rf_setAttrib(rv, gdsn_handle_symbol(), ptr);
+
+		UNPROTECT(3);
 	}
 	return rv;
 }
@@ -431,6 +633,8 @@ COREARRAY_DLL_EXPORT void GDS_R_Obj_SEXP2SEXP(SEXP ObjDst, SEXP ObjSrc)
 	CheckSEXPObject(ObjDst, false);
 	CheckSEXPObject(ObjSrc, true);
 	memcpy(RAW(ObjDst), RAW(ObjSrc), GDSFMT_NUM_BYTE_FOR_GDSOBJ);
+	Rf_setAttrib(ObjDst, gdsn_handle_symbol(),
+		Rf_getAttrib(ObjSrc, gdsn_handle_symbol()));
 }
 
 /// return true, if Obj is a logical object in R
@@ -708,25 +912,585 @@ COREARRAY_DLL_EXPORT SEXP GDS_R_Array_Read(PdAbstractArray Obj,
 	return rv_ans;
 }
 
-/// apply user-defined function margin by margin
+// ===========================================================================
+// decoding with multiple threads
+
+/// close the files opened by open_thread_objects
+static void close_thread_objects(vector<CdGDSFile*> &Files)
+{
+	for (size_t i=0; i < Files.size(); i++)
+	{
+		try { delete Files[i]; } catch (...) { }
+	}
+	Files.clear();
+}
+
+/// open the GDS files again to have independent decoders in threads
+/** \param Num       the number of objects
+ *  \param ObjList   the array objects
+ *  \param iStart    the first thread with a reopened file, threads before
+ *                   iStart use ObjList
+ *  \param nThread   the number of threads
+ *  \param Files     the opened files, to be closed by close_thread_objects
+ *  \param List      List[thread][object], or all ObjList if returning false
+ *  \return false if the files are not read-only or cannot be opened again
+**/
+static bool open_thread_objects(int Num, const PdAbstractArray ObjList[],
+	int iStart, int nThread, vector<CdGDSFile*> &Files,
+	vector< vector<PdAbstractArray> > &List)
+{
+	List.assign(nThread, vector<PdAbstractArray>(ObjList, ObjList + Num));
+	bool ok = true;
+	for (int i=0; (i < Num) && ok; i++)
+	{
+		CdGDSFile *f = ObjList[i]->GDSFile();
+		ok = f && f->ReadOnly() && !f->FileName().empty();
+	}
+	try {
+		// the block indices shared with the reopened objects, instead of
+		// scanning the block headers again
+		vector< vector<SIZE64> > RawSize(Num), CmpSize(Num);
+		vector<bool> HasBlock(Num, false);
+		for (int i=0; (i < Num) && ok && (iStart < nThread); i++)
+		{
+			CdAllocArray *p = dynamic_cast<CdAllocArray*>(ObjList[i]);
+			if (p) HasBlock[i] = p->GetRABlockInfo(RawSize[i], CmpSize[i]);
+		}
+		for (int t=iStart; (t < nThread) && ok; t++)
+		{
+			map<CdGDSFile*, CdGDSFile*> Opened;
+			for (int i=0; (i < Num) && ok; i++)
+			{
+				CdGDSFile *src = ObjList[i]->GDSFile();
+				CdGDSFile *&f = Opened[src];
+				if (!f)
+				{
+					f = new CdGDSFile;
+					Files.push_back(f);
+					f->LoadFile(src->FileName(), true);
+				}
+				PdAbstractArray a = dynamic_cast<PdAbstractArray>(
+					f->Root().PathEx(ObjList[i]->FullName()));
+				ok = a && (a->DimCnt() == ObjList[i]->DimCnt()) &&
+					(a->TotalCount() == ObjList[i]->TotalCount()) &&
+					(a->SVType() == ObjList[i]->SVType());
+				if (ok)
+				{
+					CdAllocArray *p = dynamic_cast<CdAllocArray*>(a);
+					if (HasBlock[i] && p)
+						p->SetRABlockInfo(RawSize[i], CmpSize[i]);
+					List[t][i] = a;
+				}
+			}
+		}
+	} catch (...) {
+		ok = false;
+	}
+	if (!ok)
+	{
+		close_thread_objects(Files);
+		List.assign(nThread, vector<PdAbstractArray>(ObjList, ObjList + Num));
+	}
+	return ok;
+}
+
+namespace gdsfmt
+{
+	/// the maximum number of ranges decoded ahead in the last GDS_R_Apply2
+	COREARRAY_DLL_LOCAL int ApplyDecoderMaxAhead = 0;
+}
+
+/// decoding the margins ahead on worker threads for GDS_R_Apply2
+/** The selected margins are split into ranges aligned to the compressed
+ *  blocks, and each worker thread reads a range with its own decoder into
+ *  the ring of slots of that range. The R evaluator consumes the slots in
+ *  order. The ranges in flight are no more than the threads, and a worker
+ *  waits if it is more than 'QSize' margins ahead in its own range, so all
+ *  threads decode ahead simultaneously.
+**/
+class COREARRAY_DLL_LOCAL CApplyDecoder
+{
+public:
+	/// a decoded margin of all objects
+	struct TSlot
+	{
+		vector< vector<C_UInt8> > Buf;     ///< numeric data for each object
+		vector< vector<UTF8String> > Str;  ///< strings for each object
+		bool Ready;                        ///< true if decoded
+	};
+
+	CApplyDecoder(): Cancel(NULL), Consumed(0), CurRange(0), NextRange(0),
+		NextThread(0), MaxAhead(0), Abort(false), Stop(false) { }
+	~CApplyDecoder() { Done(); ApplyDecoderMaxAhead = MaxAhead; }
+
+	/// start the threads, return false if the files cannot be opened again
+	bool Start(int Num, const PdAbstractArray ObjList[], const int Margins[],
+		const C_SVType SVType[], const C_BOOL *const * const Selection[],
+		int nThread, C_Int64 BufferSize);
+	/// wait for the margin 'Idx' (starting from 0) decoded
+	TSlot &Wait(C_Int32 Idx);
+	/// release the slot of margin 'Idx' after copying data
+	void Release(C_Int32 Idx);
+	/// stop and join the threads, and close the files
+	void Done();
+
+	/// the cancellation token of the call, or NULL
+	const CdCancelToken *Cancel;
+	/// the margin indices of ObjList[0] for all selected margins
+	vector<C_Int32> Pos0;
+	/// the maximum number of ranges decoded ahead when waiting
+	int MaxAhead;
+
+private:
+	int Num, QSize, nRing;
+	vector<int> Margin;
+	vector<C_SVType> SV;
+	vector< vector< vector<C_BOOL> > > Sel;  ///< Sel[object][dimension]
+	vector< vector<C_Int32> > Pos;           ///< margin indices of objects
+	vector<C_Int32> Range;   ///< the boundaries of ranges in selected indices
+	vector< vector<PdAbstractArray> > ObjList;  ///< ObjList[thread][object]
+	vector<CdGDSFile*> Files;
+	C_Int64 BufferSize;      ///< the buffer size for each thread
+	vector< vector<TSlot> > Ring;  ///< the slots of range k in Ring[k % nRing]
+	vector<C_Int32> Decoded; ///< the number of decoded margins in Ring[i]
+	vector<CdThread*> Threads;
+	CdThreadMutex Mutex;
+	CdThreadCondition Cond;
+	C_Int32 Consumed;        ///< the number of consumed margins
+	int CurRange;            ///< the range of the next consumed margin
+	int NextRange, NextThread;
+	bool Abort, Stop;
+	string ErrMsg;
+
+	static int Proc(CdThread *Thread, CApplyDecoder *D);
+	void Run();
+	void NextConsumed();
+};
+
+bool CApplyDecoder::Start(int num, const PdAbstractArray ObjList_[],
+	const int Margins[], const C_SVType SVType[],
+	const C_BOOL *const * const Selection[], int nThread, C_Int64 BufSize)
+{
+	Num = num;
+	Margin.assign(Margins, Margins + Num);
+	SV.assign(SVType, SVType + Num);
+	Sel.resize(Num); Pos.resize(Num);
+	for (int i=0; i < Num; i++)
+	{
+		const int DimCnt = ObjList_[i]->DimCnt();
+		C_Int32 DLen[GDS_MAX_NUM_DIMENSION];
+		ObjList_[i]->GetDim(DLen);
+		Sel[i].resize(DimCnt);
+		for (int j=0; j < DimCnt; j++)
+		{
+			if (Selection[i] && Selection[i][j])
+				Sel[i][j].assign(Selection[i][j], Selection[i][j] + DLen[j]);
+			else
+				Sel[i][j].assign(DLen[j], 1);
+		}
+		const vector<C_BOOL> &S = Sel[i][Margin[i]];
+		for (C_Int32 j=0; j < (C_Int32)S.size(); j++)
+			if (S[j]) Pos[i].push_back(j);
+	}
+	const C_Int32 Total = Pos[0].size();
+	Pos0 = Pos[0];
+	if (Total <= 0) return false;
+
+	// the ranges aligned to the blocks of ObjList[0]
+	vector<C_Int32> Split;
+	Split_ArrayRead_Margin(*ObjList_[0], Margin[0], &Sel[0][Margin[0]][0],
+		nThread * 4, Split);
+	Range.clear();
+	for (size_t k=0; k < Split.size(); k++)
+	{
+		Range.push_back(lower_bound(Pos[0].begin(), Pos[0].end(), Split[k]) -
+			Pos[0].begin());
+	}
+	if (nThread > (int)Range.size() - 1)
+		nThread = Range.size() - 1;
+
+	// each thread has its own decoders, otherwise no thread
+	if (!open_thread_objects(Num, ObjList_, 0, nThread, Files, ObjList))
+		return false;
+
+	// half of the budget for the readers, and the other half for the slots
+	// of the ranges in flight, one range per thread
+	const C_Int64 Budget = (BufSize >= 0) ? BufSize : ARRAY_READ_MEM_BUFFER_SIZE;
+	BufferSize = Budget / 2 / nThread;
+	C_Int64 MSize = 0;
+	for (int i=0; i < Num; i++)
+	{
+		C_Int64 n = 1;
+		for (int j=0; j < (int)Sel[i].size(); j++)
+		{
+			if (j == Margin[i]) continue;
+			C_Int64 m = 0;
+			for (size_t k=0; k < Sel[i][j].size(); k++) m += Sel[i][j][k] ? 1:0;
+			n *= m;
+		}
+		MSize += n * (COREARRAY_SV_STRING(SV[i]) ? 32 : 8);
+	}
+	C_Int32 MaxLen = 0;
+	for (size_t k=0; k+1 < Range.size(); k++)
+		MaxLen = std::max(MaxLen, Range[k+1] - Range[k]);
+	C_Int64 q = Budget / 2 / nThread / (MSize > 0 ? MSize : 1);
+	QSize = (int)std::max((C_Int64)2, std::min(q, (C_Int64)MaxLen));
+	nRing = nThread;
+	Ring.resize(nRing);
+	Decoded.assign(nRing, 0);
+	for (int r=0; r < nRing; r++)
+	{
+		Ring[r].resize(QSize);
+		for (int k=0; k < QSize; k++)
+		{
+			Ring[r][k].Buf.resize(Num);
+			Ring[r][k].Str.resize(Num);
+			Ring[r][k].Ready = false;
+		}
+	}
+	NextConsumed();
+
+	// start the threads
+	for (int i=0; i < nThread; i++)
+	{
+		CdThread *th = new CdThread;
+		Threads.push_back(th);
+		th->BeginThread(Proc, this);
+	}
+	return true;
+}
+
+CApplyDecoder::TSlot &CApplyDecoder::Wait(C_Int32 Idx)
+{
+	TdAutoMutex _m(&Mutex);
+	TSlot &s = Ring[CurRange % nRing][(Idx - Range[CurRange]) % QSize];
+	// the ranges having decoded margins ahead
+	int n = 0;
+	for (int k=CurRange; (k < CurRange + nRing) && (k+1 < (int)Range.size()); k++)
+	{
+		C_Int32 c = (k == CurRange) ? (Consumed - Range[k]) : 0;
+		if (Decoded[k % nRing] > c) n ++;
+	}
+	if (n > MaxAhead) MaxAhead = n;
+	while (!s.Ready && !Abort)
+		Cond.Wait(Mutex);
+	if (Abort)
+		throw ErrGDSFmt(ErrMsg);
+	return s;
+}
+
+void CApplyDecoder::Release(C_Int32 Idx)
+{
+	TdAutoMutex _m(&Mutex);
+	Ring[CurRange % nRing][(Idx - Range[CurRange]) % QSize].Ready = false;
+	Consumed = Idx + 1;
+	NextConsumed();
+	Cond.Broadcast();
+}
+
+void CApplyDecoder::NextConsumed()
+{
+	// move to the range of the next margin, and its ring is free then
+	while ((CurRange+1 < (int)Range.size()) && (Consumed >= Range[CurRange+1]))
+	{
+		Decoded[CurRange % nRing] = 0;
+		CurRange ++;
+	}
+}
+
+void CApplyDecoder::Done()
+{
+	{
+		TdAutoMutex _m(&Mutex);
+		Stop = true;
+		Cond.Broadcast();
+	}
+	for (size_t i=0; i < Threads.size(); i++)
+	{
+		try {
+			Threads[i]->EndThread();
+		} catch (...) { }
+		delete Threads[i];
+	}
+	Threads.clear();
+	close_thread_objects(Files);
+}
+
+int CApplyDecoder::Proc(CdThread *Thread, CApplyDecoder *D)
+{
+	try {
+		D->Run();
+	}
+	catch (exception &E)
+	{
+		TdAutoMutex _m(&D->Mutex);
+		if (!D->Abort) D->ErrMsg = E.what();
+		D->Abort = true;
+		D->Cond.Broadcast();
+	}
+	catch (...)
+	{
+		TdAutoMutex _m(&D->Mutex);
+		if (!D->Abort) D->ErrMsg = "GDS_R_Apply: unknown error in decoding.";
+		D->Abort = true;
+		D->Cond.Broadcast();
+	}
+	return 0;
+}
+
+void CApplyDecoder::Run()
+{
+	int iThread;
+	{
+		TdAutoMutex _m(&Mutex);
+		iThread = NextThread ++;
+	}
+	// bind to a NUMA node like the workers of ThreadPool()
+	if (ThreadPool().NumaPlacement())
+	{
+		const int nNode = Mach::GetNUMA_NumOfNodes();
+		if (nNode > 1) Mach::SetNUMA_ThreadNode(iThread % nNode);
+	}
+	const int nRange = (int)Range.size() - 1;
+	vector< vector<C_BOOL> > MarginSel(Num);
+	vector< vector<const C_BOOL*> > SelPtr(Num);
+
+	while (true)
+	{
+		// get the next range, and wait for its ring released by the range
+		// 'k - nRing'
+		int k;
+		{
+			TdAutoMutex _m(&Mutex);
+			if (Abort || Stop || (Cancel && Cancel->Cancelled()) ||
+				(NextRange >= nRange)) break;
+			k = NextRange ++;
+			while ((k >= CurRange + nRing) && !Abort && !Stop)
+				Cond.Wait(Mutex);
+			if (Abort || Stop) return;
+		}
+		const C_Int32 st = Range[k], ed = Range[k+1];
+		vector<TSlot> &Slot = Ring[k % nRing];
+
+		// the readers restricted to the range
+		vector<CdArrayRead> Array(Num);
+		vector<PdArrayRead> ArrayList(Num);
+		for (int i=0; i < Num; i++)
+		{
+			SelPtr[i].resize(Sel[i].size());
+			for (size_t j=0; j < Sel[i].size(); j++)
+				SelPtr[i][j] = &Sel[i][j][0];
+			MarginSel[i].assign(Sel[i][Margin[i]].size(), 0);
+			for (C_Int32 j=st; j < ed; j++)
+				MarginSel[i][Pos[i][j]] = 1;
+			SelPtr[i][Margin[i]] = &MarginSel[i][0];
+			Array[i].Init(*ObjList[iThread][i], Margin[i], SV[i],
+				&SelPtr[i][0], false);
+			ArrayList[i] = &Array[i];
+		}
+		Balance_ArrayRead_Buffer(&ArrayList[0], Num, BufferSize);
+
+		// decode margin by margin
+		for (C_Int32 Idx=st; Idx < ed; Idx++)
+		{
+			{
+				TdAutoMutex _m(&Mutex);
+				while ((Idx >= std::max(Consumed, st) + QSize) && !Abort && !Stop)
+					Cond.Wait(Mutex);
+				if (Abort || Stop) return;
+			}
+			TSlot &s = Slot[(Idx - st) % QSize];
+			for (int i=0; i < Num; i++)
+			{
+				const C_Int64 n = Array[i].MarginCount();
+				if (COREARRAY_SV_STRING(SV[i]))
+				{
+					if ((C_Int64)s.Str[i].size() < n) s.Str[i].resize(n);
+					Array[i].Read(n > 0 ? &s.Str[i][0] : NULL);
+				} else {
+					const C_Int64 m = Array[i].MarginSize();
+					if ((C_Int64)s.Buf[i].size() < m) s.Buf[i].resize(m);
+					Array[i].Read(m > 0 ? &s.Buf[i][0] : NULL);
+				}
+			}
+			TdAutoMutex _m(&Mutex);
+			s.Ready = true;
+			Decoded[k % nRing] ++;
+			Cond.Broadcast();
+		}
+	}
+}
+
+
+/// the readers and decoders of a running GDS_R_Apply2
+/** It is allocated on the heap and registered in ApplyStateList, since the
+ *  R evaluator may jump out of GDS_R_Apply2 because of an error or an
+ *  interrupt, and then the prefetching threads and decoders are joined by
+ *  ApplyDecoderStop() instead of being left running.
+**/
+class COREARRAY_DLL_LOCAL CApplyState
+{
+public:
+	CApplyState(int Num): Array(Num), Decoder(NULL), ProgDone(0),
+		ProgTotal(0) { }
+	~CApplyState()
+	{
+		JoinPrefetch();
+		if (Decoder) delete Decoder;
+	}
+
+	/// join the prefetching threads
+	void JoinPrefetch()
+	{
+		for (size_t i=0; i < Array.size(); i++)
+		{
+			try {
+				Array[i].SetPrefetch(false);
+			} catch (...) { }
+		}
+	}
+
+	/// array read objects
+	vector<CdArrayRead> Array;
+	/// the GDS files of array read objects
+	vector<CdGDSFile*> Files;
+	/// the decoding threads, or NULL
+	CApplyDecoder *Decoder;
+	/// the cancellation token, see GDS_R_Apply_Cancel()
+	CdCancelToken Cancel;
+	/// the numbers of finished and all margins, see GDS_R_Apply_Progress()
+	volatile C_Int64 ProgDone, ProgTotal;
+};
+
+
+/// protecting ApplyStateList, which is also read by GDS_R_Apply_Progress()
+/// and GDS_R_Apply_Cancel() from other threads
+static CdThreadMutex ApplyStateMutex;
+/// the cancellation requested when no GDS_R_Apply2 is running, taken by the
+/// next call
+static CdCancelToken ApplyCancelPending;
+/// the numbers of finished and all margins of the last outermost call
+static C_Int64 ApplyLastDone = 0, ApplyLastTotal = 0;
+
+/// remove the state from ApplyStateList, return false if not found
+static bool apply_state_remove(CApplyState *d);
+
+
+namespace gdsfmt
+{
+	/// the states of the running GDS_R_Apply2 (nested calls are stacked),
+	/// which are not released if the R evaluator jumps out
+	COREARRAY_DLL_LOCAL vector<CApplyState*> ApplyStateList;
+
+	/// stop the readers and decoders and delete the states from the n-th,
+	/// return the number of running GDS_R_Apply2
+	COREARRAY_DLL_LOCAL int ApplyDecoderStop(int n)
+	{
+		if (n < 0) n = 0;
+		while ((int)ApplyStateList.size() > n)
+		{
+			CApplyState *d = ApplyStateList.back();
+			apply_state_remove(d);
+			delete d;
+		}
+		return ApplyStateList.size();
+	}
+}
+
+namespace gdsfmt
+{
+	/// set the limit of MemGovernor() from 'options(gds.memory.limit)', called
+	/// by all functions reading arrays with CdArrayRead
+	COREARRAY_DLL_LOCAL void SetMemoryLimit()
+	{
+		double limit = Rf_asReal(
+			Rf_GetOption1(Rf_install("gds.memory.limit")));
+		MemGovernor().SetLimit(R_FINITE(limit) ? (C_Int64)limit : 0);
+	}
+}
+
+static bool apply_state_remove(CApplyState *d)
+{
+	TdAutoMutex _m(&ApplyStateMutex);
+	vector<CApplyState*>::iterator it =
+		find(ApplyStateList.begin(), ApplyStateList.end(), d);
+	if (it == ApplyStateList.end()) return false;
+	if (it == ApplyStateList.begin())
+	{
+		ApplyLastDone = AtomicLoad(d->ProgDone);
+		ApplyLastTotal = AtomicLoad(d->ProgTotal);
+	}
+	ApplyStateList.erase(it);
+	return true;
+}
+
+static void apply_state_free(CApplyState *d)
+{
+	if (d)
+	{
+		apply_state_remove(d);
+		delete d;
+	}
+}
+
+/// release the state when GDS_R_Apply2 returns or throws an exception
+struct COREARRAY_DLL_LOCAL CApplyStateGuard
+{
+	CApplyState *State;
+	CApplyStateGuard(CApplyState *s): State(s) { }
+	~CApplyStateGuard() { apply_state_free(State); }
+};
+
+/// join the prefetching threads reading the file before it is closed
+static void apply_state_join(CdGDSFile *File)
+{
+	for (size_t i=0; i < ApplyStateList.size(); i++)
+	{
+		CApplyState *d = ApplyStateList[i];
+		if (find(d->Files.begin(), d->Files.end(), File) != d->Files.end())
+			d->JoinPrefetch();
+	}
+}
+
+/// the progress of GDS_R_Apply2 shown in the R console
+class COREARRAY_DLL_LOCAL CApplyProgress: public CdBaseProgression
+{
+public:
+	CApplyProgress(): CdBaseProgression(tp10) { }
+	virtual void ShowProgress()
+	{
+		Rprintf("[%s] %d%%\n", NowDateToStr().c_str(), fPercent);
+	}
+};
+
+/// throw an exception if GDS_R_Apply_Cancel() was called
+static void apply_check_cancel(const CApplyState *State)
+{
+	if (State->Cancel.Cancelled())
+		throw ErrGDSFmt("GDS_R_Apply: cancelled.");
+}
+
+/// apply user-defined function margin by margin with a memory budget
 /** \param Num         [in] the number of GDS objects
  *  \param ObjList     [in] a list of GDS objects
  *  \param Margins     [in  margin indices starting from 0 with C orders
  *  \param Selection   [in] indicating selection
  *  \param Func        [in] a user-defined function
  *  \param Param       [in] the parameter passed to the user-defined function
+ *  \param BufferSize  [in] the memory budget of buffers, -1 for the default
 **/
-COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
+COREARRAY_DLL_EXPORT void GDS_R_Apply2(int Num, PdAbstractArray ObjList[],
 	int Margins[], const C_BOOL *const * const Selection[],
 	void (*InitFunc)(SEXP Argument, C_Int32 Count, PdArrayRead ReadObjList[],
 		void *_Param),
 	void (*LoopFunc)(SEXP Argument, C_Int32 Idx, void *_Param),
-	void *Param, C_BOOL IncOrDec, C_UInt32 UseMode)
+	void *Param, C_BOOL IncOrDec, C_UInt32 UseMode, C_Int64 BufferSize)
 {
 	if (Num <= 0)
 		throw ErrGDSFmt("GDS_R_Apply: Invalid 'Num=%d'.", Num);
 	if (!IncOrDec)
 		throw ErrGDSFmt("GDS_R_Apply: The current implementation does not support 'IncOrDec=FALSE'.");
+	SetMemoryLimit();
 
 	// -----------------------------------------------------------
 	// get dimension information
@@ -759,12 +1523,27 @@ COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 	// -----------------------------------------------------------
 	// initialize variables
 
-	// array read object
-	vector<CdArrayRead> Array(Num);
+	// the array read objects and decoders, released by ApplyDecoderStop()
+	// if the user-defined function jumps out
+	CApplyState *State = new CApplyState(Num);
+	{
+		TdAutoMutex _m(&ApplyStateMutex);
+		ApplyStateList.push_back(State);
+		if (ApplyCancelPending.Cancelled())
+		{
+			State->Cancel.Cancel();
+			ApplyCancelPending.Reset();
+		}
+	}
+	CApplyStateGuard StateGuard(State);
+	vector<CdArrayRead> &Array = State->Array;
 	vector<PdArrayRead> ArrayList(Num);
 	for (int i=0; i < Num; i++)
 	{
 		ArrayList[i] = &Array[i];
+		State->Files.push_back(ObjList[i]->GDSFile());
+		if (UseMode & GDS_R_READ_PREFETCH)
+			Array[i].SetPrefetch(true);
 		if (COREARRAY_SV_INTEGER(SVType[i]))
 		{
 			enum C_SVType SV = svInt32;
@@ -801,8 +1580,31 @@ COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 		}
 	}
 
-	// allocate internal buffer uniformly
-	Balance_ArrayRead_Buffer(&(Array[0]), Array.size());
+	// the progress, polled by GDS_R_Apply_Progress()
+	AtomicStore(State->ProgTotal, (C_Int64)MCnt);
+	CApplyProgress Progress;
+	const bool ShowProgress = (UseMode & GDS_R_READ_PROGRESS) != 0;
+	if (ShowProgress) Progress.Init(MCnt);
+
+	// decode the margins ahead on worker threads if the files are read-only,
+	// otherwise allocate internal buffer uniformly
+	CApplyDecoder *Decoder = NULL;
+	const int nDecode = (UseMode >> 24) & 0xFF;
+	if ((nDecode > 0) && (MCnt > 0))
+	{
+		vector<C_SVType> SV(Num);
+		for (int i=0; i < Num; i++) SV[i] = Array[i].SVType();
+		Decoder = State->Decoder = new CApplyDecoder;
+		Decoder->Cancel = &State->Cancel;
+		if (!Decoder->Start(Num, ObjList, Margins, &SV[0], Selection,
+			nDecode, BufferSize))
+		{
+			delete Decoder;
+			Decoder = State->Decoder = NULL;
+		}
+	}
+	if (!Decoder)
+		Balance_ArrayRead_Buffer(&(Array[0]), Array.size(), BufferSize);
 
 	// used in UNPROTECT
 	int nProtected = 0;
@@ -887,8 +1689,38 @@ COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 		// call the initial user-defined function
 		(*InitFunc)(Func_Argument, Array[0].Count(), &ArrayList[0], Param);
 
+		// for - loop, the margins decoded by the worker threads
+		for (C_Int32 Idx=0; Decoder && (Idx < MCnt); Idx++)
+		{
+			CApplyDecoder::TSlot &s = Decoder->Wait(Idx);
+			for (int i=0; i < Num; i++)
+			{
+				if (!COREARRAY_SV_STRING(SVType[i]))
+				{
+					C_Int64 m = Array[i].MarginSize();
+					if (m > 0) memcpy(BufPtr[i], &s.Buf[i][0], m);
+				} else {
+					C_Int64 n = Array[i].MarginCount();
+					SEXP bufstr = (SEXP)BufPtr[i];
+					for (C_Int64 j=0; j < n; j++)
+					{
+						UTF8String &ss = s.Str[i][j];
+						SET_STRING_ELT(bufstr, j,
+							Rf_mkCharLenCE(&ss[0], ss.size(), CE_UTF8));
+					}
+				}
+			}
+			Decoder->Release(Idx);
+
+			// call the user-defined function
+			apply_check_cancel(State);
+			(*LoopFunc)(Func_Argument, Decoder->Pos0[Idx], Param);
+			AtomicStore(State->ProgDone, (C_Int64)Idx + 1);
+			if (ShowProgress) Progress.Forward();
+		}
+
 		// for - loop
-		while (!Array[0].Eof())
+		while (!Decoder && !Array[0].Eof())
 		{
 			C_Int32 Idx = Array[0].MarginIndex();
 
@@ -914,7 +1746,10 @@ COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 			}
 
 			// call the user-defined function
+			apply_check_cancel(State);
 			(*LoopFunc)(Func_Argument, Idx, Param);
+			AtomicFetchAdd(State->ProgDone, (C_Int64)1);
+			if (ShowProgress) Progress.Forward();
 		}
 
 		if (nProtected > 0)
@@ -930,6 +1765,49 @@ COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
 	}
 }
 
+/// apply user-defined function margin by margin
+COREARRAY_DLL_EXPORT void GDS_R_Apply(int Num, PdAbstractArray ObjList[],
+	int Margins[], const C_BOOL *const * const Selection[],
+	void (*InitFunc)(SEXP Argument, C_Int32 Count, PdArrayRead ReadObjList[],
+		void *_Param),
+	void (*LoopFunc)(SEXP Argument, C_Int32 Idx, void *_Param),
+	void *Param, C_BOOL IncOrDec, C_UInt32 UseMode)
+{
+	GDS_R_Apply2(Num, ObjList, Margins, Selection, InitFunc, LoopFunc,
+		Param, IncOrDec, UseMode, -1);
+}
+
+/// return the numbers of finished and all margins of the outermost running
+/// GDS_R_Apply2 (or apply.gdsn), or of the last one if none is running, it
+/// can be called from any thread
+COREARRAY_DLL_EXPORT void GDS_R_Apply_Progress(C_Int64 *Done, C_Int64 *Total)
+{
+	TdAutoMutex _m(&ApplyStateMutex);
+	if (!ApplyStateList.empty())
+	{
+		CApplyState *d = ApplyStateList.front();
+		if (Done) *Done = AtomicLoad(d->ProgDone);
+		if (Total) *Total = AtomicLoad(d->ProgTotal);
+	} else {
+		if (Done) *Done = ApplyLastDone;
+		if (Total) *Total = ApplyLastTotal;
+	}
+}
+
+/// request the running GDS_R_Apply2 (or apply.gdsn), including the nested
+/// calls, to stop before calling the user-defined function next time; if
+/// none is running, the next call stops, it can be called from any thread
+COREARRAY_DLL_EXPORT void GDS_R_Apply_Cancel()
+{
+	TdAutoMutex _m(&ApplyStateMutex);
+	if (!ApplyStateList.empty())
+	{
+		for (size_t i=0; i < ApplyStateList.size(); i++)
+			ApplyStateList[i]->Cancel.Cancel();
+	} else
+		ApplyCancelPending.Cancel();
+}
+
 
 // append R data
 COREARRAY_DLL_EXPORT void GDS_R_Append(PdAbstractArray Obj, SEXP Val)
@@ -1273,14 +2151,13 @@ COREARRAY_DLL_EXPORT void GDS_File_Close(PdGDSFile File)
 	{
 		PKG_GDS_Files[gds_idx] = NULL;
 
-		// delete GDS objects in GDSFMT_GDSObj_List and GDSFMT_GDSObj_Map
-		vector<PdGDSObj>::iterator p = GDSFMT_GDSObj_List.begin();
-		for (; p != GDSFMT_GDSObj_List.end(); p++)
+		// release the handles of GDS objects in the file
+		for (int i=0; i < GDSFMT_GDSObj_Handles.Count(); i++)
 		{
-			if (*p != NULL)
+			if (GDSFMT_GDSObj_Handles.Obj(i) != NULL)
 			{
 				// for a virtual folder
-				PdGDSObj Obj = *p;
+				PdGDSObj Obj = GDSFMT_GDSObj_Handles.Obj(i);
 				PdGDSFolder Folder = Obj->Folder();
 				while (Folder != NULL)
 				{
@@ -1289,14 +2166,15 @@ COREARRAY_DLL_EXPORT void GDS_File_Close(PdGDSFile File)
 				}
 				// Obj is the root, and then get the GDS file
 				if (Obj->GDSFile() == File)
-				{
-					GDSFMT_GDSObj_Map.erase(*p);
-					*p = NULL;
-				}
+					GDSFMT_GDSObj_Handles.Release(i);
 			}
 		}
 	}
-	if (File) delete File;
+	if (File)
+	{
+		apply_state_join(File);
+		delete File;
+	}
 }
 
 /// synchronize the GDS file
@@ -1305,7 +2183,7 @@ COREARRAY_DLL_EXPORT void GDS_File_Sync(PdGDSFile File)
 	File->SyncFile();
 }
 
-/// reopen the GDS file if needed
+/// reopen the GDS file if needed, or refresh a reader in the SWMR mode
 COREARRAY_DLL_EXPORT C_BOOL GDS_File_Reopen(SEXP GDSObj)
 {
 	// information
@@ -1427,8 +2305,13 @@ COREARRAY_DLL_EXPORT C_BOOL GDS_File_Reopen(SEXP GDSObj)
 		SET_ELEMENT(GDSObj, i_rt, GDS_R_Obj2SEXP(&(file->Root())));
 		// output
 		return TRUE;
-	} else
+	} else {
+		// a reader in the SWMR mode: incremental refresh instead of reopening
+		PdGDSFile file = GDS_R_SEXP2File(GDSObj);
+		if (file->SWMR() && file->ReadOnly())
+			return file->Refresh() ? TRUE : FALSE;
 		return FALSE;
+	}
 }
 
 /// get the root folder of a GDS file
@@ -1450,50 +2333,20 @@ COREARRAY_DLL_EXPORT C_BOOL GDS_Node_Load(PdGDSObj Node, int NodeID,
 	{
 		if (!Node)
 			Node = File->Root().Path(Path);
-		map<PdGDSObj, int>::iterator it = GDSFMT_GDSObj_Map.find(Node);
-		if (it != GDSFMT_GDSObj_Map.end())
-		{
-			if (OutNode) *OutNode = Node;
-			if (OutNodeID) *OutNodeID = it->second;
-		} else {
-			vector<PdGDSObj>::iterator it =
-				find(GDSFMT_GDSObj_List.begin(), GDSFMT_GDSObj_List.end(),
-				(PdGDSObj)NULL);
-			if (it != GDSFMT_GDSObj_List.end())
-			{
-				NodeID = it - GDSFMT_GDSObj_List.begin();
-				*it = Node;
-			} else {
-				NodeID = GDSFMT_GDSObj_List.size();
-				GDSFMT_GDSObj_List.push_back(Node);
-			}
-			GDSFMT_GDSObj_Map[Node] = NodeID;
-			if (OutNode) *OutNode = Node;
-			if (OutNodeID) *OutNodeID = NodeID;
-		}
+		NodeID = GDSFMT_GDSObj_Handles.Add(Node);
+		if (OutNode) *OutNode = Node;
+		if (OutNodeID) *OutNodeID = NodeID;
 		return TRUE;
 	}
 
-	PdGDSObj Obj = NULL;
-	if (NodeID < (int)GDSFMT_GDSObj_List.size())
-		Obj = GDSFMT_GDSObj_List[NodeID];
+	PdGDSObj Obj = GDSFMT_GDSObj_Handles.Obj(NodeID);
 	if ((Obj != Node) || !Node) // need update
 	{
-		if (!Obj)
+		if (!Obj || Node)
 		{
+			// the slot was released or reused by another node
 			Node = File->Root().Path(Path);
-			vector<PdGDSObj>::iterator it =
-				find(GDSFMT_GDSObj_List.begin(), GDSFMT_GDSObj_List.end(),
-				(PdGDSObj)NULL);
-			if (it != GDSFMT_GDSObj_List.end())
-			{
-				NodeID = it - GDSFMT_GDSObj_List.begin();
-				*it = Node;
-			} else {
-				NodeID = GDSFMT_GDSObj_List.size();
-				GDSFMT_GDSObj_List.push_back(Node);
-			}
-			GDSFMT_GDSObj_Map[Node] = NodeID;
+			NodeID = GDSFMT_GDSObj_Handles.Add(Node);
 		} else {
 			Node = Obj;
 		}
@@ -1513,11 +2366,8 @@ COREARRAY_DLL_EXPORT void GDS_Node_Unload(PdGDSObj Node)
 		else
 			throw ErrGDSFmt("Can not unload the root.");
 
-		// delete GDS objects in GDSFMT_GDSObj_List and GDSFMT_GDSObj_Map
-		vector<PdGDSObj>::iterator p = GDSFMT_GDSObj_List.begin();
-		for (; p != GDSFMT_GDSObj_List.end(); p++)
-			if (*p == Node) *p = NULL;
-		GDSFMT_GDSObj_Map.erase(Node);
+		// release the handle
+		GDSFMT_GDSObj_Handles.Remove(Node);
 	}
 }
 
@@ -1525,20 +2375,18 @@ COREARRAY_DLL_EXPORT void GDS_Node_Delete(PdGDSObj Node, C_BOOL Force)
 {
 	if (Node != NULL)
 	{
-		vector<C_BOOL> DeleteArray;
+		// the handles of child nodes
+		vector<int> DeleteSlot;
 		if (dynamic_cast<CdGDSAbsFolder*>(Node))
 		{
-			DeleteArray.resize(GDSFMT_GDSObj_List.size(), FALSE);
-			size_t idx = 0;
-			vector<PdGDSObj>::iterator p = GDSFMT_GDSObj_List.begin();
-			for (; p != GDSFMT_GDSObj_List.end(); p++)
+			for (int i=0; i < GDSFMT_GDSObj_Handles.Count(); i++)
 			{
-				if (*p != NULL)
+				PdGDSObj Obj = GDSFMT_GDSObj_Handles.Obj(i);
+				if (Obj != NULL)
 				{
-					if (static_cast<CdGDSAbsFolder*>(Node)->HasChild(*p, true))
-						DeleteArray[idx] = TRUE;
+					if (static_cast<CdGDSAbsFolder*>(Node)->HasChild(Obj, true))
+						DeleteSlot.push_back(i);
 				}
-				idx ++;
 			}
 		}
 
@@ -1547,27 +2395,11 @@ COREARRAY_DLL_EXPORT void GDS_Node_Delete(PdGDSObj Node, C_BOOL Force)
 		else
 			throw ErrGDSFmt("Can not delete the root.");
 
-		// delete GDS objects in GDSFMT_GDSObj_List and GDSFMT_GDSObj_Map
-		vector<PdGDSObj>::iterator p = GDSFMT_GDSObj_List.begin();
-		for (; p != GDSFMT_GDSObj_List.end(); p++)
-			if (*p == Node) *p = NULL;
-		GDSFMT_GDSObj_Map.erase(Node);
-
-		if (!DeleteArray.empty())
-		{
-			size_t idx = 0;
-			vector<C_BOOL>::iterator p = DeleteArray.begin();
-			for (; p != DeleteArray.end(); p++)
-			{
-				if (*p)
-				{
-					PdGDSObj &Obj = GDSFMT_GDSObj_List[idx];
-					GDSFMT_GDSObj_Map.erase(Obj);
-					Obj = NULL;
-				}
-				idx ++;
-			}
-		}
+		// release the handles, if the objects are still referred elsewhere
+		GDSFMT_GDSObj_Handles.Remove(Node);
+		vector<int>::iterator p;
+		for (p = DeleteSlot.begin(); p != DeleteSlot.end(); p++)
+			GDSFMT_GDSObj_Handles.Release(*p);
 	}
 }
 
@@ -1587,10 +2419,7 @@ COREARRAY_DLL_EXPORT int GDS_Node_ChildCount(PdGDSFolder Node)
 COREARRAY_DLL_EXPORT PdGDSObj GDS_Node_Path(PdGDSFolder Node,
 	const char *Path, C_BOOL MustExist)
 {
-	if (MustExist)
-		return Node->Path(Path);
-	else
-		return Node->PathEx(Path);
+	return MustExist ? Node->Path(Path) : Node->PathEx(Path);
 }
 
 
@@ -1653,6 +2482,20 @@ COREARRAY_DLL_EXPORT void *GDS_Array_ReadDataEx(PdAbstractArray Obj,
 	return Obj->ReadDataEx(Start, Length, Selection, OutBuf, OutSV);
 }
 
+COREARRAY_DLL_EXPORT void *GDS_Array_ReadDataEx2(PdAbstractArray Obj,
+	const C_Int32 *const Index[], const C_Int32 IdxCnt[], void *OutBuf,
+	enum C_SVType OutSV)
+{
+	return Obj->ReadDataIdx(Index, IdxCnt, OutBuf, OutSV);
+}
+
+COREARRAY_DLL_EXPORT void GDS_Array_ReadDataMulti(PdAbstractArray Obj,
+	int NumSlab, const C_Int32 *Start, const C_Int32 *Length,
+	void *const OutBuf[], enum C_SVType OutSV)
+{
+	Obj->ReadDataMulti(NumSlab, Start, Length, OutBuf, OutSV);
+}
+
 COREARRAY_DLL_EXPORT const void *GDS_Array_WriteData(PdAbstractArray Obj,
 	const C_Int32 *Start, const C_Int32 *Length, const void *InBuf,
 	enum C_SVType InSV)
@@ -1875,15 +2718,12 @@ COREARRAY_DLL_EXPORT void GDS_Parallel_WakeUp(PdThreadsSuspending Obj)
 }
 
 
-/// the object with multiple threads for parallel computing
-static CParallelBase R_CoreArray_ParallelBase;
-
-/// parallel computing
+/// parallel computing with the worker threads in the process-wide pool
 COREARRAY_DLL_EXPORT void GDS_Parallel_RunThreads(
 	void (*Proc)(PdThread, int, void*), void *Param, int nThread)
 {
-	R_CoreArray_ParallelBase.SetNumThread(nThread);
-	R_CoreArray_ParallelBase.RunThreads((CParallelBase::TProc)Proc, Param);
+	CParallelBase Base(nThread);
+	Base.RunThreads((CParallelBase::TProc)Proc, Param);
 }
 
 
@@ -1911,6 +2751,7 @@ COREARRAY_DLL_EXPORT PdArrayRead GDS_ArrayRead_Init(PdAbstractArray Obj,
 	int Margin, enum C_SVType SVType, const C_BOOL *const Selection[],
 	C_BOOL buf_if_need)
 {
+	SetMemoryLimit();
 	PdArrayRead rv = new CdArrayRead;
 	rv->Init(*Obj, Margin, SVType, Selection, buf_if_need);
 	return rv;
@@ -1938,10 +2779,251 @@ COREARRAY_DLL_EXPORT C_BOOL GDS_ArrayRead_Eof(PdArrayRead Obj)
 COREARRAY_DLL_EXPORT void GDS_ArrayRead_BalanceBuffer(PdArrayRead array[],
 	int n, C_Int64 buffer_size)
 {
+	SetMemoryLimit();
 	Balance_ArrayRead_Buffer(array, n, buffer_size);
 }
 
 
+/// the structure shared by the threads in GDS_ArrayRead_Parallel
+struct TArrayReadParallel
+{
+	PdAbstractArray Obj;          ///< the array object
+	vector<PdAbstractArray> ObjList;  ///< the objects of threads
+	int Margin;                   ///< the margin index
+	C_SVType SVType;              ///< the data type of buffers
+	vector< vector<C_BOOL> > Sel; ///< the selection of all dimensions
+	vector<C_Int32> Split;        ///< the ranges along the margin
+	vector<C_Int32> SplitIdx;     ///< the index of selected at each range
+	bool Ordered;                 ///< true for calling Proc in order
+	bool ShareObj;                ///< true for sharing Obj with a mutex
+	void (*Proc)(int, C_Int32, void*, void*);
+	void *Param;
+	C_Int64 BufferSize;           ///< the buffer size for each thread
+	CdThreadMutex Mutex;          ///< for the counters
+	CdThreadMutex ObjMutex;       ///< for reading the shared object
+	CdThreadCondition Cond;       ///< for delivering in order
+	int NextRange;                ///< the next range to be read
+	int DeliverRange;             ///< the next range to be delivered
+	bool Abort;                   ///< true if an error occurs
+	string ErrMsg;                ///< the error message
+};
+
+static void *arrayread_buffer(C_SVType sv, ssize_t elm_size, C_Int64 n,
+	vector<C_UInt8> &buf, vector<UTF8String> &buf_utf8,
+	vector<UTF16String> &buf_utf16)
+{
+	switch (sv)
+	{
+		case svStrUTF8:
+			buf_utf8.resize(n); return &buf_utf8[0];
+		case svStrUTF16:
+			buf_utf16.resize(n); return &buf_utf16[0];
+		default:
+			buf.resize(n * elm_size); return &buf[0];
+	}
+}
+
+static void arrayread_parallel_proc(CdThread *Thread, int iThread, void *ptr)
+{
+	TArrayReadParallel &P = *((TArrayReadParallel*)ptr);
+	const int nRange = (int)P.Split.size() - 1;
+	const int DimCnt = P.Sel.size();
+	PdAbstractArray Obj = P.ObjList[iThread];
+	vector<C_BOOL> MarginSel;
+	const C_BOOL *SelPtr[GDS_MAX_NUM_DIMENSION];
+	vector<C_UInt8> Buf;
+	vector<UTF8String> Buf_UTF8;
+	vector<UTF16String> Buf_UTF16;
+
+	try {
+		while (true)
+		{
+			// get the next range
+			int k;
+			{
+				TdAutoMutex _m(&P.Mutex);
+				if (P.Abort || (P.NextRange >= nRange)) break;
+				k = P.NextRange ++;
+			}
+
+			// the selection restricted to the range
+			for (int i=0; i < DimCnt; i++) SelPtr[i] = &P.Sel[i][0];
+			MarginSel.assign(P.Sel[P.Margin].size(), 0);
+			for (C_Int32 i=P.Split[k]; i < P.Split[k+1]; i++)
+				MarginSel[i] = P.Sel[P.Margin][i];
+			SelPtr[P.Margin] = &MarginSel[0];
+
+			CdArrayRead R;
+			R.Init(*Obj, P.Margin, P.SVType, SelPtr, false);
+			if (R.Count() > 0) R.AllocBuffer(P.BufferSize);
+			C_Int32 Idx = P.SplitIdx[k];
+			const C_Int64 MSize = R.MarginSize();
+
+			if (P.Ordered)
+			{
+				// read the range, then deliver in order
+				C_UInt8 *p = (C_UInt8*)arrayread_buffer(P.SVType, R.ElmSize(),
+					R.MarginCount() * R.Count(), Buf, Buf_UTF8, Buf_UTF16);
+				for (C_Int32 i=0; i < R.Count(); i++)
+				{
+					TdAutoMutex _m(P.ShareObj ? &P.ObjMutex : NULL);
+					R.Read(p + i*MSize);
+				}
+				{
+					TdAutoMutex _m(&P.Mutex);
+					while ((P.DeliverRange != k) && !P.Abort)
+						P.Cond.Wait(P.Mutex);
+					if (P.Abort) break;
+				}
+				for (C_Int32 i=0; i < R.Count(); i++)
+					(*P.Proc)(iThread, Idx++, p + i*MSize, P.Param);
+				TdAutoMutex _m(&P.Mutex);
+				P.DeliverRange ++;
+				P.Cond.Broadcast();
+			} else {
+				// read and deliver margin by margin
+				void *p = arrayread_buffer(P.SVType, R.ElmSize(),
+					R.MarginCount(), Buf, Buf_UTF8, Buf_UTF16);
+				while (!R.Eof())
+				{
+					{
+						TdAutoMutex _m(P.ShareObj ? &P.ObjMutex : NULL);
+						R.Read(p);
+					}
+					(*P.Proc)(iThread, Idx++, p, P.Param);
+				}
+			}
+		}
+	}
+	catch (exception &E)
+	{
+		TdAutoMutex _m(&P.Mutex);
+		if (!P.Abort) P.ErrMsg = E.what();
+		P.Abort = true;
+		P.Cond.Broadcast();
+	}
+	catch (...)
+	{
+		TdAutoMutex _m(&P.Mutex);
+		if (!P.Abort) P.ErrMsg = "GDS_ArrayRead_Parallel: unknown error.";
+		P.Abort = true;
+		P.Cond.Broadcast();
+	}
+}
+
+/// read an array-oriented object margin by margin with multiple threads
+/** The selected margins are split into ranges aligned to the compressed
+ *  blocks, and each thread reads a range with its own decoder (the file is
+ *  opened again in each thread if it is read-only; otherwise, the reading is
+ *  serialized).
+ *  \param Obj        the array object
+ *  \param Margin     the margin index starting from 0 with C orders
+ *  \param SVType     the data type of buffers
+ *  \param Selection  indicating selection, or NULL for all
+ *  \param nThread    the number of threads
+ *  \param Ordered    if TRUE, Proc is called in the order of margins one by
+ *                    one; otherwise, Proc is called by the threads
+ *                    simultaneously
+ *  \param Proc       called with the thread index, the index of selected
+ *                    margin starting from 0, the data buffer and Param
+ *  \param Param      the parameter passed to Proc
+**/
+COREARRAY_DLL_EXPORT void GDS_ArrayRead_Parallel(PdAbstractArray Obj,
+	int Margin, enum C_SVType SVType, const C_BOOL *const Selection[],
+	int nThread, C_BOOL Ordered,
+	void (*Proc)(int iThread, C_Int32 Idx, void *Buffer, void *Param),
+	void *Param)
+{
+	if (!Proc) return;
+	const int DimCnt = Obj->DimCnt();
+	if ((Margin < 0) || (Margin >= DimCnt))
+		throw ErrGDSFmt("GDS_ArrayRead_Parallel: invalid 'Margin'.");
+	if (nThread < 1) nThread = 1;
+	SetMemoryLimit();
+
+	TArrayReadParallel P;
+	P.Obj = Obj;
+	P.Margin = Margin; P.SVType = SVType;
+	P.Ordered = (Ordered != 0);
+	P.Proc = Proc; P.Param = Param;
+	P.NextRange = P.DeliverRange = 0;
+	P.Abort = false;
+
+	// the selection
+	C_Int32 DLen[GDS_MAX_NUM_DIMENSION];
+	Obj->GetDim(DLen);
+	P.Sel.resize(DimCnt);
+	for (int i=0; i < DimCnt; i++)
+	{
+		if (Selection && Selection[i])
+			P.Sel[i].assign(Selection[i], Selection[i] + DLen[i]);
+		else
+			P.Sel[i].assign(DLen[i], 1);
+	}
+
+	// the size of a margin
+	C_Int64 MSize = (COREARRAY_SV_STRING(SVType) ? sizeof(UTF16String) : 8);
+	for (int i=0; i < DimCnt; i++)
+	{
+		if (i != Margin)
+		{
+			C_Int64 n = 0;
+			for (C_Int32 j=0; j < DLen[i]; j++) n += P.Sel[i][j] ? 1 : 0;
+			MSize *= n;
+		}
+	}
+	C_Int32 Total = 0;
+	for (C_Int32 j=0; j < DLen[Margin]; j++)
+		Total += P.Sel[Margin][j] ? 1 : 0;
+	if ((Total <= 0) || (MSize <= 0)) return;
+
+	// the number of ranges, several ranges per thread for load balancing,
+	// and the buffer of a range no more than the budget of a thread
+	P.BufferSize = ARRAY_READ_MEM_BUFFER_SIZE / nThread;
+	C_Int64 nRange = (nThread > 1) ? (C_Int64)nThread * 4 : 1;
+	if (P.Ordered)
+	{
+		C_Int64 m = (C_Int64)((double)MSize * Total / P.BufferSize) + 1;
+		if (nRange < m) nRange = m;
+	}
+	if (nRange > Total) nRange = Total;
+	Split_ArrayRead_Margin(*Obj, Margin, &P.Sel[Margin][0], nRange, P.Split);
+	P.SplitIdx.resize(P.Split.size());
+	C_Int32 Idx = 0;
+	for (size_t k=0; k < P.Split.size(); k++)
+	{
+		P.SplitIdx[k] = Idx;
+		if (k+1 < P.Split.size())
+		{
+			for (C_Int32 j=P.Split[k]; j < P.Split[k+1]; j++)
+				Idx += P.Sel[Margin][j] ? 1 : 0;
+		}
+	}
+	if (nThread > (int)P.Split.size() - 1)
+		nThread = (int)P.Split.size() - 1;
+
+	// the objects with independent decoders
+	vector<CdGDSFile*> Files;
+	vector< vector<PdAbstractArray> > List;
+	bool ok = open_thread_objects(1, &Obj, 1, nThread, Files, List);
+	P.ShareObj = !ok && (nThread > 1);
+	P.ObjList.resize(nThread);
+	for (int i=0; i < nThread; i++) P.ObjList[i] = List[i][0];
+
+	// run
+	try {
+		ThreadPool().Run(arrayread_parallel_proc, &P, nThread);
+	} catch (...) {
+		close_thread_objects(Files);
+		throw;
+	}
+	close_thread_objects(Files);
+
+	if (P.Abort)
+		throw ErrGDSFmt(P.ErrMsg);
+}
+
+
 
 // ===========================================================================
 // External packages
@@ -2075,6 +3157,9 @@ void R_init_gdsfmt(DllInfo *info)
 	REG(GDS_R_Set_IfFactor);
 	REG(GDS_R_Array_Read);
 	REG(GDS_R_Apply);
+	REG(GDS_R_Apply2);
+	REG(GDS_R_Apply_Progress);
+	REG(GDS_R_Apply_Cancel);
 	REG(GDS_R_Append);
 	REG(GDS_R_AppendEx);
 	REG(GDS_R_Is_Element);
@@ -2108,6 +3193,8 @@ void R_init_gdsfmt(DllInfo *info)
 	REG(GDS_Array_GetBitOf);
 	REG(GDS_Array_ReadData);
 	REG(GDS_Array_ReadDataEx);
+	REG(GDS_Array_ReadDataEx2);
+	REG(GDS_Array_ReadDataMulti);
 	REG(GDS_Array_WriteData);
 	REG(GDS_Array_AppendData);
 	REG(GDS_Array_AppendString);
@@ -2160,6 +3247,7 @@ void R_init_gdsfmt(DllInfo *info)
 	REG(GDS_ArrayRead_Read);
 	REG(GDS_ArrayRead_Eof);
 	REG(GDS_ArrayRead_BalanceBuffer);
+	REG(GDS_ArrayRead_Parallel);
 
 	/// Matrix package
 	REG(GDS_Load_Matrix);
@@ -32,11 +32,18 @@
 #include <Rdefines.h>
 #include <R_ext/Rdynload.h>
 
+#ifdef COREARRAY_PLATFORM_LINUX
+#   include <sched.h>
+#endif
+
 
 namespace gdsfmt
 {
 	extern PdGDSFile PKG_GDS_Files[];
 	extern int GetFileIndex(PdGDSFile file, bool throw_error=true);
+	extern int ApplyDecoderStop(int n);
+	extern void SetMemoryLimit();
+	extern int ApplyDecoderMaxAhead;
 
 
 	/// initialization and finalization
@@ -280,6 +287,37 @@ static string fmt_size(double b)
 	return string(s);
 }
 
+/// bind the pooled worker threads to NUMA nodes, 'options(gds.numa=TRUE)'
+static void set_numa_placement()
+{
+	int v = Rf_asLogical(Rf_GetOption1(Rf_install("gds.numa")));
+	Parallel::ThreadPool().SetNumaPlacement(v == TRUE);
+}
+
+/// the single-writer/multi-reader mode, 'options(gds.swmr=TRUE)'
+static void set_swmr_mode(CdGDSFile *file)
+{
+	int v = Rf_asLogical(Rf_GetOption1(Rf_install("gds.swmr")));
+	if (v == TRUE) file->SetSWMR(true);
+}
+
+/// the metadata index written at sync and close, 'options(gds.meta.index=TRUE)'
+static void set_meta_index(CdGDSFile *file)
+{
+	int v = Rf_asLogical(Rf_GetOption1(Rf_install("gds.meta.index")));
+	if ((v == TRUE) && !file->ReadOnly()) file->SetMetaIndex(true);
+}
+
+extern bool gds_obj_in_use(CdGDSObj *Obj);
+
+/// the maximum number of loaded nodes, 'options(gds.node.cache)'
+static void set_node_cache(CdGDSFile *file)
+{
+	int v = Rf_asInteger(Rf_GetOption1(Rf_install("gds.node.cache")));
+	if ((v != NA_INTEGER) && (v > 0))
+		file->SetNodeCache(v, gds_obj_in_use);
+}
+
 
 extern SEXP new_gdsptr_obj(CdGDSFile *file, SEXP id, bool do_free);
 extern SEXP gdsObjWriteAll(SEXP Node, SEXP Val, SEXP Check);
@@ -329,6 +367,8 @@ COREARRAY_DLL_EXPORT SEXP gdsCreateGDS(SEXP FileName, SEXP AllowDup)
 		}
 		// create file and return R object
 		CdGDSFile *file = GDS_File_Create(fn);
+		set_swmr_mode(file);
+		set_meta_index(file);
 		PROTECT(rv_ans = NEW_LIST(5));
 			SET_ELEMENT(rv_ans, 0, FileName);
 			SEXP ID = Rf_ScalarInteger(GetFileIndex(file));
@@ -388,8 +428,17 @@ COREARRAY_DLL_EXPORT SEXP gdsOpenGDS(SEXP FileName, SEXP ReadOnly,
 				}
 			}
 		}
+		// the shared cache of decompressed blocks for read-only files,
+		// 'options(gds.block.cache)'
+		double cache = Rf_asReal(Rf_GetOption1(Rf_install("gds.block.cache")));
+		CdBlockCache::SetDefaultLimit(
+			(R_FINITE(cache) && (cache > 0)) ? (C_Int64)cache : 0);
+		set_numa_placement();
 		// open file and return R object
 		CdGDSFile *file = GDS_File_Open(fn, readonly, allow_fork, allow_error);
+		set_swmr_mode(file);
+		set_meta_index(file);
+		set_node_cache(file);
 		PROTECT(rv_ans = NEW_LIST(5));
 			SET_ELEMENT(rv_ans, 0, FileName);
 			SEXP ID = Rf_ScalarInteger(GetFileIndex(file));
@@ -423,7 +472,12 @@ COREARRAY_DLL_EXPORT SEXP gdsCloseGDS(SEXP gdsfile)
 COREARRAY_DLL_EXPORT SEXP gdsSyncGDS(SEXP gdsfile)
 {
 	COREARRAY_TRY
-		GDS_R_SEXP2File(gdsfile)->SyncFile();
+		PdGDSFile file = GDS_R_SEXP2File(gdsfile);
+		// a reader in the SWMR mode loads the changes committed by the writer
+		if (file->SWMR() && file->ReadOnly())
+			file->Refresh();
+		else
+			file->SyncFile();
 	COREARRAY_CATCH
 }
 
@@ -815,16 +869,13 @@ COREARRAY_DLL_EXPORT SEXP gdsNodeChildCnt(SEXP Node, SEXP Hidden)
 			{
 				Cnt = Dir->NodeCount();
 			} else {
+				// no need to load the child nodes
 				for (int i=0; i < Dir->NodeCount(); i++)
 				{
-					CdGDSObj *Obj = Dir->ObjItemEx(i);
-					if (Obj)
+					if (!Dir->NodeHidden(i) &&
+						!Dir->NodeHasAttr(i, STR_INVISIBLE))
 					{
-						if (!Obj->GetHidden() &&
-							!Obj->Attribute().HasName(STR_INVISIBLE))
-						{
-							Cnt ++;
-						}
+						Cnt ++;
 					}
 				}
 			}
@@ -887,6 +938,36 @@ COREARRAY_DLL_EXPORT SEXP gdsNodeName(SEXP Node, SEXP FullName)
 static void gds_ls_name(CdGDSAbsFolder *dir, bool recursive, bool hidden,
 	bool include_dir, string name, vector<string> &list)
 {
+	CdGDSFolder *folder = dynamic_cast<CdGDSFolder*>(dir);
+	if (folder)
+	{
+		// using the name table, only the sub folders are loaded
+		for (int i=0; i < folder->NodeCount(); i++)
+		{
+			if (!hidden && (folder->NodeHidden(i) ||
+				folder->NodeHasAttr(i, STR_INVISIBLE)))
+			{
+				continue;
+			}
+			bool is_dir = folder->NodeIsFolder(i);
+			string nm = folder->NodeName(i);
+			if (name != "") nm = name + "/" + nm;
+			if (include_dir || !is_dir)
+				list.push_back(nm);
+			if (recursive && is_dir)
+			{
+				CdGDSAbsFolder *dir_obj =
+					dynamic_cast<CdGDSAbsFolder*>(folder->ObjItemEx(i));
+				if (dir_obj)
+				{
+					gds_ls_name(dir_obj, recursive, hidden, include_dir,
+						nm, list);
+				}
+			}
+		}
+		return;
+	}
+
 	for (int i=0; i < dir->NodeCount(); i++)
 	{
 		CdGDSObj *obj = dir->ObjItemEx(i);
@@ -1742,6 +1823,175 @@ COREARRAY_DLL_EXPORT SEXP gdsAddFolder(SEXP Node, SEXP NodeName, SEXP Type,
 }
 
 
+/// return the node 'Name' in 'Dir' to be replaced by a new virtual array,
+/// or NULL, after checking the arrays which the new array refers to
+static CdGDSObj *virtual_replace(CdGDSAbsFolder &Dir, const char *Name,
+	bool Replace, const vector<CdAbstractArray*> &List, const char *ArgName)
+{
+	CdGDSObj *Old = Dir.ObjItemEx(Name);
+	// adding fails with the existing name
+	if (Old && !Replace) return NULL;
+
+	// the referred arrays are deleted or form a cycle if they depend on
+	// the path of the new array
+	UTF8String Path = Dir.FullName();
+	if (!Path.empty()) Path.push_back('/');
+	Path.append(Name);
+	for (size_t i=0; i < List.size(); i++)
+	{
+		if (ArrayDependsOn(List[i], Path))
+		{
+			throw ErrGDSFmt("'%s[[%d]]' is or refers to the node '%s'.",
+				ArgName, (int)i+1, Path.c_str());
+		}
+	}
+	return Old;
+}
+
+
+/// Add a concatenated array of existing arrays
+/** \param Node        [in] a GDS node
+ *  \param NodeName    [in] the name of a new node
+ *  \param Members     [in] a list of GDS nodes
+ *  \param Replace     [in] if TRUE, replace the existing variable silently
+ *  \param Visible     [in] if TRUE, visible or hidden
+**/
+COREARRAY_DLL_EXPORT SEXP gdsAddConcat(SEXP Node, SEXP NodeName, SEXP Members,
+	SEXP Replace, SEXP Visible)
+{
+	const char *nm = Rf_translateCharUTF8(STRING_ELT(NodeName, 0));
+	int replace_flag = Rf_asLogical(Replace);
+	if (replace_flag == NA_LOGICAL)
+		Rf_error("'replace' must be TRUE or FALSE.");
+
+	COREARRAY_TRY
+
+		PdGDSObj Obj = GDS_R_SEXP2Obj(Node, FALSE);
+		if (!dynamic_cast<CdGDSAbsFolder*>(Obj))
+			throw ErrGDSFmt(ERR_NOT_FOLDER);
+
+		// the member arrays
+		vector<CdAbstractArray*> List(Rf_length(Members));
+		for (size_t i=0; i < List.size(); i++)
+		{
+			PdGDSObj p = GDS_R_SEXP2Obj(VECTOR_ELT(Members, i), TRUE);
+			List[i] = dynamic_cast<CdAbstractArray*>(p);
+			if (!List[i])
+				throw ErrGDSFmt("'members[[%d]]' is not an array.", (int)i+1);
+		}
+		if (List.empty())
+			throw ErrGDSFmt("No member array.");
+
+		// validate before deleting the replaced node
+		CdGDSAbsFolder &Dir = *((CdGDSAbsFolder*)Obj);
+		CdGDSObj *Old = virtual_replace(Dir, nm, replace_flag, List,
+			"members");
+		CdConcatArray::CheckMembers(Dir.GDSFile(), &List[0], List.size());
+		int IdxReplace = -1;
+		if (Old)
+		{
+			IdxReplace = Dir.IndexObj(Old);
+			GDS_Node_Delete(Old, TRUE);
+		}
+
+		CdConcatArray *vObj = new CdConcatArray;
+		Dir.InsertObj(IdxReplace, nm, vObj);
+		try {
+			vObj->SetMembers(&List[0], List.size());
+		}
+		catch (...) {
+			Dir.DeleteObj(vObj, true);
+			throw;
+		}
+
+		// hidden flag
+		if (Rf_asLogical(Visible) != TRUE)
+		{
+			vObj->SetHidden(true);
+			vObj->Attribute().Add(STR_INVISIBLE);
+		}
+
+		rv_ans = GDS_R_Obj2SEXP(vObj);
+
+	COREARRAY_CATCH
+}
+
+
+/// Add a computed array of existing arrays
+/** \param Node        [in] a GDS node
+ *  \param NodeName    [in] the name of a new node
+ *  \param Expr        [in] the expression
+ *  \param Sources     [in] a named list of GDS nodes
+ *  \param Replace     [in] if TRUE, replace the existing variable silently
+ *  \param Visible     [in] if TRUE, visible or hidden
+**/
+COREARRAY_DLL_EXPORT SEXP gdsAddCompute(SEXP Node, SEXP NodeName, SEXP Expr,
+	SEXP Sources, SEXP Replace, SEXP Visible)
+{
+	const char *nm = Rf_translateCharUTF8(STRING_ELT(NodeName, 0));
+	const char *expr = Rf_translateCharUTF8(STRING_ELT(Expr, 0));
+	SEXP SrcNames = Rf_getAttrib(Sources, R_NamesSymbol);
+	int replace_flag = Rf_asLogical(Replace);
+	if (replace_flag == NA_LOGICAL)
+		Rf_error("'replace' must be TRUE or FALSE.");
+
+	COREARRAY_TRY
+
+		PdGDSObj Obj = GDS_R_SEXP2Obj(Node, FALSE);
+		if (!dynamic_cast<CdGDSAbsFolder*>(Obj))
+			throw ErrGDSFmt(ERR_NOT_FOLDER);
+
+		// the source arrays
+		const size_t n = Rf_length(Sources);
+		if ((n <= 0) || Rf_isNull(SrcNames))
+			throw ErrGDSFmt("'sources' should be a named list.");
+		vector<CdAbstractArray*> List(n);
+		vector<const char*> Names(n);
+		for (size_t i=0; i < n; i++)
+		{
+			PdGDSObj p = GDS_R_SEXP2Obj(VECTOR_ELT(Sources, i), TRUE);
+			List[i] = dynamic_cast<CdAbstractArray*>(p);
+			if (!List[i])
+				throw ErrGDSFmt("'sources[[%d]]' is not an array.", (int)i+1);
+			Names[i] = Rf_translateCharUTF8(STRING_ELT(SrcNames, i));
+		}
+
+		// validate before deleting the replaced node
+		CdGDSAbsFolder &Dir = *((CdGDSAbsFolder*)Obj);
+		CdGDSObj *Old = virtual_replace(Dir, nm, replace_flag, List,
+			"sources");
+		CdComputedArray::CheckExpression(Dir.GDSFile(), expr, &Names[0],
+			&List[0], n);
+		int IdxReplace = -1;
+		if (Old)
+		{
+			IdxReplace = Dir.IndexObj(Old);
+			GDS_Node_Delete(Old, TRUE);
+		}
+
+		CdComputedArray *vObj = new CdComputedArray;
+		Dir.InsertObj(IdxReplace, nm, vObj);
+		try {
+			vObj->SetExpression(expr, &Names[0], &List[0], n);
+		}
+		catch (...) {
+			Dir.DeleteObj(vObj, true);
+			throw;
+		}
+
+		// hidden flag
+		if (Rf_asLogical(Visible) != TRUE)
+		{
+			vObj->SetHidden(true);
+			vObj->Attribute().Add(STR_INVISIBLE);
+		}
+
+		rv_ans = GDS_R_Obj2SEXP(vObj);
+
+	COREARRAY_CATCH
+}
+
+
 /// Add a new node with a GDS file
 /** \param Node        [in] a GDS node
  *  \param NodeName    [in] the name of a new node
@@ -2158,6 +2408,162 @@ COREARRAY_DLL_EXPORT SEXP gdsObjReadData(SEXP Node, SEXP Start, SEXP Count,
 }
 
 
+/// Read multiple hyperslabs from a node
+/** \param Node        [in] a GDS node
+ *  \param Start       [in] the starting positions, one column per hyperslab
+ *  \param Count       [in] the counts of each dimension, one column per hyperslab
+ *  \param Simplify    [in] convert to a vector if possible
+ *  \param UseRaw      [in] if TRUE, use RAW if possible
+ *  \param ValList     [in] a list of '.value' and '.substitute'
+**/
+COREARRAY_DLL_EXPORT SEXP gdsObjReadMulti(SEXP Node, SEXP Start, SEXP Count,
+	SEXP Simplify, SEXP UseRaw, SEXP ValList)
+{
+	extern SEXP gdsDataFmt(SEXP Result, SEXP Simplify, SEXP ValList);
+
+	if (!Rf_isNumeric(Start))
+		Rf_error("'start' should be numeric.");
+	if (!Rf_isNumeric(Count))
+		Rf_error("'count' should be numeric.");
+
+	int use_raw_flag = Rf_asLogical(UseRaw);
+	if (use_raw_flag == NA_LOGICAL)
+		Rf_error("'.useraw' must be TRUE or FALSE.");
+
+	COREARRAY_TRY
+
+		// GDS object
+		CdAbstractArray *Obj =
+			dynamic_cast<CdAbstractArray*>(GDS_R_SEXP2Obj(Node, TRUE));
+		if (Obj == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+
+		const int Len = Obj->DimCnt();
+		CdAbstractArray::TArrayDim DCnt;
+		Obj->GetDim(DCnt);
+		if (XLENGTH(Start) != XLENGTH(Count))
+			throw ErrGDSFmt("'start' and 'count' should have the same size.");
+		if ((Len <= 0) || !Rf_isMatrix(Start) || (Rf_nrows(Start) != Len))
+			throw ErrGDSFmt("The number of rows in 'start' should be %d.", Len);
+		if (!Rf_isMatrix(Count) || (Rf_nrows(Count) != Len))
+			throw ErrGDSFmt("The number of rows in 'count' should be %d.", Len);
+		const int NumSlab = Rf_ncols(Start);
+
+		// hyperslabs
+		Start = PROTECT(Rf_coerceVector(Start, INTSXP));
+		Count = PROTECT(Rf_coerceVector(Count, INTSXP));
+		vector<C_Int32> DStart(XLENGTH(Start)), DLen(XLENGTH(Start));
+		vector<C_Int64> NumElm(NumSlab);
+		C_Int64 TotalCount = 0;
+		for (int j=0; j < NumSlab; j++)
+		{
+			const int *ps = INTEGER(Start) + (size_t)j*Len;
+			const int *pc = INTEGER(Count) + (size_t)j*Len;
+			C_Int32 *s = &DStart[(size_t)j*Len], *c = &DLen[(size_t)j*Len];
+			C_Int64 n = 1;
+			for (int i=0; i < Len; i++)
+			{
+				int k = Len - i - 1;
+				int v = ps[i];
+				if ((v < 1) || (v > DCnt[k]))
+					throw ErrGDSFmt("'start[,%d]' is invalid.", j+1);
+				s[k] = v - 1;
+				v = pc[i];
+				if (v == -1) v = DCnt[k] - s[k];
+				if ((v < 0) || ((s[k] + v) > DCnt[k]))
+					throw ErrGDSFmt("'count[,%d]' is invalid.", j+1);
+				c[k] = v;
+				n *= v;
+			}
+			NumElm[j] = n;
+			TotalCount += n;
+		}
+
+		// the data type in R
+		SEXPTYPE RType;
+		C_SVType SV;
+		int ExtType = 0;
+		if (COREARRAY_SV_INTEGER(Obj->SVType()))
+		{
+			ExtType = GDS_R_Is_ExtType(Obj);
+			SV = svInt32;
+			if (ExtType == GDS_R_ExtType_Logical)
+				RType = LGLSXP;
+			else if (use_raw_flag && (Obj->BitOf() <= 8) && (ExtType == 0))
+				{ RType = RAWSXP; SV = svInt8; }
+			else
+				RType = INTSXP;
+		} else if (COREARRAY_SV_FLOAT(Obj->SVType()))
+		{
+			RType = REALSXP; SV = svFloat64;
+		} else if (COREARRAY_SV_STRING(Obj->SVType()))
+		{
+			RType = STRSXP; SV = svStrUTF8;
+		} else
+			throw ErrGDSFmt("Invalid SVType of array-oriented object.");
+
+		// allocate the output
+		rv_ans = PROTECT(NEW_LIST(NumSlab));
+		vector<void*> Buffer(NumSlab, (void*)NULL);
+		for (int j=0; j < NumSlab; j++)
+		{
+			SEXP val = Rf_allocVector(RType, NumElm[j]);
+			SET_VECTOR_ELT(rv_ans, j, val);
+			if (Len > 1)
+			{
+				SEXP dim = PROTECT(NEW_INTEGER(Len));
+				int *p = INTEGER(dim);
+				for (int k=Len-1; k >= 0; k--)
+					*p++ = DLen[(size_t)j*Len + k];
+				SET_DIM(val, dim);
+				UNPROTECT(1);
+			}
+			if (ExtType == GDS_R_ExtType_Factor)
+				UNPROTECT(GDS_R_Set_IfFactor(Obj, val));
+			switch (RType)
+			{
+				case LGLSXP:  Buffer[j] = LOGICAL(val); break;
+				case RAWSXP:  Buffer[j] = RAW(val); break;
+				case INTSXP:  Buffer[j] = INTEGER(val); break;
+				case REALSXP: Buffer[j] = REAL(val); break;
+				default: break;
+			}
+		}
+
+		// read data
+		if (TotalCount > 0)
+		{
+			if (RType == STRSXP)
+			{
+				vector<UTF8String> strbuf(TotalCount);
+				Buffer[0] = &strbuf[0];
+				Obj->ReadDataMulti(NumSlab, &DStart[0], &DLen[0], &Buffer[0], SV);
+				UTF8String *s = &strbuf[0];
+				for (int j=0; j < NumSlab; j++)
+				{
+					SEXP val = VECTOR_ELT(rv_ans, j);
+					for (C_Int64 i=0; i < NumElm[j]; i++, s++)
+					{
+						SET_STRING_ELT(val, i,
+							Rf_mkCharLenCE(s->c_str(), s->size(), CE_UTF8));
+					}
+				}
+			} else
+				Obj->ReadDataMulti(NumSlab, &DStart[0], &DLen[0], &Buffer[0], SV);
+		}
+
+		// format
+		for (int j=0; j < NumSlab; j++)
+		{
+			SET_VECTOR_ELT(rv_ans, j,
+				gdsDataFmt(VECTOR_ELT(rv_ans, j), Simplify, ValList));
+		}
+		UNPROTECT(3);
+
+	COREARRAY_CATCH
+}
+
+
 /// Read data from a node with a selection
 /** \param Node        [in] a GDS node
  *  \param Selection   [in] the logical variable of selection
@@ -2927,6 +3333,133 @@ COREARRAY_DLL_EXPORT SEXP gdsAssign(SEXP Dest, SEXP Src)
 }
 
 
+/// the parameter of 'pipeline_aperm'
+struct COREARRAY_DLL_LOCAL TPipelinePerm
+{
+	vector<int> Perm;  ///< 0-based permutation of the margin in R order
+};
+
+/// permute the dimensions of a margin, as 'aperm' in R
+static void pipeline_aperm(const void *In, void *Out,
+	const CdArrayPipeline::TMargin &M, void *Param)
+{
+	const vector<int> &P = ((TPipelinePerm*)Param)->Perm;
+	const int K = P.size();
+	// the dimensions and strides of the margin in R order
+	const int RMargin = M.DimCnt - 1 - M.Margin;
+	vector<C_Int64> D, S(K), DOut(K), SOut(K), Idx(K, 0);
+	for (int i=0; i < M.DimCnt; i++)
+		if (i != RMargin) D.push_back(M.DimLen[M.DimCnt - 1 - i]);
+	for (int i=0; i < K; i++)
+		S[i] = (i > 0) ? S[i-1] * D[i-1] : 1;
+	for (int j=0; j < K; j++)
+	{
+		DOut[j] = D[P[j]];
+		SOut[j] = S[P[j]];
+	}
+
+	C_Int64 off = 0;
+	for (C_Int64 n=0; n < M.Count; n++)
+	{
+		if (M.SVType == svStrUTF8)
+			((UTF8String*)Out)[n] = ((const UTF8String*)In)[off];
+		else
+			memcpy((C_UInt8*)Out + n*M.ElmSize,
+				(const C_UInt8*)In + off*M.ElmSize, M.ElmSize);
+		// the next index in the output
+		for (int j=0; j < K; j++)
+		{
+			off += SOut[j];
+			if (++Idx[j] < DOut[j]) break;
+			off -= SOut[j] * DOut[j];
+			Idx[j] = 0;
+		}
+	}
+}
+
+/// Append the margins of a node to another node in a pipeline
+/** \param Node        [in] the source GDS node
+ *  \param Margin      [in] the margin dimension (starting from 1)
+ *  \param Selection   [in] NULL, or a list of NULL, logical or raw vectors
+ *  \param Target      [in] the target GDS node
+ *  \param Perm        [in] NULL, or the permutation of dimensions in a margin
+**/
+COREARRAY_DLL_EXPORT SEXP gdsPipeline(SEXP Node, SEXP Margin, SEXP Selection,
+	SEXP Target, SEXP Perm)
+{
+	COREARRAY_TRY
+
+		CdAbstractArray *Src =
+			dynamic_cast<CdAbstractArray*>(GDS_R_SEXP2Obj(Node, TRUE));
+		CdAbstractArray *Dst =
+			dynamic_cast<CdAbstractArray*>(GDS_R_SEXP2Obj(Target, FALSE));
+		if (!Src || !Dst)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		const int DimCnt = Src->DimCnt();
+
+		int margin = Rf_asInteger(Margin);
+		if ((margin == NA_INTEGER) || (margin < 1) || (margin > DimCnt))
+			throw ErrGDSFmt("'margin' is not valid.");
+		margin = DimCnt - margin;
+
+		// selection
+		vector< vector<C_BOOL> > Select;
+		const C_BOOL *SelPtr[CdAbstractArray::MAX_ARRAY_DIM];
+		if (!Rf_isNull(Selection))
+		{
+			if (!Rf_isNewList(Selection) || (XLENGTH(Selection) != DimCnt))
+				throw ErrGDSFmt("'selection' should be a list of %d element(s).",
+					DimCnt);
+			Select.resize(DimCnt);
+			for (int i=0; i < DimCnt; i++)
+			{
+				SEXP elmt = VECTOR_ELT(Selection, i);
+				const int k = DimCnt - i - 1, Len = Src->GetDLen(k);
+				Select[k].resize(Len + 1, TRUE);  // not empty if Len = 0
+				if (Rf_isLogical(elmt) && (XLENGTH(elmt) == Len))
+				{
+					for (int j=0; j < Len; j++)
+						Select[k][j] = (LOGICAL(elmt)[j] == TRUE);
+				} else if ((TYPEOF(elmt) == RAWSXP) && (XLENGTH(elmt) == Len))
+				{
+					for (int j=0; j < Len; j++)
+						Select[k][j] = (RAW(elmt)[j] != 0);
+				} else if (!Rf_isNull(elmt))
+					throw ErrGDSFmt("Invalid 'selection[[%d]]'.", i+1);
+				SelPtr[k] = &Select[k][0];
+			}
+		}
+
+		// permutation
+		TPipelinePerm P;
+		if (!Rf_isNull(Perm))
+		{
+			if (XLENGTH(Perm) != DimCnt - 1)
+				throw ErrGDSFmt("'perm' should have %d element(s).", DimCnt-1);
+			vector<bool> flag(DimCnt - 1, false);
+			for (int i=0; i < DimCnt - 1; i++)
+			{
+				int v = Rf_isReal(Perm) ? (int)REAL(Perm)[i] : INTEGER(Perm)[i];
+				if ((v < 1) || (v >= DimCnt) || flag[v-1])
+					throw ErrGDSFmt("'perm' is not valid.");
+				flag[v-1] = true;
+				P.Perm.push_back(v - 1);
+			}
+		}
+
+		SetMemoryLimit();
+		CdArrayPipeline Pipe;
+		Pipe.Run(*Src, margin, Select.empty() ? NULL : SelPtr, *Dst,
+			P.Perm.empty() ? NULL : pipeline_aperm, &P);
+	}
+	catch (ErrAllocWrite &E) {
+		GDS_SetError(ERR_READ_ONLY);
+		has_error = true;
+
+	COREARRAY_CATCH
+}
+
+
 /// Set the dimension of data to a node
 /** \param Node        [in] a GDS node
  *  \param DLen        [in] the new sizes of dimension
@@ -3257,9 +3790,9 @@ COREARRAY_DLL_EXPORT SEXP gdsSystem()
 	COREARRAY_TRY
 
 		int nProtect = 0;
-		PROTECT(rv_ans = NEW_LIST(10));
+		PROTECT(rv_ans = NEW_LIST(13));
 		nProtect ++;
-		SEXP nm = PROTECT(NEW_CHARACTER(10));
+		SEXP nm = PROTECT(NEW_CHARACTER(13));
 		nProtect ++;
 		SET_NAMES(rv_ans, nm);
 
@@ -3403,6 +3936,94 @@ COREARRAY_DLL_EXPORT SEXP gdsSystem()
 			SET_STRING_ELT(Desp, i, Rf_mkChar(desp[i].c_str()));
 		}
 
+		// memory governor
+		SEXP Mem = PROTECT(NEW_NUMERIC(5));
+		nProtect ++;
+		SET_ELEMENT(rv_ans, 10, Mem);
+		SET_STRING_ELT(nm, 10, Rf_mkChar("memory.governor"));
+		CdMemGovernor &G = MemGovernor();
+		REAL(Mem)[0] = (G.Limit() > 0) ? (double)G.Limit() : R_PosInf;
+		REAL(Mem)[1] = G.Used();
+		REAL(Mem)[2] = G.Peak();
+		REAL(Mem)[3] = G.NumAcquire();
+		REAL(Mem)[4] = G.NumShrink();
+		SEXP MemNm = PROTECT(NEW_CHARACTER(5));
+		nProtect ++;
+		SET_NAMES(Mem, MemNm);
+		SET_STRING_ELT(MemNm, 0, Rf_mkChar("limit"));
+		SET_STRING_ELT(MemNm, 1, Rf_mkChar("used"));
+		SET_STRING_ELT(MemNm, 2, Rf_mkChar("peak"));
+		SET_STRING_ELT(MemNm, 3, Rf_mkChar("num.acquire"));
+		SET_STRING_ELT(MemNm, 4, Rf_mkChar("num.shrink"));
+
+		// shared cache of decompressed blocks
+		SEXP BC = PROTECT(NEW_NUMERIC(6));
+		nProtect ++;
+		SET_ELEMENT(rv_ans, 11, BC);
+		SET_STRING_ELT(nm, 11, Rf_mkChar("block.cache"));
+		CdBlockCache::TStat St;
+		int nAttach = CdBlockCache::GetAllStat(St);
+		REAL(BC)[0] = (double)CdBlockCache::DefaultLimit();
+		REAL(BC)[1] = nAttach;
+		REAL(BC)[2] = St.Used;
+		REAL(BC)[3] = St.Hit;
+		REAL(BC)[4] = St.Miss;
+		REAL(BC)[5] = St.Evict;
+		SEXP BCNm = PROTECT(NEW_CHARACTER(6));
+		nProtect ++;
+		SET_NAMES(BC, BCNm);
+		SET_STRING_ELT(BCNm, 0, Rf_mkChar("limit"));
+		SET_STRING_ELT(BCNm, 1, Rf_mkChar("num.file"));
+		SET_STRING_ELT(BCNm, 2, Rf_mkChar("used"));
+		SET_STRING_ELT(BCNm, 3, Rf_mkChar("hit"));
+		SET_STRING_ELT(BCNm, 4, Rf_mkChar("miss"));
+		SET_STRING_ELT(BCNm, 5, Rf_mkChar("evict"));
+
+		// NUMA nodes and the placement of worker threads, without applying
+		// 'options(gds.numa)'
+		const int nNode = Mach::GetNUMA_NumOfNodes();
+		SEXP Numa = PROTECT(NEW_LIST(4));
+		nProtect ++;
+		SET_ELEMENT(rv_ans, 12, Numa);
+		SET_STRING_ELT(nm, 12, Rf_mkChar("numa"));
+		SET_ELEMENT(Numa, 0, Rf_ScalarInteger(nNode));
+		SEXP CPU = NEW_CHARACTER(nNode);
+		SET_ELEMENT(Numa, 1, CPU);
+		for (int i=0; i < nNode; i++)
+		{
+			vector<int> cpu;
+			string s;
+			if (Mach::GetNUMA_NodeCPU(i, cpu))
+			{
+				// like "0-3,8-11"
+				for (size_t j=0; j < cpu.size(); )
+				{
+					size_t k = j;
+					while ((k+1 < cpu.size()) && (cpu[k+1] == cpu[k] + 1)) k ++;
+					char buf[64];
+					if (k > j)
+						FmtText(buf, sizeof(buf), "%d-%d", cpu[j], cpu[k]);
+					else
+						FmtText(buf, sizeof(buf), "%d", cpu[j]);
+					if (!s.empty()) s.append(",");
+					s.append(buf);
+					j = k + 1;
+				}
+			}
+			SET_STRING_ELT(CPU, i, s.empty() ? NA_STRING : Rf_mkChar(s.c_str()));
+		}
+		SET_ELEMENT(Numa, 2,
+			Rf_ScalarLogical(Parallel::ThreadPool().NumaPlacement()));
+		SET_ELEMENT(Numa, 3,
+			Rf_ScalarInteger(Parallel::ThreadPool().NumPinnedWorker()));
+		SEXP NumaNm = PROTECT(NEW_CHARACTER(4));
+		nProtect ++;
+		SET_NAMES(Numa, NumaNm);
+		SET_STRING_ELT(NumaNm, 0, Rf_mkChar("num.node"));
+		SET_STRING_ELT(NumaNm, 1, Rf_mkChar("cpu.list"));
+		SET_STRING_ELT(NumaNm, 2, Rf_mkChar("placement"));
+		SET_STRING_ELT(NumaNm, 3, Rf_mkChar("num.pinned"));
+
 		UNPROTECT(nProtect);
 
 	COREARRAY_CATCH
@@ -3420,6 +4041,13 @@ COREARRAY_DLL_EXPORT SEXP gdsApplySetStart(SEXP Idx)
 	return R_NilValue;
 }
 
+/// stop the decoding threads of apply.gdsn from the n-th (e.g., after an
+/// error in 'FUN'), and return the number of running ones
+COREARRAY_DLL_EXPORT SEXP gdsApplyStopDecoder(SEXP N)
+{
+	return Rf_ScalarInteger(ApplyDecoderStop(Rf_asInteger(N)));
+}
+
 
 struct COREARRAY_DLL_LOCAL TApplyStruct
 {
@@ -3691,10 +4319,11 @@ static void _apply_func_gdsnode(SEXP Argument, C_Int32 MarginIdx, void *_Param)
  *  \param rho         [in] the environment variable
  *  \param use_raw     [in] whether use RAW to represent data
  *  \param ValList     [in] a list of '.value' and '.substitute'
+ *  \param BufSize     [in] the memory budget of buffers, NA for the default
 **/
 COREARRAY_DLL_EXPORT SEXP gdsApplyCall(SEXP gds_nodes, SEXP margins,
 	SEXP FUN, SEXP selection, SEXP as_is, SEXP var_index, SEXP target_node,
-	SEXP rho, SEXP use_raw, SEXP ValList)
+	SEXP rho, SEXP use_raw, SEXP ValList, SEXP BufSize)
 {
 	int use_raw_flag = Rf_asLogical(use_raw);
 	if (use_raw_flag == NA_LOGICAL)
@@ -3914,6 +4543,29 @@ COREARRAY_DLL_EXPORT SEXP gdsApplyCall(SEXP gds_nodes, SEXP margins,
 			throw ErrGDSFmt("'var.index' is not valid!");
 
 
+		// -----------------------------------------------------------
+		// reading mode, prefetching if 'options(gds.prefetch=TRUE)', but not
+		// for as.is="gdsnode" since 'FUN' reads and writes the nodes
+		C_UInt32 use_mode = use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0;
+		if ((Rf_asLogical(Rf_GetOption1(Rf_install("gds.prefetch"))) == TRUE)
+				&& (strcmp(asRes, "gdsnode") != 0))
+			use_mode |= GDS_R_READ_PREFETCH;
+		// the number of threads decoding ahead, 'options(gds.apply.nthread)'
+		int nthread = Rf_asInteger(
+			Rf_GetOption1(Rf_install("gds.apply.nthread")));
+		if ((nthread != NA_INTEGER) && (nthread > 0))
+			use_mode |= GDS_R_READ_DECODE_THREAD(nthread > 255 ? 255 : nthread);
+		// showing the progress, 'options(gds.progress=TRUE)'
+		if (Rf_asLogical(Rf_GetOption1(Rf_install("gds.progress"))) == TRUE)
+			use_mode |= GDS_R_READ_PROGRESS;
+		set_numa_placement();
+
+		// the memory budget, and the process-wide limit of memory
+		// 'options(gds.memory.limit)' is set in GDS_R_Apply2()
+		double bufsize = Rf_asReal(BufSize);
+		C_Int64 buffer_size = (R_FINITE(bufsize) && (bufsize >= 0)) ?
+			(C_Int64)bufsize : -1;
+
 		// -----------------------------------------------------------
 		// as.is
 		// 0: none, 1: list, 2: integer, 3: double,
@@ -3921,53 +4573,53 @@ COREARRAY_DLL_EXPORT SEXP gdsApplyCall(SEXP gds_nodes, SEXP margins,
 		if (strcmp(asRes, "none") == 0)
 		{
 			a_struct.DatType = 0;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_none, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "list") == 0)
 		{
 			a_struct.DatType = 1;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_list, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "integer") == 0)
 		{
 			a_struct.DatType = 2;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_integer, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "double") == 0)
 		{
 			a_struct.DatType = 3;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_double, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "character") == 0)
 		{
 			a_struct.DatType = 4;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_char, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "logical") == 0)
 		{
 			a_struct.DatType = 5;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_logical, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "raw") == 0)
 		{
 			a_struct.DatType = 6;
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_raw, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else if (strcmp(asRes, "gdsnode") == 0)
 		{
 			a_struct.DatType = 7;
 			a_struct.pTarget = &Targets[0];
 			a_struct.nTarget = Targets.size();
-			GDS_R_Apply(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
+			GDS_R_Apply2(nObject, &ObjList[0], &Margin[0], &sel_ptr[0],
 				_apply_initfunc, _apply_func_gdsnode, &a_struct, TRUE,
-				(use_raw_flag ? GDS_R_READ_ALLOW_RAW_TYPE : 0));
+				use_mode, buffer_size);
 		} else
 			throw ErrGDSFmt("'as.is' is not valid!");
 
@@ -4186,6 +4838,123 @@ COREARRAY_DLL_EXPORT SEXP gdsApplyCreateSelection(SEXP gds_nodes,
 }
 
 
+/// Called by 'clusterApply.gdsn', split the selected margins into parts
+/// aligned to the compressed blocks of the first node
+/** \param gds_nodes   [in] a list of objects of 'gdsn' class
+ *  \param margin      [in] the margin index of the first node starting from 1
+ *  \param selection   [in] the selection of the first node, returned from
+ *                     gdsApplyCreateSelection
+ *  \param num         [in] the number of parts
+ *  \return a list of 'count' (the numbers of selected margins in the parts)
+ *          and 'block' (the raw and compressed sizes of blocks of each node,
+ *          or NULL if not compressed with random access)
+**/
+COREARRAY_DLL_EXPORT SEXP gdsApplySplitMargin(SEXP gds_nodes, SEXP margin,
+	SEXP selection, SEXP num)
+{
+	int n = Rf_asInteger(num);
+	COREARRAY_TRY
+
+		const int nObject = Rf_length(gds_nodes);
+		PdAbstractArray Obj = dynamic_cast<PdAbstractArray>(
+			GDS_R_SEXP2Obj(VECTOR_ELT(gds_nodes, 0), TRUE));
+		if (!Obj)
+			throw ErrGDSFmt("'node.names[[1]]' should be array-based!");
+		const int Margin = Obj->DimCnt() - Rf_asInteger(margin);
+		if ((Margin < 0) || (Margin >= Obj->DimCnt()))
+			throw ErrGDSFmt("'margin' is not valid according to 'node.names[[1]]'!");
+
+		// the selection along the margin
+		C_Int32 DLen[GDS_MAX_NUM_DIMENSION];
+		Obj->GetDim(DLen);
+		SEXP sel = VECTOR_ELT(selection, Obj->DimCnt() - Margin - 1);
+		if (!Rf_isLogical(sel) || (XLENGTH(sel) != DLen[Margin]))
+			throw ErrGDSFmt("Invalid 'selection'.");
+		vector<C_BOOL> Sel(DLen[Margin]);
+		int *p = LOGICAL(sel);
+		for (C_Int32 i=0; i < DLen[Margin]; i++)
+			Sel[i] = (p[i] == TRUE);
+
+		// split
+		vector<C_Int32> Split;
+		if (n < 1) n = 1;
+		Split_ArrayRead_Margin(*Obj, Margin, &Sel[0], n, Split);
+
+		int nProtected = 0;
+		PROTECT(rv_ans = NEW_LIST(2));
+		nProtected ++;
+		SEXP cnt = NEW_INTEGER(Split.size() - 1);
+		SET_ELEMENT(rv_ans, 0, cnt);
+		for (size_t k=0; k+1 < Split.size(); k++)
+		{
+			int m = 0;
+			for (C_Int32 i=Split[k]; i < Split[k+1]; i++)
+				if (Sel[i]) m ++;
+			INTEGER(cnt)[k] = m;
+		}
+
+		// the block lists handed over to the workers
+		SEXP blk = NEW_LIST(nObject);
+		SET_ELEMENT(rv_ans, 1, blk);
+		for (int j=0; j < nObject; j++)
+		{
+			CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(
+				GDS_R_SEXP2Obj(VECTOR_ELT(gds_nodes, j), TRUE));
+			vector<SIZE64> RawSize, CmpSize;
+			if (Arr && Arr->GetRABlockInfo(RawSize, CmpSize))
+			{
+				SEXP b = NEW_LIST(2);
+				SET_ELEMENT(blk, j, b);
+				SEXP r = NEW_NUMERIC(RawSize.size());
+				SET_ELEMENT(b, 0, r);
+				SEXP c = NEW_NUMERIC(CmpSize.size());
+				SET_ELEMENT(b, 1, c);
+				for (size_t i=0; i < RawSize.size(); i++)
+				{
+					REAL(r)[i] = RawSize[i];
+					REAL(c)[i] = CmpSize[i];
+				}
+			}
+		}
+		UNPROTECT(nProtected);
+
+	COREARRAY_CATCH
+}
+
+
+/// Called by the workers of 'clusterApply.gdsn', set the block lists
+/** \param gds_nodes   [in] a list of objects of 'gdsn' class
+ *  \param block       [in] the 'block' returned from gdsApplySplitMargin
+ *  \return the number of nodes using the lists
+**/
+COREARRAY_DLL_EXPORT SEXP gdsApplySetBlockInfo(SEXP gds_nodes, SEXP block)
+{
+	COREARRAY_TRY
+
+		int cnt = 0;
+		const int nObject = Rf_length(gds_nodes);
+		for (int j=0; (j < nObject) && (j < Rf_length(block)); j++)
+		{
+			SEXP b = VECTOR_ELT(block, j);
+			CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(
+				GDS_R_SEXP2Obj(VECTOR_ELT(gds_nodes, j), TRUE));
+			if (Arr && !Rf_isNull(b))
+			{
+				SEXP r = VECTOR_ELT(b, 0), c = VECTOR_ELT(b, 1);
+				vector<SIZE64> RawSize(XLENGTH(r)), CmpSize(XLENGTH(c));
+				for (size_t i=0; i < RawSize.size(); i++)
+					RawSize[i] = (SIZE64)REAL(r)[i];
+				for (size_t i=0; i < CmpSize.size(); i++)
+					CmpSize[i] = (SIZE64)REAL(c)[i];
+				if (Arr->SetRABlockInfo(RawSize, CmpSize)) cnt ++;
+			}
+		}
+		rv_ans = Rf_ScalarInteger(cnt);
+
+	COREARRAY_CATCH
+}
+
+
 /// format
 COREARRAY_DLL_EXPORT SEXP gdsFmtSize(SEXP size_in_byte)
 {
@@ -4250,6 +5019,342 @@ COREARRAY_DLL_EXPORT SEXP gds_test_Class(SEXP ClassName)
 }
 
 
+/// Read numeric data with integer indices, for testing ReadDataIdx()
+/** \param Node        [in] a GDS node
+ *  \param Index       [in] a list of one-based indices or NULL for each
+ *                          dimension, in the order of R
+**/
+COREARRAY_DLL_EXPORT SEXP gds_test_ReadIdx(SEXP Node, SEXP Index)
+{
+	COREARRAY_TRY
+
+		CdAbstractArray *Obj =
+			dynamic_cast<CdAbstractArray*>(GDS_R_SEXP2Obj(Node, TRUE));
+		if (!Obj)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		const int DCnt = Obj->DimCnt();
+		if (Rf_length(Index) != DCnt)
+			throw ErrGDSFmt("The dimension of 'index' is not correct.");
+
+		vector< vector<C_Int32> > Idx(DCnt);
+		vector<const C_Int32*> IdxPtr(DCnt);
+		vector<C_Int32> IdxCnt(DCnt);
+		R_xlen_t Total = 1;
+		for (int i=0; i < DCnt; i++)
+		{
+			SEXP v = VECTOR_ELT(Index, i);
+			int k = DCnt - i - 1;
+			if (Rf_isNull(v))
+			{
+				IdxPtr[k] = NULL;
+				IdxCnt[k] = Obj->GetDLen(k);
+			} else {
+				if (!Rf_isInteger(v))
+					throw ErrGDSFmt("'index[[%d]]' should be integers.", i+1);
+				Idx[k].resize(Rf_length(v) + 1);
+				for (int j=0; j < Rf_length(v); j++)
+					Idx[k][j] = INTEGER(v)[j] - 1;
+				IdxPtr[k] = &Idx[k][0];
+				IdxCnt[k] = Rf_length(v);
+			}
+			Total *= IdxCnt[k];
+		}
+
+		rv_ans = PROTECT(NEW_NUMERIC(Total));
+		Obj->ReadDataIdx(&IdxPtr[0], &IdxCnt[0], REAL(rv_ans), svFloat64);
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+/// the parameters of gds_test_ReadParallel()
+struct COREARRAY_DLL_LOCAL TTestReadParallel
+{
+	C_Int64 MCnt;          ///< the number of elements in a margin
+	double *Sum;           ///< the sum of each margin
+	vector<C_Int32> Order; ///< the order of calls if ordered
+	bool Ordered;
+};
+
+static void test_read_parallel(int iThread, C_Int32 Idx, void *Buffer,
+	void *Param)
+{
+	TTestReadParallel &P = *((TTestReadParallel*)Param);
+	const double *p = (const double*)Buffer;
+	double s = 0;
+	for (C_Int64 i=0; i < P.MCnt; i++) s += p[i];
+	P.Sum[Idx] = s;
+	if (P.Ordered) P.Order.push_back(Idx);
+}
+
+/// Sum each margin with GDS_ArrayRead_Parallel(), for testing
+/** \param Node        [in] a GDS node
+ *  \param Margin      [in] the margin starting from 1, in the order of R
+ *  \param Selection   [in] a list of logical vectors or NULL, or NULL
+ *  \param NThread     [in] the number of threads
+ *  \param Ordered     [in] whether the margins are delivered in order
+**/
+COREARRAY_DLL_EXPORT SEXP gds_test_ReadParallel(SEXP Node, SEXP Margin,
+	SEXP Selection, SEXP NThread, SEXP Ordered)
+{
+	COREARRAY_TRY
+
+		CdAbstractArray *Obj =
+			dynamic_cast<CdAbstractArray*>(GDS_R_SEXP2Obj(Node, TRUE));
+		if (!Obj)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		const int DCnt = Obj->DimCnt();
+		const int margin = DCnt - Rf_asInteger(Margin);
+		if ((margin < 0) || (margin >= DCnt))
+			throw ErrGDSFmt("'margin' is not valid.");
+
+		// selection
+		vector< vector<C_BOOL> > Sel(DCnt);
+		const C_BOOL *SelPtr[CdAbstractArray::MAX_ARRAY_DIM];
+		C_Int64 MCnt = 1;
+		C_Int32 Cnt = 0;
+		for (int k=0; k < DCnt; k++)
+		{
+			const int Len = Obj->GetDLen(k);
+			SEXP v = Rf_isNull(Selection) ? R_NilValue :
+				VECTOR_ELT(Selection, DCnt - k - 1);
+			Sel[k].resize(Len + 1, TRUE);
+			if (!Rf_isNull(v))
+			{
+				if (!Rf_isLogical(v) || (XLENGTH(v) != Len))
+					throw ErrGDSFmt("Invalid 'selection'.");
+				for (int j=0; j < Len; j++)
+					Sel[k][j] = (LOGICAL(v)[j] == TRUE);
+			}
+			SelPtr[k] = &Sel[k][0];
+			C_Int32 n = 0;
+			for (int j=0; j < Len; j++) n += Sel[k][j] ? 1 : 0;
+			if (k == margin) Cnt = n; else MCnt *= n;
+		}
+
+		TTestReadParallel P;
+		P.MCnt = MCnt;
+		P.Ordered = (Rf_asLogical(Ordered) == TRUE);
+		rv_ans = PROTECT(NEW_LIST(2));
+		SEXP Sum = NEW_NUMERIC(Cnt);
+		SET_VECTOR_ELT(rv_ans, 0, Sum);
+		P.Sum = REAL(Sum);
+		for (C_Int32 i=0; i < Cnt; i++) P.Sum[i] = R_NaN;
+		GDS_ArrayRead_Parallel(Obj, margin, svFloat64, SelPtr,
+			Rf_asInteger(NThread), P.Ordered, test_read_parallel, &P);
+		SEXP Order = NEW_INTEGER(P.Order.size());
+		SET_VECTOR_ELT(rv_ans, 1, Order);
+		for (size_t i=0; i < P.Order.size(); i++)
+			INTEGER(Order)[i] = P.Order[i] + 1;
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+/// Return the maximum number of ranges decoded ahead by the worker threads
+/// in the last apply.gdsn with 'options(gds.apply.nthread)', for testing
+COREARRAY_DLL_EXPORT SEXP gds_test_ApplyDecoder()
+{
+	return Rf_ScalarInteger(ApplyDecoderMaxAhead);
+}
+
+
+/// the parameters of gds_test_RefCount()
+struct TTestRefCount
+{
+	CdRef *Obj;
+	int NRep;
+};
+
+static void test_ref_count(CdThread *Thread, int Index, void *Param)
+{
+	TTestRefCount *P = (TTestRefCount*)Param;
+	for (int i=0; i < P->NRep; i++) P->Obj->AddRef();
+	for (int i=0; i < P->NRep; i++) P->Obj->Release();
+}
+
+/// Hold and release an object by several threads, for testing
+/** \param NThread     [in] the number of threads
+ *  \param NRep        [in] the number of references held by each thread
+ *  \return the reference count afterward, which should be one
+**/
+COREARRAY_DLL_EXPORT SEXP gds_test_RefCount(SEXP NThread, SEXP NRep)
+{
+	COREARRAY_TRY
+
+		TTestRefCount P;
+		P.Obj = new CdRef;
+		P.Obj->AddRef();
+		P.NRep = Rf_asInteger(NRep);
+		Parallel::ThreadPool().Run(test_ref_count, &P, Rf_asInteger(NThread));
+		rv_ans = Rf_ScalarInteger(P.Obj->Reference());
+		P.Obj->Release();
+
+	COREARRAY_CATCH
+}
+
+
+/// the items of gds_test_ThreadPool()
+struct TTestThreadPool
+{
+	vector<int> Done;  ///< the number of calls for each item
+	void Proc(const C_Int32 &Idx, int &Out)
+	{
+		// uneven costs
+		volatile C_Int32 s = 0;
+		for (C_Int32 i=0; i < (Idx % 16) * 1000; i++) s += i & 1;
+		Out = Idx + 1;
+		Done[Idx] ++;
+	}
+	void Nested(CdThread *Thread, int Index)
+	{
+		Parallel::CParallelSection Sec(2);
+		vector<int> Out(16);
+		Sec.RunThreads(16, &TTestThreadPool::Proc, this, &Out[0], 16*Index);
+	}
+};
+
+static void test_thread_pool_error(CdThread *Thread, int Index, void *Param)
+{
+	if (Index == 1) throw Parallel::ErrParallel("error %d", Index);
+}
+
+/// Run the tasks on the thread pool, for testing
+/** \param NThread     [in] the number of threads
+ *  \param NItem       [in] the number of items
+ *  \return the numbers of items not called exactly once by CParallelSection,
+ *          CParallelSectionEx and the nested calls, whether the error message
+ *          is kept, and the number of pooled workers
+**/
+COREARRAY_DLL_EXPORT SEXP gds_test_ThreadPool(SEXP NThread, SEXP NItem)
+{
+	const int nThread = Rf_asInteger(NThread);
+	const int nItem = Rf_asInteger(NItem);
+
+	COREARRAY_TRY
+
+		TTestThreadPool P;
+		vector<int> Out(nItem);
+		rv_ans = PROTECT(NEW_INTEGER(5));
+		int *pAns = INTEGER(rv_ans);
+
+		// claiming the indices one by one
+		P.Done.assign(nItem, 0);
+		Parallel::CParallelSection Sec(nThread);
+		Sec.RunThreads(nItem, &TTestThreadPool::Proc, &P, &Out[0], 0);
+		pAns[0] = 0;
+		for (int i=0; i < nItem; i++)
+			if ((P.Done[i] != 1) || (Out[i] != i+1)) pAns[0] ++;
+
+		// claiming the sub-buffers
+		P.Done.assign(nItem, 0);
+		Parallel::CParallelSectionEx SecEx(nThread);
+		SecEx.RunThreads(nItem, 7, &TTestThreadPool::Proc, &P, &Out[0], 0);
+		pAns[1] = 0;
+		for (int i=0; i < nItem; i++)
+			if (P.Done[i] != 1) pAns[1] ++;
+
+		// nested calls
+		P.Done.assign(16*nThread, 0);
+		Parallel::CParallelBase Base(nThread);
+		Base.RunThreads(&TTestThreadPool::Nested, &P);
+		pAns[2] = 0;
+		for (int i=0; i < 16*nThread; i++)
+			if (P.Done[i] != 1) pAns[2] ++;
+
+		// the exception raised in a task
+		pAns[3] = 0;
+		try {
+			Parallel::ThreadPool().Run(test_thread_pool_error, NULL, nThread);
+		} catch (Parallel::ErrParallel &E) {
+			pAns[3] = (strcmp(E.what(), "error 1") == 0) ? 1 : 0;
+		}
+
+		pAns[4] = Parallel::ThreadPool().NumWorker();
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+/// Bind the calling thread to a NUMA node twice and release it, for testing
+/** \return whether it is bound, and whether the CPU affinity is restored,
+ *          or NULL if the CPU affinity is not supported
+**/
+COREARRAY_DLL_EXPORT SEXP gds_test_NumaAffinity()
+{
+#if defined(COREARRAY_PLATFORM_LINUX) && defined(CPU_SETSIZE)
+	cpu_set_t s0, s1;
+	if (sched_getaffinity(0, sizeof(s0), &s0) != 0)
+		return R_NilValue;
+	// the second binding should not replace the saved affinity
+	bool bound = Mach::SetNUMA_ThreadNode(0);
+	if (bound) bound = Mach::SetNUMA_ThreadNode(0);
+	bool restored = Mach::SetNUMA_ThreadNode(-1);
+	if (sched_getaffinity(0, sizeof(s1), &s1) != 0)
+		restored = false;
+	SEXP rv_ans = NEW_LOGICAL(2);
+	LOGICAL(rv_ans)[0] = bound;
+	LOGICAL(rv_ans)[1] = restored && CPU_EQUAL(&s0, &s1);
+	return rv_ans;
+#else
+	return R_NilValue;
+#endif
+}
+
+
+/// Return the numbers of finished and all margins of the running apply.gdsn
+/// by GDS_R_Apply_Progress(), for testing
+COREARRAY_DLL_EXPORT SEXP gds_test_ApplyProgress()
+{
+	C_Int64 Done=0, Total=0;
+	GDS_R_Apply_Progress(&Done, &Total);
+	SEXP rv_ans = NEW_NUMERIC(2);
+	REAL(rv_ans)[0] = Done;
+	REAL(rv_ans)[1] = Total;
+	return rv_ans;
+}
+
+
+static int test_apply_cancel(CdThread *Thread, void *Param)
+{
+	GDS_R_Apply_Cancel();
+	return 0;
+}
+
+/// Call GDS_R_Apply_Cancel() from another thread, for testing
+COREARRAY_DLL_EXPORT SEXP gds_test_ApplyCancel()
+{
+	COREARRAY_TRY
+
+		CdThread Thread;
+		Thread.BeginThread(test_apply_cancel, (void*)NULL);
+		Thread.EndThread();
+
+	COREARRAY_CATCH
+}
+
+
+/// Return the number of chunks in the arena of a GDS file, for testing
+COREARRAY_DLL_EXPORT SEXP gds_test_ArenaChunks(SEXP gdsfile)
+{
+	COREARRAY_TRY
+		CdArena *Arena = GDS_R_SEXP2File(gdsfile)->Arena();
+		rv_ans = Rf_ScalarInteger(Arena ? (int)Arena->ChunkCount() : 0);
+	COREARRAY_CATCH
+}
+
+/// Return the number of loaded nodes in a GDS file, for testing
+COREARRAY_DLL_EXPORT SEXP gds_test_NodeCacheCount(SEXP gdsfile)
+{
+	COREARRAY_TRY
+		rv_ans = Rf_ScalarInteger(GDS_R_SEXP2File(gdsfile)->NodeCacheCount());
+	COREARRAY_CATCH
+}
+
+
 COREARRAY_DLL_LOCAL void R_Init_RegCallMethods(DllInfo *info)
 {
 	#define CALL(name, num)    { #name, (DL_FUNC)&name, num }
@@ -4271,8 +5376,9 @@ COREARRAY_DLL_LOCAL void R_Init_RegCallMethods(DllInfo *info)
 		CALL(gdsNodeObjDesp, 1),
 		CALL(gdsAddNode, 11),           CALL(gdsAddFolder, 6),
 		CALL(gdsAddFile, 6),            CALL(gdsGetFile, 2),
+		CALL(gdsAddConcat, 5),          CALL(gdsAddCompute, 6),
 		CALL(gdsDeleteNode, 2),         CALL(gdsUnloadNode, 1),
-		CALL(gdsNodeValid, 1),
+		CALL(gdsNodeValid, 1),          CALL(gdsPipeline, 5),
 		CALL(gdsAssign, 2),             CALL(gdsMoveTo, 3),
 		CALL(gdsCopyTo, 3),             CALL(gdsCache, 1),
 
@@ -4283,11 +5389,14 @@ COREARRAY_DLL_LOCAL void R_Init_RegCallMethods(DllInfo *info)
 		CALL(gdsObjSetDim, 3),
 		CALL(gdsObjAppend, 3),          CALL(gdsObjAppend2, 2),
 		CALL(gdsObjReadData, 7),        CALL(gdsObjReadExData, 5),
+		CALL(gdsObjReadMulti, 6),
 		CALL(gdsObjWriteAll, 3),        CALL(gdsObjWriteData, 5),
 		CALL(gdsDataFmt, 3),
 	
-		CALL(gdsApplySetStart, 1),      CALL(gdsApplyCall, 10),
+		CALL(gdsApplySetStart, 1),      CALL(gdsApplyCall, 11),
+		CALL(gdsApplyStopDecoder, 1),
 		CALL(gdsApplyCreateSelection, 3),
+		CALL(gdsApplySplitMargin, 4),   CALL(gdsApplySetBlockInfo, 2),
 
 		CALL(gdsIsElement, 2),          CALL(gdsLastErrGDS, 0),
 		CALL(gdsSystem, 0),             CALL(gdsDigest, 3),